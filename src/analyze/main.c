@@ -0,0 +1,718 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Offline traffic analyzer for captures of the rmtdos protocol:
+//
+//   sudo tcpdump -i eth0 -w rmtdos.pcap ether proto 0x80ab
+//   out/rmtdos-analyze rmtdos.pcap
+//
+// Prints, per host, the traffic sent and received, the mix of packet types
+// and a histogram of frame sizes; per session (server, viewer, session id),
+// the video throughput and how the server refreshed the screen; and the
+// latencies that can be inferred from request / response pairs.
+//
+// The server sends the screen in "sweeps": consecutive V1_VGA_TEXT frames
+// from offset 0 to the end of the screen, started only when the screen's
+// checksum changed.  Every session's screen is rebuilt from the frames, so
+// the analyzer can tell how many bytes were resent unchanged, and when a
+// keystroke first caused a visible change (its "echo").
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <net/ethernet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/ethernet.h"
+#include "common/protocol.h"
+#include "liblinux/pcapfile.h"
+#include "liblinux/samples.h"
+
+#define MIN(x, y) ((x) > (y) ? (y) : (x))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+// Known packet types are 0..PKT_TYPE_COUNT-1.
+#define PKT_TYPE_COUNT (V1_STATS_RESP + 1)
+
+// Frame size histogram: buckets of HIST_BUCKET_LEN bytes, up to the largest
+// Ethernet frame.
+#define HIST_BUCKET_LEN 128
+#define HIST_BUCKETS ((ETH_FRAME_LEN + HIST_BUCKET_LEN) / HIST_BUCKET_LEN)
+
+// Width of the histogram bars.
+#define HIST_BAR_LEN 40
+
+// Bytes of VGA text memory that a session can address.
+#define SCREEN_BYTES 65536
+
+// Default for `-k`.
+#define DEFAULT_ECHO_TIMEOUT_MS 1000
+
+#define NS_PER_SEC 1000000000ULL
+#define NS_PER_US 1000ULL
+
+static const char *pkt_type_names[PKT_TYPE_COUNT] = {
+    "noop",    "ping",  "pong", "status_req", "status_resp",
+    "session", "video", "keys", "stats_req",  "stats_resp",
+};
+
+static const uint8_t broadcast_addr[ETH_ALEN] = {0xff, 0xff, 0xff,
+                                                 0xff, 0xff, 0xff};
+
+struct Host {
+  uint8_t addr[ETH_ALEN];
+
+  // Bit set of PKT_TYPEs sent; tells servers from viewers.
+  uint32_t types_sent;
+
+  uint64_t first_ns;
+  uint64_t last_ns;
+
+  uint64_t tx_frames;
+  uint64_t tx_bytes;
+  uint64_t rx_frames;
+  uint64_t rx_bytes;
+
+  uint64_t type_frames[PKT_TYPE_COUNT];
+  uint64_t type_bytes[PKT_TYPE_COUNT];
+  uint64_t size_hist[HIST_BUCKETS];
+
+  // Busiest second sent.
+  uint64_t sec;
+  uint64_t sec_bytes;
+  uint64_t peak_sec_bytes;
+
+  // As a viewer: when the last broadcast request was sent, for matching the
+  // responses of every server.
+  uint64_t bcast_ping_ns;
+  uint64_t bcast_status_ns;
+
+  // As a server: round trips of requests sent to it.
+  struct Samples ping_rtt;
+  struct Samples status_rtt;
+};
+
+struct Session {
+  struct Host *server;
+  struct Host *viewer;
+  uint32_t session_id;
+
+  uint64_t first_ns;
+  uint64_t last_ns;
+
+  // Pending requests from the viewer (0 if none).
+  uint64_t ping_ns;
+  uint64_t status_ns;
+  uint64_t start_ns;  // First V1_SESSION_START, until video arrives.
+  uint64_t key_ns;    // First keystroke not yet echoed.
+
+  uint64_t setup_us; // SESSION_START to first video; 0 if not seen.
+
+  uint64_t video_frames;
+  uint64_t video_bytes;   // On the wire.
+  uint64_t text_bytes;    // Screen bytes carried.
+  uint64_t changed_bytes; // Screen bytes that differed from before.
+  uint64_t key_frames;
+  uint64_t keystrokes;
+  uint64_t keys_no_echo;
+
+  // Sweeps (full screen refreshes).
+  int in_sweep;
+  uint64_t sweep_start_ns;
+  uint64_t sweep_frame_count;
+  struct VideoText sweep_first;
+  int sweep_torn;
+  uint64_t sweeps;
+  uint64_t sweep_frames;
+  uint64_t sweep_ns;
+  uint64_t torn_sweeps;
+  uint64_t partial_sweeps;
+
+  struct Samples echo;
+
+  uint8_t screen[SCREEN_BYTES];
+};
+
+struct Totals {
+  uint64_t frames;       // All frames in the capture.
+  uint64_t rmtdos;       // Matching ethertype.
+  uint64_t bad;          // Matching ethertype, but short or wrong signature.
+  uint64_t unknown_type; // Valid, but pkt_type not known.
+  uint64_t first_ns;
+  uint64_t last_ns;
+};
+
+static struct Host **g_hosts = NULL;
+static size_t g_host_count = 0;
+
+static struct Session **g_sessions = NULL;
+static size_t g_session_count = 0;
+
+static struct Totals g_totals;
+
+static uint64_t g_echo_timeout_ns = DEFAULT_ECHO_TIMEOUT_MS * 1000000ULL;
+
+static void *xrealloc(void *p, size_t size) {
+  p = realloc(p, size);
+  if (!p) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+// Linear search; captures hold few hosts, and consecutive frames are mostly
+// from the same one.
+static struct Host *host_find(const uint8_t *addr, uint64_t now_ns) {
+  static struct Host *last = NULL;
+
+  if (last && !memcmp(last->addr, addr, ETH_ALEN)) {
+    return last;
+  }
+
+  for (size_t i = 0; i < g_host_count; ++i) {
+    if (!memcmp(g_hosts[i]->addr, addr, ETH_ALEN)) {
+      return last = g_hosts[i];
+    }
+  }
+
+  struct Host *h = (struct Host *)calloc(1, sizeof(struct Host));
+  if (!h) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  memcpy(h->addr, addr, ETH_ALEN);
+  h->first_ns = now_ns;
+
+  g_hosts = (struct Host **)xrealloc(g_hosts,
+                                     (g_host_count + 1) * sizeof(*g_hosts));
+  g_hosts[g_host_count++] = h;
+  return last = h;
+}
+
+static struct Session *session_find(struct Host *server, struct Host *viewer,
+                                    uint32_t session_id, uint64_t now_ns) {
+  static struct Session *last = NULL;
+
+  if (last && (last->server == server) && (last->viewer == viewer) &&
+      (last->session_id == session_id)) {
+    return last;
+  }
+
+  for (size_t i = 0; i < g_session_count; ++i) {
+    struct Session *s = g_sessions[i];
+    if ((s->server == server) && (s->viewer == viewer) &&
+        (s->session_id == session_id)) {
+      return last = s;
+    }
+  }
+
+  struct Session *s = (struct Session *)calloc(1, sizeof(struct Session));
+  if (!s) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  s->server = server;
+  s->viewer = viewer;
+  s->session_id = session_id;
+  s->first_ns = now_ns;
+
+  g_sessions = (struct Session **)xrealloc(
+      g_sessions, (g_session_count + 1) * sizeof(*g_sessions));
+  g_sessions[g_session_count++] = s;
+  return last = s;
+}
+
+// Looks for the most recent request from `viewer` to `server`, by any
+// session id.  Returns NULL if none is known.
+static struct Session *session_find_any(const struct Host *server,
+                                        const struct Host *viewer) {
+  for (size_t i = g_session_count; i > 0; --i) {
+    struct Session *s = g_sessions[i - 1];
+    if ((s->server == server) && (s->viewer == viewer)) {
+      return s;
+    }
+  }
+  return NULL;
+}
+
+static void host_count_tx(struct Host *h, enum PKT_TYPE type, size_t len,
+                          uint64_t now_ns) {
+  const uint64_t sec = now_ns / NS_PER_SEC;
+
+  h->last_ns = now_ns;
+  h->types_sent |= 1U << type;
+  h->tx_frames++;
+  h->tx_bytes += len;
+  h->type_frames[type]++;
+  h->type_bytes[type] += len;
+  h->size_hist[MIN(len / HIST_BUCKET_LEN, HIST_BUCKETS - 1)]++;
+
+  if (sec != h->sec) {
+    h->sec = sec;
+    h->sec_bytes = 0;
+  }
+  h->sec_bytes += len;
+  h->peak_sec_bytes = MAX(h->peak_sec_bytes, h->sec_bytes);
+}
+
+// Time from `*req_ns` (cleared) or `bcast_ns` to now, if either is set.
+// `req_ns` may be NULL.
+static void match_response(struct Samples *samples, uint64_t *req_ns,
+                           uint64_t bcast_ns, uint64_t now_ns) {
+  const uint64_t t = MAX(req_ns ? *req_ns : 0, bcast_ns);
+
+  if (t && (t <= now_ns)) {
+    samples_add(samples, (now_ns - t) / NS_PER_US);
+  }
+  if (req_ns) {
+    *req_ns = 0;
+  }
+}
+
+// Keys older than the echo timeout are given up on.
+static void expire_keys(struct Session *s, uint64_t now_ns) {
+  if (s->key_ns && (now_ns - s->key_ns > g_echo_timeout_ns)) {
+    s->keys_no_echo++;
+    s->key_ns = 0;
+  }
+}
+
+static void sweep_end(struct Session *s, uint64_t now_ns, int complete) {
+  if (!s->in_sweep) {
+    return;
+  }
+
+  if (complete) {
+    s->sweeps++;
+    s->sweep_frames += s->sweep_frame_count;
+    s->sweep_ns += now_ns - s->sweep_start_ns;
+    s->torn_sweeps += s->sweep_torn;
+  } else {
+    s->partial_sweeps++;
+  }
+  s->in_sweep = 0;
+}
+
+static void process_video(struct Session *s, const uint8_t *payload,
+                          size_t payload_len, size_t wire_len,
+                          uint64_t now_ns) {
+  const struct VideoText *vt = (const struct VideoText *)payload;
+
+  s->video_frames++;
+  s->video_bytes += wire_len;
+
+  if (s->start_ns) {
+    s->setup_us = MAX(1, (now_ns - s->start_ns) / NS_PER_US);
+    s->start_ns = 0;
+  }
+
+  if (payload_len < sizeof(struct VideoText)) {
+    return;
+  }
+
+  const uint16_t offset = ntohs(vt->offset);
+  const size_t count =
+      MIN(ntohs(vt->count), payload_len - sizeof(struct VideoText));
+  const size_t screen_len = vt->text_rows * vt->text_cols * 2;
+  const uint8_t *text = (const uint8_t *)(vt + 1);
+
+  if (offset + count > SCREEN_BYTES) {
+    return;
+  }
+
+  // Sweeps always start at offset 0.
+  if (offset == 0) {
+    sweep_end(s, now_ns, 0);
+    s->in_sweep = 1;
+    s->sweep_start_ns = now_ns;
+    s->sweep_frame_count = 0;
+    s->sweep_first = *vt;
+    s->sweep_torn = 0;
+  }
+
+  if (s->in_sweep) {
+    s->sweep_frame_count++;
+
+    // The screen changed while this sweep was in flight, so the rows that it
+    // already sent were stale until the next sweep (if there is one).
+    if ((vt->text_rows != s->sweep_first.text_rows) ||
+        (vt->text_cols != s->sweep_first.text_cols) ||
+        (vt->cursor_row != s->sweep_first.cursor_row) ||
+        (vt->cursor_col != s->sweep_first.cursor_col)) {
+      s->sweep_torn = 1;
+    }
+  }
+
+  size_t changed = 0;
+  for (size_t i = 0; i < count; ++i) {
+    changed += (s->screen[offset + i] != text[i]);
+  }
+  memcpy(&s->screen[offset], text, count);
+
+  s->text_bytes += count;
+  s->changed_bytes += changed;
+
+  expire_keys(s, now_ns);
+  if (changed && s->key_ns) {
+    samples_add(&s->echo, (now_ns - s->key_ns) / NS_PER_US);
+    s->key_ns = 0;
+  }
+
+  if (screen_len && (offset + count >= screen_len)) {
+    sweep_end(s, now_ns, 1);
+  }
+}
+
+static void process_frame(const struct PcapPacket *pkt, uint16_t ethertype) {
+  const struct ether_header *eh = (const struct ether_header *)pkt->data;
+  const struct ProtocolHeader *ph = (const struct ProtocolHeader *)(eh + 1);
+  const uint64_t now_ns = pkt->time_ns;
+
+  g_totals.frames++;
+
+  if ((pkt->caplen < sizeof(struct ether_header)) ||
+      (ntohs(eh->ether_type) != ethertype)) {
+    return;
+  }
+
+  g_totals.rmtdos++;
+  if (!g_totals.first_ns) {
+    g_totals.first_ns = now_ns;
+  }
+  g_totals.last_ns = now_ns;
+
+  if ((pkt->caplen < COMBINED_HEADER_LEN) ||
+      (PACKET_SIGNATURE != ntohl(ph->signature))) {
+    g_totals.bad++;
+    return;
+  }
+
+  const uint16_t type = ntohs(ph->pkt_type);
+  if (type >= PKT_TYPE_COUNT) {
+    g_totals.unknown_type++;
+    return;
+  }
+
+  const uint32_t session_id = ntohl(ph->session_id);
+  const uint8_t *payload = (const uint8_t *)(ph + 1);
+  const size_t payload_len =
+      MIN(ntohs(ph->payload_len), pkt->caplen - COMBINED_HEADER_LEN);
+  const int to_broadcast = !memcmp(eh->ether_dhost, broadcast_addr, ETH_ALEN);
+
+  struct Host *src = host_find(eh->ether_shost, now_ns);
+  host_count_tx(src, (enum PKT_TYPE)type, pkt->len, now_ns);
+
+  struct Host *dst = NULL;
+  if (!(eh->ether_dhost[0] & 1)) {
+    dst = host_find(eh->ether_dhost, now_ns);
+    dst->rx_frames++;
+    dst->rx_bytes += pkt->len;
+    dst->last_ns = now_ns;
+  }
+
+  struct Session *s = NULL;
+  switch (type) {
+    case V1_PING:
+    case V1_STATUS_REQ:
+      if (to_broadcast) {
+        *(type == V1_PING ? &src->bcast_ping_ns : &src->bcast_status_ns) =
+            now_ns;
+      } else if (dst) {
+        s = session_find(dst, src, session_id, now_ns);
+        *(type == V1_PING ? &s->ping_ns : &s->status_ns) = now_ns;
+      }
+      break;
+
+    case V1_PONG:
+    case V1_STATUS_RESP:
+      if (!dst) {
+        break;
+      }
+      // Servers echo the session id only in video; match any request.
+      s = session_find_any(src, dst);
+      if (type == V1_PONG) {
+        match_response(&src->ping_rtt, s ? &s->ping_ns : NULL,
+                       dst->bcast_ping_ns, now_ns);
+      } else {
+        match_response(&src->status_rtt, s ? &s->status_ns : NULL,
+                       dst->bcast_status_ns, now_ns);
+      }
+      s = NULL;
+      break;
+
+    case V1_SESSION_START:
+      if (dst) {
+        s = session_find(dst, src, session_id, now_ns);
+        if (!s->video_frames && !s->start_ns) {
+          s->start_ns = now_ns;
+        }
+      }
+      break;
+
+    case V1_VGA_TEXT:
+      if (dst) {
+        s = session_find(src, dst, session_id, now_ns);
+        process_video(s, payload, payload_len, pkt->len, now_ns);
+      }
+      break;
+
+    case V1_INJECT_KEYSTROKE:
+      if (dst) {
+        s = session_find(dst, src, session_id, now_ns);
+        s->key_frames++;
+        s->keystrokes += payload_len / sizeof(struct Keystroke);
+        expire_keys(s, now_ns);
+        if (!s->key_ns) {
+          s->key_ns = now_ns;
+        }
+      }
+      break;
+  }
+
+  if (s) {
+    s->last_ns = now_ns;
+  }
+}
+
+static const char *format_addr(const uint8_t *a) {
+  static char buf[4][18];
+  static int next = 0;
+  char *p = buf[next++ % 4];
+
+  snprintf(p, 18, "%02x:%02x:%02x:%02x:%02x:%02x", a[0], a[1], a[2], a[3],
+           a[4], a[5]);
+  return p;
+}
+
+static const char *host_role(const struct Host *h) {
+  const uint32_t server = (1U << V1_PONG) | (1U << V1_STATUS_RESP) |
+                          (1U << V1_VGA_TEXT) | (1U << V1_STATS_RESP);
+  const uint32_t viewer = (1U << V1_PING) | (1U << V1_STATUS_REQ) |
+                          (1U << V1_SESSION_START) |
+                          (1U << V1_INJECT_KEYSTROKE) | (1U << V1_STATS_REQ);
+  const int is_server = !!(h->types_sent & server);
+  const int is_viewer = !!(h->types_sent & viewer);
+
+  if (is_server && is_viewer) {
+    return "both";
+  }
+  return is_server ? "server" : is_viewer ? "viewer" : "-";
+}
+
+static double secs_between(uint64_t first_ns, uint64_t last_ns) {
+  return (last_ns > first_ns) ? (last_ns - first_ns) / 1e9 : 0.0;
+}
+
+static void print_samples(const char *who, const char *what,
+                          struct Samples *s) {
+  if (!s->count) {
+    return;
+  }
+
+  printf("  %-28s %-8s ", who, what);
+  samples_print(s, 9);
+  printf("\n");
+}
+
+static void print_hosts() {
+  printf("\nHosts (bytes on the wire; B/s averaged over the host's activity)\n");
+  printf("  %-17s %-6s %9s %11s %9s %9s %9s %11s\n", "address", "role",
+         "tx frames", "tx bytes", "avg B/s", "peak B/s", "rx frames",
+         "rx bytes");
+
+  for (size_t i = 0; i < g_host_count; ++i) {
+    const struct Host *h = g_hosts[i];
+    const double secs = secs_between(h->first_ns, h->last_ns);
+
+    printf("  %-17s %-6s %9lu %11lu %9.0f %9lu %9lu %11lu\n",
+           format_addr(h->addr), host_role(h), h->tx_frames, h->tx_bytes,
+           secs ? h->tx_bytes / secs : 0.0, h->peak_sec_bytes, h->rx_frames,
+           h->rx_bytes);
+  }
+
+  printf("\nPacket types sent (frames)\n");
+  printf("  %-17s", "address");
+  for (int t = 0; t < PKT_TYPE_COUNT; ++t) {
+    printf(" %11s", pkt_type_names[t]);
+  }
+  printf("\n");
+
+  for (size_t i = 0; i < g_host_count; ++i) {
+    const struct Host *h = g_hosts[i];
+    if (!h->tx_frames) {
+      continue;
+    }
+
+    printf("  %-17s", format_addr(h->addr));
+    for (int t = 0; t < PKT_TYPE_COUNT; ++t) {
+      printf(" %11lu", h->type_frames[t]);
+    }
+    printf("\n");
+  }
+}
+
+static void print_histograms() {
+  for (size_t i = 0; i < g_host_count; ++i) {
+    const struct Host *h = g_hosts[i];
+    uint64_t most = 0;
+
+    if (!h->tx_frames) {
+      continue;
+    }
+
+    for (int b = 0; b < HIST_BUCKETS; ++b) {
+      most = MAX(most, h->size_hist[b]);
+    }
+
+    printf("\nFrame sizes sent by %s\n", format_addr(h->addr));
+    for (int b = 0; b < HIST_BUCKETS; ++b) {
+      if (!h->size_hist[b]) {
+        continue;
+      }
+
+      const int bar = (int)((h->size_hist[b] * HIST_BAR_LEN + most - 1) / most);
+      printf("  %4d-%-4d %9lu  %.*s\n", b * HIST_BUCKET_LEN,
+             (b + 1) * HIST_BUCKET_LEN - 1, h->size_hist[b], bar,
+             "########################################");
+    }
+  }
+}
+
+static void print_sessions() {
+  if (!g_session_count) {
+    return;
+  }
+
+  printf("\nSessions (video from server to viewer)\n");
+  printf("  %-17s %-17s %-8s %8s %8s %9s %7s %8s %8s %8s %6s %7s %7s\n",
+         "server", "viewer", "session", "secs", "frames", "B/s", "sweeps",
+         "fr/sweep", "ms/sweep", "resent%", "torn", "keys", "no-echo");
+
+  for (size_t i = 0; i < g_session_count; ++i) {
+    struct Session *s = g_sessions[i];
+    const double secs = secs_between(s->first_ns, s->last_ns);
+
+    // Unicast pings alone do not make a session.
+    if (!s->video_frames && !s->key_frames && !s->start_ns) {
+      continue;
+    }
+
+    // Keys still waiting at the end of the capture are not counted.
+    printf("  %-17s %-17s %08x %8.1f %8lu %9.0f %7lu %8.2f %8.1f %8.1f %6lu "
+           "%7lu %7lu\n",
+           format_addr(s->server->addr), format_addr(s->viewer->addr),
+           s->session_id, secs, s->video_frames,
+           secs ? s->video_bytes / secs : 0.0, s->sweeps,
+           s->sweeps ? (double)s->sweep_frames / s->sweeps : 0.0,
+           s->sweeps ? s->sweep_ns / 1e6 / s->sweeps : 0.0,
+           s->text_bytes
+               ? 100.0 * (s->text_bytes - s->changed_bytes) / s->text_bytes
+               : 0.0,
+           s->torn_sweeps, s->keystrokes, s->keys_no_echo);
+  }
+}
+
+static void print_latencies() {
+  char who[64];
+
+  printf("\nLatencies (microseconds)\n");
+  printf("  %-28s %-8s %9s %9s %9s %9s %9s %9s\n", "host / session", "what",
+         "count", "min", "p50", "p95", "p99", "max");
+
+  for (size_t i = 0; i < g_host_count; ++i) {
+    struct Host *h = g_hosts[i];
+    print_samples(format_addr(h->addr), "ping", &h->ping_rtt);
+    print_samples(format_addr(h->addr), "status", &h->status_rtt);
+  }
+
+  for (size_t i = 0; i < g_session_count; ++i) {
+    struct Session *s = g_sessions[i];
+
+    snprintf(who, sizeof(who), "%s/%08x", format_addr(s->server->addr),
+             s->session_id);
+    if (s->setup_us) {
+      struct Samples one = {0};
+      samples_add(&one, s->setup_us);
+      print_samples(who, "setup", &one);
+      samples_free(&one);
+    }
+    print_samples(who, "echo", &s->echo);
+  }
+}
+
+static void print_usage(const char *progname) {
+  printf("usage: %s [-e type] [-H] [-k ms] capture.pcap\n", progname);
+  printf("  -e  Ethertype as 4 hexadecimal digits (default: %04x).\n",
+         ETHERTYPE_RMTDOS);
+  printf("  -H  Omit frame size histograms.\n");
+  printf("  -k  Keystrokes not echoed within this time are counted as lost "
+         "(default: %d).\n",
+         DEFAULT_ECHO_TIMEOUT_MS);
+}
+
+int main(int argc, char **argv) {
+  uint16_t ethertype = ETHERTYPE_RMTDOS;
+  int histograms = 1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "e:Hk:")) != -1) {
+    switch (opt) {
+      case 'e':
+        ethertype = strtoul(optarg, NULL, 16);
+        break;
+      case 'H':
+        histograms = 0;
+        break;
+      case 'k':
+        g_echo_timeout_ns = strtoull(optarg, NULL, 10) * 1000000ULL;
+        break;
+      default: /* '?' */
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (optind != argc - 1) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  struct PcapFile pf;
+  if (0 > pcapfile_open(&pf, argv[optind])) {
+    return EXIT_FAILURE;
+  }
+  if (pf.linktype != PCAP_LINKTYPE_ETHERNET) {
+    fprintf(stderr, "%s: not an Ethernet capture (link type %u).\n",
+            argv[optind], pf.linktype);
+    return EXIT_FAILURE;
+  }
+
+  struct PcapPacket pkt;
+  while (pcapfile_next(&pf, &pkt)) {
+    process_frame(&pkt, ethertype);
+  }
+
+  printf("capture:  %s\n", argv[optind]);
+  printf("frames:   %lu, of which %lu rmtdos (%lu malformed, %lu unknown "
+         "type)\n",
+         g_totals.frames, g_totals.rmtdos, g_totals.bad,
+         g_totals.unknown_type);
+  printf("duration: %.3f s\n",
+         secs_between(g_totals.first_ns, g_totals.last_ns));
+
+  if (g_totals.rmtdos) {
+    print_hosts();
+    if (histograms) {
+      print_histograms();
+    }
+    print_sessions();
+    print_latencies();
+  }
+
+  pcapfile_release(&pf);
+  return EXIT_SUCCESS;
+}
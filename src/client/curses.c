@@ -3,7 +3,6 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 
-#include <iconv.h>
 #include <ncurses.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -11,56 +10,23 @@
 #include <string.h>
 
 #include "client/curses.h"
+#include "client/globals.h"
+#include "client/probes.h"
+#include "client/screen.h"
 #include "client/util.h"
 
-char g_cp437_table[CP437_CHARS][CP437_WIDTH];
+#define MIN(x, y) ((x) > (y) ? (y) : (x))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
 
 int g_ncurses_colors[VGA_ATTRS];
 
 WINDOW *g_probe_window = NULL;
 WINDOW *g_debug_window = NULL;
 WINDOW *g_session_window = NULL;
+WINDOW *g_wall_window = NULL;
 
-static const char *control_chars[32] = {
-    " ",      "\u263a", "\u263b", "\u2665", "\u2666", "\u2663", "\u2660",
-    "\u2022", "\u25d8", "\u25cb", "\u25d9", "\u2642", "\u2640", "\u266a",
-    "\u266b", "\u263c", "\u25ba", "\u25c4", "\u2195", "\u203c", "\u00b6",
-    "\u00a7", "\u25ac", "\u21a8", "\u2191", "\u2193", "\u2192", "\u2190",
-    "\u221f", "\u2194", "\u25b2", "\u25bc",
-};
-
-void cp437_table_init() {
-  iconv_t cnv = iconv_open("UTF-8", "CP437");
-  if (!cnv) {
-    fprintf(stderr, "iconv_open(\"UTF-8\", \"CP437\") failed.\n");
-    exit(EXIT_FAILURE);
-  }
-
-  for (int i = 0; i < 32; i++) {
-    strncpy(g_cp437_table[i], control_chars[i], CP437_WIDTH);
-  }
-
-  for (int i = 32; i < 256; i++) {
-    char src[2];
-    src[0] = i;
-    src[1] = 0;
-    char *c = src;
-    size_t in_size = sizeof(src);
-
-    char *d = g_cp437_table[i];
-    size_t out_size = CP437_WIDTH;
-
-    int r = iconv(cnv, &c, &in_size, &d, &out_size);
-    if (r == -1) {
-      fprintf(stderr, "iconv() for char 0x%02x failed.\n", i);
-      exit(EXIT_FAILURE);
-    }
-  }
-
-  strncpy(g_cp437_table[127], "\u2302", CP437_WIDTH);
-
-  iconv_close(cnv);
-}
+// Consistent copy of the screen being drawn.  Only used by the UI thread.
+static struct Screen g_snapshot;
 
 // VGA bits (lsb to msb) are swapped from ncurses color bits.
 // VGA bits are: "I, R, G, B"  (0x04 = red)
@@ -144,28 +110,62 @@ void update_hud(struct RemoteHost *rh) {
   fmt_mac_addr(mac_addr, sizeof(mac_addr), rh->if_addr);
 
   // Compute time delta to last received packet.
-  struct timeval tv_now, tv_stale;
-  gettimeofday(&tv_now, NULL);
-  timersub(&tv_now, &(rh->tv_last_resp), &tv_stale);
-
   char stale[32];
-  snprintf(stale, sizeof(stale), "%ld.%06ld", tv_stale.tv_sec,
-           tv_stale.tv_usec);
+  fmt_elapsed(stale, sizeof(stale), host_last_resp_us(rh));
 
   mvwprintw(rh->window, ++y, 0, "addr: %s, rows: %d, cols:%d, latency:%s",
             mac_addr, rh->text_rows, rh->text_cols, stale);
 
-  mvwprintw(rh->window, ++y, 0, "<CTRL-Q> to Exit");
+  if (g_observer_mode) {
+    mvwprintw(rh->window, ++y, 0, "Observing (read only).  <CTRL-Q> to Exit");
+  } else {
+    mvwprintw(rh->window, ++y, 0,
+              "<CTRL-Q> to Exit, <CTRL-]><p> previous host, <CTRL-]><m> menu");
+  }
 }
 
 void update_session_window(struct RemoteHost *rh, uint16_t video_offset,
                            uint16_t byte_count) {
+  const struct Screen *s = &g_snapshot;
+  const struct Screen *screen = host_screen(rh);
+
+  if (!screen) {
+    return;
+  }
+
+  screen_snapshot(screen, &g_snapshot);
+  if (!s->text_cols) {
+    return;
+  }
+
+  PROBE3(render_start, rh->index, video_offset, byte_count);
+
+  // Rows beyond the buffer (a screen larger than SCREEN_BUFFER_SIZE) are
+  // never drawn.
+  const int rows = screen_visible_rows(s);
+  const size_t visible_bytes = (size_t)rows * s->text_cols * 2;
+  size_t start = video_offset;
+  size_t end = start + byte_count;
 
-  for (uint16_t i = video_offset; i < (video_offset + byte_count); i += 2) {
+  // If the resolution changed since we last drew, everything is dirty.
+  if ((s->text_rows != rh->text_rows) || (s->text_cols != rh->text_cols)) {
+    start = 0;
+    end = visible_bytes;
+  }
+
+  rh->text_rows = s->text_rows;
+  rh->text_cols = s->text_cols;
+
+  // we already have a place to store the cursor position
+  rh->status.cursor_row = s->cursor_row;
+  rh->status.cursor_col = s->cursor_col;
+
+  end = MIN(end, visible_bytes);
+  for (size_t i = start & ~1; i < end; i += 2) {
     const uint16_t y = (i >> 1) / rh->text_cols;
     const uint16_t x = (i >> 1) % rh->text_cols;
-    const uint8_t ch = rh->video_text_buffer[i];
-    const uint8_t attr = rh->video_text_buffer[i + 1];
+    const uint8_t ch = s->video_text_buffer[i];
+    const uint8_t attr = s->video_text_buffer[i + 1];
 
     wattron(g_session_window, COLOR_PAIR(g_ncurses_colors[attr]));
     //  wattron(g_session_window, PAIR_NUMBER(attr));
@@ -181,7 +181,7 @@ void update_session_window(struct RemoteHost *rh, uint16_t video_offset,
   // Typical VGA text mode widths are 40, 80, 90, 132.  If we switch from a
   // higher horizontal resolution to a lower one, we want to clear the now
   // vacant right margin.
-  for (int y = 0; y < rh->text_rows; ++y) {
+  for (int y = 0; y < rows; ++y) {
     if (OK == wmove(g_session_window, y, rh->text_cols)) {
       wclrtoeol(g_session_window);
     }
@@ -190,8 +190,8 @@ void update_session_window(struct RemoteHost *rh, uint16_t video_offset,
   // If our ncurses window is larger than the remote screen resolution,
   // then clear the area that is outside of the remote end's screen resolution.
   // Then display connection stats below it.
-  if (OK == wmove(g_session_window, rh->text_rows, 0)) {
-    int y = rh->text_rows;
+  if (OK == wmove(g_session_window, rows, 0)) {
+    int y = rows;
     wclrtobot(g_session_window);
 
     wattron(g_session_window, COLOR_PAIR(g_ncurses_colors[0x4f]));
@@ -207,6 +207,23 @@ void update_session_window(struct RemoteHost *rh, uint16_t video_offset,
     waddch(g_session_window, ' ' | A_REVERSE);
     wattroff(g_session_window, COLOR_PAIR(MY_COLOR_HEADER));
   }
+
+  PROBE1(render_done, rh->index);
+}
+
+static void create_windows() {
+  // The host list scrolls, so use whatever height the terminal offers.
+  g_probe_window = newwin(MAX(18, LINES - 4), 70, 2, 5);
+  g_debug_window = newwin(5, 80, 20, 0);
+  g_session_window = newwin(0, 0, 0, 0);
+  g_wall_window = newwin(0, 0, 0, 0);
+
+  // Arrow keys etc. for the host selection menu.
+  keypad(stdscr, TRUE);
+
+  keypad(g_session_window, TRUE);
+  meta(g_session_window, TRUE);
+  nodelay(g_session_window, TRUE);
 }
 
 void init_ncurses() {
@@ -217,24 +234,28 @@ void init_ncurses() {
   curs_set(0);
   timeout(0);
   color_table_init();
-
-  g_probe_window = newwin(18, 70, 2, 5);
-  g_debug_window = newwin(5, 80, 20, 0);
-  g_session_window = newwin(0, 0, 0, 0);
-
-  keypad(g_session_window, TRUE);
-  meta(g_session_window, TRUE);
-  nodelay(g_session_window, TRUE);
+  create_windows();
   nonl();
 
   refresh();
 }
 
+void init_ncurses_headless(const char *term, int rows, int cols) {
+  FILE *null_out = fopen("/dev/null", "w");
+  FILE *null_in = fopen("/dev/null", "r");
+
+  newterm(term, null_out, null_in);
+  resizeterm(rows, cols);
+  color_table_init();
+  create_windows();
+}
+
 void shutdown_ncurses() {
+  delwin(g_wall_window);
   delwin(g_session_window);
   delwin(g_debug_window);
   delwin(g_probe_window);
   endwin();
 
-  g_session_window = g_debug_window = g_probe_window = NULL;
+  g_wall_window = g_session_window = g_debug_window = g_probe_window = NULL;
 }
@@ -9,11 +9,7 @@
 #include <ncurses.h>
 
 #include "client/hostlist.h"
-
-// Maps VGA text mode characters to unicode strings.
-#define CP437_CHARS 256
-#define CP437_WIDTH 8
-extern char g_cp437_table[CP437_CHARS][CP437_WIDTH];
+#include "liblinux/cp437.h"
 
 // Maps VGA text mode attribute to ncurses color code.
 #define VGA_ATTRS 256
@@ -25,8 +21,7 @@ extern int g_ncurses_colors[VGA_ATTRS];
 extern WINDOW *g_probe_window;
 extern WINDOW *g_debug_window;
 extern WINDOW *g_session_window;
-
-extern void cp437_table_init();
+extern WINDOW *g_wall_window;
 
 extern void update_hud(struct RemoteHost *rh);
 
@@ -35,6 +30,10 @@ extern void update_session_window(struct RemoteHost *rh, uint16_t vga_offset,
 
 extern void init_ncurses();
 
+// For benchmarks: windows are drawn as usual, but the terminal output (if
+// refreshed) goes to /dev/null.
+extern void init_ncurses_headless(const char *term, int rows, int cols);
+
 extern void shutdown_ncurses();
 
 #endif // __RMTDOS_CLIENT_CURSES_H
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "client/daemon.h"
+#include "client/flightrec.h"
+#include "client/hostlist.h"
+#include "client/query.h"
+#include "client/session.h"
+#include "client/shmstore.h"
+#include "client/timerwheel.h"
+#include "client/util.h"
+
+#define MAX_EVENTS (MAX_RX_WORKERS + 2)
+
+static volatile sig_atomic_t g_stop = 0;
+
+static const uint8_t *g_hosts;
+static size_t g_host_count;
+
+static struct RawSocket *g_sockets;
+static size_t g_socket_count;
+
+static struct Timer g_probe_timer;
+static struct Timer g_heartbeat_timer;
+
+static void on_stop(int sig) {
+  (void)sig;
+  g_stop = 1;
+}
+
+static int wanted(const struct RemoteHost *rh) {
+  if (!g_host_count) {
+    return 1;
+  }
+
+  for (size_t i = 0; i < g_host_count; ++i) {
+    if (!memcmp(&g_hosts[i * ETH_ALEN], rh->if_addr, ETH_ALEN)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Gives a newly heard host a slot in the store, and a session that keeps
+// its slot current.
+static void publish_host(struct RemoteHost *rh) {
+  char mac_tmp[MAC_ADDR_FMT_LEN];
+
+  if (host_screen(rh) || !wanted(rh)) {
+    return;
+  }
+
+  if (!shmstore_attach(rh)) {
+    fprintf(stderr, "%s: screen store is full\n",
+            fmt_mac_addr(mac_tmp, sizeof(mac_tmp), rh->if_addr));
+    return;
+  }
+
+  session_pin(rh);
+  fprintf(stderr, "%s: publishing as host %d\n",
+          fmt_mac_addr(mac_tmp, sizeof(mac_tmp), rh->if_addr), rh->index);
+}
+
+static void process_events(struct RxThread *rx) {
+  struct RxEvent ev;
+
+  rx_thread_ack(rx);
+
+  // Screens are already in the store; only new hosts, and waits on the
+  // query socket, need work.
+  while (eventq_pop(&rx->queue, &ev)) {
+    if (ev.type == RX_EVENT_STATUS) {
+      ev.host->status = ev.status;
+      publish_host(ev.host);
+    } else if (ev.type == RX_EVENT_VIDEO) {
+      query_screen_changed(ev.host);
+    }
+  }
+
+  if (eventq_take_overflow(&rx->queue)) {
+    query_screen_changed(NULL);
+  }
+}
+
+static void probe_fire(struct Timer *timer) {
+  for (size_t i = 0; i < g_socket_count; ++i) {
+    send_status_req(&g_sockets[i], NULL);
+  }
+  timer_schedule(timer, DAEMON_PROBE_INTERVAL_MS);
+}
+
+static void heartbeat_fire(struct Timer *timer) {
+  shmstore_heartbeat();
+  timer_schedule(timer, DAEMON_HEARTBEAT_MS);
+}
+
+int daemon_run(struct RxThread **workers, size_t worker_count,
+               struct RawSocket *sockets, size_t socket_count,
+               const uint8_t *hosts, size_t host_count, int query_fd) {
+  struct epoll_event ev, events[MAX_EVENTS];
+  struct sigaction sa;
+  int epoll_fd;
+  int timer_fd;
+
+  g_hosts = hosts;
+  g_host_count = host_count;
+  g_sockets = sockets;
+  g_socket_count = socket_count;
+
+  // No SA_RESTART: interrupts `epoll_wait()`.
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_stop;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  if (0 > (epoll_fd = epoll_create1(EPOLL_CLOEXEC))) {
+    perror("epoll_create1()");
+    return -1;
+  }
+
+  if (0 > (timer_fd = timers_init())) {
+    close(epoll_fd);
+    return -1;
+  }
+
+  ev.events = EPOLLIN;
+  ev.data.fd = timer_fd;
+  if (0 > epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev)) {
+    perror("epoll_ctl(timerfd)");
+    goto fail;
+  }
+
+  for (size_t w = 0; w < worker_count; ++w) {
+    ev.events = EPOLLIN;
+    ev.data.fd = workers[w]->notify_fd;
+    if (0 > epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ev.data.fd, &ev)) {
+      perror("epoll_ctl(rx_thread)");
+      goto fail;
+    }
+  }
+
+  if (query_fd >= 0) {
+    ev.events = EPOLLIN;
+    ev.data.fd = query_fd;
+    if (0 > epoll_ctl(epoll_fd, EPOLL_CTL_ADD, query_fd, &ev)) {
+      perror("epoll_ctl(query)");
+      goto fail;
+    }
+  }
+
+  timer_init(&g_probe_timer, probe_fire, NULL);
+  timer_schedule(&g_probe_timer, 0);
+  timer_init(&g_heartbeat_timer, heartbeat_fire, NULL);
+  timer_schedule(&g_heartbeat_timer, DAEMON_HEARTBEAT_MS);
+
+  // A signal taken by a network thread is seen at the next heartbeat.
+  while (!g_stop) {
+    if (flightrec_take_request()) {
+      flightrec_dump();
+    }
+
+    const int nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+    if (nfds < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("epoll_wait()");
+      goto fail;
+    }
+
+    for (int n = 0; n < nfds; ++n) {
+      if (events[n].data.fd == timer_fd) {
+        timers_run();
+      }
+
+      if (events[n].data.fd == query_fd) {
+        query_run();
+      }
+
+      for (size_t w = 0; w < worker_count; ++w) {
+        if (events[n].data.fd == workers[w]->notify_fd) {
+          process_events(workers[w]);
+        }
+      }
+    }
+  }
+
+  timers_close();
+  close(epoll_fd);
+  return 0;
+
+fail:
+  timers_close();
+  close(epoll_fd);
+  return -1;
+}
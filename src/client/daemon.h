@@ -0,0 +1,36 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Headless screen collector ("rmtdos-client -P path [host...]").  Keeps a
+// session to each host given (or to every host that answers, if none are),
+// and publishes their screens in a screen store (see "client/shmstore.h"),
+// so that local tools read them without a session of their own.  Optionally
+// serves the query socket (see "client/query.h").  Runs until SIGINT or
+// SIGTERM.
+
+#ifndef __RMTDOS_CLIENT_DAEMON_H
+#define __RMTDOS_CLIENT_DAEMON_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "client/network.h"
+#include "client/rxthread.h"
+
+// How often to broadcast a probe, looking for the hosts.
+#define DAEMON_PROBE_INTERVAL_MS 2500
+
+// How often to rewrite the store's heartbeat.
+#define DAEMON_HEARTBEAT_MS 1000
+
+// `workers` must be running on `sockets`, and the store must be open.
+// `hosts` holds `host_count` MAC addresses (ETH_ALEN bytes each).
+// `query_fd` is from `query_open()`, or -1 for no query socket.  Returns <0
+// on error.
+extern int daemon_run(struct RxThread **workers, size_t worker_count,
+                      struct RawSocket *sockets, size_t socket_count,
+                      const uint8_t *hosts, size_t host_count, int query_fd);
+
+#endif // __RMTDOS_CLIENT_DAEMON_H
@@ -0,0 +1,215 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "client/echobench.h"
+#include "client/hostlist.h"
+#include "client/screen.h"
+#include "client/util.h"
+#include "common/probe.h"
+#include "liblinux/samples.h"
+
+#define US_PER_SEC 1000000ULL
+
+// How long to wait for the probe to show up, and for the last echoes.
+#define PROBE_WAIT_US (5 * US_PER_SEC)
+#define GRACE_US (2 * US_PER_SEC)
+
+// Same as the UI's session refresh.
+#define KEEPALIVE_US (2 * US_PER_SEC)
+
+// Keys in flight at once; an older key is given up on.  Half of PROBE_KEYS,
+// so the echo of a key given up on is never taken for a later one.
+#define MAX_IN_FLIGHT (PROBE_KEY_COUNT / 2)
+
+struct ProbeState {
+  uint8_t key;
+  unsigned count;
+};
+
+// Too large for the stack.
+static struct Screen g_snapshot;
+
+// Reads the probe's cells from `rh`'s screen.  Returns 0 if the probe is not
+// on it.
+static int read_probe(const struct RemoteHost *rh, struct ProbeState *ps) {
+  const struct Screen *screen = host_screen(rh);
+
+  if (!screen) {
+    return 0;
+  }
+
+  screen_snapshot(screen, &g_snapshot);
+  if ((g_snapshot.text_rows <= PROBE_ROW) ||
+      (g_snapshot.text_cols <
+       PROBE_COL + PROBE_COUNT_OFFSET + PROBE_COUNT_DIGITS)) {
+    return 0;
+  }
+
+  const uint8_t *p =
+      &g_snapshot.video_text_buffer[(PROBE_ROW * g_snapshot.text_cols +
+                                     PROBE_COL) *
+                                    2];
+  unsigned count = 0;
+  for (int i = 0; i < PROBE_COUNT_DIGITS; ++i) {
+    const uint8_t ch = p[(PROBE_COUNT_OFFSET + i) * 2];
+    if (!isxdigit(ch)) {
+      return 0;
+    }
+    count = count * 16 + (isdigit(ch) ? ch - '0' : tolower(ch) - 'a' + 10);
+  }
+
+  ps->key = p[0];
+  ps->count = count;
+  return 1;
+}
+
+// Waits for the network thread, up to `timeout_us`.  Returns the latest
+// receive time of a video frame from `rh`, or 0 if none arrived.
+static uint64_t wait_for_video(struct RxThread *rx,
+                               const struct RemoteHost *rh,
+                               uint64_t timeout_us) {
+  struct pollfd pfd = {.fd = rx->notify_fd, .events = POLLIN};
+  const int timeout_ms = (timeout_us + 999) / 1000;
+  uint64_t rx_us = 0;
+  struct RxEvent ev;
+
+  if (0 >= poll(&pfd, 1, timeout_ms)) {
+    return 0;
+  }
+
+  rx_thread_ack(rx);
+  while (eventq_pop(&rx->queue, &ev)) {
+    if ((ev.type == RX_EVENT_VIDEO) && (ev.host == rh) &&
+        (ev.video.rx_us > rx_us)) {
+      rx_us = ev.video.rx_us;
+    }
+  }
+
+  // Events were dropped; the screen is still current, but the time of the
+  // frame that changed it is lost.  Take the latest one seen.
+  eventq_take_overflow(&rx->queue);
+  return rx_us;
+}
+
+int echo_bench_run(struct RawSocket *rs, struct RxThread *rx,
+                   const uint8_t *server_addr, double keys_per_sec,
+                   unsigned count) {
+  struct RemoteHost *rh = hostlist_add(server_addr);
+  const uint64_t interval_us = US_PER_SEC / keys_per_sec;
+  struct Samples latency_us = {0};
+  struct ProbeState first, last, now_ps;
+  uint64_t *sent_us;
+  uint64_t last_keepalive_us, next_send_us, now;
+  unsigned sent = 0;
+  unsigned next_match = 0; // Oldest key not yet seen, nor given up on.
+  unsigned unseen = 0;
+  char tmp[MAC_ADDR_FMT_LEN];
+
+  if (!rh || !(sent_us = (uint64_t *)calloc(count, sizeof(*sent_us)))) {
+    fprintf(stderr, "Out of memory.\n");
+    return -1;
+  }
+  host_attach_screen(rh);
+  fmt_mac_addr(tmp, sizeof(tmp), server_addr);
+
+  // Start a session, and wait for the probe to be on the screen.
+  send_session_start(rs, server_addr);
+  last_keepalive_us = time_now_us();
+  while (!read_probe(rh, &first)) {
+    now = time_now_us();
+    if (now - last_keepalive_us > PROBE_WAIT_US) {
+      fprintf(stderr,
+              "No echo probe on %s's screen.  Run \"vga_demo -p\" there.\n",
+              tmp);
+      free(sent_us);
+      return -1;
+    }
+    wait_for_video(rx, rh, last_keepalive_us + PROBE_WAIT_US - now);
+  }
+
+  printf("Echo latency of %s: %u keys, %.1f per second.\n", tmp, count,
+         keys_per_sec);
+  fflush(stdout);
+
+  last = first;
+  next_send_us = time_now_us();
+  while (1) {
+    now = time_now_us();
+
+    if ((sent < count) && (now >= next_send_us)) {
+      const struct Keystroke ks = {
+          .bios_scan_code = 0,
+          .ascii_value = PROBE_KEYS[sent % PROBE_KEY_COUNT],
+          .flags_17 = 0,
+      };
+
+      if (sent - next_match >= MAX_IN_FLIGHT) {
+        ++next_match;
+        ++unseen;
+      }
+      send_keystrokes(rs, server_addr, 1, &ks);
+      sent_us[sent++] = now;
+      next_send_us += interval_us;
+    }
+
+    if (now - last_keepalive_us >= KEEPALIVE_US) {
+      send_session_start(rs, server_addr);
+      last_keepalive_us = now;
+    }
+
+    if ((sent == count) &&
+        ((next_match == count) || (now - sent_us[count - 1] > GRACE_US))) {
+      break;
+    }
+
+    uint64_t timeout_us = last_keepalive_us + KEEPALIVE_US - now;
+    if ((sent < count) && (next_send_us - now < timeout_us)) {
+      timeout_us = (next_send_us > now) ? next_send_us - now : 0;
+    }
+
+    const uint64_t rx_us = wait_for_video(rx, rh, timeout_us);
+    if (!rx_us || !read_probe(rh, &now_ps) ||
+        ((now_ps.count == last.count) && (now_ps.key == last.key))) {
+      continue;
+    }
+    last = now_ps;
+
+    // The oldest key in flight that the probe shows.  Keys before it were
+    // drawn over before any frame showed them.
+    for (unsigned i = next_match; i < sent; ++i) {
+      if (PROBE_KEYS[i % PROBE_KEY_COUNT] == now_ps.key) {
+        samples_add(&latency_us, rx_us - sent_us[i]);
+        unseen += i - next_match;
+        next_match = i + 1;
+        break;
+      }
+    }
+  }
+  unseen += sent - next_match;
+
+  // Keys the probe never read, by its count.
+  const unsigned received = (last.count - first.count) & 0xffff;
+  const unsigned lost = (sent > received) ? sent - received : 0;
+
+  printf("  sent %u, timed %zu, unseen %u (drawn over before a frame showed "
+         "them), lost %u (never read)\n",
+         sent, latency_us.count, unseen, lost);
+  printf("  latency (us): %8s %8s %8s %8s %8s %8s\n", "count", "min", "p50",
+         "p95", "p99", "max");
+  printf("                ");
+  samples_print(&latency_us, 8);
+  printf("\n");
+
+  samples_free(&latency_us);
+  free(sent_us);
+  return 0;
+}
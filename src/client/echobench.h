@@ -0,0 +1,31 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Keystroke to echo latency benchmark ("rmtdos-client -E").  Runs headless
+// against a server showing the echo probe ("vga_demo.com -p", see
+// common/probe.h): injects keys at a fixed rate, and times each from being
+// sent until a V1_VGA_TEXT frame shows its echo in the probe's cell.  That
+// is the latency an operator sees: the network both ways, the server's tick,
+// the DOS program reading the key, and the server noticing the change.
+
+#ifndef __RMTDOS_CLIENT_ECHOBENCH_H
+#define __RMTDOS_CLIENT_ECHOBENCH_H
+
+#include <stdint.h>
+
+#include "client/network.h"
+#include "client/rxthread.h"
+
+// Default count of keys for `-E rate`.
+#define ECHO_BENCH_DEFAULT_KEYS 200
+
+// Sends `count` keys to `server_addr`, `keys_per_sec` apart, and prints a
+// report.  `rx` must be running on `rs`.  Returns <0 if the probe was not
+// found on the server's screen.
+extern int echo_bench_run(struct RawSocket *rs, struct RxThread *rx,
+                          const uint8_t *server_addr, double keys_per_sec,
+                          unsigned count);
+
+#endif // __RMTDOS_CLIENT_ECHOBENCH_H
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <string.h>
+
+#include "client/eventq.h"
+
+#define EVENTQ_MASK (EVENTQ_CAPACITY - 1)
+
+void eventq_init(struct EventQueue *q) { memset(q, 0, sizeof(*q)); }
+
+int eventq_push(struct EventQueue *q, const struct RxEvent *ev) {
+  const uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+  const uint32_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+
+  if (tail - head >= EVENTQ_CAPACITY) {
+    __atomic_store_n(&q->overflow, 1, __ATOMIC_RELEASE);
+    return 0;
+  }
+
+  q->events[tail & EVENTQ_MASK] = *ev;
+  __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+int eventq_pop(struct EventQueue *q, struct RxEvent *ev) {
+  const uint32_t head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+  const uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+
+  if (head == tail) {
+    return 0;
+  }
+
+  *ev = q->events[head & EVENTQ_MASK];
+  __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+int eventq_take_overflow(struct EventQueue *q) {
+  return __atomic_exchange_n(&q->overflow, 0, __ATOMIC_ACQ_REL);
+}
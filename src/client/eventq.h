@@ -0,0 +1,82 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Lock-free ring buffer that carries notifications from the network thread to
+// the UI thread.  Exactly one thread may push, and exactly one thread may pop.
+// The network thread never waits on the UI; if the ring is full, the event is
+// dropped and `overflow` is raised so the UI knows to redraw everything.
+
+#ifndef __RMTDOS_CLIENT_EVENTQ_H
+#define __RMTDOS_CLIENT_EVENTQ_H
+
+#include <stdint.h>
+
+#include "common/protocol.h"
+
+struct RemoteHost;
+
+enum RxEventType {
+  RX_EVENT_STATUS = 1, // V1_STATUS_RESP received, `status` is valid.
+  RX_EVENT_VIDEO = 2,  // Screen updated, `video` is the dirty byte range.
+  RX_EVENT_PACKET = 3, // Copy of a received frame, for the debug window.
+  RX_EVENT_STATS = 4,  // V1_STATS_RESP received, `stats` is valid.
+};
+
+// Bytes of a received frame copied into a RX_EVENT_PACKET.
+#define RX_EVENT_DUMP_LEN 64
+
+struct RxEvent {
+  enum RxEventType type;
+  struct RemoteHost *host;
+
+  union {
+    struct StatusResponse status;
+
+    // In host byte order.
+    struct StatsResponse stats;
+
+    struct {
+      uint16_t offset; // Byte offset into `video_text_buffer`.
+      uint16_t count;  // Count of bytes that changed.
+      uint64_t rx_us;  // `time_now_us()` when the frame was received.
+    } video;
+
+    struct {
+      uint16_t length; // Size of the received frame (not of `data`).
+      uint8_t data[RX_EVENT_DUMP_LEN];
+    } packet;
+  };
+};
+
+// Must be a power of two.
+#define EVENTQ_CAPACITY 4096
+
+struct EventQueue {
+  // Next slot to pop.  Written only by the consumer.
+  uint32_t head;
+  uint8_t _pad_head[60];
+
+  // Next slot to push.  Written only by the producer.
+  uint32_t tail;
+  uint8_t _pad_tail[60];
+
+  // Raised by the producer when an event had to be dropped.
+  int overflow;
+
+  struct RxEvent events[EVENTQ_CAPACITY];
+};
+
+extern void eventq_init(struct EventQueue *q);
+
+// Producer.  Returns 1 on success, 0 if the queue was full.
+extern int eventq_push(struct EventQueue *q, const struct RxEvent *ev);
+
+// Consumer.  Returns 1 if an event was copied into `ev`, 0 if empty.
+extern int eventq_pop(struct EventQueue *q, struct RxEvent *ev);
+
+// Consumer.  Returns non-zero (once) if events were dropped since last call.
+extern int eventq_take_overflow(struct EventQueue *q);
+
+#endif // __RMTDOS_CLIENT_EVENTQ_H
@@ -0,0 +1,668 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "client/fleet.h"
+#include "client/flightrec.h"
+#include "client/hostlist.h"
+#include "client/keyboard.h"
+#include "client/recorder.h"
+#include "client/screen.h"
+#include "client/session.h"
+#include "client/timerwheel.h"
+#include "client/util.h"
+
+#define MAX_EVENTS (MAX_RX_WORKERS + 1)
+
+// Longest script line.
+#define SCRIPT_LINE_MAX 1024
+
+enum StepType {
+  STEP_SEND,
+  STEP_EXPECT,
+  STEP_CAPTURE,
+  STEP_SLEEP,
+};
+
+struct Step {
+  enum StepType type;
+  int line; // In the script, for reports.
+
+  // STEP_EXPECT (and STEP_CAPTURE, for the first row), -1 for any row.
+  int row;
+
+  // STEP_CAPTURE.
+  int col;
+  int count;
+  int rows;
+
+  // STEP_EXPECT timeout, or STEP_SLEEP.
+  uint64_t ms;
+
+  // STEP_EXPECT text, or STEP_CAPTURE name.
+  char *text;
+
+  // STEP_SEND.
+  struct Keystroke *keys;
+  size_t key_count;
+};
+
+enum HostState {
+  HOST_IDLE = 0,   // Not heard from (yet).
+  HOST_CONNECTING, // Waiting for its screen.
+  HOST_RUNNING,
+  HOST_DONE,
+};
+
+struct FleetHost {
+  struct RemoteHost *rh;
+  enum HostState state;
+  int failed;
+
+  // Index of the current step in `g_steps`.
+  size_t step;
+
+  // For a STEP_SEND, keys already sent.  For a STEP_EXPECT, the screen's
+  // `seq` when last checked.
+  size_t keys_sent;
+  uint32_t seq;
+
+  // `time_now_us()` when the host answered, got its screen, and started the
+  // current step.  The slowest step.
+  uint64_t start_us;
+  uint64_t screen_us;
+  uint64_t step_us;
+  uint64_t slowest_us;
+  size_t slowest_step;
+
+  // Connect or step timeout, next batch of keys, or end of a sleep.
+  struct Timer timer;
+
+  // Captured text, printed with the result.
+  char *captures;
+  size_t captures_len;
+};
+
+static struct Step g_steps[FLEET_MAX_STEPS];
+static size_t g_step_count = 0;
+
+static volatile sig_atomic_t g_stop = 0;
+
+// Indexed by `RemoteHost.index`.
+static struct FleetHost *g_fleet;
+static size_t g_fleet_size;
+
+static const uint8_t *g_hosts;
+static size_t g_host_count;
+
+static struct RawSocket *g_sockets;
+static size_t g_socket_count;
+
+// Hosts are started while discovering.  The run ends once it is over and no
+// host is unfinished.
+static int g_discovering;
+static size_t g_found;
+static size_t g_unfinished;
+static size_t g_ok;
+static size_t g_failed;
+static size_t g_missing; // Given, but did not answer.  Counted as failed.
+static uint64_t g_fastest_us = UINT64_MAX;
+static uint64_t g_slowest_us = 0;
+
+static struct Timer g_probe_timer;
+static struct Timer g_discover_timer;
+
+// Scratch copy of the screen being read.
+static struct Screen g_snap;
+
+static void on_stop(int sig) {
+  (void)sig;
+  g_stop = 1;
+}
+
+// Returns 0 if `text` is not a whole, non-negative number.
+static int parse_num(const char *text, long *value) {
+  char *end;
+
+  if (!text || !*text) {
+    return 0;
+  }
+  *value = strtol(text, &end, 10);
+  return !*end && (*value >= 0);
+}
+
+// Returns what is wrong with the step, or NULL.
+static const char *parse_step(struct Step *st, char *p) {
+  const char *cmd = split_word(&p);
+  long n;
+
+  if (!strcmp(cmd, "send")) {
+    st->type = STEP_SEND;
+    st->keys = (struct Keystroke *)malloc(strlen(p) * sizeof(*st->keys) + 1);
+    const int count = keyboard_parse_text(p, st->keys);
+    if (count <= 0) {
+      return count ? "character with no key" : "nothing to send";
+    }
+    st->key_count = count;
+    return NULL;
+  }
+
+  if (!strcmp(cmd, "expect")) {
+    const char *row = split_word(&p);
+    st->type = STEP_EXPECT;
+    st->row = -1;
+    if (!row || (strcmp(row, "*") && !parse_num(row, &n)) ||
+        !parse_num(split_word(&p), &n) || !*p) {
+      return "usage: expect ROW|* TIMEOUT_MS TEXT";
+    }
+    if (strcmp(row, "*")) {
+      st->row = atoi(row);
+    }
+    st->ms = n;
+    st->text = strdup(p);
+    return NULL;
+  }
+
+  if (!strcmp(cmd, "capture")) {
+    const char *name = split_word(&p);
+    st->type = STEP_CAPTURE;
+    if (!name || !parse_num(split_word(&p), &n)) {
+      return "usage: capture NAME ROW [COL COUNT [ROWS]]";
+    }
+    st->text = strdup(name);
+    st->row = n;
+
+    long col = 0, count = SCREEN_ROW_TEXT_MAX, rows = 1;
+    if (*p && (!parse_num(split_word(&p), &col) ||
+               !parse_num(split_word(&p), &count) ||
+               (*p && !parse_num(split_word(&p), &rows)) || *p || !rows)) {
+      return "usage: capture NAME ROW [COL COUNT [ROWS]]";
+    }
+    st->col = col;
+    st->count = count;
+    st->rows = rows;
+    return NULL;
+  }
+
+  if (!strcmp(cmd, "sleep")) {
+    st->type = STEP_SLEEP;
+    if (!parse_num(split_word(&p), &n) || *p) {
+      return "usage: sleep MS";
+    }
+    st->ms = n;
+    return NULL;
+  }
+
+  return "unknown step";
+}
+
+int fleet_load(const char *path) {
+  char line[SCRIPT_LINE_MAX];
+  int line_no = 0;
+  FILE *fp;
+
+  if (!(fp = fopen(path, "r"))) {
+    perror(path);
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), fp)) {
+    char *p = line;
+
+    ++line_no;
+    line[strcspn(line, "\r\n")] = 0;
+    while (*p == ' ') {
+      ++p;
+    }
+    if (!*p || (*p == '#')) {
+      continue;
+    }
+
+    if (g_step_count == FLEET_MAX_STEPS) {
+      fprintf(stderr, "%s: more than %d steps\n", path, FLEET_MAX_STEPS);
+      fclose(fp);
+      return -1;
+    }
+
+    struct Step *st = &g_steps[g_step_count++];
+    st->line = line_no;
+    const char *error = parse_step(st, p);
+    if (error) {
+      fprintf(stderr, "%s:%d: %s\n", path, line_no, error);
+      fclose(fp);
+      return -1;
+    }
+  }
+
+  fclose(fp);
+  if (!g_step_count) {
+    fprintf(stderr, "%s: no steps\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+static void capture_add(struct FleetHost *fh, const char *name,
+                        const char *text, size_t len) {
+  const size_t need = fh->captures_len + strlen(name) + len + 8;
+
+  fh->captures = (char *)realloc(fh->captures, need);
+  fh->captures_len += sprintf(fh->captures + fh->captures_len,
+                              "    %s: %.*s\n", name, (int)len, text);
+}
+
+// Prints the result of `fh`, which is done.
+static void report(struct FleetHost *fh, const char *error) {
+  const uint64_t now = time_now_us();
+  const uint64_t total_us = now - fh->start_us;
+  char mac_tmp[MAC_ADDR_FMT_LEN];
+
+  fmt_mac_addr(mac_tmp, sizeof(mac_tmp), fh->rh->if_addr);
+  if (error) {
+    printf("%s  failed  %7.3fs  %s\n", mac_tmp, total_us / 1e6, error);
+  } else {
+    printf("%s  ok      %7.3fs  screen %.3fs, slowest line %d %.3fs\n",
+           mac_tmp, total_us / 1e6, (fh->screen_us - fh->start_us) / 1e6,
+           g_steps[fh->slowest_step].line, fh->slowest_us / 1e6);
+  }
+  if (fh->captures) {
+    fputs(fh->captures, stdout);
+  }
+  fflush(stdout);
+
+  if (total_us < g_fastest_us) {
+    g_fastest_us = total_us;
+  }
+  if (total_us > g_slowest_us) {
+    g_slowest_us = total_us;
+  }
+}
+
+// Ends the run of `fh`; it failed if there is an `error`.
+static void finish(struct FleetHost *fh, const char *error) {
+  timer_cancel(&fh->timer);
+  session_unpin(fh->rh);
+  fh->state = HOST_DONE;
+  fh->failed = !!error;
+  g_failed += fh->failed;
+  g_ok += !fh->failed;
+  --g_unfinished;
+  report(fh, error);
+}
+
+// Sends the next batch of keys of the current STEP_SEND.  Returns non-zero
+// once all are sent.
+static int send_batch(struct FleetHost *fh) {
+  const struct Step *st = &g_steps[fh->step];
+  struct RemoteHost *rh = fh->rh;
+  struct RawSocket *rs = host_socket(rh);
+
+  size_t count = st->key_count - fh->keys_sent;
+  if (count > KEYS_PER_BATCH) {
+    count = KEYS_PER_BATCH;
+  }
+
+  const struct Keystroke *keys = &st->keys[fh->keys_sent];
+  send_keystrokes(rs, rh->if_addr, count, keys);
+  recorder_keystrokes(rh, count, keys);
+  rh->metrics.keystrokes_sent += count;
+
+  const struct FlightEvent fe = {
+      .type = FLIGHT_KEYS,
+      .host = rh->index,
+      .pkt_type = V1_INJECT_KEYSTROKE,
+      .count = count,
+  };
+  flightrec_add(&g_flight_ui, &fe);
+
+  fh->keys_sent += count;
+  return fh->keys_sent == st->key_count;
+}
+
+// Returns non-zero if the current STEP_EXPECT's text is on screen.
+static int expect_met(struct FleetHost *fh) {
+  const struct Step *st = &g_steps[fh->step];
+
+  screen_snapshot(host_screen(fh->rh), &g_snap);
+  fh->seq = g_snap.seq;
+  return screen_find_text(&g_snap, st->row, st->text) >= 0;
+}
+
+static void capture(struct FleetHost *fh) {
+  const struct Step *st = &g_steps[fh->step];
+  char line[SCREEN_ROW_TEXT_MAX + 1];
+
+  screen_snapshot(host_screen(fh->rh), &g_snap);
+  for (int r = 0; r < st->rows; ++r) {
+    size_t len = screen_text(&g_snap, st->row + r, st->col, st->count, line);
+    while (len && (line[len - 1] == ' ')) {
+      --len;
+    }
+    capture_add(fh, st->text, line, len);
+  }
+}
+
+static void step_timed(struct FleetHost *fh) {
+  const uint64_t us = time_now_us() - fh->step_us;
+
+  if (us >= fh->slowest_us) {
+    fh->slowest_us = us;
+    fh->slowest_step = fh->step;
+  }
+}
+
+static void send_tick(struct Timer *timer);
+static void expect_expired(struct Timer *timer);
+static void step_done(struct Timer *timer);
+
+// Runs steps from the current one, until one has to wait.
+static void run(struct FleetHost *fh) {
+  for (; fh->step < g_step_count; ++fh->step) {
+    const struct Step *st = &g_steps[fh->step];
+
+    fh->step_us = time_now_us();
+    switch (st->type) {
+      case STEP_SEND:
+        fh->keys_sent = 0;
+        if (!send_batch(fh)) {
+          timer_init(&fh->timer, send_tick, fh);
+          timer_schedule(&fh->timer, TIMER_TICK_MS);
+          return;
+        }
+        break;
+
+      case STEP_EXPECT:
+        if (!expect_met(fh)) {
+          timer_init(&fh->timer, expect_expired, fh);
+          timer_schedule(&fh->timer, st->ms);
+          return;
+        }
+        break;
+
+      case STEP_CAPTURE:
+        capture(fh);
+        break;
+
+      case STEP_SLEEP:
+        timer_init(&fh->timer, step_done, fh);
+        timer_schedule(&fh->timer, st->ms);
+        return;
+    }
+
+    step_timed(fh);
+  }
+
+  finish(fh, NULL);
+}
+
+// The current step, which waited, is over.
+static void next_step(struct FleetHost *fh) {
+  timer_cancel(&fh->timer);
+  step_timed(fh);
+  ++fh->step;
+  run(fh);
+}
+
+static void step_done(struct Timer *timer) {
+  next_step((struct FleetHost *)timer->arg);
+}
+
+static void send_tick(struct Timer *timer) {
+  struct FleetHost *fh = (struct FleetHost *)timer->arg;
+
+  if (send_batch(fh)) {
+    next_step(fh);
+  } else {
+    timer_schedule(timer, TIMER_TICK_MS);
+  }
+}
+
+static void expect_expired(struct Timer *timer) {
+  struct FleetHost *fh = (struct FleetHost *)timer->arg;
+  const struct Step *st = &g_steps[fh->step];
+  char error[SCRIPT_LINE_MAX + 64];
+
+  snprintf(error, sizeof(error), "line %d: no \"%s\" after %lu ms", st->line,
+           st->text, (unsigned long)st->ms);
+  finish(fh, error);
+}
+
+static void connect_expired(struct Timer *timer) {
+  finish((struct FleetHost *)timer->arg, "no screen from host");
+}
+
+static int wanted(const struct RemoteHost *rh) {
+  if (!g_host_count) {
+    return 1;
+  }
+
+  for (size_t i = 0; i < g_host_count; ++i) {
+    if (!memcmp(&g_hosts[i * ETH_ALEN], rh->if_addr, ETH_ALEN)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void discover_done(struct Timer *timer) {
+  (void)timer;
+  g_discovering = 0;
+  timer_cancel(&g_probe_timer);
+}
+
+// `rh` answered a probe; starts a session to it, if it is wanted.
+static void host_found(struct RemoteHost *rh) {
+  if (!g_discovering || ((size_t)rh->index >= g_fleet_size) || !wanted(rh)) {
+    return;
+  }
+
+  struct FleetHost *fh = &g_fleet[rh->index];
+  if (fh->state != HOST_IDLE) {
+    return;
+  }
+
+  fh->rh = rh;
+  fh->state = HOST_CONNECTING;
+  fh->start_us = time_now_us();
+  ++g_found;
+  ++g_unfinished;
+
+  host_attach_screen(rh);
+  session_pin(rh);
+  timer_init(&fh->timer, connect_expired, fh);
+  timer_schedule(&fh->timer, FLEET_CONNECT_MS);
+
+  // Every host given has answered.
+  if (g_host_count && (g_found == g_host_count)) {
+    discover_done(&g_discover_timer);
+    timer_cancel(&g_discover_timer);
+  }
+}
+
+// The screen of `rh` changed.
+static void host_changed(struct RemoteHost *rh) {
+  if ((size_t)rh->index >= g_fleet_size) {
+    return;
+  }
+
+  struct FleetHost *fh = &g_fleet[rh->index];
+  if (fh->state == HOST_CONNECTING) {
+    timer_cancel(&fh->timer);
+    fh->state = HOST_RUNNING;
+    fh->screen_us = time_now_us();
+    run(fh);
+  } else if ((fh->state == HOST_RUNNING) &&
+             (g_steps[fh->step].type == STEP_EXPECT) &&
+             (__atomic_load_n(&host_screen(rh)->seq, __ATOMIC_ACQUIRE) !=
+              fh->seq) &&
+             expect_met(fh)) {
+    next_step(fh);
+  }
+}
+
+static void process_events(struct RxThread *rx) {
+  struct RxEvent ev;
+
+  rx_thread_ack(rx);
+
+  while (eventq_pop(&rx->queue, &ev)) {
+    if (ev.type == RX_EVENT_STATUS) {
+      ev.host->status = ev.status;
+      host_found(ev.host);
+    } else if (ev.type == RX_EVENT_VIDEO) {
+      host_changed(ev.host);
+    }
+  }
+
+  // Events were dropped; look at every host.
+  if (eventq_take_overflow(&rx->queue)) {
+    for (size_t i = 0; i < g_fleet_size; ++i) {
+      if (g_fleet[i].state != HOST_IDLE) {
+        host_changed(g_fleet[i].rh);
+      }
+    }
+  }
+}
+
+static void probe_fire(struct Timer *timer) {
+  for (size_t i = 0; i < g_socket_count; ++i) {
+    send_status_req(&g_sockets[i], NULL);
+  }
+  timer_schedule(timer, FLEET_PROBE_INTERVAL_MS);
+}
+
+// Reports the hosts that did not get to the end.
+static void report_missing() {
+  char mac_tmp[MAC_ADDR_FMT_LEN];
+
+  for (size_t i = 0; i < g_fleet_size; ++i) {
+    struct FleetHost *fh = &g_fleet[i];
+    if ((fh->state == HOST_CONNECTING) || (fh->state == HOST_RUNNING)) {
+      finish(fh, "interrupted");
+    }
+  }
+
+  for (size_t i = 0; i < g_host_count; ++i) {
+    const uint8_t *addr = &g_hosts[i * ETH_ALEN];
+    const struct RemoteHost *rh = hostlist_find_by_mac(addr);
+    if (!rh || (g_fleet[rh->index].state == HOST_IDLE)) {
+      printf("%s  failed  no answer\n",
+             fmt_mac_addr(mac_tmp, sizeof(mac_tmp), addr));
+      ++g_failed;
+      ++g_missing;
+    }
+  }
+}
+
+int fleet_run(struct RxThread **workers, size_t worker_count,
+              struct RawSocket *sockets, size_t socket_count,
+              const uint8_t *hosts, size_t host_count, size_t max_hosts) {
+  struct epoll_event ev, events[MAX_EVENTS];
+  struct sigaction sa;
+  int epoll_fd;
+  int timer_fd;
+  int r = -1;
+
+  g_hosts = hosts;
+  g_host_count = host_count;
+  g_sockets = sockets;
+  g_socket_count = socket_count;
+  g_fleet = (struct FleetHost *)calloc(max_hosts, sizeof(*g_fleet));
+  g_fleet_size = max_hosts;
+
+  // No SA_RESTART: interrupts `epoll_wait()`.
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_stop;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  if (0 > (epoll_fd = epoll_create1(EPOLL_CLOEXEC))) {
+    perror("epoll_create1()");
+    free(g_fleet);
+    return -1;
+  }
+
+  if (0 > (timer_fd = timers_init())) {
+    close(epoll_fd);
+    free(g_fleet);
+    return -1;
+  }
+
+  ev.events = EPOLLIN;
+  ev.data.fd = timer_fd;
+  if (0 > epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev)) {
+    perror("epoll_ctl(timerfd)");
+    goto done;
+  }
+
+  for (size_t w = 0; w < worker_count; ++w) {
+    ev.events = EPOLLIN;
+    ev.data.fd = workers[w]->notify_fd;
+    if (0 > epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ev.data.fd, &ev)) {
+      perror("epoll_ctl(rx_thread)");
+      goto done;
+    }
+  }
+
+  g_discovering = 1;
+  timer_init(&g_probe_timer, probe_fire, NULL);
+  timer_schedule(&g_probe_timer, 0);
+  timer_init(&g_discover_timer, discover_done, NULL);
+  timer_schedule(&g_discover_timer, FLEET_DISCOVER_MS);
+
+  while (!g_stop && (g_discovering || g_unfinished)) {
+    if (flightrec_take_request()) {
+      flightrec_dump();
+    }
+
+    const int nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+    if (nfds < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("epoll_wait()");
+      goto done;
+    }
+
+    for (int n = 0; n < nfds; ++n) {
+      if (events[n].data.fd == timer_fd) {
+        timers_run();
+      }
+
+      for (size_t w = 0; w < worker_count; ++w) {
+        if (events[n].data.fd == workers[w]->notify_fd) {
+          process_events(workers[w]);
+        }
+      }
+    }
+  }
+
+  report_missing();
+  printf("%zu hosts: %zu ok, %zu failed", g_ok + g_failed, g_ok, g_failed);
+  if (g_ok + g_failed > g_missing) {
+    printf("; fastest %.3fs, slowest %.3fs", g_fastest_us / 1e6,
+           g_slowest_us / 1e6);
+  }
+  printf("\n");
+  r = g_failed;
+
+done:
+  for (size_t i = 0; i < g_fleet_size; ++i) {
+    free(g_fleet[i].captures);
+  }
+  free(g_fleet);
+  g_fleet = NULL;
+  timers_close();
+  close(epoll_fd);
+  return r;
+}
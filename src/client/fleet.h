@@ -0,0 +1,64 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Fleet runner ("rmtdos-client -X script [host-addr ...]").  Runs one
+// expect-style script on many hosts at once: on the hosts given, or on every
+// host that answers a probe within FLEET_DISCOVER_MS.  Runs headless, and
+// prints each host's result and timings as it finishes, then a summary.
+//
+// Each host is a state machine on the UI thread.  Its screen updates (from
+// the network threads' events) and its timer move it along, so a hundred
+// hosts cost no more threads than one.
+//
+// A script has one step per line.  Blank lines and lines starting with '#'
+// are skipped.  Rows and columns count from 0.
+//
+//   send TEXT                     Types TEXT (the rest of the line).  The
+//                                 escapes \n (Enter), \t, \b, \e (Esc) and
+//                                 \\ are understood.
+//   expect ROW|* TIMEOUT_MS TEXT  Waits until row ROW (or any row, for "*")
+//                                 contains TEXT.  The host fails if
+//                                 TIMEOUT_MS passes first.
+//   capture NAME ROW [COL COUNT [ROWS]]
+//                                 Reports the text of row ROW (or of COUNT
+//                                 columns from COL, on ROWS rows), as
+//                                 "NAME: text".
+//   sleep MS                      Pauses.
+
+#ifndef __RMTDOS_CLIENT_FLEET_H
+#define __RMTDOS_CLIENT_FLEET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "client/network.h"
+#include "client/rxthread.h"
+
+// How long hosts have to answer a probe.
+#define FLEET_DISCOVER_MS 3000
+
+// How often to probe, until then.
+#define FLEET_PROBE_INTERVAL_MS 500
+
+// How long a host that answered has to send its screen.
+#define FLEET_CONNECT_MS 5000
+
+// Most steps in a script.
+#define FLEET_MAX_STEPS 1024
+
+// Reads the script at `path`.  Prints what is wrong with it, and returns <0,
+// on error.
+extern int fleet_load(const char *path);
+
+// Runs the script.  `workers` must be running on `sockets`.  `hosts` holds
+// `host_count` MAC addresses (ETH_ALEN bytes each), or is empty for every
+// host that answers.  `max_hosts` is the host list's size.  Returns the count
+// of hosts that failed (or did not answer), or <0 on error.
+extern int fleet_run(struct RxThread **workers, size_t worker_count,
+                     struct RawSocket *sockets, size_t socket_count,
+                     const uint8_t *hosts, size_t host_count,
+                     size_t max_hosts);
+
+#endif // __RMTDOS_CLIENT_FLEET_H
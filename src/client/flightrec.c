@@ -0,0 +1,303 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client/flightrec.h"
+#include "client/hostlist.h"
+#include "client/metrics.h"
+#include "client/util.h"
+
+#define MASK (FLIGHTREC_RING_SIZE - 1)
+
+// A dump skips this many of the oldest events in each ring, which the owner
+// may be overwriting while they are read.
+#define SLACK 256
+
+// Output is formatted into this much stack, then written.
+#define OUT_BUF_SIZE 4096
+
+struct FlightRing g_flight_rx;
+struct FlightRing g_flight_ui;
+
+// What a dump merges.  Only ever appended to.
+static struct FlightRing *g_rings[FLIGHTREC_MAX_RINGS] = {&g_flight_rx,
+                                                          &g_flight_ui};
+static size_t g_ring_count = 2;
+
+static char g_path[256];
+static volatile sig_atomic_t g_dump_requested = 0;
+
+static const char *const g_type_names[] = {
+    "?", "rx", "video", "drop", "render", "refresh", "keys", "overflow",
+};
+
+static const char *const g_drop_names[] = {
+    "?",       "not-for-us", "signature", "session",
+    "short",   "no-host",    "no-screen", "range",
+    "observer",
+};
+
+#define NAME(table, i)                                                         \
+  ((i) < sizeof(table) / sizeof(table[0]) ? table[i] : table[0])
+
+// Crashes that leave a dump behind.
+static const int g_fatal_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+static void on_sigusr1(int sig) {
+  (void)sig;
+  g_dump_requested = 1;
+}
+
+static void on_fatal(int sig) {
+  flightrec_dump();
+
+  // The handler was reset (SA_RESETHAND), so this ends the process.
+  raise(sig);
+}
+
+void flightrec_init(const char *path) {
+  struct sigaction sa;
+
+  if (path) {
+    snprintf(g_path, sizeof(g_path), "%s", path);
+  } else {
+    snprintf(g_path, sizeof(g_path), "rmtdos-flight-%d.txt", (int)getpid());
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_sigusr1;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGUSR1, &sa, NULL);
+
+  sa.sa_handler = on_fatal;
+  sa.sa_flags = SA_RESETHAND;
+  for (size_t i = 0; i < sizeof(g_fatal_signals) / sizeof(int); ++i) {
+    sigaction(g_fatal_signals[i], &sa, NULL);
+  }
+}
+
+const char *flightrec_path() { return g_path; }
+
+struct FlightRing *flightrec_ring_create() {
+  struct FlightRing *ring;
+
+  if ((g_ring_count == FLIGHTREC_MAX_RINGS) ||
+      !(ring = (struct FlightRing *)calloc(1, sizeof(*ring)))) {
+    return NULL;
+  }
+
+  g_rings[g_ring_count] = ring;
+  __atomic_store_n(&g_ring_count, g_ring_count + 1, __ATOMIC_RELEASE);
+  return ring;
+}
+
+void flightrec_add(struct FlightRing *ring, const struct FlightEvent *ev) {
+  const uint64_t head = ring->head;
+  struct FlightEvent *dest = &ring->events[head & MASK];
+
+  *dest = *ev;
+  if (!dest->ns) {
+    dest->ns = metrics_now_ns();
+  }
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+int flightrec_take_request() {
+  if (!g_dump_requested) {
+    return 0;
+  }
+  g_dump_requested = 0;
+  return 1;
+}
+
+// Async-signal-safe output: no stdio.
+struct Out {
+  int fd;
+  size_t len;
+  char buf[OUT_BUF_SIZE];
+};
+
+static void out_flush(struct Out *out) {
+  size_t done = 0;
+  ssize_t r;
+
+  while (done < out->len) {
+    if (0 >= (r = write(out->fd, out->buf + done, out->len - done))) {
+      break;
+    }
+    done += r;
+  }
+  out->len = 0;
+}
+
+static void out_str(struct Out *out, const char *s) {
+  while (*s) {
+    if (out->len == sizeof(out->buf)) {
+      out_flush(out);
+    }
+    out->buf[out->len++] = *s++;
+  }
+}
+
+// `value` in decimal, zero padded to at least `width` digits.
+static void out_uint(struct Out *out, uint64_t value, int width) {
+  char tmp[24];
+  int i = sizeof(tmp) - 1;
+
+  tmp[i] = 0;
+  do {
+    tmp[--i] = '0' + value % 10;
+    value /= 10;
+  } while ((value || (sizeof(tmp) - 1 - i < (size_t)width)) && (i > 0));
+  out_str(out, tmp + i);
+}
+
+static void out_field(struct Out *out, const char *name, uint64_t value) {
+  out_str(out, " ");
+  out_str(out, name);
+  out_str(out, " ");
+  out_uint(out, value, 1);
+}
+
+static void out_host(struct Out *out, uint16_t index) {
+  static const char hex[] = "0123456789abcdef";
+  const struct RemoteHost *rh;
+  char mac[MAC_ADDR_FMT_LEN];
+  char *p = mac;
+
+  if ((index == FLIGHT_NO_HOST) || !(rh = hostlist_find_by_index(index))) {
+    out_str(out, " host -");
+    return;
+  }
+
+  for (int i = 0; i < ETH_ALEN; ++i) {
+    *p++ = hex[rh->if_addr[i] >> 4];
+    *p++ = hex[rh->if_addr[i] & 15];
+    *p++ = (i < ETH_ALEN - 1) ? ':' : 0;
+  }
+  out_field(out, "host", index);
+  out_str(out, " ");
+  out_str(out, mac);
+}
+
+static void out_event(struct Out *out, const struct FlightEvent *ev,
+                      uint64_t real_ns, uint64_t mono_ns) {
+  const uint64_t when = real_ns - (mono_ns - ev->ns);
+
+  out_uint(out, when / 1000000000, 1);
+  out_str(out, ".");
+  out_uint(out, when % 1000000000 / 1000, 6);
+  out_str(out, " ");
+  out_str(out, NAME(g_type_names, ev->type));
+
+  switch (ev->type) {
+    case FLIGHT_RX:
+      out_host(out, ev->host);
+      out_field(out, "type", ev->pkt_type);
+      out_field(out, "len", ev->length);
+      break;
+
+    case FLIGHT_DROP:
+      out_str(out, " ");
+      out_str(out, NAME(g_drop_names, ev->detail));
+      out_host(out, ev->host);
+      out_field(out, "type", ev->pkt_type);
+      out_field(out, "len", ev->length);
+      break;
+
+    case FLIGHT_VIDEO:
+    case FLIGHT_RENDER:
+      out_host(out, ev->host);
+      out_field(out, "offset", ev->offset);
+      out_field(out, "count", ev->count);
+      out_field(out, "ns", ev->duration_ns);
+      break;
+
+    case FLIGHT_REFRESH:
+      out_field(out, "bytes", ev->length);
+      out_field(out, "ns", ev->duration_ns);
+      break;
+
+    case FLIGHT_KEYS:
+      out_host(out, ev->host);
+      out_field(out, "count", ev->count);
+      break;
+  }
+  out_str(out, "\n");
+}
+
+// Index of the oldest event in `ring` at or after `cutoff_ns`, up to `head`.
+static uint64_t first_event(const struct FlightRing *ring, uint64_t head,
+                            uint64_t cutoff_ns) {
+  uint64_t i = (head > FLIGHTREC_RING_SIZE - SLACK)
+                   ? head - (FLIGHTREC_RING_SIZE - SLACK)
+                   : 0;
+
+  while ((i < head) && (ring->events[i & MASK].ns < cutoff_ns)) {
+    ++i;
+  }
+  return i;
+}
+
+int flightrec_dump() {
+  const size_t count = __atomic_load_n(&g_ring_count, __ATOMIC_ACQUIRE);
+  uint64_t next[FLIGHTREC_MAX_RINGS];
+  uint64_t head[FLIGHTREC_MAX_RINGS];
+  struct Out out;
+  struct timespec ts;
+
+  if (0 > (out.fd = open(g_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                         0644))) {
+    return -1;
+  }
+  out.len = 0;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  const uint64_t real_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  const uint64_t mono_ns = metrics_now_ns();
+  const uint64_t cutoff_ns = mono_ns - FLIGHTREC_SECONDS * 1000000000ULL;
+
+  out_str(&out, "# rmtdos-client flight recorder, pid ");
+  out_uint(&out, getpid(), 1);
+  out_str(&out, ", last ");
+  out_uint(&out, FLIGHTREC_SECONDS, 1);
+  out_str(&out, " seconds\n");
+
+  for (size_t r = 0; r < count; ++r) {
+    head[r] = __atomic_load_n(&g_rings[r]->head, __ATOMIC_ACQUIRE);
+    next[r] = first_event(g_rings[r], head[r], cutoff_ns);
+  }
+
+  // Merge the rings, oldest first.
+  while (1) {
+    const struct FlightEvent *oldest = NULL;
+    size_t from = 0;
+
+    for (size_t r = 0; r < count; ++r) {
+      const struct FlightEvent *ev = &g_rings[r]->events[next[r] & MASK];
+      if ((next[r] < head[r]) && (!oldest || (ev->ns < oldest->ns))) {
+        oldest = ev;
+        from = r;
+      }
+    }
+
+    if (!oldest) {
+      break;
+    }
+    ++next[from];
+    out_event(&out, oldest, real_ns, mono_ns);
+  }
+
+  out_flush(&out);
+  return close(out.fd);
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Flight recorder: an always-on record of the last FLIGHTREC_SECONDS of
+// frames received (or thrown away, and why), screen updates stored and
+// drawn, terminal refreshes and keystrokes sent.  Written to a text file by
+// `flightrec_dump()`: on DUMP_WCH_CODE in the menu or wall view, on SIGUSR1,
+// and when the client crashes.
+//
+// Each thread writes its own ring (`g_flight_rx`, `g_flight_ui`, or one from
+// `flightrec_ring_create()`), so adding an event is a few stores, with no
+// locks or allocation.  Old events are overwritten.
+
+#ifndef __RMTDOS_CLIENT_FLIGHTREC_H
+#define __RMTDOS_CLIENT_FLIGHTREC_H
+
+#include <stdint.h>
+
+// Events per ring.  Must be a power of 2.  Enough for FLIGHTREC_SECONDS of a
+// busy session (~1000 frames per second).
+#define FLIGHTREC_RING_SIZE 65536
+
+// How far back a dump goes.
+#define FLIGHTREC_SECONDS 30
+
+// Most rings, including `g_flight_rx` and `g_flight_ui`.
+#define FLIGHTREC_MAX_RINGS 32
+
+enum FlightEventType {
+  FLIGHT_RX = 1,   // Frame accepted (not video).  `pkt_type`, `length`.
+  FLIGHT_VIDEO,    // V1_VGA_TEXT stored.  `offset`, `count`, `duration_ns`.
+  FLIGHT_DROP,     // Frame thrown away.  `detail`, `pkt_type`, `length`.
+  FLIGHT_RENDER,   // Host drawn.  `offset`, `count`, `duration_ns`.
+  FLIGHT_REFRESH,  // Terminal written.  `length` (bytes), `duration_ns`.
+  FLIGHT_KEYS,     // Keystrokes sent.  `count`.
+  FLIGHT_OVERFLOW, // UI thread fell behind; events were lost.
+};
+
+// Why a frame was thrown away (`FlightEvent.detail`).
+enum FlightDropReason {
+  FLIGHT_DROP_NOT_FOR_US = 1, // Sent to another MAC address.
+  FLIGHT_DROP_SIGNATURE,      // Not PACKET_SIGNATURE.
+  FLIGHT_DROP_SESSION,        // Not our session.
+  FLIGHT_DROP_SHORT,          // Shorter than its payload.
+  FLIGHT_DROP_NO_HOST,        // Sender unknown, or the host list is full.
+  FLIGHT_DROP_NO_SCREEN,      // Video for a host in no session.
+  FLIGHT_DROP_RANGE,          // Video outside of the screen buffer.
+  FLIGHT_DROP_OBSERVER,       // Not the server / session being observed.
+};
+
+// No host: sender not known.
+#define FLIGHT_NO_HOST 0xffff
+
+struct FlightEvent {
+  uint64_t ns;          // `metrics_now_ns()`.
+  uint32_t duration_ns; // Time taken, if the event has one.
+  uint16_t length;      // Frame or write length.
+  uint16_t offset;      // Screen buffer offset.
+  uint16_t count;       // Screen bytes, or keystrokes.
+  uint16_t host;        // `RemoteHost.index`, or FLIGHT_NO_HOST.
+  uint8_t type;         // enum FlightEventType
+  uint8_t pkt_type;     // enum PKT_TYPE, if a frame.
+  uint8_t detail;       // enum FlightDropReason, for FLIGHT_DROP.
+};
+
+struct FlightRing {
+  struct FlightEvent events[FLIGHTREC_RING_SIZE];
+  uint64_t head; // Events ever added.  Stored last, with release.
+};
+
+// Network thread (the first one, in collector mode).
+extern struct FlightRing g_flight_rx;
+
+// UI thread.
+extern struct FlightRing g_flight_ui;
+
+// Sets the dump file (NULL: "rmtdos-flight-PID.txt"), and dumps on SIGUSR1
+// (see `flightrec_take_request()`) and on crashes.
+extern void flightrec_init(const char *path);
+
+// UI thread: returns a new ring, for another thread, that dumps will include.
+// It lives until the process exits.  Returns NULL if FLIGHTREC_MAX_RINGS are
+// in use.
+extern struct FlightRing *flightrec_ring_create();
+
+// Only the thread that owns `ring` may add to it.  Copies `ev`, setting `ns`
+// to now if it is 0.
+extern void flightrec_add(struct FlightRing *ring, const struct FlightEvent *ev);
+
+// UI thread: returns non-zero (once) if SIGUSR1 asked for a dump.
+extern int flightrec_take_request();
+
+// Writes the last FLIGHTREC_SECONDS of every ring to the dump file, oldest
+// first.  Async-signal-safe.  Returns <0 on error.
+extern int flightrec_dump();
+
+// The dump file.
+extern const char *flightrec_path();
+
+#endif // __RMTDOS_CLIENT_FLIGHTREC_H
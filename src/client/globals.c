@@ -0,0 +1,13 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "client/globals.h"
+
+int g_running = 1;
+int g_show_debug_window = 0;
+int g_observer_mode = 0;
+
+// Non-NULL if we're actively controlling a server.
+struct RemoteHost *g_active_host = NULL;
@@ -11,6 +11,9 @@
 extern int g_running;
 extern int g_show_debug_window;
 
+// Non-zero if passively watching another viewer's session (see "-o").
+extern int g_observer_mode;
+
 // Non-NULL if we're actively controlling a server.
 extern struct RemoteHost *g_active_host;
 
@@ -4,6 +4,11 @@
  */
 
 // Routines for managing a list of known remote hosts.
+//
+// Hosts are kept in an open-addressing (linear probing) hash table keyed by
+// MAC address, plus a dense array indexed by `RemoteHost.index`.  Hosts are
+// never removed while the client runs, which lets any thread insert with a
+// compare-and-swap and lets any thread read without taking a lock.
 
 #include <arpa/inet.h>
 #include <stddef.h>
@@ -12,98 +17,205 @@
 #include <sys/time.h>
 
 #include "client/hostlist.h"
+#include "client/util.h"
+
+// Hash table slots.  Power of two, at least twice `g_max_hosts`, so probe
+// sequences stay short.
+static struct RemoteHost **g_table = NULL;
+static size_t g_table_mask = 0;
+
+// Hosts by `index`.  Slots below `g_host_count` may briefly be NULL while an
+// insert is being published, and stay NULL when two threads raced to add the
+// same host (the loser's index is never used).
+static struct RemoteHost **g_by_index = NULL;
+static size_t g_max_hosts = 0;
+static size_t g_host_count = 0;
+
+static size_t mac_hash(const uint8_t *if_addr) {
+  uint64_t key = 0;
+  for (int i = 0; i < ETH_ALEN; ++i) {
+    key = (key << 8) | if_addr[i];
+  }
 
-// This would be so much easier if I were using C++17 w/ the STL...
-#define MAX_HOSTS 16
-static struct RemoteHost *g_remote_hosts[MAX_HOSTS] = {NULL};
+  // Fibonacci hashing; the top bits are the best mixed.
+  return (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32);
+}
 
-static struct RemoteHost *host_create() {
+static struct RemoteHost *host_create(const uint8_t *if_addr) {
   struct RemoteHost *rh =
       (struct RemoteHost *)malloc(sizeof(struct RemoteHost));
   memset(rh, 0, sizeof(struct RemoteHost));
+  memcpy(rh->if_addr, if_addr, ETH_ALEN);
   return rh;
 }
 
-static void host_destroy(struct RemoteHost *rh) { free(rh); }
+static void host_destroy(struct RemoteHost *rh) {
+  if (!rh->screen_external) {
+    free(rh->screen);
+  }
+  free(rh);
+}
 
-void hostlist_create() {}
+void hostlist_create(size_t max_hosts) {
+  size_t slots = 16;
+  while (slots < 2 * max_hosts) {
+    slots <<= 1;
+  }
+
+  g_table = (struct RemoteHost **)calloc(slots, sizeof(*g_table));
+  g_table_mask = slots - 1;
+  g_by_index = (struct RemoteHost **)calloc(max_hosts, sizeof(*g_by_index));
+  g_max_hosts = max_hosts;
+  g_host_count = 0;
+}
 
 void hostlist_destroy() {
-  for (int i = 0; i < MAX_HOSTS; ++i) {
-    if (g_remote_hosts[i]) {
-      host_destroy(g_remote_hosts[i]);
-      g_remote_hosts[i] = NULL;
+  for (size_t i = 0; i <= g_table_mask; ++i) {
+    if (g_table[i]) {
+      host_destroy(g_table[i]);
     }
   }
+
+  free(g_table);
+  free(g_by_index);
+  g_table = g_by_index = NULL;
+  g_table_mask = g_max_hosts = g_host_count = 0;
+}
+
+size_t hostlist_count() {
+  const size_t count = __atomic_load_n(&g_host_count, __ATOMIC_ACQUIRE);
+  return count < g_max_hosts ? count : g_max_hosts;
 }
 
 struct RemoteHost *hostlist_find_by_mac(const uint8_t *if_addr) {
-  for (int i = 0; i < MAX_HOSTS; ++i) {
-    if (g_remote_hosts[i] &&
-        !memcmp(g_remote_hosts[i]->if_addr, if_addr, ETH_ALEN)) {
-      return g_remote_hosts[i];
+  for (size_t i = mac_hash(if_addr), n = 0; n <= g_table_mask; ++i, ++n) {
+    struct RemoteHost *rh =
+        __atomic_load_n(&g_table[i & g_table_mask], __ATOMIC_ACQUIRE);
+    if (!rh) {
+      return NULL;
+    }
+    if (!memcmp(rh->if_addr, if_addr, ETH_ALEN)) {
+      return rh;
     }
   }
   return NULL;
 }
 
 struct RemoteHost *hostlist_find_by_index(int index) {
-  if ((index >= 0) && (index < MAX_HOSTS) && g_remote_hosts[index]) {
-    return g_remote_hosts[index];
+  if ((index >= 0) && ((size_t)index < hostlist_count())) {
+    return __atomic_load_n(&g_by_index[index], __ATOMIC_ACQUIRE);
   }
 
   return NULL;
 }
 
-struct RemoteHost *hostlist_allocate() {
-  for (int i = 0; i < MAX_HOSTS; ++i) {
-    if (!g_remote_hosts[i]) {
-      g_remote_hosts[i] = host_create();
-      g_remote_hosts[i]->index = i;
-      return g_remote_hosts[i];
+static struct RemoteHost *hostlist_allocate(const uint8_t *if_addr) {
+  if (hostlist_count() >= g_max_hosts) {
+    return NULL;
+  }
+
+  // The menu index is set before the host is published, so that a thread
+  // that finds it by MAC never sees a stale one.
+  const size_t index = __atomic_fetch_add(&g_host_count, 1, __ATOMIC_ACQ_REL);
+  if (index >= g_max_hosts) {
+    return NULL;
+  }
+
+  struct RemoteHost *rh = host_create(if_addr);
+  rh->index = index;
+
+  for (size_t i = mac_hash(if_addr), n = 0; n <= g_table_mask; ++i, ++n) {
+    struct RemoteHost **slot = &g_table[i & g_table_mask];
+    struct RemoteHost *expected = NULL;
+
+    if (__atomic_compare_exchange_n(slot, &expected, rh, 0, __ATOMIC_ACQ_REL,
+                                    __ATOMIC_ACQUIRE)) {
+      __atomic_store_n(&g_by_index[index], rh, __ATOMIC_RELEASE);
+      return rh;
+    }
+
+    // Someone else inserted the same host first.
+    if (!memcmp(expected->if_addr, if_addr, ETH_ALEN)) {
+      host_destroy(rh);
+      return expected;
     }
   }
+
+  host_destroy(rh);
   return NULL;
 }
 
 extern struct RemoteHost *hostlist_iter(int *iter) {
-  while (*iter < MAX_HOSTS) {
-    if (g_remote_hosts[*iter]) {
-      struct RemoteHost *rh = g_remote_hosts[*iter];
-      ++(*iter);
+  const size_t count = hostlist_count();
+
+  while ((*iter >= 0) && ((size_t)*iter < count)) {
+    struct RemoteHost *rh =
+        __atomic_load_n(&g_by_index[*iter], __ATOMIC_ACQUIRE);
+    ++(*iter);
+    if (rh) {
       return rh;
     }
-    ++(*iter);
   }
 
   *iter = -1;
   return NULL;
 }
 
-void hostlist_register(const uint8_t *packet, size_t length) {
+struct RemoteHost *hostlist_add(const uint8_t *if_addr) {
+  struct RemoteHost *rh = hostlist_find_by_mac(if_addr);
+  return rh ? rh : hostlist_allocate(if_addr);
+}
+
+struct RemoteHost *hostlist_register(const uint8_t *packet, size_t length,
+                                     struct RawSocket *rs) {
   const struct ether_header *eh = (const struct ether_header *)packet;
-  const struct ProtocolHeader *ph = (const struct ProtocolHeader *)(eh + 1);
 
-  struct RemoteHost *rh = hostlist_find_by_mac(eh->ether_shost);
+  struct RemoteHost *rh = hostlist_add(eh->ether_shost);
   if (!rh) {
-    if (NULL == (rh = hostlist_allocate())) {
-      // No more space, drop host.
-      return;
-    }
+    // No more space, drop host.
+    return NULL;
+  }
 
-    memcpy(rh->if_addr, eh->ether_shost, ETH_ALEN);
+  // The same MAC on two segments is the first one heard; set only once.
+  if (!host_socket(rh)) {
+    __atomic_store_n(&rh->rs, rs, __ATOMIC_RELEASE);
   }
 
-  gettimeofday(&(rh->tv_last_resp), NULL);
+  __atomic_store_n(&rh->last_resp_us, time_now_us(), __ATOMIC_RELAXED);
+  return rh;
+}
 
-  if (ntohs(ph->pkt_type) == V1_STATUS_RESP) {
-    const struct StatusResponse *s = (const struct StatusResponse *)(ph + 1);
+uint64_t host_last_resp_us(const struct RemoteHost *rh) {
+  return __atomic_load_n(&rh->last_resp_us, __ATOMIC_RELAXED);
+}
 
-    rh->status.video_mode = s->video_mode;
-    rh->status.active_page = s->active_page;
-    rh->status.text_rows = s->text_rows;
-    rh->status.text_cols = s->text_cols;
-    rh->status.cursor_row = s->cursor_row;
-    rh->status.cursor_col = s->cursor_col;
+struct RawSocket *host_socket(const struct RemoteHost *rh) {
+  return __atomic_load_n(&rh->rs, __ATOMIC_ACQUIRE);
+}
+
+struct Screen *host_screen(const struct RemoteHost *rh) {
+  return __atomic_load_n(&rh->screen, __ATOMIC_ACQUIRE);
+}
+
+struct Screen *host_attach_screen(struct RemoteHost *rh) {
+  struct Screen *s = host_screen(rh);
+
+  if (!s) {
+    s = (struct Screen *)calloc(1, sizeof(struct Screen));
+    __atomic_store_n(&rh->screen, s, __ATOMIC_RELEASE);
+  }
+
+  return s;
+}
+
+struct Screen *host_attach_screen_at(struct RemoteHost *rh, struct Screen *s) {
+  struct Screen *current = host_screen(rh);
+
+  if (current) {
+    return current;
   }
+
+  rh->screen_external = 1;
+  __atomic_store_n(&rh->screen, s, __ATOMIC_RELEASE);
+  return s;
 }
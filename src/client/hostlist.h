@@ -12,43 +12,121 @@
 #include <stdint.h>
 #include <sys/time.h>
 
+#include "client/metrics.h"
+#include "client/screen.h"
+#include "client/timerwheel.h"
 #include "common/protocol.h"
 
+struct RawSocket;
+struct RecordingWriter;
+struct WallTile;
+
 // Used to keep track of all servers seen, so we can present a selection
 // to the user.
 struct RemoteHost {
   // Human-friendly (small integer) ID attached to this host, for menu
-  // seection usage.
+  // seection usage.  Assigned in order of discovery, starting at 0.
   int index;
 
   // Network identify of the host.
   uint8_t if_addr[ETH_ALEN];
 
-  // Absolute timestamp of last packet received for this host.
-  struct timeval tv_last_resp;
+  // Socket (interface) the host was first heard on, which everything sent to
+  // it goes out of.  NULL if never heard from.  Set by the network thread,
+  // use `host_socket()` to read.
+  struct RawSocket *rs;
+
+  // Absolute timestamp (`time_now_us()`) of last packet received for this
+  // host.  Written by the network thread, use `host_last_resp_us()` to read.
+  uint64_t last_resp_us;
 
-  // Absolute timestamp of last sent V1_SESSION_START.
-  struct timeval tv_last_session_start;
+  // Sends V1_SESSION_START while the host is in a session (see
+  // "client/session.h").
+  struct Timer keepalive;
 
   // Misc status flags from the host.
   // Captured even when not actively under remote control.
+  // Owned by the UI thread (updated from RX_EVENT_STATUS).
   struct StatusResponse status;
 
+  // Last V1_STATS_RESP from the host, in host byte order, and when it came
+  // (`time_now_us()`, 0 if never).  Owned by the UI thread (updated from
+  // RX_EVENT_STATS).
+  struct StatsResponse stats;
+  uint64_t stats_us;
+
   // Non-NULL if host is being remotely controlled (ncurses WINDOW).
   WINDOW *window;
 
-  // Last known VGA text mode resolution.
+  // Non-NULL if host is shown on the wall view.
+  struct WallTile *tile;
+
+  // Non-zero if a session is kept alive in the background (see
+  // "client/session.h").
+  uint8_t background;
+
+  // Non-NULL while the session is being recorded (see "client/recorder.h").
+  struct RecordingWriter *recording;
+
+  // Non-zero if picked in the menu for the wall view.
+  uint8_t marked;
+
+  // VGA text mode resolution of the last frame drawn by the UI thread.
   uint8_t text_rows;
   uint8_t text_cols;
 
-  // Raw VGA text buffer, as sent from client in V1_VGA_TEXT packets.
-  // VGA text buffer is from $000b8000 to $000bffff (32KiB).
-  uint8_t video_text_buffer[32768];
+  // Counters and timings, see "client/metrics.h".
+  struct HostMetrics metrics;
+
+  // Screen contents, written by the network thread.  NULL until the host is
+  // first put into a session, so idle hosts cost only a few bytes.  Use
+  // `host_screen()` to read from another thread.
+  struct Screen *screen;
+
+  // Non-zero if `screen` is not ours to free (see `host_attach_screen_at()`).
+  uint8_t screen_external;
 };
 
-extern void hostlist_create();
+// Default for `hostlist_create()`.
+#define HOSTLIST_DEFAULT_MAX_HOSTS 4096
+
+extern void hostlist_create(size_t max_hosts);
 extern void hostlist_destroy();
-extern void hostlist_register(const uint8_t *packet, size_t length);
+
+// Count of indexes given out.  Valid indexes are 0 .. count-1; a few may
+// have no host (see "hostlist.c"), so use `hostlist_iter()` to list hosts.
+extern size_t hostlist_count();
+
+// Called by the network thread.  Returns the host that sent `packet` (received
+// on `rs`), adding it to the list if needed.  Returns NULL if the list is
+// full.
+extern struct RemoteHost *hostlist_register(const uint8_t *packet,
+                                            size_t length,
+                                            struct RawSocket *rs);
+
+// Returns the host with MAC `if_addr`, adding it to the list if needed.
+// Returns NULL if the list is full.
+extern struct RemoteHost *hostlist_add(const uint8_t *if_addr);
+
+// Safe to call from any thread.
+extern uint64_t host_last_resp_us(const struct RemoteHost *rh);
+
+// Safe to call from any thread.  Returns NULL if the host was never heard
+// from.
+extern struct RawSocket *host_socket(const struct RemoteHost *rh);
+
+// Safe to call from any thread.  Returns NULL if no screen is attached.
+extern struct Screen *host_screen(const struct RemoteHost *rh);
+
+// UI thread only.  Allocates the screen buffer, if not already done, so the
+// network thread starts storing V1_VGA_TEXT updates for this host.
+extern struct Screen *host_attach_screen(struct RemoteHost *rh);
+
+// UI thread only.  Like `host_attach_screen()`, but stores into `s`, which
+// the caller owns and keeps for as long as the host list exists.  Returns
+// the screen already attached, if any.
+extern struct Screen *host_attach_screen_at(struct RemoteHost *rh,
+                                            struct Screen *s);
 
 // To iterate through the known remote hosts, set *iter to 0.  Call
 // `hostlist_iter()` until it returns NULL.
@@ -57,7 +135,7 @@ extern struct RemoteHost *hostlist_iter(int *iter);
 // Returns NULL is mac_addr is not found.
 extern struct RemoteHost *hostlist_find_by_mac(const uint8_t *if_addr);
 
-// Returns NULL is mac_addr is not found.
+// Returns NULL is index is not found.
 extern struct RemoteHost *hostlist_find_by_index(int index);
 
 #endif // __RMTDOS_CLIENT_HOSTLIST_H
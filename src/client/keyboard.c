@@ -31,9 +31,12 @@
 #include <stdlib.h>
 
 #include "client/curses.h"
+#include "client/flightrec.h"
 #include "client/globals.h"
 #include "client/keyboard.h"
 #include "client/keysyms.h"
+#include "client/recorder.h"
+#include "client/session.h"
 #include "common/protocol.h"
 
 // Short version of `struct Keystroke`.
@@ -483,7 +486,57 @@ static const struct Key keymap[WCH_MAX] = {
     [0x244] = {0x4a, '-', 0, "sub"},           // keypad "-"
 };
 
-void process_stdin_session_mode(struct RawSocket *rs) {
+int keyboard_map(int wch, struct Keystroke *ks) {
+  if ((wch < 0) || (wch >= WCH_MAX) ||
+      (!keymap[wch].bios && !keymap[wch].ascii)) {
+    return 0;
+  }
+
+  ks->bios_scan_code = keymap[wch].bios;
+  ks->ascii_value = keymap[wch].ascii;
+  ks->flags_17 = keymap[wch].flags;
+  return 1;
+}
+
+int keyboard_parse_text(const char *text, struct Keystroke *keys) {
+  int count = 0;
+
+  for (const char *p = text; *p; ++p) {
+    int wch = (uint8_t)*p;
+
+    if (wch == '\\') {
+      switch (*++p) {
+        case 'n':
+          wch = ENTER_WCH_CODE;
+          break;
+        case 't':
+          wch = '\t';
+          break;
+        case 'b':
+          wch = BACKSPACE_WCH_CODE;
+          break;
+        case 'e':
+          wch = 0x1b;
+          break;
+        case '\\':
+          wch = '\\';
+          break;
+        default:
+          return -1 - (int)(p - text);
+      }
+    }
+
+    if (!keyboard_map(wch, &keys[count++])) {
+      return -1 - (int)(p - text);
+    }
+  }
+
+  return count;
+}
+
+void process_stdin_session_mode() {
+  // Set after PREFIX_WCH_CODE, until the next key.
+  static int prefixed = 0;
   wint_t wch = 0;
 
   switch (wget_wch(g_session_window, &wch)) {
@@ -507,15 +560,52 @@ void process_stdin_session_mode(struct RawSocket *rs) {
     return;
   }
 
-  if ((wch > 0) && (wch < WCH_MAX)) {
-    const struct Keystroke ks = {
-        .bios_scan_code = keymap[wch].bios,
-        .ascii_value = keymap[wch].ascii,
-        .flags_17 = keymap[wch].flags,
-    };
+  // Read only; nothing is ever sent to the server.
+  if (g_observer_mode) {
+    return;
+  }
+
+  if (prefixed) {
+    prefixed = 0;
+    mvwprintw(g_session_window, 53, 1, "%*c", 30, ' ');
+
+    // Hot-switch to the previous host.
+    if (wch == SWITCH_WCH_CODE) {
+      session_switch_previous();
+      return;
+    }
+
+    // Back to the menu, keeping the session in the background.
+    if (wch == DETACH_WCH_CODE) {
+      session_detach();
+      return;
+    }
+
+    // Anything but a second CTRL-] cancels the prefix.
+    if (wch != PREFIX_WCH_CODE) {
+      return;
+    }
+  } else if (wch == PREFIX_WCH_CODE) {
+    prefixed = 1;
+    mvwprintw(g_session_window, 53, 1, "%-30s", "CTRL-]: p, m or CTRL-]");
+    return;
+  }
 
-    if (keymap[wch].bios || keymap[wch].ascii) {
+  struct Keystroke ks;
+  if ((wch > 0) && keyboard_map(wch, &ks)) {
+    struct RawSocket *rs = host_socket(g_active_host);
+    if (rs) {
       send_keystrokes(rs, g_active_host->if_addr, 1, &ks);
+      recorder_keystrokes(g_active_host, 1, &ks);
+      ++g_active_host->metrics.keystrokes_sent;
+
+      const struct FlightEvent fe = {
+          .type = FLIGHT_KEYS,
+          .host = g_active_host->index,
+          .pkt_type = V1_INJECT_KEYSTROKE,
+          .count = 1,
+      };
+      flightrec_add(&g_flight_ui, &fe);
 
       mvwprintw(g_session_window, 53, 1, "%*c", 30, ' ');
       return;
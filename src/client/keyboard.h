@@ -10,10 +10,37 @@
 #include "client/network.h"
 
 #define EXIT_WCH_CODE 0x11 /* CTRL-q */
+// In a session, the key after CTRL-] picks a client command; CTRL-] twice
+// sends CTRL-] to the server.  Every other key goes to the server.
+#define PREFIX_WCH_CODE 0x1d /* CTRL-] */
+#define SWITCH_WCH_CODE 'p'  /* Previous host */
+#define DETACH_WCH_CODE 'm'  /* Menu */
+// Flight recorder (see "client/flightrec.h").  Menu and wall view only; in a
+// session, F10 goes to the host (it opens the menu of most DOS programs).
+#define DUMP_WCH_CODE KEY_F(10)
+
+// Keys with no BIOS equivalent, as `wch` for `keyboard_map()`.
+#define ENTER_WCH_CODE 0x157
+#define BACKSPACE_WCH_CODE KEY_BACKSPACE
+
+// Sets `ks` to what the key `wch` (as returned by `wget_wch()`) sends to the
+// server.  Returns 0 if the key is not mapped.
+int keyboard_map(int wch, struct Keystroke *ks);
+
+// Sets `keys` to the keys that type `text`, which may use the escapes \n
+// (Enter), \t, \b (backspace), \e (Esc) and \\.  `keys` must have room for
+// strlen(text) keys.  Returns the count, or <0 if the character at offset
+// -(1 + result) has no key (or is a bad escape).
+int keyboard_parse_text(const char *text, struct Keystroke *keys);
+
+// The server puts injected keys straight into the BIOS keyboard buffer,
+// which holds 15, so typed text is sent at most this many keys per frame,
+// a frame per TIMER_TICK_MS.
+#define KEYS_PER_BATCH 8
 
 // UI is in "session mode" (connected to a server).  Send the keystroke over
 // for server to inject it into the BIOS keyboard buffer.
-void process_stdin_session_mode(struct RawSocket *rs);
+void process_stdin_session_mode();
 
 void dump_keyboard_table(FILE *fp);
 
@@ -25,99 +25,68 @@
 #include <unistd.h>
 
 #include "client/curses.h"
+#include "client/daemon.h"
+#include "client/echobench.h"
+#include "client/fleet.h"
+#include "client/flightrec.h"
 #include "client/globals.h"
 #include "client/hostlist.h"
 #include "client/keyboard.h"
+#include "client/menu.h"
+#include "client/metrics.h"
 #include "client/network.h"
+#include "client/probes.h"
+#include "client/query.h"
+#include "client/recorder.h"
+#include "client/rxthread.h"
+#include "client/session.h"
+#include "client/shmstore.h"
+#include "client/statsquery.h"
+#include "client/timerwheel.h"
 #include "client/util.h"
+#include "client/wall.h"
 #include "common/protocol.h"
 
 #define BUF_SIZE (ETH_FRAME_LEN)
 
 #define MAX_EVENTS 16 /* epoll events */
 
-#define MAX_HOSTS 16
+// Hosts whose redraws can be merged per batch of events.
+#define MAX_DIRTY 64
 
 enum AppMode {
   MODE_PROBING = 1,  // Probing for remote servers.
   MODE_RMT_CTRL = 2, // Remote control of a single server.
 };
 
-static const int epoll_timeout_ms = 1000;
+// Network receive thread state.  Large (holds the event ring), so static.
+static struct RxThread g_rx_thread;
+
+// Collector mode (`-W`): every network thread, `g_rx_thread` first.
+static struct RxThread *g_rx_workers[MAX_RX_WORKERS] = {&g_rx_thread};
+static size_t g_rx_worker_count = 1;
+
+// One per interface (`-i`).
+static struct RawSocket g_sockets[MAX_INTERFACES];
+static size_t g_socket_count = 0;
 
 // How often to send a broadcast probe, looking for servers.
-static const struct timeval broadcast_probe_interval = {
-    .tv_sec = 2,
-    .tv_usec = 500000,
-};
+#define PROBE_INTERVAL_MS 2500
 
-// How often client should send a 'V1_SESSION_START' message.
-static const struct timeval session_start_interval = {
-    .tv_sec = 2,
-    .tv_usec = 0,
-};
+// How often to redraw what shows the time since a host was last heard from
+// (session HUD, wall titles, menu), and the debug window's metrics.
+#define HUD_INTERVAL_MS 1000
 
 static uint8_t broadcast_addr[ETH_ALEN] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
 
 #define MIN(x, y) ((x) > (y) ? (y) : (x))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
 
 enum AppMode g_app_mode = MODE_PROBING;
-int g_running = 1;
-int g_show_debug_window = 0;
-
-static struct timeval g_last_probe = {0};
-
-// Non-NULL if we're actively controlling a server.
-struct RemoteHost *g_active_host = NULL;
-
-void update_probing_window(const struct RawSocket *rs) {
-  struct timeval tv_now;
-  char mac_tmp[MAC_ADDR_FMT_LEN];
-  WINDOW *w = g_probe_window;
-  int y = 0;
-
-  wmove(w, y, 0);
-  wclrtobot(w);
-
-  box(w, 0, 0);
-  mvwprintw(w, y, 2, "Probing LAN for Servers (EtherType: %04x)",
-            rs->ethertype);
-  ++y;
-  mvwprintw(w, y, 1, RMTDOS_VERSION);
-  mvwprintw(w, y, 50, "<CTRL-Q> to exit");
-  ++y;
-  mvwprintw(w, y, 1, "%s: %s", rs->if_name,
-            fmt_mac_addr(mac_tmp, sizeof(mac_tmp), rs->if_addr));
-  y += 2;
-
-  wattron(w, COLOR_PAIR(MY_COLOR_HEADER));
-  wattron(w, A_BOLD);
-  mvwprintw(w, y, 1, "Id  Source            Mode    W   H  last_ping");
-  wattroff(w, A_BOLD);
-  wattroff(w, COLOR_PAIR(MY_COLOR_HEADER));
 
-  gettimeofday(&tv_now, NULL);
-  ++y;
-
-  int iter = 0;
-  struct RemoteHost *r;
-  while (NULL != (r = hostlist_iter(&iter))) {
-    if (timerisset(&(r->tv_last_resp))) {
-      struct timeval tv_stale;
-      timersub(&tv_now, &(r->tv_last_resp), &tv_stale);
-
-      char stale[32];
-      snprintf(stale, sizeof(stale), "%ld.%06ld", tv_stale.tv_sec,
-               tv_stale.tv_usec);
-
-      mvwprintw(w, y, 1, "%2d  %s   %2d  %3d %3d  %s", r->index,
-                fmt_mac_addr(mac_tmp, sizeof(mac_tmp), r->if_addr),
-                r->status.video_mode, r->status.text_cols, r->status.text_rows,
-                stale);
-      ++y;
-    }
-  }
-}
+static struct Timer g_probe_timer;
+static struct Timer g_hud_timer;
+static struct Timer g_export_timer;
 
 void debug_show_incoming_packet(const uint8_t *buf, size_t received) {
   const struct ether_header *eh = (const struct ether_header *)buf;
@@ -150,138 +119,236 @@ void debug_show_incoming_packet(const uint8_t *buf, size_t received) {
   }
 }
 
-void process_incoming_video_text(const uint8_t *buf, size_t received) {
-  const struct ether_header *eh = (const struct ether_header *)buf;
-  const struct ProtocolHeader *ph = (const struct ProtocolHeader *)(eh + 1);
-  const struct VideoText *video = (const struct VideoText *)(ph + 1);
-  const uint8_t *data = (const uint8_t *)(video + 1);
-
-  struct RemoteHost *rh = hostlist_find_by_mac(eh->ether_shost);
-  if (!rh) {
-    return;
+// Row 3 of the debug window: metrics of the host under control (if any), and
+// of the terminal.
+static void debug_show_metrics() {
+  const struct RemoteHost *rh = g_active_host;
+  WINDOW *w = g_debug_window;
+  char line[128];
+  int len = 0;
+
+  if (rh) {
+    const struct HostMetrics *m = &rh->metrics;
+    len = snprintf(line, sizeof(line),
+                   "rx %lu/%luK filt %lu keys %lu dec %.1fus rend %.1fus ",
+                   (unsigned long)metrics_read(&m->frames_rx),
+                   (unsigned long)(metrics_read(&m->bytes_rx) / 1024),
+                   (unsigned long)metrics_read(&m->frames_filtered),
+                   (unsigned long)m->keystrokes_sent,
+                   histogram_mean_us(&m->decode),
+                   histogram_mean_us(&m->render));
+  } else {
+    len = snprintf(line, sizeof(line), "unmatched %lu ",
+                   (unsigned long)metrics_read(&g_metrics.frames_unmatched));
   }
 
-  gettimeofday(&(rh->tv_last_resp), NULL);
+  snprintf(line + len, sizeof(line) - len, "term %luK refr %.1fus",
+           (unsigned long)(g_metrics.terminal_bytes / 1024),
+           histogram_mean_us(&g_metrics.refresh));
+  mvwprintw(w, 3, 1, "%-*.*s", getmaxx(w) - 2, getmaxx(w) - 2, line);
+}
 
-  const uint16_t offset = ntohs(video->offset);
-  const uint16_t count = ntohs(video->count);
-  if (count + offset > sizeof(rh->video_text_buffer)) {
-    return;
+// Records `rh`, and redraws whichever views show it.
+static void redraw_host(struct RemoteHost *rh, uint16_t offset,
+                        uint16_t count) {
+  if (recorder_enabled()) {
+    recorder_update(rh);
+  }
+
+  const uint64_t start_ns = metrics_now_ns();
+  if (rh->window) {
+    update_session_window(rh, offset, count);
+  }
+  if (rh->tile) {
+    wall_update_tile(rh, offset, count);
   }
+  if (rh->window || rh->tile) {
+    const uint64_t end_ns = metrics_now_ns();
+    const struct FlightEvent fe = {
+        .ns = end_ns,
+        .type = FLIGHT_RENDER,
+        .host = rh->index,
+        .offset = offset,
+        .count = count,
+        .duration_ns = end_ns - start_ns,
+    };
+    histogram_add(&rh->metrics.render, end_ns - start_ns);
+    flightrec_add(&g_flight_ui, &fe);
+  }
+}
+
+// Called when the network thread has published events.  Applies host status
+// updates, and redraws the parts of the screen that changed.  Multiple updates
+// to the same host are merged, so a backlog costs one redraw, not many.
+void process_rx_events(struct RxThread *rx) {
+  struct DirtyRange {
+    struct RemoteHost *host;
+    uint32_t lo;
+    uint32_t hi;
+  } dirty[MAX_DIRTY];
+  int dirty_count = 0;
+  struct RxEvent ev;
+
+  rx_thread_ack(rx);
+
+  while (eventq_pop(&rx->queue, &ev)) {
+    struct RemoteHost *rh = ev.host;
+
+    switch (ev.type) {
+      case RX_EVENT_STATUS:
+        rh->status = ev.status;
+        break;
+
+      case RX_EVENT_STATS:
+        rh->stats = ev.stats;
+        rh->stats_us = time_now_us();
+        break;
+
+      case RX_EVENT_PACKET:
+        if (g_show_debug_window) {
+          debug_show_incoming_packet(ev.packet.data, ev.packet.length);
+        }
+        break;
 
-  memcpy(rh->video_text_buffer + offset, data, count);
+      case RX_EVENT_VIDEO: {
+        if (!rh->window && !rh->tile && !recorder_enabled()) {
+          break;
+        }
+
+        const uint32_t lo = ev.video.offset;
+        const uint32_t hi = lo + ev.video.count;
+        int i;
+        for (i = 0; (i < dirty_count) && (dirty[i].host != rh); ++i) {
+        }
 
-  rh->text_rows = video->text_rows;
-  rh->text_cols = video->text_cols;
+        if (i == dirty_count) {
+          if (dirty_count == MAX_DIRTY) {
+            redraw_host(rh, lo, hi - lo);
+            break;
+          }
+          dirty[dirty_count++] = (struct DirtyRange){rh, lo, hi};
+        } else {
+          dirty[i].lo = MIN(dirty[i].lo, lo);
+          dirty[i].hi = MAX(dirty[i].hi, hi);
+        }
+      } break;
+    }
+  }
 
-  // we already have a place to store the cursor position
-  rh->status.cursor_row = video->cursor_row;
-  rh->status.cursor_col = video->cursor_col;
+  for (int i = 0; i < dirty_count; ++i) {
+    redraw_host(dirty[i].host, dirty[i].lo, dirty[i].hi - dirty[i].lo);
+  }
 
-  update_session_window(rh, offset, count);
+  // The network thread outran us and dropped events.  Redraw everything.
+  if (eventq_take_overflow(&rx->queue)) {
+    const struct FlightEvent fe = {.type = FLIGHT_OVERFLOW};
+    flightrec_add(&g_flight_ui, &fe);
+    if (g_active_host && g_active_host->window) {
+      redraw_host(g_active_host, 0, SCREEN_BUFFER_SIZE);
+    }
+    if (wall_is_active()) {
+      wall_redraw_all();
+    }
+  }
 }
 
-void process_socket_io(struct RawSocket *rs) {
-  uint8_t buf[ETH_FRAME_LEN];
-  const struct ether_header *eh = (const struct ether_header *)buf;
-  const struct ProtocolHeader *ph = (const struct ProtocolHeader *)(eh + 1);
-  ssize_t received;
+// Called when there is data on STDIN and the UI is in the "menu mode" (waiting
+// for user to select a server to connect to).
+void process_stdin_menu_mode() {
+  int c = getch();
 
-  if (0 >= (received = recvfrom(rs->sock_fd, buf, BUF_SIZE, 0, NULL, NULL))) {
+  if (c == EXIT_WCH_CODE || c == KEY_F(12) || c == 27) {
+    g_running = 0;
     return;
   }
 
-  // Only accept packets sent directly to our host.
-  // We send broadcasts to servers to find them, but a server already knows
-  // our MAC address.  This way, we can safely run multiple servers on the
-  // same broadcast domain.
-  if (memcmp(eh->ether_dhost, rs->if_addr, ETH_ALEN)) {
+  if (c == DUMP_WCH_CODE) {
+    flightrec_dump();
     return;
   }
 
-  // Skip packets without our signature.
-  if (PACKET_SIGNATURE != ntohl(ph->signature)) {
+  if (c == 'w') {
+    wall_open();
     return;
   }
 
-  // Only accept packets sent to OUR session_id
-  // Allows me to test w/ multiple clients on the same host.
-  if (rs->session_id != ntohl(ph->session_id)) {
+  struct RemoteHost *rh = menu_process_key(c);
+  if (rh) {
+    session_activate(rh);
+  }
+}
+
+// Called when there is data on STDIN and the wall view is shown.
+void process_stdin_wall_mode() {
+  int c = getch();
+
+  if (c == EXIT_WCH_CODE || c == KEY_F(12)) {
+    g_running = 0;
     return;
   }
 
-  if (g_show_debug_window) {
-    debug_show_incoming_packet(buf, received);
+  if (c == DUMP_WCH_CODE) {
+    flightrec_dump();
+    return;
   }
 
-  switch (ntohs(ph->pkt_type)) {
-    case V1_STATUS_RESP:
-      hostlist_register(buf, received);
-      break;
-    case V1_VGA_TEXT:
-      process_incoming_video_text(buf, received);
-      break;
+  // Back to the menu.
+  if (c == 27 || c == 'q') {
+    wall_close();
+    return;
+  }
+
+  struct RemoteHost *rh = wall_process_key(c);
+  if (rh) {
+    session_activate(rh);
   }
 }
 
-void start_remote_control(struct RemoteHost *rh) {
-  g_active_host = rh;
-  rh->window = g_session_window;
+// Broadcast probe on every interface, looking for servers.  (Observers never
+// transmit.)
+static void probe_fire(struct Timer *timer) {
+  for (size_t i = 0; i < g_socket_count; ++i) {
+    send_status_req(&g_sockets[i], NULL);
+  }
+  timer_schedule(timer, PROBE_INTERVAL_MS);
+}
 
-  mvwprintw(rh->window, 0, 0, "Connecting...");
+static void close_sockets() {
+  for (size_t i = 0; i < g_socket_count; ++i) {
+    close_socket(&g_sockets[i]);
+  }
+  g_socket_count = 0;
 }
 
-// Called when there is data on STDIN and the UI is in the "menu mode" (waiting
-// for user to select a server to connect to).
-void process_stdin_menu_mode() {
-  int c = getch();
+static void hud_fire(struct Timer *timer) {
+  if (g_active_host && g_active_host->window) {
+    update_hud(g_active_host);
+  }
 
-  if (c == EXIT_WCH_CODE || c == KEY_F(12) || c == 27) {
-    g_running = 0;
-    return;
+  if (wall_is_active()) {
+    wall_update_titles();
   }
 
-  if ((c >= '0') && (c <= '9')) {
-    struct RemoteHost *rh = hostlist_find_by_index(c - '0');
-    if (rh) {
-      start_remote_control(rh);
-    }
+  if (g_show_debug_window) {
+    debug_show_metrics();
   }
-}
 
-void process_timers(struct RawSocket *rs) {
-  struct timeval now;
-  struct timeval diff;
-  gettimeofday(&now, NULL);
-
-  // Time to send another broadcast probe?
-  timersub(&now, &g_last_probe, &diff);
-  if (timercmp(&diff, &broadcast_probe_interval, >)) {
-    send_status_req(rs, NULL);
-    g_last_probe = now;
-  }
-
-  // Refresh session intention with each server under control.
-  int iter = 0;
-  struct RemoteHost *rh;
-  while (NULL != (rh = hostlist_iter(&iter))) {
-    if (rh->window) {
-      timersub(&now, &(rh->tv_last_session_start), &diff);
-      if (timercmp(&diff, &session_start_interval, >)) {
-        send_session_start(rs, rh->if_addr);
-        rh->tv_last_session_start = now;
-      }
+  timer_schedule(timer, HUD_INTERVAL_MS);
+}
 
-      update_hud(rh);
-    }
-  }
+static void export_fire(struct Timer *timer) {
+  metrics_export_write();
+  timer_schedule(timer, METRICS_EXPORT_INTERVAL_MS);
 }
 
 void refresh_windows() {
+  PROBE0(refresh_start);
   refresh();
 
   if (g_active_host && g_active_host->window) {
     wrefresh(g_active_host->window);
+  } else if (wall_is_active()) {
+    wrefresh(g_wall_window);
   } else {
     wrefresh(g_probe_window);
   }
@@ -289,24 +356,116 @@ void refresh_windows() {
   if (g_show_debug_window) {
     wrefresh(g_debug_window);
   }
+  PROBE0(refresh_done);
+}
+
+// `refresh_windows()`, counting the time taken and the bytes written.
+static void refresh_windows_measured() {
+  const uint64_t start_bytes = metrics_thread_bytes_written();
+  const uint64_t start_ns = metrics_now_ns();
+
+  refresh_windows();
+
+  const uint64_t end_ns = metrics_now_ns();
+  const uint64_t bytes = metrics_thread_bytes_written() - start_bytes;
+  const struct FlightEvent fe = {
+      .ns = end_ns,
+      .type = FLIGHT_REFRESH,
+      .length = MIN(bytes, UINT16_MAX),
+      .duration_ns = end_ns - start_ns,
+  };
+
+  histogram_add(&g_metrics.refresh, end_ns - start_ns);
+  g_metrics.terminal_bytes += bytes;
+  flightrec_add(&g_flight_ui, &fe);
 }
 
 static const char *DEFAULT_ETH_DEV = "eth0";
 
 static void print_usage(const char *progname) {
-  printf("usage: %s [-d dest-addr] [-e type] [-i eth_dev] [-k]\n", progname);
+  printf("usage: %s [-b count] [-D] [-d dest-addr] [-e type] [-F file] "
+         "[-i eth_dev]\n"
+         "       [-k] [-M file|unix:path] [-n max_hosts] "
+         "[-o server-addr[/session-id]]\n"
+         "       [-r dir] [-U] [-W threads]\n"
+         "       -d dest-addr -E rate[/count]\n"
+         "       [-d dest-addr] -S\n"
+         "       [-F file] -P path [-Q path] [host-addr ...]\n"
+         "       [-F file] -X script [host-addr ...]\n",
+         progname);
+  printf("  -b  Background sessions kept to recently used hosts (default: "
+         "%d).\n",
+         SESSION_DEFAULT_BACKGROUND);
+  printf("  -D  Show the debug window: last packet received, and metrics.\n");
   printf("  -d  Destination MAC address (xx:xx:xx:xx:xx:xx).\n");
+  printf("  -F  Flight recorder dump file (default: rmtdos-flight-PID.txt), "
+         "written\n"
+         "      on F10 in the menu or wall view, SIGUSR1 or a crash.\n");
   printf("  -e  Ethertype as 4 hexadecimal digits (default: %04x).\n",
          ETHERTYPE_RMTDOS);
-  printf("  -i  Name of local ethernet device (default: %s).\n",
-         DEFAULT_ETH_DEV);
+  printf("  -E  Benchmark keystroke to echo latency of dest-addr, which must "
+         "run\n"
+         "      \"vga_demo -p\": inject `rate` keys per second, `count` in "
+         "all\n"
+         "      (default: %d), and print latency percentiles.  No UI.\n",
+         ECHO_BENCH_DEFAULT_KEYS);
+  printf("  -i  Name of local ethernet device (default: %s).  Repeat to "
+         "listen on\n"
+         "      several (up to %d); -E uses the first.\n",
+         DEFAULT_ETH_DEV, MAX_INTERFACES);
   printf("  -k  Dump keyboard layout to text file for debugging.\n");
+  printf("  -M  Export metrics in the Prometheus text format, to `file` "
+         "every %d\n"
+         "      seconds, or to each connection on the Unix socket `path`.\n",
+         METRICS_EXPORT_INTERVAL_MS / 1000);
+  printf("  -n  Maximum number of servers to track (default: %d).\n",
+         HOSTLIST_DEFAULT_MAX_HOSTS);
+  printf("  -o  Observe server-addr[/session-id] passively (read only).  "
+         "Sniffs\n"
+         "      frames sent to another viewer; session-id is hex, default is\n"
+         "      whichever session is seen first.\n");
+  printf("  -P  Headless: keep sessions to the host-addrs (default: every "
+         "server\n"
+         "      that answers), and publish their screens in the screen store "
+         "`path`\n"
+         "      (e.g. /dev/shm/rmtdos).  No UI.\n");
+  printf("  -Q  With -P: answer screen queries, waits for text and "
+         "keystrokes on the\n"
+         "      Unix socket `path` (see src/client/query.h).\n");
+  printf("  -r  Record every session into a file in `dir`.\n");
+  printf("  -S  Print the runtime counters of dest-addr (default: every "
+         "server\n"
+         "      that answers a broadcast).  No UI.\n");
+  printf("  -U  Receive with io_uring (Linux 6.0+; falls back to poll()).\n");
+  printf("  -W  Network threads, sharing the hosts by MAC address (default: "
+         "1,\n"
+         "      max %d).  For hundreds of busy hosts.\n",
+         MAX_RX_WORKERS);
+  printf("  -X  Run the expect-style `script` (see src/client/fleet.h) on "
+         "the\n"
+         "      host-addrs at once (default: every server that answers), and "
+         "print\n"
+         "      each host's result and timings.  No UI.\n");
 }
 
 int main(int argc, char **argv) {
-  const char *if_name = DEFAULT_ETH_DEV;
+  const char *if_names[MAX_INTERFACES];
+  size_t if_count = 0;
   uint16_t ethertype = ETHERTYPE_RMTDOS;
   uint8_t dest_addr[ETH_ALEN] = {0};
+  size_t max_hosts = HOSTLIST_DEFAULT_MAX_HOSTS;
+  double echo_bench_rate = 0;
+  unsigned echo_bench_keys = ECHO_BENCH_DEFAULT_KEYS;
+  int stats_query = 0;
+  const char *store_path = NULL;
+  const char *query_path = NULL;
+  const char *fleet_script = NULL;
+  int query_fd = -1;
+  uint8_t *host_addrs = NULL;
+  size_t host_addr_count = 0;
+  const char *metrics_target = NULL;
+  const char *flightrec_file = NULL;
+  int metrics_fd = 0;
   int i;
   int opt;
 
@@ -315,35 +474,114 @@ int main(int argc, char **argv) {
   cp437_table_init();
 
   memcpy(dest_addr, broadcast_addr, ETH_ALEN);
-  hostlist_create();
 
-  while ((opt = getopt(argc, argv, "d:e:i:kl")) != -1) {
+  while ((opt = getopt(argc, argv, "b:Dd:e:E:F:i:klM:n:o:P:Q:r:SUW:X:")) != -1) {
     switch (opt) {
-      case 'i':
-        if_name = optarg;
+      case 'b':
+        session_set_background_limit(atoi(optarg));
         break;
 
-      case 'd': {
-        int mac[ETH_ALEN];
+      case 'D':
+        g_show_debug_window = 1;
+        break;
 
-        if (ETH_ALEN != sscanf(optarg, "%02x:%02x:%02x:%02x:%02x:%02x", &mac[0],
-                               &mac[1], &mac[2], &mac[3], &mac[4], &mac[5])) {
-          print_usage(argv[0]);
+      case 'i':
+        if (if_count == MAX_INTERFACES) {
+          fprintf(stderr, "At most %d interfaces (-i).\n", MAX_INTERFACES);
           return EXIT_FAILURE;
         }
-        for (i = 0; i < ETH_ALEN; i++) {
-          dest_addr[i] = mac[i];
+        if_names[if_count++] = optarg;
+        break;
+
+      case 'd':
+        if (!parse_mac_addr(optarg, dest_addr)) {
+          print_usage(argv[0]);
+          return EXIT_FAILURE;
         }
-      } break;
+        break;
 
       case 'e':
         ethertype = strtoul(optarg, NULL, 16);
         break;
 
+      case 'F':
+        flightrec_file = optarg;
+        break;
+
+      case 'E':
+        if ((1 > sscanf(optarg, "%lf/%u", &echo_bench_rate,
+                        &echo_bench_keys)) ||
+            (echo_bench_rate <= 0) || !echo_bench_keys) {
+          print_usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+
       case 'k':
         dump_keyboard_table(stdout);
         return EXIT_SUCCESS;
 
+      case 'o': {
+        struct Observer *ob = &g_rx_thread.observer;
+        int mac[ETH_ALEN];
+        int n = sscanf(optarg, "%02x:%02x:%02x:%02x:%02x:%02x/%x", &mac[0],
+                       &mac[1], &mac[2], &mac[3], &mac[4], &mac[5],
+                       &ob->session_id);
+        if (n < ETH_ALEN) {
+          print_usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        for (i = 0; i < ETH_ALEN; i++) {
+          ob->server_addr[i] = mac[i];
+        }
+        ob->pinned = (n > ETH_ALEN);
+        ob->enabled = 1;
+        g_observer_mode = 1;
+      } break;
+
+      case 'M':
+        metrics_target = optarg;
+        break;
+
+      case 'P':
+        store_path = optarg;
+        break;
+
+      case 'Q':
+        query_path = optarg;
+        break;
+
+      case 'r':
+        recorder_set_dir(optarg);
+        break;
+
+      case 'S':
+        stats_query = 1;
+        break;
+
+      case 'U':
+        g_rx_thread.use_uring = 1;
+        break;
+
+      case 'W':
+        g_rx_worker_count = strtoul(optarg, NULL, 10);
+        if (!g_rx_worker_count || (g_rx_worker_count > MAX_RX_WORKERS)) {
+          print_usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+
+      case 'X':
+        fleet_script = optarg;
+        break;
+
+      case 'n':
+        if (0 == (max_hosts = strtoul(optarg, NULL, 10))) {
+          print_usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+
       default: /* '?' */
         print_usage(argv[0]);
         return EXIT_FAILURE;
@@ -351,27 +589,160 @@ int main(int argc, char **argv) {
   }
 
   if (optind < argc) {
-    //  msg = argv[optind];
+    if (!store_path && !fleet_script) {
+      fprintf(stderr, "Host addresses are only used with -P or -X.\n");
+      return EXIT_FAILURE;
+    }
+
+    host_addr_count = argc - optind;
+    host_addrs = (uint8_t *)malloc(host_addr_count * ETH_ALEN);
+    for (size_t h = 0; h < host_addr_count; ++h) {
+      if (!parse_mac_addr(argv[optind + h], &host_addrs[h * ETH_ALEN])) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  if (query_path && !store_path) {
+    fprintf(stderr, "-Q needs -P.\n");
+    return EXIT_FAILURE;
   }
 
-  struct RawSocket rs = {0};
-  if (0 > create_socket(&rs, if_name, ethertype)) {
+  if (fleet_script &&
+      (g_observer_mode || echo_bench_rate || stats_query || store_path)) {
+    fprintf(stderr, "-X cannot be used with -o, -E, -S or -P.\n");
     return EXIT_FAILURE;
   }
 
+  if (fleet_script && (0 > fleet_load(fleet_script))) {
+    return EXIT_FAILURE;
+  }
+
+  if (store_path && (g_observer_mode || echo_bench_rate || stats_query)) {
+    fprintf(stderr, "-P cannot be used with -o, -E or -S.\n");
+    return EXIT_FAILURE;
+  }
+
+  if (echo_bench_rate && (g_observer_mode ||
+                          !memcmp(dest_addr, broadcast_addr, ETH_ALEN))) {
+    fprintf(stderr, "-E needs the server's address (-d), and no -o.\n");
+    return EXIT_FAILURE;
+  }
+
+  if (stats_query && (g_observer_mode || echo_bench_rate)) {
+    fprintf(stderr, "-S cannot be used with -o or -E.\n");
+    return EXIT_FAILURE;
+  }
+
+  if ((g_rx_worker_count > 1) && (stats_query || echo_bench_rate)) {
+    fprintf(stderr, "-W cannot be used with -S or -E.\n");
+    return EXIT_FAILURE;
+  }
+
+  if (!if_count) {
+    if_names[if_count++] = DEFAULT_ETH_DEV;
+  }
+
+  hostlist_create(max_hosts);
+
+  if (store_path &&
+      (0 > shmstore_open(store_path,
+                         host_addr_count ? host_addr_count : max_hosts))) {
+    return EXIT_FAILURE;
+  }
+
+  for (; g_socket_count < if_count; ++g_socket_count) {
+    struct RawSocket *rs = &g_sockets[g_socket_count];
+
+    if (0 > create_socket(rs, if_names[g_socket_count], ethertype)) {
+      return EXIT_FAILURE;
+    }
+
+    if (g_observer_mode && (0 > set_promiscuous(rs))) {
+      return EXIT_FAILURE;
+    }
+  }
+
   int epoll_fd;
   if (0 > (epoll_fd = epoll_create1(EPOLL_CLOEXEC))) {
     perror("epoll_create1()");
     return EXIT_FAILURE;
   }
 
-  struct epoll_event ev, events[MAX_EVENTS];
-  ev.events = EPOLLIN;
-  ev.data.fd = rs.sock_fd;
-  if (0 > epoll_ctl(epoll_fd, EPOLL_CTL_ADD, rs.sock_fd, &ev)) {
-    perror("epoll_ctl(socket)");
+  if (0 > rx_thread_start(&g_rx_thread, g_sockets, g_socket_count)) {
     return EXIT_FAILURE;
   }
+  g_rx_thread.dump_packets = g_show_debug_window;
+
+  if (echo_bench_rate) {
+    const int r = echo_bench_run(&g_sockets[0], &g_rx_thread, dest_addr,
+                                 echo_bench_rate, echo_bench_keys);
+    rx_thread_stop(&g_rx_thread);
+    close(epoll_fd);
+    close_sockets();
+    hostlist_destroy();
+    return (0 > r) ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  if (stats_query) {
+    const int answers =
+        stats_query_run(&g_rx_thread, dest_addr, STATS_QUERY_WAIT_MS);
+    rx_thread_stop(&g_rx_thread);
+    close(epoll_fd);
+    close_sockets();
+    hostlist_destroy();
+    return answers ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if ((g_rx_worker_count > 1) &&
+      (0 > rx_workers_start(g_rx_workers, g_rx_worker_count))) {
+    return EXIT_FAILURE;
+  }
+
+  if (fleet_script) {
+    flightrec_init(flightrec_file);
+    const int failed =
+        fleet_run(g_rx_workers, g_rx_worker_count, g_sockets, g_socket_count,
+                  host_addrs, host_addr_count, max_hosts);
+    rx_workers_stop(g_rx_workers, g_rx_worker_count);
+    rx_thread_stop(&g_rx_thread);
+    close(epoll_fd);
+    close_sockets();
+    hostlist_destroy();
+    free(host_addrs);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  if (store_path) {
+    if (query_path && (0 > (query_fd = query_open(query_path)))) {
+      return EXIT_FAILURE;
+    }
+
+    flightrec_init(flightrec_file);
+    const int r =
+        daemon_run(g_rx_workers, g_rx_worker_count, g_sockets, g_socket_count,
+                   host_addrs, host_addr_count, query_fd);
+    query_close();
+    rx_workers_stop(g_rx_workers, g_rx_worker_count);
+    rx_thread_stop(&g_rx_thread);
+    close(epoll_fd);
+    close_sockets();
+    shmstore_close();
+    hostlist_destroy();
+    free(host_addrs);
+    return (0 > r) ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  struct epoll_event ev, events[MAX_EVENTS];
+  for (size_t w = 0; w < g_rx_worker_count; ++w) {
+    ev.events = EPOLLIN;
+    ev.data.fd = g_rx_workers[w]->notify_fd;
+    if (0 > epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ev.data.fd, &ev)) {
+      perror("epoll_ctl(rx_thread)");
+      return EXIT_FAILURE;
+    }
+  }
 
   struct epoll_event ev_stdin;
   ev_stdin.events = EPOLLIN;
@@ -381,19 +752,67 @@ int main(int argc, char **argv) {
     return EXIT_FAILURE;
   }
 
+  int timer_fd;
+  if (0 > (timer_fd = timers_init())) {
+    return EXIT_FAILURE;
+  }
+
+  struct epoll_event ev_timer;
+  ev_timer.events = EPOLLIN;
+  ev_timer.data.fd = timer_fd;
+  if (0 > epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev_timer)) {
+    perror("epoll_ctl(timerfd)");
+    return EXIT_FAILURE;
+  }
+
+  if (metrics_target &&
+      (0 > (metrics_fd = metrics_export_open(metrics_target)))) {
+    return EXIT_FAILURE;
+  }
+
+  if (metrics_fd > 0) {
+    struct epoll_event ev_metrics;
+    ev_metrics.events = EPOLLIN;
+    ev_metrics.data.fd = metrics_fd;
+    if (0 > epoll_ctl(epoll_fd, EPOLL_CTL_ADD, metrics_fd, &ev_metrics)) {
+      perror("epoll_ctl(metrics)");
+      return EXIT_FAILURE;
+    }
+  }
+
+  flightrec_init(flightrec_file);
   init_ncurses();
 
-  // Ping broadcast address, to trigger a response from all clients.
-  send_status_req(&rs, NULL);
+  timer_init(&g_hud_timer, hud_fire, NULL);
+  timer_schedule(&g_hud_timer, HUD_INTERVAL_MS);
+
+  if (metrics_target && !metrics_fd) {
+    timer_init(&g_export_timer, export_fire, NULL);
+    timer_schedule(&g_export_timer, 0);
+  }
+
+  if (g_observer_mode) {
+    // Watch the one server; there is no menu.
+    session_activate(hostlist_add(g_rx_thread.observer.server_addr));
+  } else {
+    // Ping broadcast address now, to trigger a response from all servers.
+    timer_init(&g_probe_timer, probe_fire, NULL);
+    timer_schedule(&g_probe_timer, 0);
+  }
 
   while (g_running) {
-    int nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, epoll_timeout_ms);
+    if (flightrec_take_request()) {
+      flightrec_dump();
+    }
+
+    int nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
     if (nfds < 0) {
       if (errno == EINTR) {
         continue;
       }
 
       perror("epoll_wait()");
+      flightrec_dump();
 
       // Exit cleanly, so that ncurses can restore the terminal.
       g_running = false;
@@ -403,27 +822,45 @@ int main(int argc, char **argv) {
     for (int n = 0; n < nfds; ++n) {
       if (events[n].data.fd == STDIN_FILENO) {
         if (g_active_host) {
-          process_stdin_session_mode(&rs);
+          process_stdin_session_mode();
+        } else if (wall_is_active()) {
+          process_stdin_wall_mode();
         } else {
           process_stdin_menu_mode();
         }
       }
 
-      if (events[n].data.fd == rs.sock_fd) {
-        process_socket_io(&rs);
+      for (size_t w = 0; w < g_rx_worker_count; ++w) {
+        if (events[n].data.fd == g_rx_workers[w]->notify_fd) {
+          process_rx_events(g_rx_workers[w]);
+        }
+      }
+
+      if (metrics_fd && (events[n].data.fd == metrics_fd)) {
+        metrics_export_run();
+      }
+
+      if (events[n].data.fd == timer_fd) {
+        timers_run();
       }
     }
 
-    process_timers(&rs);
-    update_probing_window(&rs);
-    refresh_windows();
+    if (!g_active_host && !wall_is_active()) {
+      update_probing_window(g_sockets, g_socket_count);
+    }
+    refresh_windows_measured();
   }
 
   shutdown_ncurses();
 
+  rx_workers_stop(g_rx_workers, g_rx_worker_count);
+  rx_thread_stop(&g_rx_thread);
+  timers_close();
   close(epoll_fd);
-  close_socket(&rs);
+  close_sockets();
 
+  recorder_close_all();
+  metrics_export_close();
   hostlist_destroy();
 
   return 0;
@@ -0,0 +1,293 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <ncurses.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "client/curses.h"
+#include "client/menu.h"
+#include "client/util.h"
+
+#define MIN(x, y) ((x) > (y) ? (y) : (x))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+// Window rows used above and below the host list.
+#define MENU_HEADER_ROWS 7
+#define MENU_FOOTER_ROWS 1
+
+// Longest id the user can type.
+#define MENU_TYPED_ID_LEN 7
+
+struct MenuRow {
+  struct RemoteHost *rh;
+  uint64_t last_resp_us; // Snapshot, so sorting by age is stable.
+};
+
+static const char *sort_names[MENU_SORT_COUNT] = {
+    [MENU_SORT_ID] = "id",
+    [MENU_SORT_MAC] = "mac",
+    [MENU_SORT_MODE] = "mode",
+    [MENU_SORT_AGE] = "last_ping",
+};
+
+static enum MenuSort g_sort = MENU_SORT_ID;
+static int g_sort_reverse = 0;
+
+// Rows from the last redraw, in display order.
+static struct MenuRow *g_rows = NULL;
+static size_t g_row_count = 0;
+static size_t g_row_alloc = 0;
+
+// Highlighted host.  Tracked by pointer (hosts are never freed while running)
+// so the highlight stays put when the list is re-sorted.
+static struct RemoteHost *g_selected = NULL;
+
+// First row shown, and count of rows that fit in the window.
+static size_t g_top = 0;
+static size_t g_page_rows = 1;
+
+// Digits typed so far, for selecting a host by id.
+static char g_typed_id[MENU_TYPED_ID_LEN + 1] = "";
+
+static int compare_rows(const void *a, const void *b) {
+  const struct MenuRow *x = (const struct MenuRow *)a;
+  const struct MenuRow *y = (const struct MenuRow *)b;
+  int r = 0;
+
+  switch (g_sort) {
+    case MENU_SORT_MAC:
+      r = memcmp(x->rh->if_addr, y->rh->if_addr, ETH_ALEN);
+      break;
+    case MENU_SORT_MODE:
+      r = (int)x->rh->status.video_mode - (int)y->rh->status.video_mode;
+      break;
+    case MENU_SORT_AGE:
+      // Most recently heard from first.
+      r = (x->last_resp_us < y->last_resp_us) -
+          (x->last_resp_us > y->last_resp_us);
+      break;
+    default:
+      break;
+  }
+
+  // Ties (and MENU_SORT_ID) are broken by id, so the order is total.
+  if (!r) {
+    r = x->rh->index - y->rh->index;
+  }
+
+  return g_sort_reverse ? -r : r;
+}
+
+static void collect_rows() {
+  const size_t count = hostlist_count();
+
+  if (count > g_row_alloc) {
+    g_row_alloc = MAX(count, 2 * g_row_alloc);
+    g_rows = (struct MenuRow *)realloc(g_rows, g_row_alloc * sizeof(*g_rows));
+  }
+
+  g_row_count = 0;
+  int iter = 0;
+  struct RemoteHost *rh;
+  while ((NULL != (rh = hostlist_iter(&iter))) && (g_row_count < count)) {
+    const uint64_t last_resp_us = host_last_resp_us(rh);
+    if (last_resp_us) {
+      g_rows[g_row_count].rh = rh;
+      g_rows[g_row_count].last_resp_us = last_resp_us;
+      ++g_row_count;
+    }
+  }
+
+  qsort(g_rows, g_row_count, sizeof(*g_rows), compare_rows);
+}
+
+static size_t selected_row() {
+  for (size_t i = 0; i < g_row_count; ++i) {
+    if (g_rows[i].rh == g_selected) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+static void select_row(size_t row) {
+  if (g_row_count) {
+    g_selected = g_rows[MIN(row, g_row_count - 1)].rh;
+  }
+}
+
+void update_probing_window(const struct RawSocket *sockets,
+                           size_t socket_count) {
+  char mac_tmp[MAC_ADDR_FMT_LEN];
+  WINDOW *w = g_probe_window;
+  int y = 0;
+
+  collect_rows();
+
+  wmove(w, y, 0);
+  wclrtobot(w);
+
+  box(w, 0, 0);
+  mvwprintw(w, y, 2, "Probing LAN for Servers (EtherType: %04x)",
+            sockets->ethertype);
+  ++y;
+  mvwprintw(w, y, 1, RMTDOS_VERSION);
+  mvwprintw(w, y, 50, "<CTRL-Q> to exit");
+  ++y;
+  wmove(w, y, 1);
+  for (size_t i = 0; i < socket_count; ++i) {
+    wprintw(w, "%s%s: %s", i ? "  " : "", sockets[i].if_name,
+            fmt_mac_addr(mac_tmp, sizeof(mac_tmp), sockets[i].if_addr));
+  }
+  ++y;
+  mvwprintw(w, y, 1, "<s> sort: %-9s <r> reverse  <Enter> connect  id: %s_",
+            sort_names[g_sort], g_typed_id);
+  ++y;
+  mvwprintw(w, y, 1, "<Space> mark  <w> wall of marked (or first) hosts");
+  y += 2;
+
+  wattron(w, COLOR_PAIR(MY_COLOR_HEADER));
+  wattron(w, A_BOLD);
+  mvwprintw(w, y, 1,
+            "    Id  Source            Mode    W   H  Iface     last_ping");
+  wattroff(w, A_BOLD);
+  wattroff(w, COLOR_PAIR(MY_COLOR_HEADER));
+  ++y;
+
+  // Scroll so that the highlighted row is visible.
+  const int height = getmaxy(w);
+  const size_t sel = selected_row();
+  g_page_rows = MAX(1, height - MENU_HEADER_ROWS - MENU_FOOTER_ROWS);
+  select_row(sel);
+  if (sel < g_top) {
+    g_top = sel;
+  } else if (sel >= g_top + g_page_rows) {
+    g_top = sel - g_page_rows + 1;
+  }
+  g_top = MIN(g_top, g_row_count > g_page_rows ? g_row_count - g_page_rows : 0);
+
+  for (size_t i = g_top; (i < g_row_count) && (i < g_top + g_page_rows);
+       ++i) {
+    const struct RemoteHost *r = g_rows[i].rh;
+    char stale[32];
+    fmt_elapsed(stale, sizeof(stale), g_rows[i].last_resp_us);
+
+    // '*' marked for the wall, '+' background session.
+    const char flag = r->marked ? '*' : (r->background ? '+' : ' ');
+
+    if (r == g_selected) {
+      wattron(w, A_REVERSE);
+    }
+    const struct RawSocket *rs = host_socket(r);
+    mvwprintw(w, y, 1, "%c%5d  %s   %2d  %3d %3d  %-8.8s  %s", flag, r->index,
+              fmt_mac_addr(mac_tmp, sizeof(mac_tmp), r->if_addr),
+              r->status.video_mode, r->status.text_cols, r->status.text_rows,
+              rs ? rs->if_name : "-", stale);
+    if (r == g_selected) {
+      wattroff(w, A_REVERSE);
+    }
+    ++y;
+  }
+
+  if (g_row_count) {
+    mvwprintw(w, height - 1, 2, " %zu-%zu of %zu ", g_top + 1,
+              MIN(g_row_count, g_top + g_page_rows), g_row_count);
+  }
+}
+
+struct RemoteHost *menu_selected_host() {
+  return g_row_count ? g_rows[selected_row()].rh : NULL;
+}
+
+int menu_wall_hosts(struct RemoteHost **hosts, int max) {
+  int count = 0;
+
+  for (size_t i = 0; (i < g_row_count) && (count < max); ++i) {
+    if (g_rows[i].rh->marked) {
+      hosts[count++] = g_rows[i].rh;
+    }
+  }
+
+  for (size_t i = 0; !count && (i < g_row_count) && (i < (size_t)max); ++i) {
+    hosts[i] = g_rows[i].rh;
+  }
+
+  return count ? count : (int)MIN(g_row_count, (size_t)max);
+}
+
+struct RemoteHost *menu_process_key(int c) {
+  const size_t sel = selected_row();
+  const size_t len = strlen(g_typed_id);
+
+  switch (c) {
+    case KEY_UP:
+      select_row(sel ? sel - 1 : 0);
+      break;
+    case KEY_DOWN:
+      select_row(sel + 1);
+      break;
+    case KEY_PPAGE:
+      select_row(sel > g_page_rows ? sel - g_page_rows : 0);
+      break;
+    case KEY_NPAGE:
+      select_row(sel + g_page_rows);
+      break;
+    case KEY_HOME:
+      select_row(0);
+      break;
+    case KEY_END:
+      select_row(g_row_count);
+      break;
+
+    case 's':
+      g_sort = (g_sort + 1) % MENU_SORT_COUNT;
+      break;
+    case 'r':
+      g_sort_reverse = !g_sort_reverse;
+      break;
+
+    case ' ':
+      if (g_row_count) {
+        g_rows[sel].rh->marked = !g_rows[sel].rh->marked;
+        select_row(sel + 1);
+      }
+      break;
+
+    case KEY_BACKSPACE:
+    case 127:
+    case '\b':
+      if (len) {
+        g_typed_id[len - 1] = 0;
+      }
+      break;
+
+    case KEY_ENTER:
+    case '\n':
+    case '\r':
+      if (len) {
+        struct RemoteHost *rh = hostlist_find_by_index(atoi(g_typed_id));
+        g_typed_id[0] = 0;
+        return rh;
+      }
+      return menu_selected_host();
+
+    default:
+      if ((c >= '0') && (c <= '9') && (len < MENU_TYPED_ID_LEN)) {
+        g_typed_id[len] = c;
+        g_typed_id[len + 1] = 0;
+
+        // Move the highlight to the host being typed, if it exists.
+        struct RemoteHost *rh = hostlist_find_by_index(atoi(g_typed_id));
+        if (rh) {
+          g_selected = rh;
+        }
+      }
+      break;
+  }
+
+  return NULL;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Host selection menu, shown while probing the LAN for servers.
+//
+// The list scrolls, can be sorted by any column, and hosts are chosen either
+// by moving the highlight or by typing their id and pressing <Enter>.
+
+#ifndef __RMTDOS_CLIENT_MENU_H
+#define __RMTDOS_CLIENT_MENU_H
+
+#include "client/hostlist.h"
+#include "client/network.h"
+
+enum MenuSort {
+  MENU_SORT_ID = 0,
+  MENU_SORT_MAC = 1,
+  MENU_SORT_MODE = 2,
+  MENU_SORT_AGE = 3,
+  MENU_SORT_COUNT
+};
+
+// Redraws `g_probe_window`.
+extern void update_probing_window(const struct RawSocket *sockets,
+                                  size_t socket_count);
+
+// Handles one key press (from `getch()`).  Returns the host that the user
+// chose, or NULL if the key only changed the menu state.
+extern struct RemoteHost *menu_process_key(int c);
+
+// Host currently highlighted, or NULL.
+extern struct RemoteHost *menu_selected_host();
+
+// Hosts for the wall view, in menu order: the marked hosts, or if none are
+// marked, the first hosts listed.  Returns count stored in `hosts`.
+extern int menu_wall_hosts(struct RemoteHost **hosts, int max);
+
+#endif // __RMTDOS_CLIENT_MENU_H
@@ -0,0 +1,414 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client/hostlist.h"
+#include "client/metrics.h"
+#include "client/util.h"
+
+#define UNIX_PREFIX "unix:"
+
+// A scraper that stops reading is given up on after this long.
+#define EXPORT_SEND_TIMEOUT_SEC 1
+
+// Most scrapers served at once; more are refused.
+#define EXPORT_MAX_SCRAPERS 8
+
+// One connection to the export socket, until it has read the metrics.
+struct Scraper {
+  int fd; // -1 if the slot is free.
+  uint64_t start_ns; // `metrics_now_ns()` when accepted.
+  char *out; // Written at accept time, from `open_memstream()`.
+  size_t out_len;
+  size_t sent;
+};
+
+const uint64_t g_metrics_bucket_ns[METRICS_BUCKETS] = {
+    250,     500,      1000,     2500,     5000,      10000,
+    25000,   50000,    100000,   250000,   500000,    1000000,
+    2500000, 5000000,  10000000, 25000000, 50000000,  100000000,
+};
+
+struct ClientMetrics g_metrics;
+
+// Export target; see `metrics_export_open()`.
+static char *g_export_path = NULL;
+static char *g_export_tmp_path = NULL;
+static int g_export_fd = -1;
+
+// The listener and the scrapers share one epoll set, which the caller waits
+// on as a single fd.
+static int g_export_epoll_fd = -1;
+static struct Scraper g_scrapers[EXPORT_MAX_SCRAPERS];
+
+// /proc/thread-self/io of the UI thread, kept open.
+static int g_io_fd = -1;
+
+uint64_t metrics_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void metrics_add(uint64_t *counter, uint64_t n) {
+  __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+uint64_t metrics_read(const uint64_t *counter) {
+  return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+void histogram_add(struct Histogram *h, uint64_t ns) {
+  int i = 0;
+
+  while ((i < METRICS_BUCKETS) && (ns > g_metrics_bucket_ns[i])) {
+    ++i;
+  }
+
+  metrics_add(&h->counts[i], 1);
+  metrics_add(&h->sum_ns, ns);
+  metrics_add(&h->count, 1);
+}
+
+double histogram_mean_us(const struct Histogram *h) {
+  const uint64_t count = metrics_read(&h->count);
+  return count ? metrics_read(&h->sum_ns) / 1000.0 / count : 0;
+}
+
+uint64_t metrics_thread_bytes_written() {
+  char buf[512];
+  ssize_t len;
+
+  if ((g_io_fd < 0) &&
+      (0 > (g_io_fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC)))) {
+    return 0;
+  }
+
+  if (0 >= (len = pread(g_io_fd, buf, sizeof(buf) - 1, 0))) {
+    return 0;
+  }
+  buf[len] = 0;
+
+  // "wchar": bytes passed to write(2) and friends.
+  const char *p = strstr(buf, "wchar: ");
+  return p ? strtoull(p + 7, NULL, 10) : 0;
+}
+
+static void write_counters(FILE *fp, const char *name, const char *help,
+                           size_t offset) {
+  struct RemoteHost *rh;
+  char tmp[MAC_ADDR_FMT_LEN];
+  int iter = 0;
+
+  fprintf(fp, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+  while (NULL != (rh = hostlist_iter(&iter))) {
+    const uint64_t *counter =
+        (const uint64_t *)((const uint8_t *)&rh->metrics + offset);
+    fprintf(fp, "%s{host=\"%s\"} %lu\n", name,
+            fmt_mac_addr(tmp, sizeof(tmp), rh->if_addr),
+            (unsigned long)metrics_read(counter));
+  }
+}
+
+static void write_histogram(FILE *fp, const char *name, const char *labels,
+                            const struct Histogram *h) {
+  const char *sep = labels[0] ? "," : "";
+  char braced[40] = "";
+  uint64_t cumulative = 0;
+
+  if (labels[0]) {
+    snprintf(braced, sizeof(braced), "{%s}", labels);
+  }
+
+  for (int i = 0; i < METRICS_BUCKETS; ++i) {
+    cumulative += metrics_read(&h->counts[i]);
+    fprintf(fp, "%s_bucket{%s%sle=\"%g\"} %lu\n", name, labels, sep,
+            g_metrics_bucket_ns[i] / 1e9, (unsigned long)cumulative);
+  }
+  cumulative += metrics_read(&h->counts[METRICS_BUCKETS]);
+  fprintf(fp, "%s_bucket{%s%sle=\"+Inf\"} %lu\n", name, labels, sep,
+          (unsigned long)cumulative);
+  fprintf(fp, "%s_sum%s %.9f\n", name, braced,
+          metrics_read(&h->sum_ns) / 1e9);
+  fprintf(fp, "%s_count%s %lu\n", name, braced,
+          (unsigned long)metrics_read(&h->count));
+}
+
+// Only hosts with samples are written, so idle hosts cost one line each.
+static void write_host_histograms(FILE *fp, const char *name,
+                                  const char *help, size_t offset) {
+  struct RemoteHost *rh;
+  char tmp[MAC_ADDR_FMT_LEN];
+  char labels[32];
+  int iter = 0;
+
+  fprintf(fp, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+  while (NULL != (rh = hostlist_iter(&iter))) {
+    const struct Histogram *h =
+        (const struct Histogram *)((const uint8_t *)&rh->metrics + offset);
+    if (!metrics_read(&h->count)) {
+      continue;
+    }
+    snprintf(labels, sizeof(labels), "host=\"%s\"",
+             fmt_mac_addr(tmp, sizeof(tmp), rh->if_addr));
+    write_histogram(fp, name, labels, h);
+  }
+}
+
+void metrics_write_prometheus(FILE *fp) {
+  struct RemoteHost *rh;
+  char tmp[MAC_ADDR_FMT_LEN];
+  int iter = 0;
+
+  write_counters(fp, "rmtdos_client_frames_received_total",
+                 "Frames accepted from the host.",
+                 offsetof(struct HostMetrics, frames_rx));
+  write_counters(fp, "rmtdos_client_bytes_received_total",
+                 "Bytes of the frames accepted from the host.",
+                 offsetof(struct HostMetrics, bytes_rx));
+  write_counters(fp, "rmtdos_client_frames_filtered_total",
+                 "Frames from the host that were thrown away.",
+                 offsetof(struct HostMetrics, frames_filtered));
+  write_counters(fp, "rmtdos_client_keystrokes_sent_total",
+                 "Keystrokes sent to the host.",
+                 offsetof(struct HostMetrics, keystrokes_sent));
+
+  fprintf(fp, "# HELP rmtdos_client_last_video_seconds Time of the last "
+              "video frame from the host.\n"
+              "# TYPE rmtdos_client_last_video_seconds gauge\n");
+  while (NULL != (rh = hostlist_iter(&iter))) {
+    const uint64_t last_video_us = metrics_read(&rh->metrics.last_video_us);
+    if (!last_video_us) {
+      continue;
+    }
+    fprintf(fp, "rmtdos_client_last_video_seconds{host=\"%s\"} %.6f\n",
+            fmt_mac_addr(tmp, sizeof(tmp), rh->if_addr),
+            last_video_us / 1e6);
+  }
+
+  write_host_histograms(fp, "rmtdos_client_decode_seconds",
+                        "Time to store a video frame from the host.",
+                        offsetof(struct HostMetrics, decode));
+  write_host_histograms(fp, "rmtdos_client_render_seconds",
+                        "Time to draw changes of the host's screen.",
+                        offsetof(struct HostMetrics, render));
+
+  fprintf(fp, "# HELP rmtdos_client_frames_unmatched_total Frames from "
+              "senders that are not known hosts.\n"
+              "# TYPE rmtdos_client_frames_unmatched_total counter\n"
+              "rmtdos_client_frames_unmatched_total %lu\n",
+          (unsigned long)metrics_read(&g_metrics.frames_unmatched));
+  fprintf(fp, "# HELP rmtdos_client_terminal_bytes_total Bytes written to "
+              "the terminal.\n"
+              "# TYPE rmtdos_client_terminal_bytes_total counter\n"
+              "rmtdos_client_terminal_bytes_total %lu\n",
+          (unsigned long)g_metrics.terminal_bytes);
+  fprintf(fp, "# HELP rmtdos_client_refresh_seconds Time to write screen "
+              "updates to the terminal.\n"
+              "# TYPE rmtdos_client_refresh_seconds histogram\n");
+  write_histogram(fp, "rmtdos_client_refresh_seconds", "", &g_metrics.refresh);
+}
+
+int metrics_export_open(const char *target) {
+  if (strncmp(target, UNIX_PREFIX, strlen(UNIX_PREFIX))) {
+    g_export_path = strdup(target);
+    g_export_tmp_path = (char *)malloc(strlen(target) + 5);
+    sprintf(g_export_tmp_path, "%s.tmp", target);
+    return 0;
+  }
+
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+  const char *path = target + strlen(UNIX_PREFIX);
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  if (0 > (g_export_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK |
+                                             SOCK_CLOEXEC,
+                                0))) {
+    perror("socket(AF_UNIX)");
+    return -1;
+  }
+
+  // A socket left behind by an earlier run.
+  unlink(path);
+  if ((0 > bind(g_export_fd, (struct sockaddr *)&addr, sizeof(addr))) ||
+      (0 > listen(g_export_fd, 8))) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    close(g_export_fd);
+    g_export_fd = -1;
+    return -1;
+  }
+
+  g_export_path = strdup(path);
+
+  for (size_t i = 0; i < EXPORT_MAX_SCRAPERS; ++i) {
+    g_scrapers[i].fd = -1;
+  }
+  if ((0 > (g_export_epoll_fd = epoll_create1(EPOLL_CLOEXEC))) ||
+      (0 > epoll_ctl(g_export_epoll_fd, EPOLL_CTL_ADD, g_export_fd, &ev))) {
+    perror("epoll(metrics)");
+    metrics_export_close();
+    return -1;
+  }
+
+  return g_export_epoll_fd;
+}
+
+void metrics_export_write() {
+  FILE *fp;
+
+  if (!g_export_tmp_path) {
+    return;
+  }
+
+  // Readers only ever see a complete file.
+  if (!(fp = fopen(g_export_tmp_path, "w"))) {
+    return;
+  }
+  metrics_write_prometheus(fp);
+  if (!fclose(fp)) {
+    rename(g_export_tmp_path, g_export_path);
+  }
+}
+
+static void drop_scraper(struct Scraper *s) {
+  // Never added to the epoll set if the first send took everything.
+  epoll_ctl(g_export_epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+  close(s->fd);
+  free(s->out);
+  memset(s, 0, sizeof(*s));
+  s->fd = -1;
+}
+
+// Sends what it can.  Drops `s` once it has everything, or on error.
+// Returns 1 if more is left to send.
+static int flush_scraper(struct Scraper *s) {
+  while (s->sent < s->out_len) {
+    const ssize_t n =
+        send(s->fd, s->out + s->sent, s->out_len - s->sent, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+        return 1;
+      }
+      break;
+    }
+    s->sent += n;
+  }
+
+  drop_scraper(s);
+  return 0;
+}
+
+static void accept_scrapers() {
+  const uint64_t now_ns = metrics_now_ns();
+  FILE *fp;
+  int fd;
+
+  // Slots held by scrapers that stopped reading.
+  for (size_t i = 0; i < EXPORT_MAX_SCRAPERS; ++i) {
+    if ((g_scrapers[i].fd >= 0) &&
+        (now_ns - g_scrapers[i].start_ns >
+         EXPORT_SEND_TIMEOUT_SEC * 1000000000ULL)) {
+      drop_scraper(&g_scrapers[i]);
+    }
+  }
+
+  while (0 <= (fd = accept(g_export_fd, NULL, NULL))) {
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+
+    struct Scraper *s = NULL;
+    for (size_t i = 0; !s && (i < EXPORT_MAX_SCRAPERS); ++i) {
+      if (g_scrapers[i].fd < 0) {
+        s = &g_scrapers[i];
+      }
+    }
+    if (!s) {
+      close(fd);
+      continue;
+    }
+
+    // Every metric as of now, so a slow scraper never holds up the UI.
+    if (!(fp = open_memstream(&s->out, &s->out_len))) {
+      close(fd);
+      continue;
+    }
+    metrics_write_prometheus(fp);
+    fclose(fp);
+    s->fd = fd;
+    s->start_ns = now_ns;
+    s->sent = 0;
+
+    struct epoll_event ev = {.events = EPOLLOUT, .data.ptr = s};
+    if (flush_scraper(s) &&
+        (0 > epoll_ctl(g_export_epoll_fd, EPOLL_CTL_ADD, fd, &ev))) {
+      drop_scraper(s);
+    }
+  }
+}
+
+void metrics_export_run() {
+  struct epoll_event events[EXPORT_MAX_SCRAPERS + 1];
+
+  const int nfds =
+      epoll_wait(g_export_epoll_fd, events, EXPORT_MAX_SCRAPERS + 1, 0);
+  for (int n = 0; n < nfds; ++n) {
+    struct Scraper *s = (struct Scraper *)events[n].data.ptr;
+
+    if (!s) {
+      accept_scrapers();
+    } else if (s->fd < 0) {
+      // Dropped by an earlier event.
+    } else if (events[n].events & (EPOLLERR | EPOLLHUP)) {
+      drop_scraper(s);
+    } else if (events[n].events & EPOLLOUT) {
+      flush_scraper(s);
+    }
+  }
+}
+
+void metrics_export_close() {
+  if (g_export_epoll_fd >= 0) {
+    for (size_t i = 0; i < EXPORT_MAX_SCRAPERS; ++i) {
+      if (g_scrapers[i].fd >= 0) {
+        drop_scraper(&g_scrapers[i]);
+      }
+    }
+    close(g_export_epoll_fd);
+    g_export_epoll_fd = -1;
+  }
+  if (g_export_fd >= 0) {
+    close(g_export_fd);
+    unlink(g_export_path);
+    g_export_fd = -1;
+  }
+  if (g_io_fd >= 0) {
+    close(g_io_fd);
+    g_io_fd = -1;
+  }
+
+  free(g_export_path);
+  free(g_export_tmp_path);
+  g_export_path = g_export_tmp_path = NULL;
+}
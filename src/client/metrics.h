@@ -0,0 +1,111 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Client metrics: per-host counters of what was received, filtered and sent,
+// and histograms of the time spent decoding and drawing, plus the bytes
+// written to the terminal.  Shown in the debug window (`-D`), and exported
+// in the Prometheus text format (`-M`), either to a file rewritten every
+// METRICS_EXPORT_INTERVAL_MS (for node_exporter's textfile collector), or
+// to each connection on a Unix socket.
+//
+// Counters written by the network thread are updated with relaxed atomics,
+// so the UI thread can read them at any time.  The others are only touched
+// by the UI thread.
+
+#ifndef __RMTDOS_CLIENT_METRICS_H
+#define __RMTDOS_CLIENT_METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct RemoteHost;
+
+// Upper bounds of the histogram buckets, in nanoseconds.  One more bucket
+// counts everything slower.
+#define METRICS_BUCKETS 18
+extern const uint64_t g_metrics_bucket_ns[METRICS_BUCKETS];
+
+struct Histogram {
+  uint64_t counts[METRICS_BUCKETS + 1]; // Per bucket, not cumulative.
+  uint64_t sum_ns;
+  uint64_t count;
+};
+
+struct HostMetrics {
+  // Network thread.  Frames accepted from the host, and their bytes.
+  uint64_t frames_rx;
+  uint64_t bytes_rx;
+
+  // Network thread.  Frames from the host that were thrown away: not to our
+  // session, or video for a host that is in no session.
+  uint64_t frames_filtered;
+
+  // Network thread.  Storing a V1_VGA_TEXT into the host's `Screen`.
+  struct Histogram decode;
+
+  // Network thread.  `time_now_us()` of the last V1_VGA_TEXT from the host,
+  // 0 for none.  Other frames stamp `RemoteHost.last_resp_us` only.
+  uint64_t last_video_us;
+
+  // UI thread.
+  uint64_t keystrokes_sent;
+
+  // UI thread.  Drawing the host's changes into its window or wall tile
+  // (not the terminal output, see `ClientMetrics.refresh`).
+  struct Histogram render;
+};
+
+struct ClientMetrics {
+  // Network thread.  Frames from senders that are not known hosts.
+  uint64_t frames_unmatched;
+
+  // UI thread.  Bytes that ncurses wrote to the terminal, and the time
+  // spent writing them.
+  uint64_t terminal_bytes;
+  struct Histogram refresh;
+};
+
+extern struct ClientMetrics g_metrics;
+
+// How often to call `metrics_export_write()`.
+#define METRICS_EXPORT_INTERVAL_MS 10000
+
+// Monotonic time, in nanoseconds.
+extern uint64_t metrics_now_ns();
+
+// Network thread: adds `n` to a counter that other threads read.
+extern void metrics_add(uint64_t *counter, uint64_t n);
+
+// Reads a counter that another thread writes.
+extern uint64_t metrics_read(const uint64_t *counter);
+
+// Adds one sample to `h`.  Safe from the network thread.
+extern void histogram_add(struct Histogram *h, uint64_t ns);
+
+// Mean of the samples in `h`, in microseconds, or 0 if there are none.
+extern double histogram_mean_us(const struct Histogram *h);
+
+// Bytes written so far by the calling thread, or 0 if the kernel does not
+// say (/proc/thread-self/io).
+extern uint64_t metrics_thread_bytes_written();
+
+// Writes every metric to `fp`, in the Prometheus text format.
+extern void metrics_write_prometheus(FILE *fp);
+
+// Sets where to export to: "unix:PATH" listens on a Unix socket, anything
+// else is a file.  Returns the fd to wait on (readable when
+// `metrics_export_run()` has work), 0 for a file, or <0 on error.
+extern int metrics_export_open(const char *target);
+
+// Rewrites the export file, if one is set.
+extern void metrics_export_write();
+
+// Call when the fd from `metrics_export_open()` is readable.  Accepts
+// scrapers, and sends each its copy of the metrics without blocking.
+extern void metrics_export_run();
+
+extern void metrics_export_close();
+
+#endif // __RMTDOS_CLIENT_METRICS_H
@@ -6,6 +6,7 @@
 #include <arpa/inet.h>
 #include <assert.h>
 #include <errno.h>
+#include <linux/filter.h>
 #include <linux/if_ether.h>
 #include <linux/if_packet.h>
 #include <net/ethernet.h>
@@ -19,6 +20,7 @@
 #include <unistd.h>
 
 #include "client/network.h"
+#include "client/probes.h"
 
 // Raw packet send/recv code inspired by
 // https://gist.github.com/lethean/5fb0f493a1968939f2f7
@@ -91,6 +93,71 @@ void close_socket(struct RawSocket *sock) {
   }
 }
 
+int set_promiscuous(struct RawSocket *sock) {
+  struct packet_mreq mreq = {0};
+  mreq.mr_ifindex = sock->if_index;
+  mreq.mr_type = PACKET_MR_PROMISC;
+
+  // The kernel drops the membership when the socket is closed.
+  int r = setsockopt(sock->sock_fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq,
+                     sizeof(mreq));
+  if (r < 0) {
+    perror("PACKET_ADD_MEMBERSHIP");
+  }
+
+  return r;
+}
+
+int join_fanout(struct RawSocket *sock, uint16_t *group_id) {
+  // Picks the member: the last 4 bytes of the source MAC, which the kernel
+  // takes modulo the group's size.  Loads are relative to the MAC header.
+  static struct sock_filter by_source[] = {
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_LL_OFF + ETH_ALEN + 2),
+      BPF_STMT(BPF_RET | BPF_A, 0),
+  };
+  const struct sock_fprog prog = {
+      .len = sizeof(by_source) / sizeof(by_source[0]),
+      .filter = by_source,
+  };
+  int arg = *group_id | (PACKET_FANOUT_CBPF << 16);
+  socklen_t len = sizeof(arg);
+
+  // Groups are per device, and only bound sockets have one.
+  struct sockaddr_ll sock_addr = {0};
+  sock_addr.sll_family = AF_PACKET;
+  sock_addr.sll_protocol = htons(sock->ethertype);
+  sock_addr.sll_ifindex = sock->if_index;
+  if (0 > bind(sock->sock_fd, (struct sockaddr *)&sock_addr,
+               sizeof(sock_addr))) {
+    perror("bind()");
+    return -1;
+  }
+
+  // A new group gets an id that no other process is using.
+  if (!*group_id) {
+    arg |= PACKET_FANOUT_FLAG_UNIQUEID << 16;
+  }
+
+  if (0 > setsockopt(sock->sock_fd, SOL_PACKET, PACKET_FANOUT, &arg,
+                     sizeof(arg))) {
+    perror("PACKET_FANOUT");
+    return -1;
+  }
+
+  if (!*group_id) {
+    if ((0 > getsockopt(sock->sock_fd, SOL_PACKET, PACKET_FANOUT, &arg,
+                        &len)) ||
+        (0 > setsockopt(sock->sock_fd, SOL_PACKET, PACKET_FANOUT_DATA, &prog,
+                        sizeof(prog)))) {
+      perror("PACKET_FANOUT_DATA");
+      return -1;
+    }
+    *group_id = arg & 0xffff;
+  }
+
+  return 0;
+}
+
 int send_packet(struct RawSocket *sock, const uint8_t *dest_mac_addr,
                 enum PKT_TYPE pkt_type, const void *payload,
                 size_t payload_len) {
@@ -125,6 +192,7 @@ int send_packet(struct RawSocket *sock, const uint8_t *dest_mac_addr,
   sock_addr.sll_halen = ETH_ALEN;
   memcpy(sock_addr.sll_addr, dest, ETH_ALEN);
 
+  PROBE3(frame_tx, dest, pkt_type, payload_len);
   int r = sendto(sock->sock_fd, buffer, send_len, 0,
                  (struct sockaddr *)&sock_addr, sizeof(sock_addr));
   if (r < 0) {
@@ -147,6 +215,10 @@ int send_status_req(struct RawSocket *sock, const uint8_t *dest_mac_addr) {
   return send_packet(sock, dest_mac_addr, V1_STATUS_REQ, NULL, 0);
 }
 
+int send_stats_req(struct RawSocket *sock, const uint8_t *dest_mac_addr) {
+  return send_packet(sock, dest_mac_addr, V1_STATS_REQ, NULL, 0);
+}
+
 int send_session_start(struct RawSocket *sock, const uint8_t *dest_mac_addr) {
   return send_packet(sock, dest_mac_addr, V1_SESSION_START, NULL, 0);
 }
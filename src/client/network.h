@@ -11,6 +11,9 @@
 
 #include "common/protocol.h"
 
+// Most interfaces (`-i`) that one client listens on.
+#define MAX_INTERFACES 8
+
 struct RawSocket {
   int sock_fd;               // Socket
   int if_index;              // Interface index
@@ -29,6 +32,16 @@ int create_socket(struct RawSocket *result, const char *if_name,
 
 void close_socket(struct RawSocket *sock);
 
+// Puts the interface in promiscuous mode for as long as the socket is open.
+// Returns <0 on error.
+int set_promiscuous(struct RawSocket *sock);
+
+// Collector mode: puts the socket in a PACKET_FANOUT group, which shares the
+// interface's frames among its members by source MAC, so every frame from
+// one host reaches the same socket.  Creates the group if `*group_id` is 0,
+// and sets `*group_id`.  Returns <0 on error.
+int join_fanout(struct RawSocket *sock, uint16_t *group_id);
+
 int send_packet(struct RawSocket *sock, const uint8_t *dest_mac_addr,
                 enum PKT_TYPE pkt_type, const void *payload,
                 size_t payload_len);
@@ -37,6 +50,8 @@ int send_ping(struct RawSocket *sock, const uint8_t *dest_mac_addr);
 
 int send_status_req(struct RawSocket *sock, const uint8_t *dest_mac_addr);
 
+int send_stats_req(struct RawSocket *sock, const uint8_t *dest_mac_addr);
+
 int send_session_start(struct RawSocket *sock, const uint8_t *dest_mac_addr);
 
 int send_keystrokes(struct RawSocket *sock, const uint8_t *dest_mac_addr,
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Static tracepoints (USDT, provider "rmtdos") on the client's hot path, for
+// bpftrace and perf.  A probe that is not in use is a single `nop`; its
+// arguments are left wherever the compiler already has them.  See
+// src/client/bpftrace/ for scripts, and
+// `bpftrace -l 'usdt:out/rmtdos-client:*'` for the list.
+//
+// Uses <sys/sdt.h> (systemtap-sdt-dev) when it is installed.  Otherwise, on
+// x86-64, the same ".note.stapsdt" records are emitted here.  Build with
+// -DRMTDOS_NO_PROBES to leave them out.  Arguments are integers or pointers,
+// and are passed as 64 bits.
+
+#ifndef __RMTDOS_CLIENT_PROBES_H
+#define __RMTDOS_CLIENT_PROBES_H
+
+#include <stdint.h>
+
+#if defined(RMTDOS_NO_PROBES)
+
+#define PROBE0(name)
+#define PROBE1(name, a)
+#define PROBE2(name, a, b)
+#define PROBE3(name, a, b, c)
+
+#elif defined(__has_include) && __has_include(<sys/sdt.h>)
+
+#include <sys/sdt.h>
+
+#define PROBE0(name) DTRACE_PROBE(rmtdos, name)
+#define PROBE1(name, a) DTRACE_PROBE1(rmtdos, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(rmtdos, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(rmtdos, name, a, b, c)
+
+#elif defined(__x86_64__)
+
+// The layout that <sys/sdt.h> emits: a note per probe giving its address,
+// the address of ".stapsdt.base" (so tools can tell if the file was
+// relocated), no semaphore, and where to find each argument ("8@%rax").
+#define _PROBE_ASM(name, args)                                                 \
+  "990: nop\n"                                                                 \
+  ".pushsection .note.stapsdt,\"\",\"note\"\n"                                 \
+  ".balign 4\n"                                                                \
+  ".4byte 992f-991f, 994f-993f, 3\n"                                           \
+  "991: .asciz \"stapsdt\"\n"                                                  \
+  "992: .balign 4\n"                                                           \
+  "993: .8byte 990b\n"                                                         \
+  ".8byte _.stapsdt.base\n"                                                    \
+  ".8byte 0\n"                                                                 \
+  ".asciz \"rmtdos\"\n"                                                        \
+  ".asciz \"" #name "\"\n"                                                     \
+  ".asciz \"" args "\"\n"                                                      \
+  "994: .balign 4\n"                                                           \
+  ".popsection\n"                                                              \
+  ".ifndef _.stapsdt.base\n"                                                   \
+  ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"      \
+  ".weak _.stapsdt.base\n"                                                     \
+  ".hidden _.stapsdt.base\n"                                                   \
+  "_.stapsdt.base: .space 1\n"                                                 \
+  ".size _.stapsdt.base, 1\n"                                                  \
+  ".popsection\n"                                                              \
+  ".endif\n"
+
+#define _PROBE_ARG(x) "nor"((uint64_t)(uintptr_t)(x))
+
+#define PROBE0(name) __asm__ __volatile__(_PROBE_ASM(name, ""))
+#define PROBE1(name, a)                                                        \
+  __asm__ __volatile__(_PROBE_ASM(name, "8@%0") : : _PROBE_ARG(a))
+#define PROBE2(name, a, b)                                                     \
+  __asm__ __volatile__(_PROBE_ASM(name, "8@%0 8@%1")                           \
+                       : : _PROBE_ARG(a), _PROBE_ARG(b))
+#define PROBE3(name, a, b, c)                                                  \
+  __asm__ __volatile__(_PROBE_ASM(name, "8@%0 8@%1 8@%2")                      \
+                       : : _PROBE_ARG(a), _PROBE_ARG(b), _PROBE_ARG(c))
+
+#else
+
+#define PROBE0(name)
+#define PROBE1(name, a)
+#define PROBE2(name, a, b)
+#define PROBE3(name, a, b, c)
+
+#endif
+
+#endif // __RMTDOS_CLIENT_PROBES_H
@@ -0,0 +1,564 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ncurses.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "client/flightrec.h"
+#include "client/keyboard.h"
+#include "client/query.h"
+#include "client/recorder.h"
+#include "client/screen.h"
+#include "client/timerwheel.h"
+#include "client/util.h"
+
+// Replies that a slow reader has not taken yet.  It is dropped beyond this.
+#define OUT_MAX (1 << 20)
+
+struct Client {
+  int fd; // -1 if the slot is free.
+  uint32_t events; // As last set with `epoll_ctl()`.
+  uint8_t eof; // Peer is done sending; dropped once everything is answered.
+  uint8_t skip; // Rest of an overlong request is still to be thrown away.
+
+  char in[QUERY_LINE_MAX];
+  size_t in_len;
+
+  char *out;
+  size_t out_len;
+  size_t out_cap;
+
+  // A "wait" is pending while `wait_host` is set.
+  struct RemoteHost *wait_host;
+  int wait_row; // -1 for any row.
+  uint32_t wait_seq; // Screen last checked.
+  char wait_text[QUERY_LINE_MAX];
+
+  // A "keys" is pending while `keys_host` is set.
+  struct RemoteHost *keys_host;
+  struct Keystroke keys[QUERY_LINE_MAX];
+  size_t keys_count;
+  size_t keys_sent;
+
+  // Timeout of the wait, or next batch of keys.
+  struct Timer timer;
+};
+
+static int g_listen_fd = -1;
+static int g_epoll_fd = -1;
+static char *g_path = NULL;
+static struct Client g_clients[QUERY_MAX_CLIENTS];
+
+// Scratch copy of the screen being read.
+static struct Screen g_snap;
+
+static int busy(const struct Client *c) {
+  return c->wait_host || c->keys_host;
+}
+
+static void drop(struct Client *c) {
+  timer_cancel(&c->timer);
+  epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+  close(c->fd);
+  free(c->out);
+  memset(c, 0, sizeof(*c));
+  c->fd = -1;
+}
+
+static void reply(struct Client *c, const char *fmt, ...) {
+  va_list ap;
+
+  va_start(ap, fmt);
+  const int n = vsnprintf(NULL, 0, fmt, ap);
+  va_end(ap);
+  if (n < 0) {
+    return;
+  }
+
+  if (c->out_len + n + 1 > c->out_cap) {
+    size_t cap = c->out_cap ? c->out_cap : 4096;
+    while (cap < c->out_len + n + 1) {
+      cap *= 2;
+    }
+    c->out = (char *)realloc(c->out, cap);
+    c->out_cap = cap;
+  }
+
+  va_start(ap, fmt);
+  vsnprintf(c->out + c->out_len, n + 1, fmt, ap);
+  va_end(ap);
+  c->out_len += n;
+}
+
+// Sends what it can of the replies, and updates what to wait for on `c`.
+// Returns 0 if `c` was dropped.
+static int flush(struct Client *c) {
+  size_t done = 0;
+
+  while (done < c->out_len) {
+    const ssize_t n =
+        send(c->fd, c->out + done, c->out_len - done, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+        break;
+      }
+      drop(c);
+      return 0;
+    }
+    done += n;
+  }
+  memmove(c->out, c->out + done, c->out_len - done);
+  c->out_len -= done;
+
+  if ((c->out_len > OUT_MAX) || (c->eof && !busy(c) && !c->out_len)) {
+    drop(c);
+    return 0;
+  }
+
+  // No reading while the request buffer is full; it drains as requests are
+  // answered.
+  const uint32_t events = ((!c->eof && (c->in_len < sizeof(c->in))) ? EPOLLIN
+                                                                      : 0) |
+                          (c->out_len ? EPOLLOUT : 0);
+  if (events != c->events) {
+    struct epoll_event ev = {.events = events, .data.ptr = c};
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = events;
+  }
+  return 1;
+}
+
+static struct RemoteHost *find_host(struct Client *c, const char *arg) {
+  struct RemoteHost *rh = NULL;
+  uint8_t mac[ETH_ALEN];
+  char *end;
+
+  if (!arg) {
+    reply(c, "error no host given\n");
+    return NULL;
+  }
+
+  if (parse_mac_addr(arg, mac)) {
+    rh = hostlist_find_by_mac(mac);
+  } else {
+    const long index = strtol(arg, &end, 10);
+    if (!*end) {
+      rh = hostlist_find_by_index(index);
+    }
+  }
+
+  if (!rh || !host_screen(rh)) {
+    reply(c, "error unknown host %s\n", arg);
+    return NULL;
+  }
+  return rh;
+}
+
+// Answers `c`'s wait if its text is on screen.  Returns non-zero if so.
+static int check_wait(struct Client *c) {
+  screen_snapshot(host_screen(c->wait_host), &g_snap);
+  c->wait_seq = g_snap.seq;
+
+  const int row = screen_find_text(&g_snap, c->wait_row, c->wait_text);
+  if (row < 0) {
+    return 0;
+  }
+
+  timer_cancel(&c->timer);
+  c->wait_host = NULL;
+  reply(c, "ok %u %d\n", g_snap.seq, row);
+  return 1;
+}
+
+static int serve(struct Client *c);
+
+static void wait_expired(struct Timer *timer) {
+  struct Client *c = (struct Client *)timer->arg;
+
+  c->wait_host = NULL;
+  reply(c, "timeout %u\n", c->wait_seq);
+  serve(c);
+}
+
+// Sends the next batch of `c`'s keys.  Returns non-zero (and answers the
+// request) once all are sent.
+static int send_keys(struct Client *c) {
+  struct RemoteHost *rh = c->keys_host;
+  struct RawSocket *rs = host_socket(rh);
+
+  size_t count = c->keys_count - c->keys_sent;
+  if (count > KEYS_PER_BATCH) {
+    count = KEYS_PER_BATCH;
+  }
+
+  if (rs) {
+    const struct Keystroke *keys = &c->keys[c->keys_sent];
+
+    send_keystrokes(rs, rh->if_addr, count, keys);
+    recorder_keystrokes(rh, count, keys);
+    rh->metrics.keystrokes_sent += count;
+
+    const struct FlightEvent fe = {
+        .type = FLIGHT_KEYS,
+        .host = rh->index,
+        .pkt_type = V1_INJECT_KEYSTROKE,
+        .count = count,
+    };
+    flightrec_add(&g_flight_ui, &fe);
+  }
+  c->keys_sent += count;
+
+  if (c->keys_sent < c->keys_count) {
+    return 0;
+  }
+
+  c->keys_host = NULL;
+  reply(c, "ok %zu\n", c->keys_count);
+  return 1;
+}
+
+static void keys_tick(struct Timer *timer) {
+  struct Client *c = (struct Client *)timer->arg;
+
+  if (send_keys(c)) {
+    serve(c);
+  } else {
+    timer_schedule(timer, TIMER_TICK_MS);
+  }
+}
+
+static void do_hosts(struct Client *c) {
+  char mac_tmp[MAC_ADDR_FMT_LEN];
+  struct RemoteHost *rh;
+  int count = 0;
+  int iter = 0;
+
+  while ((rh = hostlist_iter(&iter))) {
+    count += !!host_screen(rh);
+  }
+
+  reply(c, "ok %d\n", count);
+  for (iter = 0; (rh = hostlist_iter(&iter));) {
+    if (host_screen(rh)) {
+      reply(c, "%d %s\n", rh->index,
+            fmt_mac_addr(mac_tmp, sizeof(mac_tmp), rh->if_addr));
+    }
+  }
+}
+
+static void do_screen(struct Client *c, char *args) {
+  struct RemoteHost *rh = find_host(c, split_word(&args));
+  char line[SCREEN_ROW_TEXT_MAX + 1];
+
+  if (!rh) {
+    return;
+  }
+
+  screen_snapshot(host_screen(rh), &g_snap);
+  const int rows = screen_visible_rows(&g_snap);
+  reply(c, "ok %u %d %d %d %d\n", g_snap.seq, rows, g_snap.text_cols,
+        g_snap.cursor_row, g_snap.cursor_col);
+
+  for (int r = 0; r < rows; ++r) {
+    size_t len = screen_text(&g_snap, r, 0, g_snap.text_cols, line);
+    while (len && (line[len - 1] == ' ')) {
+      --len;
+    }
+    reply(c, "%.*s\n", (int)len, line);
+  }
+}
+
+static void do_wait(struct Client *c, char *args) {
+  struct RemoteHost *rh = find_host(c, split_word(&args));
+  const char *row = split_word(&args);
+  const char *timeout = split_word(&args);
+  char *end;
+
+  if (!rh) {
+    return;
+  }
+
+  if (!row || !timeout || !*args) {
+    reply(c, "error usage: wait HOST ROW|* TIMEOUT_MS TEXT\n");
+    return;
+  }
+
+  if (strcmp(row, "*")) {
+    c->wait_row = strtol(row, &end, 10);
+    if (*end || (c->wait_row < 0)) {
+      reply(c, "error bad row %s\n", row);
+      return;
+    }
+  } else {
+    c->wait_row = -1;
+  }
+
+  const unsigned long timeout_ms = strtoul(timeout, &end, 10);
+  if (*end) {
+    reply(c, "error bad timeout %s\n", timeout);
+    return;
+  }
+
+  c->wait_host = rh;
+  strcpy(c->wait_text, args);
+  if (check_wait(c)) {
+    return;
+  }
+
+  timer_init(&c->timer, wait_expired, c);
+  timer_schedule(&c->timer, timeout_ms);
+}
+
+static void do_keys(struct Client *c, char *args) {
+  struct RemoteHost *rh = find_host(c, split_word(&args));
+
+  if (!rh) {
+    return;
+  }
+
+  const int count = keyboard_parse_text(args, c->keys);
+  if (count < 0) {
+    reply(c, "error no key for offset %d\n", -1 - count);
+    return;
+  }
+  c->keys_count = count;
+  c->keys_sent = 0;
+
+  if (!c->keys_count) {
+    reply(c, "ok 0\n");
+    return;
+  }
+
+  c->keys_host = rh;
+  if (!send_keys(c)) {
+    timer_init(&c->timer, keys_tick, c);
+    timer_schedule(&c->timer, TIMER_TICK_MS);
+  }
+}
+
+static void handle(struct Client *c, char *line) {
+  const char *cmd = split_word(&line);
+
+  if (!cmd) {
+    reply(c, "error empty request\n");
+  } else if (!strcmp(cmd, "hosts")) {
+    do_hosts(c);
+  } else if (!strcmp(cmd, "screen")) {
+    do_screen(c, line);
+  } else if (!strcmp(cmd, "wait")) {
+    do_wait(c, line);
+  } else if (!strcmp(cmd, "keys")) {
+    do_keys(c, line);
+  } else {
+    reply(c, "error unknown request %s\n", cmd);
+  }
+}
+
+// Answers the complete requests that `c` sent, up to the first one that
+// has to wait.  Returns 0 if `c` was dropped.
+static int serve(struct Client *c) {
+  char *nl;
+
+  if (c->skip) {
+    if (!(nl = (char *)memchr(c->in, '\n', c->in_len))) {
+      c->in_len = 0;
+      return flush(c);
+    }
+
+    c->in_len -= nl + 1 - c->in;
+    memmove(c->in, nl + 1, c->in_len);
+    c->skip = 0;
+  }
+
+  while (!busy(c) && (nl = (char *)memchr(c->in, '\n', c->in_len))) {
+    const size_t used = nl + 1 - c->in;
+
+    *nl = 0;
+    if ((nl > c->in) && (nl[-1] == '\r')) {
+      nl[-1] = 0;
+    }
+    handle(c, c->in);
+
+    memmove(c->in, c->in + used, c->in_len - used);
+    c->in_len -= used;
+  }
+
+  if (!busy(c) && (c->in_len == sizeof(c->in))) {
+    reply(c, "error request too long\n");
+    c->in_len = 0;
+    c->skip = 1;
+  }
+
+  return flush(c);
+}
+
+static void read_client(struct Client *c) {
+  while (c->in_len < sizeof(c->in)) {
+    const ssize_t n =
+        recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+    if (n > 0) {
+      c->in_len += n;
+    } else if (!n) {
+      c->eof = 1;
+      break;
+    } else if (errno == EINTR) {
+      continue;
+    } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+      break;
+    } else {
+      drop(c);
+      return;
+    }
+  }
+
+  serve(c);
+}
+
+static void accept_clients() {
+  int fd;
+
+  while (0 <= (fd = accept(g_listen_fd, NULL, NULL))) {
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+
+    struct Client *c = NULL;
+    for (size_t i = 0; !c && (i < QUERY_MAX_CLIENTS); ++i) {
+      if (g_clients[i].fd < 0) {
+        c = &g_clients[i];
+      }
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+    if (!c || (0 > epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, fd, &ev))) {
+      close(fd);
+      continue;
+    }
+    c->fd = fd;
+    c->events = EPOLLIN;
+  }
+}
+
+int query_open(const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  for (size_t i = 0; i < QUERY_MAX_CLIENTS; ++i) {
+    g_clients[i].fd = -1;
+  }
+
+  if (0 > (g_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK |
+                                             SOCK_CLOEXEC,
+                                0))) {
+    perror("socket(AF_UNIX)");
+    return -1;
+  }
+
+  // A socket left behind by an earlier run.
+  unlink(path);
+  if ((0 > bind(g_listen_fd, (struct sockaddr *)&addr, sizeof(addr))) ||
+      (0 > listen(g_listen_fd, 8))) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    close(g_listen_fd);
+    g_listen_fd = -1;
+    return -1;
+  }
+  g_path = strdup(path);
+
+  // The listener and the connections share one epoll set, which the caller
+  // waits on as a single fd.
+  if ((0 > (g_epoll_fd = epoll_create1(EPOLL_CLOEXEC))) ||
+      (0 > epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_listen_fd, &ev))) {
+    perror("epoll(query)");
+    query_close();
+    return -1;
+  }
+
+  return g_epoll_fd;
+}
+
+void query_run() {
+  struct epoll_event events[QUERY_MAX_CLIENTS + 1];
+
+  const int nfds =
+      epoll_wait(g_epoll_fd, events, QUERY_MAX_CLIENTS + 1, 0);
+  for (int n = 0; n < nfds; ++n) {
+    struct Client *c = (struct Client *)events[n].data.ptr;
+
+    if (!c) {
+      accept_clients();
+    } else if (c->fd < 0) {
+      // Dropped by an earlier event.
+    } else if (events[n].events & (EPOLLERR | EPOLLHUP)) {
+      drop(c);
+    } else if (events[n].events & EPOLLIN) {
+      read_client(c);
+    } else if (events[n].events & EPOLLOUT) {
+      flush(c);
+    }
+  }
+}
+
+void query_screen_changed(struct RemoteHost *rh) {
+  if (g_epoll_fd < 0) {
+    return;
+  }
+
+  for (size_t i = 0; i < QUERY_MAX_CLIENTS; ++i) {
+    struct Client *c = &g_clients[i];
+
+    if ((c->fd < 0) || !c->wait_host || (rh && (c->wait_host != rh))) {
+      continue;
+    }
+
+    // Nothing new since the last look.
+    const struct Screen *s = host_screen(c->wait_host);
+    if (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) == c->wait_seq) {
+      continue;
+    }
+
+    if (check_wait(c)) {
+      serve(c);
+    }
+  }
+}
+
+void query_close() {
+  for (size_t i = 0; i < QUERY_MAX_CLIENTS; ++i) {
+    if (g_clients[i].fd >= 0) {
+      drop(&g_clients[i]);
+    }
+  }
+
+  if (g_epoll_fd >= 0) {
+    close(g_epoll_fd);
+    g_epoll_fd = -1;
+  }
+  if (g_listen_fd >= 0) {
+    close(g_listen_fd);
+    unlink(g_path);
+    g_listen_fd = -1;
+  }
+
+  free(g_path);
+  g_path = NULL;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Screen query API, for automation: a Unix socket (`-Q path`, with `-P`)
+// that answers what is on a host's screen, waits for text to appear, and
+// injects keys.  Backed by the daemon's hosts (see "client/daemon.h").
+//
+// Requests and replies are lines of text.  Requests are answered in order;
+// a connection's next request is read once the one before it is answered.
+// HOST is a MAC address (xx:xx:xx:xx:xx:xx) or a host index, as listed by
+// "hosts".  Rows and columns count from 0.  Screen text is UTF-8, via
+// `g_cp437_table`, with trailing spaces removed.
+//
+//   hosts
+//     ok COUNT, then COUNT lines of "INDEX MAC".
+//
+//   screen HOST
+//     ok SEQ ROWS COLS CURSOR_ROW CURSOR_COL, then ROWS lines of text.
+//
+//   wait HOST ROW|* TIMEOUT_MS TEXT
+//     Waits until row ROW (or any row, for "*") contains TEXT (the rest of
+//     the line), or TIMEOUT_MS passes.  Rows are checked when frames from
+//     the host arrive, not polled.  "ok SEQ ROW" or "timeout SEQ".
+//
+//   keys HOST TEXT
+//     Types TEXT (the rest of the line) on the host.  The escapes \n (Enter),
+//     \t, \b (backspace), \e (Esc) and \\ are understood.  "ok COUNT".
+//
+// Failed requests are answered "error MESSAGE".  SEQ is the screen's
+// sequence counter (see "client/shmstore.h").
+
+#ifndef __RMTDOS_CLIENT_QUERY_H
+#define __RMTDOS_CLIENT_QUERY_H
+
+#include "client/hostlist.h"
+
+// Most connections served at once; more are refused.
+#define QUERY_MAX_CLIENTS 32
+
+// Longest request, including the newline.
+#define QUERY_LINE_MAX 1024
+
+// Listens on the Unix socket `path`.  Returns the fd to wait on (readable
+// when `query_run()` has work), or <0 on error.
+extern int query_open(const char *path);
+
+// Call when the fd from `query_open()` is readable.
+extern void query_run();
+
+// Call when the screen of `rh` changed (NULL: of any host, e.g. after
+// dropped events).  Answers the waits that are now satisfied.
+extern void query_screen_changed(struct RemoteHost *rh);
+
+// Drops every connection, and removes the socket.
+extern void query_close();
+
+#endif // __RMTDOS_CLIENT_QUERY_H
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "client/recorder.h"
+#include "client/screen.h"
+#include "client/util.h"
+#include "liblinux/recording.h"
+
+static const char *g_dir = NULL;
+
+// Consistent copy of the screen being recorded.
+static struct Screen g_snapshot;
+
+void recorder_set_dir(const char *dir) { g_dir = dir; }
+
+int recorder_enabled() { return g_dir != NULL; }
+
+static struct RecordingWriter *open_recording(struct RemoteHost *rh,
+                                              uint64_t now_us) {
+  char path[4096];
+  char stamp[32];
+  const time_t now = now_us / 1000000;
+  const uint8_t *m = rh->if_addr;
+
+  strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+  snprintf(path, sizeof(path), "%s/%02x%02x%02x%02x%02x%02x-%s.rmtrec", g_dir,
+           m[0], m[1], m[2], m[3], m[4], m[5], stamp);
+
+  struct RecordingWriter *w =
+      (struct RecordingWriter *)malloc(sizeof(struct RecordingWriter));
+  if (0 > recording_create(w, path, rh->if_addr, now_us,
+                           RECORDING_DEFAULT_KEYFRAME_US)) {
+    // Leave `w->fp` NULL, so further writes are ignored rather than retried.
+    memset(w, 0, sizeof(*w));
+  }
+
+  return rh->recording = w;
+}
+
+void recorder_update(struct RemoteHost *rh) {
+  const struct Screen *s = &g_snapshot;
+  const struct Screen *screen = host_screen(rh);
+
+  if (!g_dir || !screen) {
+    return;
+  }
+
+  screen_snapshot(screen, &g_snapshot);
+  if (!s->text_cols) {
+    return;
+  }
+
+  const uint64_t now_us = time_now_us();
+  struct RecordingWriter *w =
+      rh->recording ? rh->recording : open_recording(rh, now_us);
+
+  recording_write_screen(w, now_us, s->text_rows, s->text_cols,
+                         s->cursor_row, s->cursor_col, s->video_text_buffer);
+}
+
+void recorder_keystrokes(struct RemoteHost *rh, size_t count,
+                         const struct Keystroke *keys) {
+  if (!g_dir) {
+    return;
+  }
+
+  const uint64_t now_us = time_now_us();
+  struct RecordingWriter *w =
+      rh->recording ? rh->recording : open_recording(rh, now_us);
+
+  recording_write_keys(w, now_us, count, keys);
+}
+
+void recorder_close_all() {
+  int iter = 0;
+  struct RemoteHost *rh;
+
+  while (NULL != (rh = hostlist_iter(&iter))) {
+    if (rh->recording) {
+      recording_close(rh->recording);
+      free(rh->recording);
+      rh->recording = NULL;
+    }
+  }
+}
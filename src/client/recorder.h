@@ -0,0 +1,33 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Records every session to a file per host (see "liblinux/recording.h"),
+// for auditing.  Play back with `rmtdos-player`.
+
+#ifndef __RMTDOS_CLIENT_RECORDER_H
+#define __RMTDOS_CLIENT_RECORDER_H
+
+#include <stddef.h>
+
+#include "client/hostlist.h"
+#include "common/protocol.h"
+
+// Enables recording into directory `dir`.
+extern void recorder_set_dir(const char *dir);
+
+extern int recorder_enabled();
+
+// UI thread.  Records `rh`'s current screen.  Opens the host's recording on
+// first use.
+extern void recorder_update(struct RemoteHost *rh);
+
+// UI thread.  Records keystrokes sent to `rh`.
+extern void recorder_keystrokes(struct RemoteHost *rh, size_t count,
+                                const struct Keystroke *keys);
+
+// Finishes all recordings (writes their seek index).
+extern void recorder_close_all();
+
+#endif // __RMTDOS_CLIENT_RECORDER_H
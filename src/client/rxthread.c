@@ -0,0 +1,483 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <net/ethernet.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "client/flightrec.h"
+#include "client/hostlist.h"
+#include "client/metrics.h"
+#include "client/probes.h"
+#include "client/rxthread.h"
+#include "client/rxuring.h"
+#include "client/util.h"
+#include "common/protocol.h"
+
+#define MIN(x, y) ((x) > (y) ? (y) : (x))
+
+static int publish(struct RxThread *rx, const struct RxEvent *ev) {
+  return eventq_push(&rx->queue, ev);
+}
+
+static struct FlightRing *flight_ring(const struct RxThread *rx) {
+  return rx->flight ? rx->flight : &g_flight_rx;
+}
+
+static void flight_frame(const struct RxThread *rx, uint8_t type,
+                         const struct RemoteHost *rh, const uint8_t *buf,
+                         size_t received, uint8_t detail) {
+  const struct ProtocolHeader *ph =
+      (const struct ProtocolHeader *)(buf + sizeof(struct ether_header));
+  const struct FlightEvent ev = {
+      .type = type,
+      .host = rh ? rh->index : FLIGHT_NO_HOST,
+      .pkt_type = ntohs(ph->pkt_type),
+      .length = received,
+      .detail = detail,
+  };
+  flightrec_add(flight_ring(rx), &ev);
+}
+
+static void accepted(struct RemoteHost *rh, size_t received) {
+  PROBE2(frame_accepted, rh->index, received);
+  metrics_add(&rh->metrics.frames_rx, 1);
+  metrics_add(&rh->metrics.bytes_rx, received);
+}
+
+// Counts a frame that was thrown away against its sender, and records why.
+// Returns 0, for use as a tail call.
+static int filtered(const struct RxThread *rx, const uint8_t *buf,
+                    size_t received, enum FlightDropReason reason) {
+  const struct ether_header *eh = (const struct ether_header *)buf;
+
+  // The sockets also see the frames that we send.
+  for (size_t i = 0; i < rx->socket_count; ++i) {
+    if (!memcmp(eh->ether_shost, rx->sockets[i].if_addr, ETH_ALEN)) {
+      return 0;
+    }
+  }
+
+  PROBE2(frame_filtered, buf, reason);
+
+  struct RemoteHost *rh = hostlist_find_by_mac(eh->ether_shost);
+
+  metrics_add(rh ? &rh->metrics.frames_filtered : &g_metrics.frames_unmatched,
+              1);
+  flight_frame(rx, FLIGHT_DROP, rh, buf, received, reason);
+  return 0;
+}
+
+int process_incoming_video_text(struct RxThread *rx, const uint8_t *buf,
+                                size_t received) {
+  const struct ether_header *eh = (const struct ether_header *)buf;
+  const struct ProtocolHeader *ph = (const struct ProtocolHeader *)(eh + 1);
+  const struct VideoText *video = (const struct VideoText *)(ph + 1);
+  const uint8_t *data = (const uint8_t *)(video + 1);
+
+  if (received < COMBINED_HEADER_LEN + sizeof(*video) + ntohs(video->count)) {
+    return filtered(rx, buf, received, FLIGHT_DROP_SHORT);
+  }
+
+  struct RemoteHost *rh = hostlist_find_by_mac(eh->ether_shost);
+  if (!rh) {
+    return filtered(rx, buf, received, FLIGHT_DROP_NO_HOST);
+  }
+
+  const uint64_t now = time_now_us();
+  __atomic_store_n(&rh->last_resp_us, now, __ATOMIC_RELAXED);
+  __atomic_store_n(&rh->metrics.last_video_us, now, __ATOMIC_RELAXED);
+
+  // Only hosts that have been in a session have somewhere to put the data.
+  struct Screen *screen = host_screen(rh);
+  if (!screen) {
+    return filtered(rx, buf, received, FLIGHT_DROP_NO_SCREEN);
+  }
+
+  PROBE3(decode_start, rh->index, ntohs(video->offset), ntohs(video->count));
+  const uint64_t start_ns = metrics_now_ns();
+  const int stored = screen_update(screen, video, data);
+  const uint64_t end_ns = metrics_now_ns();
+  histogram_add(&rh->metrics.decode, end_ns - start_ns);
+  PROBE2(decode_done, rh->index, stored);
+  if (!stored) {
+    return filtered(rx, buf, received, FLIGHT_DROP_RANGE);
+  }
+  accepted(rh, received);
+
+  const struct FlightEvent fe = {
+      .ns = end_ns,
+      .type = FLIGHT_VIDEO,
+      .host = rh->index,
+      .pkt_type = V1_VGA_TEXT,
+      .length = received,
+      .offset = ntohs(video->offset),
+      .count = ntohs(video->count),
+      .duration_ns = end_ns - start_ns,
+  };
+  flightrec_add(flight_ring(rx), &fe);
+
+  struct RxEvent ev = {.type = RX_EVENT_VIDEO, .host = rh};
+  ev.video.offset = ntohs(video->offset);
+  ev.video.count = ntohs(video->count);
+  ev.video.rx_us = now;
+  return publish(rx, &ev);
+}
+
+static int process_status_resp(struct RxThread *rx, struct RawSocket *rs,
+                               const uint8_t *buf, size_t received) {
+  const struct ether_header *eh = (const struct ether_header *)buf;
+  const struct ProtocolHeader *ph = (const struct ProtocolHeader *)(eh + 1);
+
+  if (received < COMBINED_HEADER_LEN + sizeof(struct StatusResponse)) {
+    return filtered(rx, buf, received, FLIGHT_DROP_SHORT);
+  }
+
+  struct RemoteHost *rh = hostlist_register(buf, received, rs);
+  if (!rh) {
+    return filtered(rx, buf, received, FLIGHT_DROP_NO_HOST);
+  }
+  accepted(rh, received);
+  flight_frame(rx, FLIGHT_RX, rh, buf, received, 0);
+
+  struct RxEvent ev = {.type = RX_EVENT_STATUS, .host = rh};
+  memcpy(&ev.status, ph + 1, sizeof(ev.status));
+  return publish(rx, &ev);
+}
+
+static int process_stats_resp(struct RxThread *rx, struct RawSocket *rs,
+                              const uint8_t *buf, size_t received) {
+  const struct ether_header *eh = (const struct ether_header *)buf;
+  const struct ProtocolHeader *ph = (const struct ProtocolHeader *)(eh + 1);
+  const struct StatsResponse *in = (const struct StatsResponse *)(ph + 1);
+
+  if (received < COMBINED_HEADER_LEN + sizeof(*in)) {
+    return filtered(rx, buf, received, FLIGHT_DROP_SHORT);
+  }
+
+  struct RemoteHost *rh = hostlist_register(buf, received, rs);
+  if (!rh) {
+    return filtered(rx, buf, received, FLIGHT_DROP_NO_HOST);
+  }
+  accepted(rh, received);
+  flight_frame(rx, FLIGHT_RX, rh, buf, received, 0);
+
+  struct RxEvent ev = {.type = RX_EVENT_STATS, .host = rh};
+  struct StatsResponse *out = &ev.stats;
+  out->int08_ticks = ntohl(in->int08_ticks);
+  out->int2f_ticks = ntohl(in->int2f_ticks);
+  out->packets_recv = ntohl(in->packets_recv);
+  out->packets_dropped = ntohl(in->packets_dropped);
+  out->packets_sent = ntohl(in->packets_sent);
+  out->send_errors = ntohl(in->send_errors);
+  out->drv_packets_in = ntohl(in->drv_packets_in);
+  out->drv_packets_out = ntohl(in->drv_packets_out);
+  out->drv_bytes_in = ntohl(in->drv_bytes_in);
+  out->drv_bytes_out = ntohl(in->drv_bytes_out);
+  out->drv_errors_in = ntohl(in->drv_errors_in);
+  out->drv_errors_out = ntohl(in->drv_errors_out);
+  out->drv_packets_lost = ntohl(in->drv_packets_lost);
+  out->flags = ntohs(in->flags);
+  out->buffers_total = ntohs(in->buffers_total);
+  out->buffers_free = ntohs(in->buffers_free);
+  out->buffers_ready = ntohs(in->buffers_ready);
+  out->buffers_min_free = ntohs(in->buffers_min_free);
+  out->sessions_active = ntohs(in->sessions_active);
+  out->int08_stack_size = ntohs(in->int08_stack_size);
+  out->int08_stack_used = ntohs(in->int08_stack_used);
+  out->int2f_stack_size = ntohs(in->int2f_stack_size);
+  out->int2f_stack_used = ntohs(in->int2f_stack_used);
+  out->pktdrv_stack_size = ntohs(in->pktdrv_stack_size);
+  out->pktdrv_stack_used = ntohs(in->pktdrv_stack_used);
+  return publish(rx, &ev);
+}
+
+// Observer mode: accept only V1_VGA_TEXT from the watched server, to the
+// watched session.
+static int process_observed_packet(struct RxThread *rx, const uint8_t *buf,
+                                   size_t received) {
+  struct Observer *ob = &rx->observer;
+  const struct ether_header *eh = (const struct ether_header *)buf;
+  const struct ProtocolHeader *ph = (const struct ProtocolHeader *)(eh + 1);
+
+  if ((PACKET_SIGNATURE != ntohl(ph->signature)) ||
+      (V1_VGA_TEXT != ntohs(ph->pkt_type)) ||
+      memcmp(eh->ether_shost, ob->server_addr, ETH_ALEN)) {
+    return filtered(rx, buf, received, FLIGHT_DROP_OBSERVER);
+  }
+
+  const uint64_t now = time_now_us();
+  const uint32_t session_id = ntohl(ph->session_id);
+
+  if (ob->locked && !ob->pinned &&
+      (now - ob->last_match_us > OBSERVER_IDLE_US)) {
+    // Viewer went away; follow the next one.
+    ob->locked = 0;
+  }
+
+  if (!ob->locked) {
+    if (ob->pinned && (session_id != ob->session_id)) {
+      return filtered(rx, buf, received, FLIGHT_DROP_OBSERVER);
+    }
+    memcpy(ob->viewer_addr, eh->ether_dhost, ETH_ALEN);
+    ob->session_id = session_id;
+    ob->locked = 1;
+  }
+
+  if ((session_id != ob->session_id) ||
+      memcmp(eh->ether_dhost, ob->viewer_addr, ETH_ALEN)) {
+    return filtered(rx, buf, received, FLIGHT_DROP_OBSERVER);
+  }
+
+  ob->last_match_us = now;
+  return process_incoming_video_text(rx, buf, received);
+}
+
+int process_packet(struct RxThread *rx, struct RawSocket *rs,
+                   const uint8_t *buf, size_t received) {
+  const struct ether_header *eh = (const struct ether_header *)buf;
+  const struct ProtocolHeader *ph = (const struct ProtocolHeader *)(eh + 1);
+  int published = 0;
+
+  PROBE2(frame_rx, buf, received);
+
+  if (received < COMBINED_HEADER_LEN) {
+    return 0;
+  }
+
+  if (rx->observer.enabled) {
+    return process_observed_packet(rx, buf, received);
+  }
+
+  // Only accept packets sent directly to our host.
+  // We send broadcasts to servers to find them, but a server already knows
+  // our MAC address.  This way, we can safely run multiple servers on the
+  // same broadcast domain.
+  if (memcmp(eh->ether_dhost, rs->if_addr, ETH_ALEN)) {
+    return filtered(rx, buf, received, FLIGHT_DROP_NOT_FOR_US);
+  }
+
+  // Skip packets without our signature.
+  if (PACKET_SIGNATURE != ntohl(ph->signature)) {
+    return filtered(rx, buf, received, FLIGHT_DROP_SIGNATURE);
+  }
+
+  // Only accept packets sent to OUR session_id
+  // Allows me to test w/ multiple clients on the same host.
+  if (rs->session_id != ntohl(ph->session_id)) {
+    return filtered(rx, buf, received, FLIGHT_DROP_SESSION);
+  }
+
+  if (__atomic_load_n(&rx->dump_packets, __ATOMIC_RELAXED)) {
+    struct RxEvent ev = {.type = RX_EVENT_PACKET};
+    ev.packet.length = received;
+    memcpy(ev.packet.data, buf, MIN(received, sizeof(ev.packet.data)));
+    published += publish(rx, &ev);
+  }
+
+  switch (ntohs(ph->pkt_type)) {
+    case V1_STATUS_RESP:
+      published += process_status_resp(rx, rs, buf, received);
+      break;
+    case V1_STATS_RESP:
+      published += process_stats_resp(rx, rs, buf, received);
+      break;
+    case V1_VGA_TEXT:
+      published += process_incoming_video_text(rx, buf, received);
+      break;
+  }
+
+  return published;
+}
+
+int process_socket_io(struct RxThread *rx, struct RawSocket *rs) {
+  uint8_t buf[ETH_FRAME_LEN];
+  ssize_t received;
+
+  received = recvfrom(rs->sock_fd, buf, sizeof(buf), MSG_DONTWAIT, NULL, NULL);
+  if (received <= 0) {
+    return -1;
+  }
+
+  return process_packet(rx, rs, buf, received);
+}
+
+static void *rx_thread_main(void *arg) {
+  struct RxThread *rx = (struct RxThread *)arg;
+  struct pollfd fds[MAX_INTERFACES + 1];
+  const size_t stop = rx->socket_count;
+
+  for (size_t i = 0; i < rx->socket_count; ++i) {
+    fds[i].fd = rx->sockets[i].sock_fd;
+    fds[i].events = POLLIN;
+  }
+  fds[stop].fd = rx->stop_fd;
+  fds[stop].events = POLLIN;
+
+  // Carries on with poll() if the kernel turns the io_uring recv down.
+  if (rx->uring && !rx_uring_run(rx)) {
+    return NULL;
+  }
+
+  while (1) {
+    if (0 > poll(fds, stop + 1, -1)) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("poll()");
+      break;
+    }
+
+    if (fds[stop].revents) {
+      break;
+    }
+
+    // Drain everything the kernel has queued, then wake the UI once.
+    int published = 0;
+    for (size_t i = 0; i < stop; ++i) {
+      int r;
+      if (!fds[i].revents) {
+        continue;
+      }
+      while (0 <= (r = process_socket_io(rx, &rx->sockets[i]))) {
+        published += r;
+      }
+    }
+
+    if (published) {
+      eventfd_write(rx->notify_fd, 1);
+    }
+  }
+
+  return NULL;
+}
+
+int rx_thread_start(struct RxThread *rx, struct RawSocket *sockets,
+                    size_t socket_count) {
+  rx->sockets = sockets;
+  rx->socket_count = socket_count;
+  eventq_init(&rx->queue);
+
+  if (0 > (rx->stop_fd = eventfd(0, EFD_CLOEXEC))) {
+    perror("eventfd()");
+    return -1;
+  }
+
+  if (0 > (rx->notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))) {
+    perror("eventfd()");
+    close(rx->stop_fd);
+    return -1;
+  }
+
+  rx->uring = NULL;
+  if (rx->use_uring) {
+    const int err = rx_uring_open(rx);
+    if (err < 0) {
+      fprintf(stderr, "io_uring unavailable (%s), using poll()\n",
+              strerror(-err));
+    }
+  }
+
+  int r = pthread_create(&rx->thread, NULL, rx_thread_main, rx);
+  if (r) {
+    fprintf(stderr, "pthread_create(): %s\n", strerror(r));
+    rx_uring_close(rx);
+    close(rx->notify_fd);
+    close(rx->stop_fd);
+    return -1;
+  }
+
+  return 0;
+}
+
+void rx_thread_stop(struct RxThread *rx) {
+  eventfd_write(rx->stop_fd, 1);
+  pthread_join(rx->thread, NULL);
+  rx_uring_close(rx);
+
+  close(rx->notify_fd);
+  close(rx->stop_fd);
+  rx->notify_fd = rx->stop_fd = -1;
+}
+
+static void close_worker_sockets(struct RxThread *rx) {
+  for (size_t i = 0; i < MAX_INTERFACES; ++i) {
+    close_socket(&rx->worker_sockets[i]);
+  }
+}
+
+int rx_workers_start(struct RxThread **workers, size_t count) {
+  const struct RxThread *first = workers[0];
+  uint16_t group_ids[MAX_INTERFACES] = {0};
+
+  for (size_t i = 0; i < first->socket_count; ++i) {
+    if (0 > join_fanout(&first->sockets[i], &group_ids[i])) {
+      return -1;
+    }
+  }
+
+  for (size_t n = 1; n < count; ++n) {
+    struct RxThread *rx = (struct RxThread *)calloc(1, sizeof(*rx));
+    if (!rx) {
+      perror("calloc()");
+      return -1;
+    }
+
+    rx->observer = first->observer;
+    rx->dump_packets = first->dump_packets;
+    rx->use_uring = first->use_uring;
+    rx->flight = flightrec_ring_create();
+    for (size_t i = 0; i < MAX_INTERFACES; ++i) {
+      rx->worker_sockets[i].sock_fd = -1;
+    }
+
+    for (size_t i = 0; i < first->socket_count; ++i) {
+      const struct RawSocket *from = &first->sockets[i];
+      struct RawSocket *rs = &rx->worker_sockets[i];
+
+      if ((0 > create_socket(rs, from->if_name, from->ethertype)) ||
+          (0 > join_fanout(rs, &group_ids[i]))) {
+        close_worker_sockets(rx);
+        free(rx);
+        return -1;
+      }
+
+      // Frames for the first thread's session may reach any thread.
+      rs->session_id = from->session_id;
+    }
+
+    if (0 > rx_thread_start(rx, rx->worker_sockets, first->socket_count)) {
+      close_worker_sockets(rx);
+      free(rx);
+      return -1;
+    }
+    workers[n] = rx;
+  }
+
+  return 0;
+}
+
+void rx_workers_stop(struct RxThread **workers, size_t count) {
+  for (size_t n = 1; n < count; ++n) {
+    if (workers[n]) {
+      rx_thread_stop(workers[n]);
+      close_worker_sockets(workers[n]);
+      free(workers[n]);
+      workers[n] = NULL;
+    }
+  }
+}
+
+void rx_thread_ack(struct RxThread *rx) {
+  eventfd_t value;
+  eventfd_read(rx->notify_fd, &value);
+}
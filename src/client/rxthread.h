@@ -0,0 +1,125 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Network receive thread.
+//
+// Reads frames from the raw socket, filters and decodes them, and writes
+// screen contents directly into each `RemoteHost`.  Changes are published to
+// the UI thread through an `EventQueue`, and `notify_fd` (an eventfd) is
+// signalled so the UI thread can wait on it with epoll.  A slow terminal
+// therefore never delays reads from the socket.
+//
+// For very large fleets, collector mode (`rx_workers_start()`) runs several
+// network threads.  The kernel shares frames among them by source MAC
+// (PACKET_FANOUT), so each host's screen is only ever written by one thread,
+// and decoding scales across cores without locks.
+
+#ifndef __RMTDOS_CLIENT_RXTHREAD_H
+#define __RMTDOS_CLIENT_RXTHREAD_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "client/eventq.h"
+#include "client/flightrec.h"
+#include "client/network.h"
+
+// Passive observer mode.  Frames that a server sends to some other viewer
+// are sniffed (the interface is put in promiscuous mode), and nothing is
+// ever sent, so observing costs the server nothing.
+struct Observer {
+  // Non-zero if observing; then only frames matching below are accepted.
+  int enabled;
+
+  // Server being watched.
+  uint8_t server_addr[ETH_ALEN];
+
+  // Session being watched: viewer's MAC and its session id.  If not `pinned`,
+  // the first session seen is followed, and another is picked up once it
+  // has been silent for `OBSERVER_IDLE_US`.
+  int pinned;
+  int locked;
+  uint8_t viewer_addr[ETH_ALEN];
+  uint32_t session_id;
+
+  // Network thread only.  `time_now_us()` of last frame accepted.
+  uint64_t last_match_us;
+};
+
+// Matches the server's session lifetime (~10s).
+#define OBSERVER_IDLE_US 10000000ULL
+
+struct RxThread {
+  pthread_t thread;
+
+  // One per interface, all received from.
+  struct RawSocket *sockets;
+  size_t socket_count;
+
+  // eventfd; signalled by the UI thread to ask the network thread to exit.
+  int stop_fd;
+
+  // eventfd; signalled by the network thread after publishing events.
+  int notify_fd;
+
+  // Non-zero if RX_EVENT_PACKET copies should be published.
+  int dump_packets;
+
+  // Set before `rx_thread_start()`.
+  struct Observer observer;
+
+  // Set before `rx_thread_start()`: non-zero to receive with io_uring (see
+  // rxuring.h).  `uring` is NULL if it is not used.
+  int use_uring;
+  struct RxUring *uring;
+
+  // Flight recorder events go here; NULL is `g_flight_rx`.
+  struct FlightRing *flight;
+
+  // Collector mode, threads after the first: sockets opened for this thread
+  // (`sockets` points here), closed by `rx_workers_stop()`.
+  struct RawSocket worker_sockets[MAX_INTERFACES];
+
+  struct EventQueue queue;
+};
+
+// Returns 0 on success, <0 on error.
+extern int rx_thread_start(struct RxThread *rx, struct RawSocket *sockets,
+                           size_t socket_count);
+
+// Signals the thread to exit and waits for it.
+extern void rx_thread_stop(struct RxThread *rx);
+
+// Most network threads in collector mode.
+#define MAX_RX_WORKERS 16
+
+// Collector mode.  `workers[0]` must be running.  Starts `workers[1]` ..
+// `workers[count-1]`, each with a socket of its own on every interface of
+// `workers[0]`, and joins all of them in one PACKET_FANOUT group per
+// interface.  Options (`observer`, `dump_packets`, `use_uring`) are copied
+// from `workers[0]`.  Returns <0 on error.
+extern int rx_workers_start(struct RxThread **workers, size_t count);
+
+// Stops and frees `workers[1]` .. `workers[count-1]`.
+extern void rx_workers_stop(struct RxThread **workers, size_t count);
+
+// Called by the UI thread when `notify_fd` is readable.  Clears the wakeup.
+extern void rx_thread_ack(struct RxThread *rx);
+
+// Network thread: receives and processes one frame from `rs`.  Returns count
+// of events published, or <0 if the socket had no data.
+extern int process_socket_io(struct RxThread *rx, struct RawSocket *rs);
+
+// Network thread: filters and decodes one frame received on `rs`.  Returns
+// count of events published.
+extern int process_packet(struct RxThread *rx, struct RawSocket *rs,
+                          const uint8_t *buf, size_t received);
+
+// Network thread: applies a V1_VGA_TEXT frame to the sending host's screen.
+extern int process_incoming_video_text(struct RxThread *rx, const uint8_t *buf,
+                                       size_t received);
+
+#endif // __RMTDOS_CLIENT_RXTHREAD_H
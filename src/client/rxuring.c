@@ -0,0 +1,386 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "client/rxthread.h"
+#include "client/rxuring.h"
+
+#if defined(RMTDOS_NO_IO_URING)
+
+int rx_uring_open(struct RxThread *rx) { return -ENOSYS; }
+int rx_uring_run(struct RxThread *rx) { return -ENOSYS; }
+void rx_uring_close(struct RxThread *rx) {}
+
+#else
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Requests in flight: a recv per socket, and the stop poll.
+#define SQ_ENTRIES 16
+
+// Larger than any Ethernet frame.
+#define BUFFER_SIZE 2048
+
+#define BUFFER_GROUP 0
+#define BUFFER_MASK (RX_URING_BUFFERS - 1)
+
+// `user_data` of requests.  The recv on `rx->sockets[i]` is UD_RECV + i.
+enum {
+  UD_CANCEL = 0,
+  UD_STOP = 1,
+  UD_RECV = 2,
+};
+
+struct RxUring {
+  int fd;
+
+  void *sq_map;
+  size_t sq_map_len;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  size_t sqes_len;
+  unsigned to_submit;
+  unsigned armed; // Recvs and stop poll that have yet to end.
+
+  void *cq_map; // Same as `sq_map` with IORING_FEAT_SINGLE_MMAP.
+  size_t cq_map_len;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  // Buffers the kernel receives into, and the ring that lends them to it.
+  struct io_uring_buf_ring *buf_ring;
+  uint8_t *buffers;
+  uint16_t buf_tail; // Published to `buf_ring->tail` once per batch.
+};
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+  return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags) {
+  return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                 NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg,
+                                 unsigned nr_args) {
+  return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Returns a zeroed SQE, queued for the next `io_uring_enter()`.  There is
+// always room: at most SQ_ENTRIES requests are ever made between two.
+static struct io_uring_sqe *get_sqe(struct RxUring *u) {
+  const unsigned tail = *u->sq_tail;
+  const unsigned index = tail & *u->sq_mask;
+  struct io_uring_sqe *sqe = &u->sqes[index];
+
+  memset(sqe, 0, sizeof(*sqe));
+  u->sq_array[index] = index;
+  __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ++u->to_submit;
+  return sqe;
+}
+
+static void queue_recv(struct RxUring *u, const struct RxThread *rx,
+                       size_t socket) {
+  struct io_uring_sqe *sqe = get_sqe(u);
+
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = rx->sockets[socket].sock_fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = BUFFER_GROUP;
+  sqe->user_data = UD_RECV + socket;
+  ++u->armed;
+}
+
+static void queue_stop_poll(struct RxUring *u, int stop_fd) {
+  struct io_uring_sqe *sqe = get_sqe(u);
+
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = stop_fd;
+  sqe->poll32_events = POLLIN;
+  sqe->user_data = UD_STOP;
+  ++u->armed;
+}
+
+// Ends every request in flight.  Each still posts its last completion.
+static void queue_cancel_all(struct RxUring *u) {
+  struct io_uring_sqe *sqe = get_sqe(u);
+
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+  sqe->user_data = UD_CANCEL;
+}
+
+// Lends buffer `bid` to the kernel again (at the next `publish_buffers()`).
+static void recycle_buffer(struct RxUring *u, uint16_t bid) {
+  // Field by field: the ring's tail overlays `bufs[0].resv`.
+  struct io_uring_buf *buf = &u->buf_ring->bufs[u->buf_tail & BUFFER_MASK];
+
+  buf->addr = (uintptr_t)(u->buffers + (size_t)bid * BUFFER_SIZE);
+  buf->len = BUFFER_SIZE;
+  buf->bid = bid;
+  ++u->buf_tail;
+}
+
+static void publish_buffers(struct RxUring *u) {
+  __atomic_store_n(&u->buf_ring->tail, u->buf_tail, __ATOMIC_RELEASE);
+}
+
+static void *map_ring(int fd, size_t len, off_t offset) {
+  void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 fd, offset);
+  return (p == MAP_FAILED) ? NULL : p;
+}
+
+static void *map_anon(size_t len) {
+  void *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return (p == MAP_FAILED) ? NULL : p;
+}
+
+int rx_uring_open(struct RxThread *rx) {
+  struct io_uring_params p;
+  struct RxUring *u;
+  int err;
+
+  if (!(u = (struct RxUring *)calloc(1, sizeof(*u)))) {
+    return -ENOMEM;
+  }
+  rx->uring = u;
+
+  u->fd = -1;
+
+  memset(&p, 0, sizeof(p));
+  if (0 > (u->fd = sys_io_uring_setup(SQ_ENTRIES, &p))) {
+    err = -errno;
+    rx_uring_close(rx);
+    return err;
+  }
+
+  u->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  u->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (u->cq_map_len > u->sq_map_len) {
+      u->sq_map_len = u->cq_map_len;
+    }
+    u->cq_map_len = 0;
+  }
+
+  if (!(u->sq_map = map_ring(u->fd, u->sq_map_len, IORING_OFF_SQ_RING))) {
+    goto fail;
+  }
+  u->cq_map = u->cq_map_len
+                  ? map_ring(u->fd, u->cq_map_len, IORING_OFF_CQ_RING)
+                  : u->sq_map;
+  u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  u->sqes = (struct io_uring_sqe *)map_ring(u->fd, u->sqes_len,
+                                            IORING_OFF_SQES);
+  if (!u->cq_map || !u->sqes) {
+    goto fail;
+  }
+
+  u->sq_head = (unsigned *)((uint8_t *)u->sq_map + p.sq_off.head);
+  u->sq_tail = (unsigned *)((uint8_t *)u->sq_map + p.sq_off.tail);
+  u->sq_mask = (unsigned *)((uint8_t *)u->sq_map + p.sq_off.ring_mask);
+  u->sq_array = (unsigned *)((uint8_t *)u->sq_map + p.sq_off.array);
+  u->cq_head = (unsigned *)((uint8_t *)u->cq_map + p.cq_off.head);
+  u->cq_tail = (unsigned *)((uint8_t *)u->cq_map + p.cq_off.tail);
+  u->cq_mask = (unsigned *)((uint8_t *)u->cq_map + p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)((uint8_t *)u->cq_map + p.cq_off.cqes);
+
+  // Page aligned, as the kernel requires of the buffer ring.
+  u->buf_ring = (struct io_uring_buf_ring *)map_anon(
+      RX_URING_BUFFERS * sizeof(struct io_uring_buf));
+  u->buffers = (uint8_t *)map_anon(RX_URING_BUFFERS * BUFFER_SIZE);
+  if (!u->buf_ring || !u->buffers) {
+    goto fail;
+  }
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uintptr_t)u->buf_ring;
+  reg.ring_entries = RX_URING_BUFFERS;
+  reg.bgid = BUFFER_GROUP;
+  if (0 > sys_io_uring_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1)) {
+    goto fail;
+  }
+
+  for (int i = 0; i < RX_URING_BUFFERS; ++i) {
+    recycle_buffer(u, i);
+  }
+  publish_buffers(u);
+  return 0;
+
+fail:
+  err = -errno;
+  rx_uring_close(rx);
+  return err;
+}
+
+void rx_uring_close(struct RxThread *rx) {
+  struct RxUring *u = rx->uring;
+
+  if (!u) {
+    return;
+  }
+
+  if (u->buffers) {
+    munmap(u->buffers, RX_URING_BUFFERS * BUFFER_SIZE);
+  }
+  if (u->buf_ring) {
+    munmap(u->buf_ring, RX_URING_BUFFERS * sizeof(struct io_uring_buf));
+  }
+  if (u->sqes) {
+    munmap(u->sqes, u->sqes_len);
+  }
+  if (u->cq_map && (u->cq_map != u->sq_map)) {
+    munmap(u->cq_map, u->cq_map_len);
+  }
+  if (u->sq_map) {
+    munmap(u->sq_map, u->sq_map_len);
+  }
+  if (u->fd >= 0) {
+    close(u->fd);
+  }
+
+  free(u);
+  rx->uring = NULL;
+}
+
+// Submits what is queued, and waits for a completion.  Returns <0 on error.
+static int enter(struct RxUring *u) {
+  while (1) {
+    const int r =
+        sys_io_uring_enter(u->fd, u->to_submit, 1, IORING_ENTER_GETEVENTS);
+    if (r >= 0) {
+      u->to_submit -= r;
+      return 0;
+    }
+    if (errno != EINTR) {
+      perror("io_uring_enter()");
+      return -1;
+    }
+  }
+}
+
+// Processes every completion queued, and lends their buffers back to the
+// kernel.  Sets `rearm[i]` for recvs that ended but can be queued again,
+// `*stop` if the stop poll fired, and `*failed` if the kernel refused a recv.
+// Wakes the UI if any frame was published.
+static void reap(struct RxThread *rx, struct RxUring *u, int *rearm,
+                 int *stop, int *failed) {
+  unsigned head = *u->cq_head;
+  const unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+  int published = 0;
+
+  for (; head != tail; ++head) {
+    const struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+
+    if (cqe->user_data == UD_CANCEL) {
+      continue;
+    }
+
+    if (cqe->user_data == UD_STOP) {
+      --u->armed;
+      *stop = 1;
+      continue;
+    }
+
+    const size_t socket = cqe->user_data - UD_RECV;
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+      const uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+      if (cqe->res > 0) {
+        published += process_packet(rx, &rx->sockets[socket],
+                                    u->buffers + (size_t)bid * BUFFER_SIZE,
+                                    cqe->res);
+      }
+      recycle_buffer(u, bid);
+    }
+
+    // The recv ended: out of buffers (-ENOBUFS, we fell behind), cancelled,
+    // or not supported by this kernel.
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+      --u->armed;
+      if ((cqe->res == -EINVAL) || (cqe->res == -EOPNOTSUPP)) {
+        *failed = 1;
+      } else {
+        rearm[socket] = 1;
+      }
+    }
+  }
+
+  __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+  publish_buffers(u);
+
+  if (published) {
+    eventfd_write(rx->notify_fd, 1);
+  }
+}
+
+int rx_uring_run(struct RxThread *rx) {
+  struct RxUring *u = rx->uring;
+  int failed = 0;
+  int stop = 0;
+
+  for (size_t i = 0; i < rx->socket_count; ++i) {
+    queue_recv(u, rx, i);
+  }
+  queue_stop_poll(u, rx->stop_fd);
+
+  while (!stop && !failed) {
+    int rearm[MAX_INTERFACES] = {0};
+
+    if (0 > enter(u)) {
+      return -1;
+    }
+    reap(rx, u, rearm, &stop, &failed);
+
+    for (size_t i = 0; !stop && !failed && (i < rx->socket_count); ++i) {
+      if (rearm[i]) {
+        queue_recv(u, rx, i);
+      }
+    }
+  }
+
+  if (!failed) {
+    return 0;
+  }
+
+  // The other sockets' recvs and the stop poll are still armed.  End them
+  // all, keeping the frames that arrive meanwhile, so that nothing completes
+  // into the buffers once they are freed.
+  queue_cancel_all(u);
+  while (u->armed) {
+    int rearm[MAX_INTERFACES];
+
+    if (0 > enter(u)) {
+      return -1; // Left for `rx_thread_stop()` to close.
+    }
+    reap(rx, u, rearm, &stop, &failed);
+  }
+
+  rx_uring_close(rx);
+  return -1;
+}
+
+#endif // RMTDOS_NO_IO_URING
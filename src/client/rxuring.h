@@ -0,0 +1,35 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// io_uring receive loop for the network thread (`-U`).  A multishot recv on
+// each packet socket fills buffers from a ring registered with the kernel,
+// so a burst of frames costs one io_uring_enter() instead of a poll() and a
+// recvfrom() each.  Needs Linux 6.0 or later; `rx_thread_start()` falls
+// back to poll() without it.  Uses the raw system calls (no liburing).
+// Build with -DRMTDOS_NO_IO_URING to leave it out.
+
+#ifndef __RMTDOS_CLIENT_RXURING_H
+#define __RMTDOS_CLIENT_RXURING_H
+
+struct RxThread;
+
+// Frames buffered between two trips through the loop.  Must be a power of
+// 2.
+#define RX_URING_BUFFERS 256
+
+// Sets up `rx->uring`.  Returns 0 on success, or -errno if io_uring (or a
+// feature of it that is needed) is not available.
+extern int rx_uring_open(struct RxThread *rx);
+
+// Network thread.  Receives and processes frames until `rx->stop_fd` is
+// signalled (returns 0), or until the kernel refuses the multishot recv
+// (returns <0, so the caller can carry on with poll()).  By then every
+// request on the ring has ended, every frame it received has been published,
+// and the ring is closed.
+extern int rx_uring_run(struct RxThread *rx);
+
+extern void rx_uring_close(struct RxThread *rx);
+
+#endif // __RMTDOS_CLIENT_RXURING_H
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <arpa/inet.h>
+#include <sched.h>
+#include <string.h>
+
+#include "client/screen.h"
+
+int screen_update(struct Screen *s, const struct VideoText *video,
+                  const uint8_t *data) {
+  const uint16_t offset = ntohs(video->offset);
+  const uint16_t count = ntohs(video->count);
+
+  if (count + offset > sizeof(s->video_text_buffer)) {
+    return 0;
+  }
+
+  const uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  memcpy(s->video_text_buffer + offset, data, count);
+  s->text_rows = video->text_rows;
+  s->text_cols = video->text_cols;
+  s->cursor_row = video->cursor_row;
+  s->cursor_col = video->cursor_col;
+
+  __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+  return 1;
+}
+
+void screen_snapshot(const struct Screen *s, struct Screen *dest) {
+  uint32_t before, after;
+
+  do {
+    while ((before = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE)) & 1) {
+      sched_yield();
+    }
+
+    dest->text_rows = s->text_rows;
+    dest->text_cols = s->text_cols;
+    dest->cursor_row = s->cursor_row;
+    dest->cursor_col = s->cursor_col;
+
+    size_t bytes = SCREEN_BYTES(dest);
+    if (bytes > sizeof(dest->video_text_buffer)) {
+      bytes = sizeof(dest->video_text_buffer);
+    }
+    memcpy(dest->video_text_buffer, s->video_text_buffer, bytes);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(&s->seq, __ATOMIC_RELAXED);
+  } while (before != after);
+
+  dest->seq = before;
+}
+
+int screen_visible_rows(const struct Screen *s) {
+  if (!s->text_cols) {
+    return 0;
+  }
+
+  const int fit = SCREEN_BUFFER_SIZE / (s->text_cols * 2);
+  return (s->text_rows < fit) ? s->text_rows : fit;
+}
+
+size_t screen_text(const struct Screen *s, int row, int col, int count,
+                   char *dest) {
+  size_t len = 0;
+
+  if ((row >= 0) && (row < screen_visible_rows(s)) && (col >= 0)) {
+    const uint8_t *p =
+        s->video_text_buffer + ((size_t)row * s->text_cols + col) * 2;
+
+    for (; (count > 0) && (col < s->text_cols); --count, ++col, p += 2) {
+      const char *glyph = g_cp437_table[p[0]];
+      const size_t n = strnlen(glyph, CP437_WIDTH);
+
+      memcpy(dest + len, glyph, n);
+      len += n;
+    }
+  }
+
+  dest[len] = 0;
+  return len;
+}
+
+int screen_find_text(const struct Screen *s, int row, const char *text) {
+  const int rows = screen_visible_rows(s);
+  char line[SCREEN_ROW_TEXT_MAX + 1];
+
+  for (int r = (row < 0) ? 0 : row; r < rows; ++r) {
+    screen_text(s, r, 0, s->text_cols, line);
+    if (strstr(line, text)) {
+      return r;
+    }
+    if (row >= 0) {
+      break;
+    }
+  }
+  return -1;
+}
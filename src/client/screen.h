@@ -0,0 +1,66 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Copy of a remote host's VGA text screen.
+//
+// The network thread is the only writer.  Any other thread must read via
+// `screen_snapshot()`, which uses the sequence counter to retry until it has
+// a copy that was not torn by a concurrent update.
+
+#ifndef __RMTDOS_CLIENT_SCREEN_H
+#define __RMTDOS_CLIENT_SCREEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/protocol.h"
+#include "liblinux/cp437.h"
+
+// VGA text buffer is from $000b8000 to $000bffff (32KiB).
+#define SCREEN_BUFFER_SIZE 32768
+
+struct Screen {
+  // Sequence lock.  Odd while the writer is updating the screen.
+  uint32_t seq;
+
+  // Last known VGA text mode resolution and cursor position.
+  uint8_t text_rows;
+  uint8_t text_cols;
+  uint8_t cursor_row;
+  uint8_t cursor_col;
+
+  // Raw VGA text buffer, as sent from server in V1_VGA_TEXT packets.
+  uint8_t video_text_buffer[SCREEN_BUFFER_SIZE];
+};
+
+// Returns count of bytes of `video_text_buffer` that are on screen.
+#define SCREEN_BYTES(s) ((size_t)(s)->text_rows * (s)->text_cols * 2)
+
+// Longest text of one row, in UTF-8, not counting the NUL.
+#define SCREEN_ROW_TEXT_MAX (255 * CP437_WIDTH)
+
+// Writer side.  Applies one V1_VGA_TEXT payload.  Returns 0 if the update
+// does not fit in the buffer (and was ignored).
+extern int screen_update(struct Screen *s, const struct VideoText *video,
+                         const uint8_t *data);
+
+// Reader side.  Copies the geometry and the visible part of the text buffer
+// into `dest`.
+extern void screen_snapshot(const struct Screen *s, struct Screen *dest);
+
+// Count of rows of a snapshot that are in the text buffer.
+extern int screen_visible_rows(const struct Screen *s);
+
+// Writes `count` columns of `row` of a snapshot, from `col`, into `dest`
+// (SCREEN_ROW_TEXT_MAX + 1 bytes) as UTF-8, via `g_cp437_table`.  Columns
+// past the edge are left out.  Returns the length.
+extern size_t screen_text(const struct Screen *s, int row, int col, int count,
+                          char *dest);
+
+// Returns the first row of a snapshot (or `row` only, if >= 0) that
+// contains the UTF-8 `text`, or -1.
+extern int screen_find_text(const struct Screen *s, int row, const char *text);
+
+#endif // __RMTDOS_CLIENT_SCREEN_H
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <ncurses.h>
+#include <string.h>
+
+#include "client/curses.h"
+#include "client/globals.h"
+#include "client/session.h"
+#include "client/wall.h"
+
+// Recently used hosts, most recent first.  Includes `g_active_host`.
+static struct RemoteHost *g_recent[SESSION_MAX_BACKGROUND + 1];
+static int g_recent_count = 0;
+static int g_background_limit = SESSION_DEFAULT_BACKGROUND;
+
+static void keepalive_fire(struct Timer *timer) {
+  struct RemoteHost *rh = (struct RemoteHost *)timer->arg;
+
+  // Sessions that ended just lapse.
+  if (!rh->window && !rh->tile && !rh->background) {
+    return;
+  }
+
+  send_session_start(host_socket(rh), rh->if_addr);
+  timer_schedule(timer, (rh->window || rh->tile)
+                            ? SESSION_KEEPALIVE_MS
+                            : SESSION_BACKGROUND_KEEPALIVE_MS);
+}
+
+void session_keepalive_now(struct RemoteHost *rh) {
+  if (!host_socket(rh) || g_observer_mode) {
+    return;
+  }
+
+  timer_init(&rh->keepalive, keepalive_fire, rh);
+  timer_schedule(&rh->keepalive, 0);
+}
+
+void session_set_background_limit(int limit) {
+  if (limit < 0) {
+    limit = 0;
+  }
+  g_background_limit =
+      limit < SESSION_MAX_BACKGROUND ? limit : SESSION_MAX_BACKGROUND;
+}
+
+// Marks every recent host, other than the active one, as a background
+// session.  Hosts beyond the limit are dropped, and their sessions lapse.
+static void recent_trim() {
+  int background = 0;
+  int kept = 0;
+
+  for (int i = 0; i < g_recent_count; ++i) {
+    struct RemoteHost *rh = g_recent[i];
+
+    if (rh == g_active_host) {
+      rh->background = 0;
+    } else if (background < g_background_limit) {
+      rh->background = 1;
+      ++background;
+    } else {
+      rh->background = 0;
+      continue;
+    }
+
+    g_recent[kept++] = rh;
+  }
+
+  g_recent_count = kept;
+}
+
+// Moves `rh` to the front of `g_recent`.
+static void recent_touch(struct RemoteHost *rh) {
+  int i;
+  for (i = 0; (i < g_recent_count) && (g_recent[i] != rh); ++i) {
+  }
+
+  if (i == g_recent_count) {
+    if (g_recent_count == SESSION_MAX_BACKGROUND + 1) {
+      // Full; the oldest entry falls off.
+      g_recent[--i]->background = 0;
+    } else {
+      ++g_recent_count;
+    }
+  }
+
+  memmove(&g_recent[1], &g_recent[0], i * sizeof(g_recent[0]));
+  g_recent[0] = rh;
+}
+
+void session_activate(struct RemoteHost *rh) {
+  if (wall_is_active()) {
+    wall_close();
+  }
+
+  if (g_active_host && (g_active_host != rh)) {
+    g_active_host->window = NULL;
+  }
+
+  g_active_host = rh;
+  recent_touch(rh);
+  recent_trim();
+
+  rh->window = g_session_window;
+  rh->text_rows = rh->text_cols = 0;
+  wclear(rh->window);
+
+  // Refresh the session now, rather than at the next keepalive.
+  session_keepalive_now(rh);
+
+  const struct Screen *screen = host_attach_screen(rh);
+  if (__atomic_load_n(&screen->text_cols, __ATOMIC_RELAXED)) {
+    // Background session; the screen is already current.
+    update_session_window(rh, 0, SCREEN_BUFFER_SIZE);
+    update_hud(rh);
+  } else {
+    mvwprintw(rh->window, 0, 0, "Connecting...");
+  }
+}
+
+void session_switch_previous() {
+  for (int i = 0; i < g_recent_count; ++i) {
+    if (g_recent[i] != g_active_host) {
+      session_activate(g_recent[i]);
+      return;
+    }
+  }
+}
+
+void session_pin(struct RemoteHost *rh) {
+  rh->background = 1;
+  session_keepalive_now(rh);
+}
+
+void session_unpin(struct RemoteHost *rh) {
+  rh->background = 0;
+}
+
+void session_detach() {
+  if (!g_active_host) {
+    return;
+  }
+
+  g_active_host->window = NULL;
+  g_active_host = NULL;
+  recent_trim();
+}
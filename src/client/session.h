@@ -0,0 +1,61 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Remote control sessions.
+//
+// The host under control is `g_active_host`.  Sessions to recently used
+// hosts are kept alive in the background (at a slower keepalive rate), and
+// the network thread keeps storing their screens, so switching back to one
+// shows a current screen at once instead of waiting for the server to send
+// a full frame.
+
+#ifndef __RMTDOS_CLIENT_SESSION_H
+#define __RMTDOS_CLIENT_SESSION_H
+
+#include "client/hostlist.h"
+#include "client/network.h"
+
+// Default count of background sessions.
+#define SESSION_DEFAULT_BACKGROUND 4
+
+// Maximum count of background sessions.
+#define SESSION_MAX_BACKGROUND 32
+
+// How often to send V1_SESSION_START to a host that is shown (session window
+// or wall tile), and to one in the background.  Both must be well under the
+// server's session lifetime (~10s).
+#define SESSION_KEEPALIVE_MS 2000
+#define SESSION_BACKGROUND_KEEPALIVE_MS 5000
+
+// Sends V1_SESSION_START to `rh` at the next `timers_run()`, and then every
+// keepalive interval for as long as the host is in a session.  Goes out on
+// the socket the host was heard on; nothing is sent to a host never heard
+// from, nor in observer mode.
+extern void session_keepalive_now(struct RemoteHost *rh);
+
+// Sets how many background sessions to keep (clamped to
+// SESSION_MAX_BACKGROUND).  Call before any session is started.
+extern void session_set_background_limit(int limit);
+
+// Puts `rh` under remote control.  The previously controlled host, if any,
+// becomes a background session.
+extern void session_activate(struct RemoteHost *rh);
+
+// Switches to the most recently used background session.  Does nothing if
+// there is none.
+extern void session_switch_previous();
+
+// Leaves remote control (back to the menu).  The session to the host is
+// kept in the background.
+extern void session_detach();
+
+// Headless modes: keeps a background session to `rh` until
+// `session_unpin()`.  Not counted against the background limit.
+extern void session_pin(struct RemoteHost *rh);
+
+// Lets the session pinned to `rh` lapse.
+extern void session_unpin(struct RemoteHost *rh);
+
+#endif // __RMTDOS_CLIENT_SESSION_H
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "client/shmstore.h"
+#include "client/util.h"
+
+// Slots start on a cache line, so two hosts' writers never share one.
+#define ALIGN 64
+#define ROUND_UP(n) (((n) + ALIGN - 1) & ~(size_t)(ALIGN - 1))
+
+static struct ShmStoreHeader *g_header = NULL;
+static size_t g_map_len = 0;
+
+static struct ShmStoreSlot *slot(size_t i) {
+  return (struct ShmStoreSlot *)((uint8_t *)g_header + g_header->header_size +
+                                 i * g_header->slot_size);
+}
+
+// Returns the pid of the daemon still running on the store at `path`, or 0.
+static pid_t running_pid(const char *path) {
+  struct ShmStoreHeader header;
+  int fd;
+
+  if (0 > (fd = open(path, O_RDONLY | O_CLOEXEC))) {
+    return 0;
+  }
+  const ssize_t n = pread(fd, &header, sizeof(header), 0);
+  close(fd);
+
+  if ((n != sizeof(header)) ||
+      memcmp(header.magic, SHMSTORE_MAGIC, sizeof(header.magic)) ||
+      !header.pid) {
+    return 0;
+  }
+
+  // EPERM: alive, but someone else's.
+  const pid_t pid = header.pid;
+  return ((0 == kill(pid, 0)) || (errno == EPERM)) ? pid : 0;
+}
+
+int shmstore_open(const char *path, size_t slot_count) {
+  const size_t header_size = ROUND_UP(sizeof(struct ShmStoreHeader));
+  const size_t slot_size = ROUND_UP(sizeof(struct ShmStoreSlot));
+  pid_t pid;
+  int fd;
+
+  if ((pid = running_pid(path))) {
+    fprintf(stderr, "%s: in use by process %d\n", path, (int)pid);
+    return -1;
+  }
+
+  // Built beside `path`, then renamed over it: readers of an earlier store
+  // keep their (whole) file, and new readers never see a partial one.
+  char *tmp_path = (char *)malloc(strlen(path) + 32);
+  sprintf(tmp_path, "%s.tmp.%d", path, (int)getpid());
+
+  g_map_len = header_size + slot_count * slot_size;
+
+  unlink(tmp_path);
+  if (0 > (fd = open(tmp_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644))) {
+    perror(tmp_path);
+    free(tmp_path);
+    return -1;
+  }
+
+  // Sparse: only the slots that are used take memory.
+  if (0 > ftruncate(fd, g_map_len)) {
+    perror("ftruncate()");
+    goto fail;
+  }
+
+  void *p = mmap(NULL, g_map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    perror("mmap()");
+    goto fail;
+  }
+  close(fd);
+
+  g_header = (struct ShmStoreHeader *)p;
+  g_header->version = SHMSTORE_VERSION;
+  g_header->header_size = header_size;
+  g_header->slot_size = slot_size;
+  g_header->slot_count = slot_count;
+  g_header->pid = getpid();
+  g_header->heartbeat_us = time_now_us();
+
+  // Last, so that a reader that sees it sees the rest.
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(g_header->magic, SHMSTORE_MAGIC, sizeof(g_header->magic));
+
+  if (0 > rename(tmp_path, path)) {
+    perror(path);
+    munmap(g_header, g_map_len);
+    g_header = NULL;
+    unlink(tmp_path);
+    free(tmp_path);
+    return -1;
+  }
+
+  free(tmp_path);
+  return 0;
+
+fail:
+  close(fd);
+  unlink(tmp_path);
+  free(tmp_path);
+  return -1;
+}
+
+void shmstore_close() {
+  if (!g_header) {
+    return;
+  }
+
+  __atomic_store_n(&g_header->pid, 0, __ATOMIC_RELEASE);
+  munmap(g_header, g_map_len);
+  g_header = NULL;
+}
+
+struct Screen *shmstore_attach(struct RemoteHost *rh) {
+  const uint32_t used = g_header->slots_used;
+
+  if ((used == g_header->slot_count) || host_screen(rh)) {
+    return NULL;
+  }
+
+  struct ShmStoreSlot *s = slot(used);
+  memcpy(s->if_addr, rh->if_addr, ETH_ALEN);
+  s->index = rh->index;
+
+  __atomic_store_n(&g_header->slots_used, used + 1, __ATOMIC_RELEASE);
+  return host_attach_screen_at(rh, &s->screen);
+}
+
+void shmstore_heartbeat() {
+  __atomic_store_n(&g_header->heartbeat_us, time_now_us(), __ATOMIC_RELAXED);
+}
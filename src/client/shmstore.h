@@ -0,0 +1,78 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Screen store: the screens of the daemon's hosts (see "client/daemon.h"),
+// published in a file that local tools map read-only (normally on tmpfs,
+// e.g. /dev/shm/rmtdos).  The network threads decode V1_VGA_TEXT straight
+// into it, so any number of readers see live screens with no copies, and
+// without a session (or any traffic) of their own.
+//
+// Layout: a `struct ShmStoreHeader`, then `slot_count` slots of `slot_size`
+// bytes each, from offset `header_size`.  Slots below `slots_used` are valid,
+// and are never reused.  All integers are in host byte order.
+//
+// Each slot's `screen.seq` is a sequence lock, and doubles as a generation
+// counter: it is odd while the screen is being written, and goes up by 2 per
+// update.  To read: load `seq` (acquire) and retry while it is odd; read what
+// is needed; then load `seq` again (after an acquire fence), and retry if it
+// changed.  A reader that sees the same even `seq` as last time has nothing
+// new to read.  `screen_snapshot()` does this.
+
+#ifndef __RMTDOS_CLIENT_SHMSTORE_H
+#define __RMTDOS_CLIENT_SHMSTORE_H
+
+#include <linux/if_ether.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "client/hostlist.h"
+#include "client/screen.h"
+
+#define SHMSTORE_MAGIC "RMTDOSSS"
+#define SHMSTORE_VERSION 1
+
+struct ShmStoreHeader {
+  char magic[8]; // SHMSTORE_MAGIC, not NUL terminated.
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t slot_size;
+  uint32_t slot_count;
+
+  // Slots in use.  Stored (release) after the slot is filled in.
+  uint32_t slots_used;
+
+  // Daemon's process id, 0 once it has exited.
+  uint32_t pid;
+
+  // `time_now_us()` (wall clock), rewritten every second while the daemon
+  // runs.
+  uint64_t heartbeat_us;
+};
+
+struct ShmStoreSlot {
+  uint8_t if_addr[ETH_ALEN];
+  uint16_t index; // `RemoteHost.index`, as in the client's menu.
+  uint32_t reserved;
+  struct Screen screen;
+};
+
+// Creates the store at `path`, with room for `slot_count` hosts.  A store
+// left by an earlier daemon is replaced, not overwritten, so its readers are
+// unharmed.  Fails if the daemon that made it is still running.  Returns <0
+// on error.
+extern int shmstore_open(const char *path, size_t slot_count);
+
+// Marks the store as no longer updated, and unmaps it.  The file is kept for
+// readers that still have it mapped.
+extern void shmstore_close();
+
+// UI thread only.  Gives `rh` a slot, and makes its screen the one in the
+// slot.  Returns NULL if the store is full (or `rh` already has a screen).
+extern struct Screen *shmstore_attach(struct RemoteHost *rh);
+
+// Rewrites `heartbeat_us`.
+extern void shmstore_heartbeat();
+
+#endif // __RMTDOS_CLIENT_SHMSTORE_H
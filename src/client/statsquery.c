@@ -0,0 +1,73 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <poll.h>
+#include <stdio.h>
+
+#include "client/hostlist.h"
+#include "client/statsquery.h"
+#include "client/util.h"
+
+static void print_stats(const struct RemoteHost *rh) {
+  const struct StatsResponse *st = &rh->stats;
+  char tmp[MAC_ADDR_FMT_LEN];
+
+  printf("%s  int08 %u  int2f %u  sessions %u\n",
+         fmt_mac_addr(tmp, sizeof(tmp), rh->if_addr), st->int08_ticks,
+         st->int2f_ticks, st->sessions_active);
+  printf("  packets  recv %u  dropped %u  sent %u  send-errors %u\n",
+         st->packets_recv, st->packets_dropped, st->packets_sent,
+         st->send_errors);
+  if (st->flags & STATS_HAS_DRIVER) {
+    printf("  driver   in %u (%u bytes, %u errors)  out %u (%u bytes, %u "
+           "errors)  lost %u\n",
+           st->drv_packets_in, st->drv_bytes_in, st->drv_errors_in,
+           st->drv_packets_out, st->drv_bytes_out, st->drv_errors_out,
+           st->drv_packets_lost);
+  } else {
+    printf("  driver   no get_statistics()\n");
+  }
+  printf("  buffers  %u total, %u free, %u ready, fewest free %u\n",
+         st->buffers_total, st->buffers_free, st->buffers_ready,
+         st->buffers_min_free);
+  printf("  stacks   int08 %u/%u  int2f %u/%u  pktdrv %u/%u bytes used\n",
+         st->int08_stack_used, st->int08_stack_size, st->int2f_stack_used,
+         st->int2f_stack_size, st->pktdrv_stack_used, st->pktdrv_stack_size);
+}
+
+int stats_query_run(struct RxThread *rx, const uint8_t *dest_addr,
+                    unsigned wait_ms) {
+  struct pollfd pfd = {.fd = rx->notify_fd, .events = POLLIN};
+  const uint64_t end_us = time_now_us() + wait_ms * 1000ULL;
+  uint64_t now;
+  int answers = 0;
+  struct RxEvent ev;
+
+  for (size_t i = 0; i < rx->socket_count; ++i) {
+    send_stats_req(&rx->sockets[i], dest_addr);
+  }
+
+  while ((now = time_now_us()) < end_us) {
+    if (0 >= poll(&pfd, 1, (end_us - now + 999) / 1000)) {
+      continue;
+    }
+
+    rx_thread_ack(rx);
+    while (eventq_pop(&rx->queue, &ev)) {
+      // Servers answer once; a repeat can only be a stray, so print the
+      // first.
+      if ((ev.type != RX_EVENT_STATS) || ev.host->stats_us) {
+        continue;
+      }
+      ++answers;
+      ev.host->stats = ev.stats;
+      ev.host->stats_us = now;
+      print_stats(ev.host);
+    }
+  }
+
+  fflush(stdout);
+  return answers;
+}
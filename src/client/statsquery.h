@@ -0,0 +1,27 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Runtime counters of servers ("rmtdos-client -S").  Runs headless: sends
+// one V1_STATS_REQ, to one server or to broadcast, and prints each
+// V1_STATS_RESP that arrives.  Cheap enough to poll a fleet from cron.
+
+#ifndef __RMTDOS_CLIENT_STATSQUERY_H
+#define __RMTDOS_CLIENT_STATSQUERY_H
+
+#include <stdint.h>
+
+#include "client/network.h"
+#include "client/rxthread.h"
+
+// How long to wait for answers.
+#define STATS_QUERY_WAIT_MS 1000
+
+// Asks `dest_addr` (may be the broadcast address) for its counters, on every
+// interface of `rx`, and prints the answers received in `wait_ms`.  `rx` must
+// be running.  Returns the count of servers that answered.
+extern int stats_query_run(struct RxThread *rx, const uint8_t *dest_addr,
+                           unsigned wait_ms);
+
+#endif // __RMTDOS_CLIENT_STATSQUERY_H
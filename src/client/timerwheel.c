@@ -0,0 +1,174 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client/timerwheel.h"
+
+#define MASK (TIMER_WHEEL_SLOTS - 1)
+
+static struct Timer *g_slots[TIMER_WHEEL_SLOTS];
+static int g_timer_fd = -1;
+
+// Next tick that `timers_run()` will look at.  Every tick before it is done.
+static uint64_t g_next_tick = 0;
+
+// Non-zero inside `timers_run()`, which arms the timerfd once at the end.
+static int g_in_run = 0;
+
+static uint64_t now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Tick N covers [N, N+1) * TIMER_TICK_MS.
+static uint64_t now_tick() { return now_ms() / TIMER_TICK_MS; }
+
+static void unlink_timer(struct Timer *t) {
+  if (t->next) {
+    t->next->pprev = t->pprev;
+  }
+  *t->pprev = t->next;
+  t->next = NULL;
+  t->pprev = NULL;
+}
+
+static void link_timer(struct Timer *t) {
+  // A tick that is already done would not be looked at for a whole turn.
+  // Inside `timers_run()`, neither would the one being done.
+  const uint64_t first = g_next_tick + g_in_run;
+  const uint64_t tick = (t->due_tick < first) ? first : t->due_tick;
+  struct Timer **head = &g_slots[tick & MASK];
+
+  t->next = *head;
+  t->pprev = head;
+  if (*head) {
+    (*head)->pprev = &t->next;
+  }
+  *head = t;
+}
+
+// Arms the timerfd for the first non-empty slot, or disarms it.  A slot may
+// only hold timers for a later turn, which costs one wakeup that fires
+// nothing.
+static void arm() {
+  struct itimerspec its;
+  uint64_t tick;
+
+  memset(&its, 0, sizeof(its));
+  for (tick = g_next_tick; tick < g_next_tick + TIMER_WHEEL_SLOTS; ++tick) {
+    if (g_slots[tick & MASK]) {
+      const uint64_t ms = tick * TIMER_TICK_MS;
+      its.it_value.tv_sec = ms / 1000;
+      its.it_value.tv_nsec = (ms % 1000) * 1000000;
+
+      // Zero would disarm; the start of the clock is long past anyway.
+      if (!its.it_value.tv_sec && !its.it_value.tv_nsec) {
+        its.it_value.tv_nsec = 1;
+      }
+      break;
+    }
+  }
+
+  if (0 > timerfd_settime(g_timer_fd, TFD_TIMER_ABSTIME, &its, NULL)) {
+    perror("timerfd_settime()");
+  }
+}
+
+int timers_init() {
+  if (0 > (g_timer_fd = timerfd_create(CLOCK_MONOTONIC,
+                                       TFD_NONBLOCK | TFD_CLOEXEC))) {
+    perror("timerfd_create()");
+    return -1;
+  }
+
+  g_next_tick = now_tick();
+  return g_timer_fd;
+}
+
+void timers_close() {
+  if (g_timer_fd >= 0) {
+    close(g_timer_fd);
+    g_timer_fd = -1;
+  }
+  memset(g_slots, 0, sizeof(g_slots));
+}
+
+void timer_init(struct Timer *timer, TimerFunc func, void *arg) {
+  timer->func = func;
+  timer->arg = arg;
+}
+
+void timer_schedule(struct Timer *timer, uint64_t delay_ms) {
+  if (timer->pprev) {
+    unlink_timer(timer);
+  }
+
+  // Rounded up, so a timer is never early.
+  timer->due_tick = (now_ms() + delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+  link_timer(timer);
+
+  if (!g_in_run) {
+    arm();
+  }
+}
+
+void timer_cancel(struct Timer *timer) {
+  if (timer->pprev) {
+    unlink_timer(timer);
+  }
+}
+
+int timer_is_scheduled(const struct Timer *timer) {
+  return NULL != timer->pprev;
+}
+
+void timers_run() {
+  const uint64_t now = now_tick();
+  uint64_t expirations;
+
+  // Only clears readability; the wheel knows what is due.
+  if (0 > read(g_timer_fd, &expirations, sizeof(expirations))) {
+    expirations = 0;
+  }
+
+  // After a long stall (or suspend), one turn visits every slot.
+  if (now >= g_next_tick + TIMER_WHEEL_SLOTS) {
+    g_next_tick = now - TIMER_WHEEL_SLOTS + 1;
+  }
+
+  g_in_run = 1;
+  for (; g_next_tick <= now; ++g_next_tick) {
+    struct Timer **head = &g_slots[g_next_tick & MASK];
+    struct Timer *list = *head;
+
+    // Detach the slot first, so that timers rescheduled by `func` (into any
+    // slot, this one included) are not visited again in this pass.
+    *head = NULL;
+    if (list) {
+      list->pprev = &list;
+    }
+
+    while (list) {
+      struct Timer *t = list;
+      unlink_timer(t);
+
+      if (t->due_tick > now) {
+        // Due on a later turn of the wheel.
+        link_timer(t);
+      } else {
+        t->func(t);
+      }
+    }
+  }
+  g_in_run = 0;
+
+  arm();
+}
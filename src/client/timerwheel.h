@@ -0,0 +1,61 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Hashed timer wheel for the UI thread's periodic work (probes, session
+// keepalives, HUD refresh).  Timers are kept in TIMER_WHEEL_SLOTS lists,
+// hashed by their due tick, and one timerfd is armed for the next non-empty
+// slot.  So a wakeup only looks at the timers that are due, and there is no
+// wakeup at all when nothing is.
+//
+// Timers are embedded in their owners (no allocation), and are not thread
+// safe: UI thread only.
+
+#ifndef __RMTDOS_CLIENT_TIMERWHEEL_H
+#define __RMTDOS_CLIENT_TIMERWHEEL_H
+
+#include <stdint.h>
+
+// Resolution.  Timers fire up to one tick late, never early.
+#define TIMER_TICK_MS 100
+
+// Must be a power of 2.  Timers further out than one turn of the wheel
+// (TIMER_TICK_MS * TIMER_WHEEL_SLOTS) wait in their slot for later turns.
+#define TIMER_WHEEL_SLOTS 128
+
+struct Timer;
+
+typedef void (*TimerFunc)(struct Timer *timer);
+
+struct Timer {
+  struct Timer *next;
+  struct Timer **pprev; // NULL if not scheduled.
+  uint64_t due_tick;
+  TimerFunc func;
+  void *arg; // For `func`.
+};
+
+// Returns the timerfd to wait on (readable when timers are due), or <0 on
+// error.
+extern int timers_init();
+
+extern void timers_close();
+
+// Sets what `timer` calls when it fires.  Zeroed memory is a valid, idle
+// timer, so this may be called any time before `timer_schedule()`.
+extern void timer_init(struct Timer *timer, TimerFunc func, void *arg);
+
+// Fires `timer` once, `delay_ms` from now (0: at the next `timers_run()`).
+// Reschedules it if already scheduled.  Safe to call from a timer's `func`,
+// including its own.
+extern void timer_schedule(struct Timer *timer, uint64_t delay_ms);
+
+extern void timer_cancel(struct Timer *timer);
+
+extern int timer_is_scheduled(const struct Timer *timer);
+
+// Call when the timerfd is readable.  Fires every timer that is due.
+extern void timers_run();
+
+#endif // __RMTDOS_CLIENT_TIMERWHEEL_H
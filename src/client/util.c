@@ -3,7 +3,10 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 
+#include <linux/if_ether.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
 
 #include "client/util.h"
 
@@ -12,3 +15,51 @@ char *fmt_mac_addr(char *dest, size_t max_len, const uint8_t *mac_addr) {
            mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
   return dest;
 }
+
+int parse_mac_addr(const char *text, uint8_t *mac_addr) {
+  int mac[ETH_ALEN];
+
+  if (ETH_ALEN != sscanf(text, "%02x:%02x:%02x:%02x:%02x:%02x", &mac[0],
+                         &mac[1], &mac[2], &mac[3], &mac[4], &mac[5])) {
+    return 0;
+  }
+  for (int i = 0; i < ETH_ALEN; i++) {
+    mac_addr[i] = mac[i];
+  }
+  return 1;
+}
+
+char *split_word(char **p) {
+  char *w = *p;
+
+  while (*w == ' ') {
+    ++w;
+  }
+  if (!*w) {
+    return NULL;
+  }
+
+  char *end = strchr(w, ' ');
+  if (end) {
+    *end = 0;
+    *p = end + 1;
+  } else {
+    *p = w + strlen(w);
+  }
+  return w;
+}
+
+uint64_t time_now_us() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+char *fmt_elapsed(char *dest, size_t max_len, uint64_t since_us) {
+  const uint64_t now = time_now_us();
+  const uint64_t delta = (now > since_us) ? now - since_us : 0;
+
+  snprintf(dest, max_len, "%lu.%06lu", (unsigned long)(delta / 1000000),
+           (unsigned long)(delta % 1000000));
+  return dest;
+}
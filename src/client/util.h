@@ -16,4 +16,17 @@
 
 extern char *fmt_mac_addr(char *dest, size_t max_len, const uint8_t *mac_addr);
 
+// Returns 0 if `text` is not a MAC address (xx:xx:xx:xx:xx:xx).
+extern int parse_mac_addr(const char *text, uint8_t *mac_addr);
+
+// Splits the next space separated word off `*p`, and moves `*p` past it
+// (and one space).  Returns NULL if there is none.
+extern char *split_word(char **p);
+
+// Wall clock time, in microseconds since the epoch.
+extern uint64_t time_now_us();
+
+// Formats the time elapsed since `since_us` as "seconds.micros".
+extern char *fmt_elapsed(char *dest, size_t max_len, uint64_t since_us);
+
 #endif // __RMTDOS_CLIENT_UTIL_H_
@@ -0,0 +1,332 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <ncurses.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "client/curses.h"
+#include "client/menu.h"
+#include "client/screen.h"
+#include "client/session.h"
+#include "client/util.h"
+#include "client/wall.h"
+
+#define MIN(x, y) ((x) > (y) ? (y) : (x))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+// Tile plus its title line and a one column gutter.
+#define TILE_PITCH_Y (WALL_TILE_ROWS + 1)
+#define TILE_PITCH_X (WALL_TILE_COLS + 1)
+
+// A pixel is lit if its source cells average at least this much ink.
+#define INK_THRESHOLD 1
+
+// Quadrant glyphs, indexed by lit pixels:
+// 1 = upper left, 2 = upper right, 4 = lower left, 8 = lower right.
+static const char *quadrants[16] = {
+    " ",      "\u2598", "\u259d", "\u2580", "\u2596", "\u258c",
+    "\u259e", "\u259b", "\u2597", "\u259a", "\u2590", "\u259c",
+    "\u2584", "\u2599", "\u259f", "\u2588",
+};
+
+static struct WallTile g_tiles[WALL_MAX_TILES];
+static int g_tile_count = 0;
+static int g_tiles_per_row = 1;
+static int g_focus = 0;
+static int g_active = 0;
+
+// Consistent copy of the screen being drawn.
+static struct Screen g_snapshot;
+
+// Rough fraction of a CP437 glyph that is ink, in quarters.
+static int glyph_ink(uint8_t ch) {
+  switch (ch) {
+    case 0x00:
+    case ' ':
+    case 0xff:
+      return 0;
+    case 0xb0: // Light shade.
+      return 1;
+    case 0xb1: // Medium shade.
+      return 2;
+    case 0xb2: // Dark shade.
+      return 3;
+    case 0xdb: // Full block.
+      return 4;
+    case '.':
+    case ',':
+    case '\'':
+    case '`':
+    case ':':
+    case ';':
+    case '-':
+    case '_':
+    case '"':
+    case 0xf9: // Bullets.
+    case 0xfa:
+      return 1;
+  }
+
+  // Box drawing is thin, but should still show up as lines.
+  if ((ch >= 0xb3) && (ch <= 0xda)) {
+    return 1;
+  }
+
+  return 2;
+}
+
+// Source cells [*lo, *hi) covered by pixel `p` of `pixels`, when `cells`
+// source cells are spread over them.  Never empty.
+static void pixel_span(int p, int pixels, int cells, int *lo, int *hi) {
+  *lo = p * cells / pixels;
+  *hi = MAX((p + 1) * cells / pixels, *lo + 1);
+  *hi = MIN(*hi, cells);
+}
+
+// Draws tile cell (ty, tx) from `s`.
+static void draw_cell(const struct WallTile *t, const struct Screen *s,
+                      int ty, int tx) {
+  // Only the rows that are in the buffer.
+  const int rows = screen_visible_rows(s);
+  const int cols = s->text_cols;
+  WINDOW *w = g_wall_window;
+  const char *glyph;
+  uint8_t attr;
+
+  if ((rows <= WALL_TILE_ROWS) && (cols <= WALL_TILE_COLS)) {
+    // Fits as is.
+    if ((ty < rows) && (tx < cols)) {
+      const uint8_t *p = &s->video_text_buffer[(ty * cols + tx) * 2];
+      glyph = g_cp437_table[p[0]];
+      attr = p[1];
+    } else {
+      glyph = " ";
+      attr = 0;
+    }
+  } else {
+    int bg_votes[16] = {0};
+    int best_ink = -1;
+    int lit = 0;
+    uint8_t fg = 7;
+
+    for (int q = 0; q < 4; ++q) {
+      int r0, r1, c0, c1;
+      pixel_span(ty * 2 + (q >> 1), WALL_TILE_ROWS * 2, rows, &r0, &r1);
+      pixel_span(tx * 2 + (q & 1), WALL_TILE_COLS * 2, cols, &c0, &c1);
+
+      int ink = 0;
+      for (int y = r0; y < r1; ++y) {
+        const uint8_t *p = &s->video_text_buffer[(y * cols + c0) * 2];
+        for (int x = c0; x < c1; ++x, p += 2) {
+          const int i = glyph_ink(p[0]);
+          ink += i;
+          ++bg_votes[p[1] >> 4];
+          if (i > best_ink) {
+            best_ink = i;
+            fg = p[1] & 0x0f;
+          }
+        }
+      }
+
+      if (ink >= INK_THRESHOLD * (r1 - r0) * (c1 - c0)) {
+        lit |= 1 << q;
+      }
+    }
+
+    int bg = 0;
+    for (int i = 1; i < 16; ++i) {
+      if (bg_votes[i] > bg_votes[bg]) {
+        bg = i;
+      }
+    }
+
+    glyph = quadrants[lit];
+    attr = fg | (bg << 4);
+  }
+
+  wattron(w, COLOR_PAIR(g_ncurses_colors[attr]));
+  mvwaddstr(w, t->y + 1 + ty, t->x + tx, glyph);
+  wattroff(w, COLOR_PAIR(g_ncurses_colors[attr]));
+}
+
+static void draw_title(const struct WallTile *t, int focused) {
+  const struct RemoteHost *rh = t->host;
+  WINDOW *w = g_wall_window;
+  char mac_tmp[MAC_ADDR_FMT_LEN];
+  char stale[32];
+  char title[WALL_TILE_COLS + 1];
+
+  fmt_elapsed(stale, sizeof(stale), host_last_resp_us(rh));
+  snprintf(title, sizeof(title), "%d %s %s", rh->index,
+           fmt_mac_addr(mac_tmp, sizeof(mac_tmp), rh->if_addr), stale);
+
+  wattron(w, COLOR_PAIR(MY_COLOR_HEADER));
+  if (focused) {
+    wattron(w, A_REVERSE);
+  }
+  mvwprintw(w, t->y, t->x, "%-*s", WALL_TILE_COLS, title);
+  if (focused) {
+    wattroff(w, A_REVERSE);
+  }
+  wattroff(w, COLOR_PAIR(MY_COLOR_HEADER));
+}
+
+// Redraws tile rows covering source rows [y0, y1], or all if the source
+// resolution changed.
+static void draw_tile(struct WallTile *t, int y0, int y1) {
+  const struct Screen *s = &g_snapshot;
+  const struct Screen *screen = host_screen(t->host);
+
+  if (!screen) {
+    return;
+  }
+
+  screen_snapshot(screen, &g_snapshot);
+  const int rows = screen_visible_rows(s);
+  if (!rows) {
+    return;
+  }
+
+  if ((s->text_rows != t->text_rows) || (s->text_cols != t->text_cols)) {
+    t->text_rows = s->text_rows;
+    t->text_cols = s->text_cols;
+    y0 = 0;
+    y1 = rows - 1;
+  }
+
+  for (int ty = 0; ty < WALL_TILE_ROWS; ++ty) {
+    int r0, r1;
+    if (rows <= WALL_TILE_ROWS) {
+      r0 = ty;
+      r1 = ty + 1;
+    } else {
+      // Rows of both pixels in this tile row.
+      int unused;
+      pixel_span(ty * 2, WALL_TILE_ROWS * 2, rows, &r0, &unused);
+      pixel_span(ty * 2 + 1, WALL_TILE_ROWS * 2, rows, &unused, &r1);
+    }
+
+    if ((r1 <= y0) || (r0 > y1)) {
+      continue;
+    }
+
+    for (int tx = 0; tx < WALL_TILE_COLS; ++tx) {
+      draw_cell(t, s, ty, tx);
+    }
+  }
+}
+
+void wall_open() {
+  int height, width;
+  getmaxyx(g_wall_window, height, width);
+
+  g_tiles_per_row = MAX(1, (width + 1) / TILE_PITCH_X);
+  const int capacity =
+      MIN(WALL_MAX_TILES, g_tiles_per_row * MAX(1, height / TILE_PITCH_Y));
+
+  struct RemoteHost *hosts[WALL_MAX_TILES];
+  g_tile_count = menu_wall_hosts(hosts, capacity);
+  g_focus = 0;
+
+  wclear(g_wall_window);
+
+  for (int i = 0; i < g_tile_count; ++i) {
+    struct WallTile *t = &g_tiles[i];
+    memset(t, 0, sizeof(*t));
+    t->host = hosts[i];
+    t->y = (i / g_tiles_per_row) * TILE_PITCH_Y;
+    t->x = (i % g_tiles_per_row) * TILE_PITCH_X;
+
+    hosts[i]->tile = t;
+    session_keepalive_now(hosts[i]);
+    host_attach_screen(hosts[i]);
+
+    draw_title(t, i == g_focus);
+    mvwprintw(g_wall_window, t->y + 1, t->x, "Connecting...");
+    draw_tile(t, 0, 0);
+  }
+
+  g_active = 1;
+}
+
+void wall_close() {
+  for (int i = 0; i < g_tile_count; ++i) {
+    g_tiles[i].host->tile = NULL;
+  }
+
+  g_tile_count = 0;
+  g_active = 0;
+}
+
+int wall_is_active() { return g_active; }
+
+void wall_update_tile(struct RemoteHost *rh, uint16_t vga_offset,
+                      uint16_t byte_count) {
+  struct WallTile *t = rh->tile;
+
+  if (!t || !byte_count) {
+    return;
+  }
+
+  // Convert the byte range to source rows.  The geometry used here may be
+  // stale, in which case `draw_tile()` redraws the whole tile anyway.
+  const int cols = MAX(1, t->text_cols);
+  const int y0 = (vga_offset / 2) / cols;
+  const int y1 = ((vga_offset + byte_count - 1) / 2) / cols;
+  draw_tile(t, y0, y1);
+}
+
+void wall_redraw_all() {
+  for (int i = 0; i < g_tile_count; ++i) {
+    g_tiles[i].text_rows = g_tiles[i].text_cols = 0;
+    draw_tile(&g_tiles[i], 0, 0);
+  }
+}
+
+void wall_update_titles() {
+  for (int i = 0; i < g_tile_count; ++i) {
+    draw_title(&g_tiles[i], i == g_focus);
+  }
+}
+
+struct RemoteHost *wall_process_key(int c) {
+  const int old_focus = g_focus;
+
+  if (!g_tile_count) {
+    return NULL;
+  }
+
+  switch (c) {
+    case KEY_LEFT:
+      g_focus = MAX(0, g_focus - 1);
+      break;
+    case KEY_RIGHT:
+      g_focus = MIN(g_tile_count - 1, g_focus + 1);
+      break;
+    case KEY_UP:
+      if (g_focus >= g_tiles_per_row) {
+        g_focus -= g_tiles_per_row;
+      }
+      break;
+    case KEY_DOWN:
+      if (g_focus + g_tiles_per_row < g_tile_count) {
+        g_focus += g_tiles_per_row;
+      }
+      break;
+
+    case KEY_ENTER:
+    case '\n':
+    case '\r':
+      return g_tiles[g_focus].host;
+  }
+
+  if (g_focus != old_focus) {
+    draw_title(&g_tiles[old_focus], 0);
+    draw_title(&g_tiles[g_focus], 1);
+  }
+
+  return NULL;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Wall view: holds sessions to several servers at once, and shows each
+// screen as a small tile.
+//
+// Screens larger than a tile are downscaled with quadrant block glyphs
+// (U+2596 .. U+259F), so each character cell of the tile shows 2x2 "pixels".
+// A pixel is lit if the source cells it covers are mostly ink, which keeps
+// the layout of the remote screen (windows, menus, text blocks) recognizable.
+
+#ifndef __RMTDOS_CLIENT_WALL_H
+#define __RMTDOS_CLIENT_WALL_H
+
+#include <stdint.h>
+
+#include "client/hostlist.h"
+
+// Size of the downscaled screen in each tile.  An 80x25 screen is mapped at
+// (about) 2x2 source cells per tile cell.
+#define WALL_TILE_COLS 40
+#define WALL_TILE_ROWS 12
+
+#define WALL_MAX_TILES 64
+
+struct WallTile {
+  struct RemoteHost *host;
+
+  // Top left corner of the tile (title line) in `g_wall_window`.
+  int y;
+  int x;
+
+  // Source resolution of the last frame drawn into this tile.
+  uint8_t text_rows;
+  uint8_t text_cols;
+};
+
+// Opens the wall, with a tile for each host returned by
+// `menu_wall_hosts()`.  Starts sessions to those hosts.
+extern void wall_open();
+
+// Closes the wall.  Sessions to the hosts lapse.
+extern void wall_close();
+
+extern int wall_is_active();
+
+// Redraws the part of `rh`'s tile covered by the given VGA buffer range.
+extern void wall_update_tile(struct RemoteHost *rh, uint16_t vga_offset,
+                             uint16_t byte_count);
+
+// Redraws every tile.
+extern void wall_redraw_all();
+
+// Redraws tile titles (host id, address, time since last packet).
+extern void wall_update_titles();
+
+// Handles one key press.  Returns the host that the user chose to control,
+// or NULL.
+extern struct RemoteHost *wall_process_key(int c);
+
+#endif // __RMTDOS_CLIENT_WALL_H
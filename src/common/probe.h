@@ -0,0 +1,39 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Screen layout of the keystroke echo probe ("vga_demo.com -p", and the
+// "probe" workload of rmtdos-sim), shared with the client's benchmark mode
+// ("rmtdos-client -E").
+//
+// Every key the probe reads from the BIOS is drawn in one fixed cell,
+// followed by a space and the count of keys read so far, as four hex
+// digits.  The count is drawn first, so a frame that shows a key also
+// shows the count that includes it.  The client injects the characters of
+// PROBE_KEYS in turn, so consecutive keys always differ, and times how long
+// each takes to appear in the cell.
+//
+// NOTE: The values here MUST compile identically under 'bcc' for 16-bit
+// real-mode, and under 'gcc' for 64-bit Linux-amd64.
+
+#ifndef __RMTDOS_COMMON_PROBE_H
+#define __RMTDOS_COMMON_PROBE_H
+
+// Cell of the last key read, on an 80x25 screen.
+#define PROBE_ROW 12
+#define PROBE_COL 36
+
+// Count of keys read, in hex, from PROBE_COL + PROBE_COUNT_OFFSET.
+#define PROBE_COUNT_OFFSET 2
+#define PROBE_COUNT_DIGITS 4
+
+#define PROBE_ATTR 0x1f
+
+// Injected in turn.  A key's echo is told from the next one's by the
+// character alone, for up to this many keys in flight.
+#define PROBE_KEYS                                                             \
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"
+#define PROBE_KEY_COUNT 62
+
+#endif // __RMTDOS_COMMON_PROBE_H
@@ -70,6 +70,15 @@ enum PKT_TYPE {
   // Client -> Server
   // Inserts keystroke into BIOS keyboard buffer.
   V1_INJECT_KEYSTROKE = 7,
+
+  // Client -> Server.  Ask server for its runtime counters.
+  // Payload is empty.
+  // Server will respond if target is broadcast address.
+  V1_STATS_REQ = 8,
+
+  // Server -> Client.  Response to V1_STATS_REQ.
+  // Payload is `struct StatsResponse`.
+  V1_STATS_RESP = 9,
 };
 
 #if NEED_PRAGMA_PACK
@@ -118,6 +127,55 @@ struct StatusResponse {
   uint8_t cursor_col;
 };
 
+// Bit flags for `StatsResponse.flags`.
+// The `drv_*` counters are valid; the packet driver implements the
+// "extended" `get_statistics()`.
+#define STATS_HAS_DRIVER 1
+
+// V1_STATS_RESP: Server -> Client
+// All counters count from when the server went resident, and wrap.
+struct StatsResponse {
+  // Calls of the server's interrupt handlers.
+  uint32_t int08_ticks;
+  uint32_t int2f_ticks;
+
+  // Frames the packet driver handed us, frames it could not hand us for
+  // lack of a free buffer, frames we sent, and sends that it refused.
+  uint32_t packets_recv;
+  uint32_t packets_dropped;
+  uint32_t packets_sent;
+  uint32_t send_errors;
+
+  // The packet driver's own counters, for all of its users.
+  uint32_t drv_packets_in;
+  uint32_t drv_packets_out;
+  uint32_t drv_bytes_in;
+  uint32_t drv_bytes_out;
+  uint32_t drv_errors_in;
+  uint32_t drv_errors_out;
+  uint32_t drv_packets_lost;
+
+  uint16_t flags; // STATS_HAS_DRIVER
+
+  // Receive buffers: allocated, free now, waiting for int 08h, and the
+  // fewest that were ever free.
+  uint16_t buffers_total;
+  uint16_t buffers_free;
+  uint16_t buffers_ready;
+  uint16_t buffers_min_free;
+
+  uint16_t sessions_active;
+
+  // Bytes in, and the most bytes ever used of, the private stacks of the
+  // int 08h and int 2fh handlers and of the packet driver's receiver.
+  uint16_t int08_stack_size;
+  uint16_t int08_stack_used;
+  uint16_t int2f_stack_size;
+  uint16_t int2f_stack_used;
+  uint16_t pktdrv_stack_size;
+  uint16_t pktdrv_stack_used;
+};
+
 // V1_VGA_TEXT: Server -> Client
 // Followed by raw data, to end of packet.
 struct VideoText {
@@ -0,0 +1,1287 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// A small 8086 interpreter that counts cycles.  It runs the 8086 (and the
+// few 80186 additions that as86 may emit), with no FPU and no protected
+// mode.  Times are from the Intel 8086 data sheet: a base per instruction
+// form, plus the effective address time, plus 4 clocks for each word moved
+// to or from an odd address.  The 8088 also takes 4 clocks for every word
+// moved (its bus is 8 bits), and cannot run an instruction faster than its
+// bytes are fetched, 4 clocks each.  Both are approximations: the prefetch
+// queue is not modelled.
+
+#include <string.h>
+
+#include "cycles/cycles.h"
+
+#define FLAGS_FIXED 0xf002 // Bits that read as 1 on the 8086.
+#define FLAGS_MASK 0x0fd5  // Bits that can be changed.
+
+// Effective address.
+struct ModRM {
+  uint8_t mod;
+  uint8_t reg;
+  uint8_t rm;
+  uint16_t seg;
+  uint16_t off;
+};
+
+static const uint8_t g_parity[256] = {
+#define P2(n) n, n ^ 1, n ^ 1, n
+#define P4(n) P2(n), P2(n ^ 1), P2(n ^ 1), P2(n)
+#define P6(n) P4(n), P4(n ^ 1), P4(n ^ 1), P4(n)
+    P6(1), P6(0), P6(0), P6(1),
+#undef P6
+#undef P4
+#undef P2
+};
+
+void cpu_init(struct Cpu *cpu, uint8_t *mem) {
+  memset(cpu, 0, sizeof(*cpu));
+  cpu->mem = mem;
+  cpu->flags = FLAGS_FIXED;
+  cpu->seg_override = -1;
+}
+
+// Memory.
+
+static uint8_t read8(struct Cpu *cpu, uint16_t seg, uint16_t off) {
+  return cpu->mem[cpu_linear(seg, off)];
+}
+
+static void write8(struct Cpu *cpu, uint16_t seg, uint16_t off, uint8_t v) {
+  cpu->mem[cpu_linear(seg, off)] = v;
+}
+
+static uint16_t read16(struct Cpu *cpu, uint16_t seg, uint16_t off) {
+  ++cpu->word_accesses;
+  cpu->odd_word_accesses += off & 1;
+  return cpu_peek16(cpu, seg, off);
+}
+
+static void write16(struct Cpu *cpu, uint16_t seg, uint16_t off, uint16_t v) {
+  ++cpu->word_accesses;
+  cpu->odd_word_accesses += off & 1;
+  cpu_poke16(cpu, seg, off, v);
+}
+
+static uint8_t fetch8(struct Cpu *cpu) {
+  ++cpu->fetched;
+  return read8(cpu, cpu->sregs[CS], cpu->ip++);
+}
+
+static uint16_t fetch16(struct Cpu *cpu) {
+  const uint16_t lo = fetch8(cpu);
+  return lo | (fetch8(cpu) << 8);
+}
+
+void cpu_push(struct Cpu *cpu, uint16_t value) {
+  cpu->regs[SP] -= 2;
+  write16(cpu, cpu->sregs[SS], cpu->regs[SP], value);
+}
+
+uint16_t cpu_pop(struct Cpu *cpu) {
+  const uint16_t v = read16(cpu, cpu->sregs[SS], cpu->regs[SP]);
+  cpu->regs[SP] += 2;
+  return v;
+}
+
+// Registers.  8-bit registers are AL CL DL BL AH CH DH BH.
+
+static uint8_t get_r8(struct Cpu *cpu, int r) {
+  return (r < 4) ? cpu->regs[r] & 0xff : cpu->regs[r - 4] >> 8;
+}
+
+static void set_r8(struct Cpu *cpu, int r, uint8_t v) {
+  if (r < 4) {
+    cpu->regs[r] = (cpu->regs[r] & 0xff00) | v;
+  } else {
+    cpu->regs[r - 4] = (cpu->regs[r - 4] & 0x00ff) | (v << 8);
+  }
+}
+
+static uint16_t get_reg(struct Cpu *cpu, int r, int w) {
+  return w ? cpu->regs[r] : get_r8(cpu, r);
+}
+
+static void set_reg(struct Cpu *cpu, int r, int w, uint16_t v) {
+  if (w) {
+    cpu->regs[r] = v;
+  } else {
+    set_r8(cpu, r, v);
+  }
+}
+
+static uint16_t data_seg(struct Cpu *cpu, int dflt) {
+  return cpu->sregs[(cpu->seg_override >= 0) ? cpu->seg_override : dflt];
+}
+
+// Decodes a ModR/M byte, and adds the effective address time.
+static void decode_modrm(struct Cpu *cpu, struct ModRM *m) {
+  const uint8_t b = fetch8(cpu);
+  int16_t disp = 0;
+  int seg = DS;
+  unsigned ea;
+
+  m->mod = b >> 6;
+  m->reg = (b >> 3) & 7;
+  m->rm = b & 7;
+  if (m->mod == 3) {
+    return;
+  }
+
+  if (m->mod == 1) {
+    disp = (int8_t)fetch8(cpu);
+  } else if (m->mod == 2) {
+    disp = fetch16(cpu);
+  }
+
+  switch (m->rm) {
+    case 0:
+      m->off = cpu->regs[BX] + cpu->regs[SI];
+      ea = 7;
+      break;
+    case 1:
+      m->off = cpu->regs[BX] + cpu->regs[DI];
+      ea = 8;
+      break;
+    case 2:
+      m->off = cpu->regs[BP] + cpu->regs[SI];
+      seg = SS;
+      ea = 8;
+      break;
+    case 3:
+      m->off = cpu->regs[BP] + cpu->regs[DI];
+      seg = SS;
+      ea = 7;
+      break;
+    case 4:
+      m->off = cpu->regs[SI];
+      ea = 5;
+      break;
+    case 5:
+      m->off = cpu->regs[DI];
+      ea = 5;
+      break;
+    case 6:
+      if (m->mod == 0) {
+        m->off = fetch16(cpu);
+        ea = 6;
+      } else {
+        m->off = cpu->regs[BP];
+        seg = SS;
+        ea = 5;
+      }
+      break;
+    default:
+      m->off = cpu->regs[BX];
+      ea = 5;
+      break;
+  }
+
+  if (m->mod) {
+    m->off += disp;
+    ea += 4;
+  }
+  if (cpu->seg_override >= 0) {
+    ea += 2;
+  }
+
+  m->seg = data_seg(cpu, seg);
+  cpu->t += ea;
+}
+
+static uint16_t get_rm(struct Cpu *cpu, const struct ModRM *m, int w) {
+  if (m->mod == 3) {
+    return get_reg(cpu, m->rm, w);
+  }
+  return w ? read16(cpu, m->seg, m->off) : read8(cpu, m->seg, m->off);
+}
+
+static void set_rm(struct Cpu *cpu, const struct ModRM *m, int w,
+                   uint16_t v) {
+  if (m->mod == 3) {
+    set_reg(cpu, m->rm, w, v);
+  } else if (w) {
+    write16(cpu, m->seg, m->off, v);
+  } else {
+    write8(cpu, m->seg, m->off, v);
+  }
+}
+
+// Flags.
+
+static void set_flag(struct Cpu *cpu, uint16_t flag, int on) {
+  if (on) {
+    cpu->flags |= flag;
+  } else {
+    cpu->flags &= ~flag;
+  }
+}
+
+static void set_szp(struct Cpu *cpu, int w, uint16_t v) {
+  const uint16_t sign = w ? 0x8000 : 0x80;
+  v = w ? v : (v & 0xff);
+  set_flag(cpu, FLAG_ZF, !v);
+  set_flag(cpu, FLAG_SF, v & sign);
+  set_flag(cpu, FLAG_PF, g_parity[v & 0xff]);
+}
+
+enum AluOp { ALU_ADD, ALU_OR, ALU_ADC, ALU_SBB, ALU_AND, ALU_SUB, ALU_XOR,
+             ALU_CMP };
+
+static uint16_t alu(struct Cpu *cpu, int op, uint16_t a, uint16_t b, int w) {
+  const uint32_t mask = w ? 0xffff : 0xff;
+  const uint32_t sign = w ? 0x8000 : 0x80;
+  const uint32_t carry = cpu->flags & FLAG_CF;
+  uint32_t r;
+
+  a &= mask;
+  b &= mask;
+  switch (op) {
+    case ALU_ADD:
+    case ALU_ADC:
+      r = a + b + ((op == ALU_ADC) ? carry : 0);
+      set_flag(cpu, FLAG_CF, r > mask);
+      set_flag(cpu, FLAG_OF, (a ^ r) & (b ^ r) & sign);
+      set_flag(cpu, FLAG_AF, (a ^ b ^ r) & 0x10);
+      break;
+    case ALU_SUB:
+    case ALU_SBB:
+    case ALU_CMP:
+      r = a - b - ((op == ALU_SBB) ? carry : 0);
+      set_flag(cpu, FLAG_CF, (r & ~mask) != 0);
+      set_flag(cpu, FLAG_OF, (a ^ b) & (a ^ r) & sign);
+      set_flag(cpu, FLAG_AF, (a ^ b ^ r) & 0x10);
+      break;
+    case ALU_OR:
+      r = a | b;
+      goto logic;
+    case ALU_AND:
+      r = a & b;
+      goto logic;
+    default: // ALU_XOR
+      r = a ^ b;
+    logic:
+      set_flag(cpu, FLAG_CF | FLAG_OF | FLAG_AF, 0);
+      break;
+  }
+
+  r &= mask;
+  set_szp(cpu, w, r);
+  return r;
+}
+
+static uint16_t inc_dec(struct Cpu *cpu, uint16_t v, int w, int dec) {
+  const uint16_t carry = cpu->flags & FLAG_CF;
+  const uint16_t r = alu(cpu, dec ? ALU_SUB : ALU_ADD, v, 1, w);
+  set_flag(cpu, FLAG_CF, carry); // INC and DEC leave CF alone.
+  return r;
+}
+
+// Group 2: rotates and shifts, one bit at a time.
+static uint16_t shift(struct Cpu *cpu, int op, uint16_t v, unsigned count,
+                      int w) {
+  const uint16_t mask = w ? 0xffff : 0xff;
+  const uint16_t sign = w ? 0x8000 : 0x80;
+
+  v &= mask;
+  if (!count) {
+    return v;
+  }
+
+  for (unsigned i = 0; i < count; ++i) {
+    int cf = cpu->flags & FLAG_CF;
+    switch (op) {
+      case 0: // ROL
+        cf = (v & sign) != 0;
+        v = ((v << 1) | cf) & mask;
+        break;
+      case 1: // ROR
+        cf = v & 1;
+        v = (v >> 1) | (cf ? sign : 0);
+        break;
+      case 2: { // RCL
+        const int out = (v & sign) != 0;
+        v = ((v << 1) | (cf ? 1 : 0)) & mask;
+        cf = out;
+        break;
+      }
+      case 3: { // RCR
+        const int out = v & 1;
+        v = (v >> 1) | (cf ? sign : 0);
+        cf = out;
+        break;
+      }
+      case 4: // SHL
+      case 6:
+        cf = (v & sign) != 0;
+        v = (v << 1) & mask;
+        break;
+      case 5: // SHR
+        cf = v & 1;
+        v >>= 1;
+        break;
+      default: // SAR
+        cf = v & 1;
+        v = (v >> 1) | (v & sign);
+        break;
+    }
+    set_flag(cpu, FLAG_CF, cf);
+  }
+
+  switch (op) {
+    case 0:
+    case 2:
+    case 4:
+    case 6:
+      set_flag(cpu, FLAG_OF, ((v & sign) != 0) != ((cpu->flags & FLAG_CF) != 0));
+      break;
+    case 1:
+    case 3:
+      set_flag(cpu, FLAG_OF, ((v ^ (v << 1)) & sign) != 0);
+      break;
+    case 5:
+      set_flag(cpu, FLAG_OF, (count == 1) && ((v << 1) & sign));
+      break;
+    default:
+      set_flag(cpu, FLAG_OF, 0);
+      break;
+  }
+  if (op >= 4) {
+    set_szp(cpu, w, v);
+  }
+  return v;
+}
+
+void cpu_interrupt(struct Cpu *cpu, uint8_t vec) {
+  cpu_push(cpu, cpu->flags);
+  cpu_push(cpu, cpu->sregs[CS]);
+  cpu_push(cpu, cpu->ip);
+  cpu->flags &= ~(FLAG_IF | FLAG_TF);
+  cpu->ip = read16(cpu, 0, vec * 4);
+  cpu->sregs[CS] = read16(cpu, 0, vec * 4 + 2);
+}
+
+static int condition(struct Cpu *cpu, int cc) {
+  const uint16_t f = cpu->flags;
+  int r;
+
+  switch (cc >> 1) {
+    case 0: r = f & FLAG_OF; break;
+    case 1: r = f & FLAG_CF; break;
+    case 2: r = f & FLAG_ZF; break;
+    case 3: r = f & (FLAG_CF | FLAG_ZF); break;
+    case 4: r = f & FLAG_SF; break;
+    case 5: r = f & FLAG_PF; break;
+    case 6: r = !(f & FLAG_SF) != !(f & FLAG_OF); break;
+    default:
+      r = (f & FLAG_ZF) || (!(f & FLAG_SF) != !(f & FLAG_OF));
+      break;
+  }
+  return (cc & 1) ? !r : !!r;
+}
+
+static void jump_rel(struct Cpu *cpu, int16_t disp) { cpu->ip += disp; }
+
+// Group 3: TEST, NOT, NEG, MUL, IMUL, DIV, IDIV.  A divide error raises
+// int 0, as on the 8086.
+static void group3(struct Cpu *cpu, const struct ModRM *m, int w) {
+  const int mem = m->mod != 3;
+  const uint16_t v = get_rm(cpu, m, w);
+
+  switch (m->reg) {
+    case 0:
+    case 1: { // TEST
+      const uint16_t imm = w ? fetch16(cpu) : fetch8(cpu);
+      alu(cpu, ALU_AND, v, imm, w);
+      cpu->t += mem ? 11 : 5;
+      break;
+    }
+    case 2: // NOT
+      set_rm(cpu, m, w, ~v);
+      cpu->t += mem ? 16 : 3;
+      break;
+    case 3: // NEG
+      set_rm(cpu, m, w, alu(cpu, ALU_SUB, 0, v, w));
+      cpu->t += mem ? 16 : 3;
+      break;
+    case 4: // MUL
+      if (w) {
+        const uint32_t r = (uint32_t)cpu->regs[AX] * v;
+        cpu->regs[AX] = r;
+        cpu->regs[DX] = r >> 16;
+        set_flag(cpu, FLAG_CF | FLAG_OF, cpu->regs[DX] != 0);
+        cpu->t += mem ? 134 : 128;
+      } else {
+        cpu->regs[AX] = (cpu->regs[AX] & 0xff) * (v & 0xff);
+        set_flag(cpu, FLAG_CF | FLAG_OF, cpu->regs[AX] >> 8);
+        cpu->t += mem ? 80 : 74;
+      }
+      break;
+    case 5: // IMUL
+      if (w) {
+        const int32_t r = (int32_t)(int16_t)cpu->regs[AX] * (int16_t)v;
+        cpu->regs[AX] = r;
+        cpu->regs[DX] = (uint32_t)r >> 16;
+        set_flag(cpu, FLAG_CF | FLAG_OF, r != (int16_t)r);
+        cpu->t += mem ? 147 : 141;
+      } else {
+        const int16_t r = (int8_t)cpu->regs[AX] * (int8_t)v;
+        cpu->regs[AX] = r;
+        set_flag(cpu, FLAG_CF | FLAG_OF, r != (int8_t)r);
+        cpu->t += mem ? 95 : 89;
+      }
+      break;
+    case 6: // DIV
+      if (w) {
+        const uint32_t n = ((uint32_t)cpu->regs[DX] << 16) | cpu->regs[AX];
+        if (!v || (n / v > 0xffff)) {
+          goto divide_error;
+        }
+        cpu->regs[AX] = n / v;
+        cpu->regs[DX] = n % v;
+        cpu->t += mem ? 159 : 153;
+      } else {
+        const uint16_t n = cpu->regs[AX];
+        const uint8_t d = v;
+        if (!d || (n / d > 0xff)) {
+          goto divide_error;
+        }
+        cpu->regs[AX] = ((n % d) << 8) | (n / d);
+        cpu->t += mem ? 91 : 85;
+      }
+      break;
+    default: // IDIV
+      if (w) {
+        const int32_t n =
+            (int32_t)(((uint32_t)cpu->regs[DX] << 16) | cpu->regs[AX]);
+        const int16_t d = v;
+        if (!d || (n / d > 32767) || (n / d < -32768)) {
+          goto divide_error;
+        }
+        cpu->regs[AX] = n / d;
+        cpu->regs[DX] = n % d;
+        cpu->t += mem ? 181 : 175;
+      } else {
+        const int16_t n = cpu->regs[AX];
+        const int8_t d = v;
+        if (!d || (n / d > 127) || (n / d < -128)) {
+          goto divide_error;
+        }
+        cpu->regs[AX] = ((uint8_t)(n % d) << 8) | (uint8_t)(n / d);
+        cpu->t += mem ? 113 : 107;
+      }
+      break;
+  }
+  return;
+
+divide_error:
+  cpu->t += 51;
+  cpu_interrupt(cpu, 0);
+}
+
+// String instructions, with REP/REPE/REPNE (`rep` is 0, 0xf2 or 0xf3).
+static void string_op(struct Cpu *cpu, uint8_t op, int rep) {
+  const int w = op & 1;
+  const int16_t step = ((cpu->flags & FLAG_DF) ? -1 : 1) * (w ? 2 : 1);
+  const uint16_t src_seg = data_seg(cpu, DS);
+  static const uint8_t once[8] = {18, 22, 0, 0, 11, 12, 15, 0};
+  static const uint8_t each[8] = {17, 22, 0, 0, 10, 13, 15, 0};
+  const int kind = (op - 0xa4) >> 1; // MOVS CMPS - - STOS LODS SCAS
+
+  if (rep) {
+    cpu->t += 9;
+  }
+
+  for (;;) {
+    if (rep && !cpu->regs[CX]) {
+      break;
+    }
+
+    switch (kind) {
+      case 0: // MOVS
+        if (w) {
+          write16(cpu, cpu->sregs[ES], cpu->regs[DI],
+                  read16(cpu, src_seg, cpu->regs[SI]));
+        } else {
+          write8(cpu, cpu->sregs[ES], cpu->regs[DI],
+                 read8(cpu, src_seg, cpu->regs[SI]));
+        }
+        cpu->regs[SI] += step;
+        cpu->regs[DI] += step;
+        break;
+      case 1: { // CMPS
+        const uint16_t a = w ? read16(cpu, src_seg, cpu->regs[SI])
+                             : read8(cpu, src_seg, cpu->regs[SI]);
+        const uint16_t b = w ? read16(cpu, cpu->sregs[ES], cpu->regs[DI])
+                             : read8(cpu, cpu->sregs[ES], cpu->regs[DI]);
+        alu(cpu, ALU_CMP, a, b, w);
+        cpu->regs[SI] += step;
+        cpu->regs[DI] += step;
+        break;
+      }
+      case 4: // STOS
+        if (w) {
+          write16(cpu, cpu->sregs[ES], cpu->regs[DI], cpu->regs[AX]);
+        } else {
+          write8(cpu, cpu->sregs[ES], cpu->regs[DI], cpu->regs[AX]);
+        }
+        cpu->regs[DI] += step;
+        break;
+      case 5: // LODS
+        set_reg(cpu, AX, w,
+                w ? read16(cpu, src_seg, cpu->regs[SI])
+                  : read8(cpu, src_seg, cpu->regs[SI]));
+        cpu->regs[SI] += step;
+        break;
+      default: { // SCAS
+        const uint16_t b = w ? read16(cpu, cpu->sregs[ES], cpu->regs[DI])
+                             : read8(cpu, cpu->sregs[ES], cpu->regs[DI]);
+        alu(cpu, ALU_CMP, get_reg(cpu, AX, w), b, w);
+        cpu->regs[DI] += step;
+        break;
+      }
+    }
+
+    if (!rep) {
+      cpu->t += once[kind];
+      break;
+    }
+
+    cpu->t += each[kind];
+    --cpu->regs[CX];
+
+    // REPE / REPNE end on the compare.
+    if ((kind == 1) || (kind == 6)) {
+      const int zf = (cpu->flags & FLAG_ZF) != 0;
+      if ((rep == 0xf3) ? !zf : zf) {
+        break;
+      }
+    }
+  }
+}
+
+static void far_jump(struct Cpu *cpu, uint16_t seg, uint16_t off) {
+  cpu->sregs[CS] = seg;
+  cpu->ip = off;
+}
+
+static int step(struct Cpu *cpu) {
+  int rep = 0;
+  struct ModRM m;
+  uint8_t op;
+
+  cpu->seg_override = -1;
+
+  // Prefixes.
+  for (;;) {
+    op = fetch8(cpu);
+    switch (op) {
+      case 0x26:
+      case 0x2e:
+      case 0x36:
+      case 0x3e:
+        cpu->seg_override = (op >> 3) & 3;
+        cpu->t += 2;
+        continue;
+      case 0xf0:
+        cpu->t += 2;
+        continue;
+      case 0xf2:
+      case 0xf3:
+        rep = op;
+        continue;
+    }
+    break;
+  }
+
+  // ALU forms: 00-3f, except the prefixes and odd ones handled below.
+  if ((op < 0x40) && ((op & 7) < 6)) {
+    const int alu_op = op >> 3;
+    const int w = op & 1;
+
+    switch (op & 7) {
+      case 0:
+      case 1: { // Eb,Gb / Ev,Gv
+        decode_modrm(cpu, &m);
+        const uint16_t r = alu(cpu, alu_op, get_rm(cpu, &m, w),
+                               get_reg(cpu, m.reg, w), w);
+        if (alu_op != ALU_CMP) {
+          set_rm(cpu, &m, w, r);
+        }
+        cpu->t += (m.mod == 3) ? 3 : ((alu_op == ALU_CMP) ? 9 : 16);
+        return 0;
+      }
+      case 2:
+      case 3: { // Gb,Eb / Gv,Ev
+        decode_modrm(cpu, &m);
+        const uint16_t r = alu(cpu, alu_op, get_reg(cpu, m.reg, w),
+                               get_rm(cpu, &m, w), w);
+        if (alu_op != ALU_CMP) {
+          set_reg(cpu, m.reg, w, r);
+        }
+        cpu->t += (m.mod == 3) ? 3 : 9;
+        return 0;
+      }
+      default: { // AL,Ib / AX,Iv
+        const uint16_t imm = w ? fetch16(cpu) : fetch8(cpu);
+        const uint16_t r = alu(cpu, alu_op, get_reg(cpu, AX, w), imm, w);
+        if (alu_op != ALU_CMP) {
+          set_reg(cpu, AX, w, r);
+        }
+        cpu->t += 4;
+        return 0;
+      }
+    }
+  }
+
+  switch (op) {
+    case 0x06:
+    case 0x0e:
+    case 0x16:
+    case 0x1e: // PUSH seg
+      cpu_push(cpu, cpu->sregs[op >> 3]);
+      cpu->t += 10;
+      break;
+    case 0x07:
+    case 0x17:
+    case 0x1f: // POP seg
+      cpu->sregs[op >> 3] = cpu_pop(cpu);
+      cpu->t += 8;
+      break;
+
+    case 0x27:   // DAA
+    case 0x2f: { // DAS
+      const uint8_t al = cpu->regs[AX];
+      const int cf = cpu->flags & FLAG_CF;
+      const int sub = (op == 0x2f);
+      uint8_t r = al;
+      int new_cf = 0;
+      if (((al & 0x0f) > 9) || (cpu->flags & FLAG_AF)) {
+        r = sub ? r - 6 : r + 6;
+        cpu->flags |= FLAG_AF;
+      } else {
+        cpu->flags &= ~FLAG_AF;
+      }
+      if ((al > 0x99) || cf) {
+        r = sub ? r - 0x60 : r + 0x60;
+        new_cf = 1;
+      }
+      set_r8(cpu, AX, r);
+      set_flag(cpu, FLAG_CF, new_cf);
+      set_szp(cpu, 0, r);
+      cpu->t += 4;
+      break;
+    }
+    case 0x37:   // AAA
+    case 0x3f: { // AAS
+      const int adjust =
+          ((cpu->regs[AX] & 0x0f) > 9) || (cpu->flags & FLAG_AF);
+      if (adjust) {
+        if (op == 0x37) {
+          cpu->regs[AX] += 0x106;
+        } else {
+          cpu->regs[AX] -= 0x106;
+        }
+      }
+      set_flag(cpu, FLAG_AF | FLAG_CF, adjust);
+      cpu->regs[AX] &= 0xff0f;
+      cpu->t += 4;
+      break;
+    }
+
+    case 0x40: case 0x41: case 0x42: case 0x43:
+    case 0x44: case 0x45: case 0x46: case 0x47:
+    case 0x48: case 0x49: case 0x4a: case 0x4b:
+    case 0x4c: case 0x4d: case 0x4e: case 0x4f: // INC / DEC r16
+      cpu->regs[op & 7] = inc_dec(cpu, cpu->regs[op & 7], 1, op & 8);
+      cpu->t += 2;
+      break;
+
+    case 0x50: case 0x51: case 0x52: case 0x53:
+    case 0x54: case 0x55: case 0x56: case 0x57: // PUSH r16
+      if ((op & 7) == SP) {
+        // The 8086 pushes SP as it is after the decrement.
+        cpu->regs[SP] -= 2;
+        write16(cpu, cpu->sregs[SS], cpu->regs[SP], cpu->regs[SP]);
+      } else {
+        cpu_push(cpu, cpu->regs[op & 7]);
+      }
+      cpu->t += 11;
+      break;
+    case 0x58: case 0x59: case 0x5a: case 0x5b:
+    case 0x5c: case 0x5d: case 0x5e: case 0x5f: // POP r16
+      cpu->regs[op & 7] = cpu_pop(cpu);
+      cpu->t += 8;
+      break;
+
+    case 0x60: { // PUSHA (80186)
+      const uint16_t sp = cpu->regs[SP];
+      for (int r = AX; r <= DI; ++r) {
+        cpu_push(cpu, (r == SP) ? sp : cpu->regs[r]);
+      }
+      cpu->t += 36;
+      break;
+    }
+    case 0x61: // POPA (80186)
+      for (int r = DI; r >= AX; --r) {
+        const uint16_t v = cpu_pop(cpu);
+        if (r != SP) {
+          cpu->regs[r] = v;
+        }
+      }
+      cpu->t += 51;
+      break;
+    case 0x68: // PUSH Iv (80186)
+      cpu_push(cpu, fetch16(cpu));
+      cpu->t += 10;
+      break;
+    case 0x6a: // PUSH Ib (80186)
+      cpu_push(cpu, (int8_t)fetch8(cpu));
+      cpu->t += 10;
+      break;
+    case 0x69:
+    case 0x6b: { // IMUL Gv,Ev,imm (80186)
+      decode_modrm(cpu, &m);
+      const int16_t a = get_rm(cpu, &m, 1);
+      const int16_t b = (op == 0x69) ? (int16_t)fetch16(cpu)
+                                     : (int8_t)fetch8(cpu);
+      const int32_t r = (int32_t)a * b;
+      cpu->regs[m.reg] = r;
+      set_flag(cpu, FLAG_CF | FLAG_OF, r != (int16_t)r);
+      cpu->t += 25;
+      break;
+    }
+
+    case 0x70: case 0x71: case 0x72: case 0x73:
+    case 0x74: case 0x75: case 0x76: case 0x77:
+    case 0x78: case 0x79: case 0x7a: case 0x7b:
+    case 0x7c: case 0x7d: case 0x7e: case 0x7f: { // Jcc
+      const int8_t disp = fetch8(cpu);
+      if (condition(cpu, op & 0x0f)) {
+        jump_rel(cpu, disp);
+        cpu->t += 16;
+      } else {
+        cpu->t += 4;
+      }
+      break;
+    }
+
+    case 0x80:
+    case 0x81:
+    case 0x82:
+    case 0x83: { // Group 1: Eb,Ib / Ev,Iv / Ev,Ib (sign extended)
+      const int w = op & 1;
+      decode_modrm(cpu, &m);
+      const uint16_t v = get_rm(cpu, &m, w);
+      const uint16_t imm = (op == 0x81)   ? fetch16(cpu)
+                           : (op == 0x83) ? (uint16_t)(int8_t)fetch8(cpu)
+                                          : fetch8(cpu);
+      const uint16_t r = alu(cpu, m.reg, v, imm, w);
+      if (m.reg != ALU_CMP) {
+        set_rm(cpu, &m, w, r);
+      }
+      cpu->t += (m.mod == 3) ? 4 : ((m.reg == ALU_CMP) ? 10 : 17);
+      break;
+    }
+
+    case 0x84:
+    case 0x85: { // TEST Eb,Gb / Ev,Gv
+      const int w = op & 1;
+      decode_modrm(cpu, &m);
+      alu(cpu, ALU_AND, get_rm(cpu, &m, w), get_reg(cpu, m.reg, w), w);
+      cpu->t += (m.mod == 3) ? 3 : 9;
+      break;
+    }
+    case 0x86:
+    case 0x87: { // XCHG
+      const int w = op & 1;
+      decode_modrm(cpu, &m);
+      const uint16_t a = get_rm(cpu, &m, w);
+      set_rm(cpu, &m, w, get_reg(cpu, m.reg, w));
+      set_reg(cpu, m.reg, w, a);
+      cpu->t += (m.mod == 3) ? 4 : 17;
+      break;
+    }
+    case 0x88:
+    case 0x89: { // MOV Eb,Gb / Ev,Gv
+      const int w = op & 1;
+      decode_modrm(cpu, &m);
+      set_rm(cpu, &m, w, get_reg(cpu, m.reg, w));
+      cpu->t += (m.mod == 3) ? 2 : 9;
+      break;
+    }
+    case 0x8a:
+    case 0x8b: { // MOV Gb,Eb / Gv,Ev
+      const int w = op & 1;
+      decode_modrm(cpu, &m);
+      set_reg(cpu, m.reg, w, get_rm(cpu, &m, w));
+      cpu->t += (m.mod == 3) ? 2 : 8;
+      break;
+    }
+    case 0x8c: // MOV Ew,Sw
+      decode_modrm(cpu, &m);
+      set_rm(cpu, &m, 1, cpu->sregs[m.reg & 3]);
+      cpu->t += (m.mod == 3) ? 2 : 9;
+      break;
+    case 0x8d: // LEA
+      decode_modrm(cpu, &m);
+      cpu->regs[m.reg] = m.off;
+      cpu->t += 2;
+      break;
+    case 0x8e: // MOV Sw,Ew
+      decode_modrm(cpu, &m);
+      cpu->sregs[m.reg & 3] = get_rm(cpu, &m, 1);
+      cpu->t += (m.mod == 3) ? 2 : 8;
+      break;
+    case 0x8f: // POP Ev
+      decode_modrm(cpu, &m);
+      set_rm(cpu, &m, 1, cpu_pop(cpu));
+      cpu->t += (m.mod == 3) ? 8 : 17;
+      break;
+
+    case 0x90: // NOP
+      cpu->t += 3;
+      break;
+    case 0x91: case 0x92: case 0x93:
+    case 0x94: case 0x95: case 0x96: case 0x97: { // XCHG AX,r16
+      const uint16_t v = cpu->regs[op & 7];
+      cpu->regs[op & 7] = cpu->regs[AX];
+      cpu->regs[AX] = v;
+      cpu->t += 3;
+      break;
+    }
+    case 0x98: // CBW
+      cpu->regs[AX] = (int8_t)cpu->regs[AX];
+      cpu->t += 2;
+      break;
+    case 0x99: // CWD
+      cpu->regs[DX] = (cpu->regs[AX] & 0x8000) ? 0xffff : 0;
+      cpu->t += 5;
+      break;
+    case 0x9a: { // CALL far
+      const uint16_t off = fetch16(cpu);
+      const uint16_t seg = fetch16(cpu);
+      cpu_push(cpu, cpu->sregs[CS]);
+      cpu_push(cpu, cpu->ip);
+      far_jump(cpu, seg, off);
+      cpu->t += 28;
+      break;
+    }
+    case 0x9b: // WAIT
+      cpu->t += 3;
+      break;
+    case 0x9c: // PUSHF
+      cpu_push(cpu, cpu->flags);
+      cpu->t += 10;
+      break;
+    case 0x9d: // POPF
+      cpu->flags = (cpu_pop(cpu) & FLAGS_MASK) | FLAGS_FIXED;
+      cpu->t += 8;
+      break;
+    case 0x9e: // SAHF
+      cpu->flags = (cpu->flags & 0xff00) |
+                   ((cpu->regs[AX] >> 8) & 0xd5) | (FLAGS_FIXED & 0xff);
+      cpu->t += 4;
+      break;
+    case 0x9f: // LAHF
+      set_r8(cpu, 4, cpu->flags);
+      cpu->t += 4;
+      break;
+
+    case 0xa0:
+    case 0xa1: { // MOV AL/AX,[moffs]
+      const int w = op & 1;
+      const uint16_t off = fetch16(cpu);
+      const uint16_t seg = data_seg(cpu, DS);
+      set_reg(cpu, AX, w, w ? read16(cpu, seg, off) : read8(cpu, seg, off));
+      cpu->t += 10;
+      break;
+    }
+    case 0xa2:
+    case 0xa3: { // MOV [moffs],AL/AX
+      const uint16_t off = fetch16(cpu);
+      const uint16_t seg = data_seg(cpu, DS);
+      if (op & 1) {
+        write16(cpu, seg, off, cpu->regs[AX]);
+      } else {
+        write8(cpu, seg, off, cpu->regs[AX]);
+      }
+      cpu->t += 10;
+      break;
+    }
+    case 0xa4: case 0xa5: case 0xa6: case 0xa7:
+    case 0xaa: case 0xab: case 0xac: case 0xad:
+    case 0xae: case 0xaf:
+      string_op(cpu, op, rep);
+      break;
+    case 0xa8:
+    case 0xa9: { // TEST AL/AX,imm
+      const int w = op & 1;
+      alu(cpu, ALU_AND, get_reg(cpu, AX, w), w ? fetch16(cpu) : fetch8(cpu),
+          w);
+      cpu->t += 4;
+      break;
+    }
+
+    case 0xb0: case 0xb1: case 0xb2: case 0xb3:
+    case 0xb4: case 0xb5: case 0xb6: case 0xb7: // MOV r8,Ib
+      set_r8(cpu, op & 7, fetch8(cpu));
+      cpu->t += 4;
+      break;
+    case 0xb8: case 0xb9: case 0xba: case 0xbb:
+    case 0xbc: case 0xbd: case 0xbe: case 0xbf: // MOV r16,Iv
+      cpu->regs[op & 7] = fetch16(cpu);
+      cpu->t += 4;
+      break;
+
+    case 0xc0:
+    case 0xc1: { // Group 2 Eb/Ev,Ib (80186)
+      const int w = op & 1;
+      decode_modrm(cpu, &m);
+      const uint8_t count = fetch8(cpu);
+      set_rm(cpu, &m, w, shift(cpu, m.reg, get_rm(cpu, &m, w), count, w));
+      cpu->t += ((m.mod == 3) ? 5 : 17) + count;
+      break;
+    }
+    case 0xc2: { // RET Iw
+      const uint16_t n = fetch16(cpu);
+      cpu->ip = cpu_pop(cpu);
+      cpu->regs[SP] += n;
+      cpu->t += 12;
+      break;
+    }
+    case 0xc3: // RET
+      cpu->ip = cpu_pop(cpu);
+      cpu->t += 8;
+      break;
+    case 0xc4:
+    case 0xc5: // LES / LDS
+      decode_modrm(cpu, &m);
+      cpu->regs[m.reg] = read16(cpu, m.seg, m.off);
+      cpu->sregs[(op == 0xc4) ? ES : DS] = read16(cpu, m.seg, m.off + 2);
+      cpu->t += 16;
+      break;
+    case 0xc6:
+    case 0xc7: { // MOV Eb,Ib / Ev,Iv
+      const int w = op & 1;
+      decode_modrm(cpu, &m);
+      set_rm(cpu, &m, w, w ? fetch16(cpu) : fetch8(cpu));
+      cpu->t += (m.mod == 3) ? 4 : 10;
+      break;
+    }
+    case 0xc8: { // ENTER (80186)
+      const uint16_t size = fetch16(cpu);
+      const uint8_t level = fetch8(cpu) & 0x1f;
+      cpu_push(cpu, cpu->regs[BP]);
+      const uint16_t frame = cpu->regs[SP];
+      for (int i = 1; i < level; ++i) {
+        cpu->regs[BP] -= 2;
+        cpu_push(cpu, read16(cpu, cpu->sregs[SS], cpu->regs[BP]));
+      }
+      if (level) {
+        cpu_push(cpu, frame);
+      }
+      cpu->regs[BP] = frame;
+      cpu->regs[SP] -= size;
+      cpu->t += 15;
+      break;
+    }
+    case 0xc9: // LEAVE (80186)
+      cpu->regs[SP] = cpu->regs[BP];
+      cpu->regs[BP] = cpu_pop(cpu);
+      cpu->t += 8;
+      break;
+    case 0xca: { // RETF Iw
+      const uint16_t n = fetch16(cpu);
+      cpu->ip = cpu_pop(cpu);
+      cpu->sregs[CS] = cpu_pop(cpu);
+      cpu->regs[SP] += n;
+      cpu->t += 17;
+      break;
+    }
+    case 0xcb: // RETF
+      cpu->ip = cpu_pop(cpu);
+      cpu->sregs[CS] = cpu_pop(cpu);
+      cpu->t += 18;
+      break;
+    case 0xcc: // INT 3
+      cpu_interrupt(cpu, 3);
+      cpu->t += 52;
+      break;
+    case 0xcd: // INT Ib
+      cpu_interrupt(cpu, fetch8(cpu));
+      cpu->t += 51;
+      break;
+    case 0xce: // INTO
+      if (cpu->flags & FLAG_OF) {
+        cpu_interrupt(cpu, 4);
+        cpu->t += 53;
+      } else {
+        cpu->t += 4;
+      }
+      break;
+    case 0xcf: // IRET
+      cpu->ip = cpu_pop(cpu);
+      cpu->sregs[CS] = cpu_pop(cpu);
+      cpu->flags = (cpu_pop(cpu) & FLAGS_MASK) | FLAGS_FIXED;
+      cpu->t += 24;
+      break;
+
+    case 0xd0:
+    case 0xd1:
+    case 0xd2:
+    case 0xd3: { // Group 2 by 1 / by CL
+      const int w = op & 1;
+      const unsigned count = (op & 2) ? (cpu->regs[CX] & 0xff) : 1;
+      decode_modrm(cpu, &m);
+      set_rm(cpu, &m, w, shift(cpu, m.reg, get_rm(cpu, &m, w), count, w));
+      if (op & 2) {
+        cpu->t += ((m.mod == 3) ? 8 : 20) + 4 * count;
+      } else {
+        cpu->t += (m.mod == 3) ? 2 : 15;
+      }
+      break;
+    }
+    case 0xd4: { // AAM
+      const uint8_t base = fetch8(cpu);
+      const uint8_t al = cpu->regs[AX];
+      if (!base) {
+        cpu_interrupt(cpu, 0);
+        break;
+      }
+      cpu->regs[AX] = ((al / base) << 8) | (al % base);
+      set_szp(cpu, 0, cpu->regs[AX]);
+      cpu->t += 83;
+      break;
+    }
+    case 0xd5: { // AAD
+      const uint8_t base = fetch8(cpu);
+      const uint8_t al = cpu->regs[AX] + (cpu->regs[AX] >> 8) * base;
+      cpu->regs[AX] = al;
+      set_szp(cpu, 0, al);
+      cpu->t += 60;
+      break;
+    }
+    case 0xd6: // SALC (undocumented)
+      set_r8(cpu, AX, (cpu->flags & FLAG_CF) ? 0xff : 0);
+      cpu->t += 3;
+      break;
+    case 0xd7: // XLAT
+      set_r8(cpu, AX,
+             read8(cpu, data_seg(cpu, DS),
+                   cpu->regs[BX] + (cpu->regs[AX] & 0xff)));
+      cpu->t += 11;
+      break;
+    case 0xd8: case 0xd9: case 0xda: case 0xdb:
+    case 0xdc: case 0xdd: case 0xde: case 0xdf: // ESC: no FPU.
+      decode_modrm(cpu, &m);
+      cpu->t += 2;
+      break;
+
+    case 0xe0:
+    case 0xe1:
+    case 0xe2: { // LOOPNE / LOOPE / LOOP
+      const int8_t disp = fetch8(cpu);
+      const int zf = (cpu->flags & FLAG_ZF) != 0;
+      const int taken = (--cpu->regs[CX] != 0) &&
+                        ((op == 0xe2) || ((op == 0xe1) ? zf : !zf));
+      if (taken) {
+        jump_rel(cpu, disp);
+      }
+      cpu->t += (op == 0xe2) ? (taken ? 17 : 5)
+                             : ((op == 0xe1) ? (taken ? 18 : 6)
+                                             : (taken ? 19 : 5));
+      break;
+    }
+    case 0xe3: { // JCXZ
+      const int8_t disp = fetch8(cpu);
+      if (!cpu->regs[CX]) {
+        jump_rel(cpu, disp);
+        cpu->t += 18;
+      } else {
+        cpu->t += 6;
+      }
+      break;
+    }
+    case 0xe4:
+    case 0xe5: // IN AL/AX,Ib: nothing is there.
+      fetch8(cpu);
+      set_reg(cpu, AX, op & 1, 0xffff);
+      cpu->t += 10;
+      break;
+    case 0xe6:
+    case 0xe7: // OUT Ib,AL/AX
+      fetch8(cpu);
+      cpu->t += 10;
+      break;
+    case 0xe8: { // CALL near
+      const int16_t disp = fetch16(cpu);
+      cpu_push(cpu, cpu->ip);
+      jump_rel(cpu, disp);
+      cpu->t += 19;
+      break;
+    }
+    case 0xe9: { // JMP near
+      const int16_t disp = fetch16(cpu);
+      jump_rel(cpu, disp);
+      cpu->t += 15;
+      break;
+    }
+    case 0xea: { // JMP far
+      const uint16_t off = fetch16(cpu);
+      far_jump(cpu, fetch16(cpu), off);
+      cpu->t += 15;
+      break;
+    }
+    case 0xeb: { // JMP short
+      const int8_t disp = fetch8(cpu);
+      jump_rel(cpu, disp);
+      cpu->t += 15;
+      break;
+    }
+    case 0xec:
+    case 0xed: // IN AL/AX,DX
+      set_reg(cpu, AX, op & 1, 0xffff);
+      cpu->t += 8;
+      break;
+    case 0xee:
+    case 0xef: // OUT DX,AL/AX
+      cpu->t += 8;
+      break;
+
+    case 0xf4: // HLT
+      cpu->error = "HLT";
+      return -1;
+    case 0xf5: // CMC
+      cpu->flags ^= FLAG_CF;
+      cpu->t += 2;
+      break;
+    case 0xf6:
+    case 0xf7: // Group 3
+      decode_modrm(cpu, &m);
+      group3(cpu, &m, op & 1);
+      break;
+    case 0xf8: // CLC
+      cpu->flags &= ~FLAG_CF;
+      cpu->t += 2;
+      break;
+    case 0xf9: // STC
+      cpu->flags |= FLAG_CF;
+      cpu->t += 2;
+      break;
+    case 0xfa: // CLI
+      cpu->flags &= ~FLAG_IF;
+      cpu->t += 2;
+      break;
+    case 0xfb: // STI
+      cpu->flags |= FLAG_IF;
+      cpu->t += 2;
+      break;
+    case 0xfc: // CLD
+      cpu->flags &= ~FLAG_DF;
+      cpu->t += 2;
+      break;
+    case 0xfd: // STD
+      cpu->flags |= FLAG_DF;
+      cpu->t += 2;
+      break;
+    case 0xfe: // Group 4: INC / DEC Eb
+      decode_modrm(cpu, &m);
+      if (m.reg > 1) {
+        cpu->error = "bad opcode (fe)";
+        return -1;
+      }
+      set_rm(cpu, &m, 0, inc_dec(cpu, get_rm(cpu, &m, 0), 0, m.reg));
+      cpu->t += (m.mod == 3) ? 3 : 15;
+      break;
+    case 0xff: // Group 5
+      decode_modrm(cpu, &m);
+      switch (m.reg) {
+        case 0:
+        case 1: // INC / DEC Ev
+          set_rm(cpu, &m, 1, inc_dec(cpu, get_rm(cpu, &m, 1), 1, m.reg));
+          cpu->t += (m.mod == 3) ? 2 : 15;
+          break;
+        case 2: { // CALL near Ev
+          const uint16_t target = get_rm(cpu, &m, 1);
+          cpu_push(cpu, cpu->ip);
+          cpu->ip = target;
+          cpu->t += (m.mod == 3) ? 16 : 21;
+          break;
+        }
+        case 3: { // CALL far Mp
+          const uint16_t off = read16(cpu, m.seg, m.off);
+          const uint16_t seg = read16(cpu, m.seg, m.off + 2);
+          cpu_push(cpu, cpu->sregs[CS]);
+          cpu_push(cpu, cpu->ip);
+          far_jump(cpu, seg, off);
+          cpu->t += 37;
+          break;
+        }
+        case 4: // JMP near Ev
+          cpu->ip = get_rm(cpu, &m, 1);
+          cpu->t += (m.mod == 3) ? 11 : 18;
+          break;
+        case 5: { // JMP far Mp
+          const uint16_t off = read16(cpu, m.seg, m.off);
+          far_jump(cpu, read16(cpu, m.seg, m.off + 2), off);
+          cpu->t += 24;
+          break;
+        }
+        case 6: // PUSH Ev
+          cpu_push(cpu, get_rm(cpu, &m, 1));
+          cpu->t += (m.mod == 3) ? 11 : 16;
+          break;
+        default:
+          cpu->error = "bad opcode (ff)";
+          return -1;
+      }
+      break;
+
+    default:
+      cpu->error = "unimplemented opcode";
+      return -1;
+  }
+
+  return 0;
+}
+
+int cpu_run(struct Cpu *cpu, uint64_t max_instructions) {
+  cpu->error = NULL;
+
+  for (uint64_t n = 0; n < max_instructions; ++n) {
+    if ((cpu->sregs[CS] == ROM_SEG) && (cpu->ip < ROM_TRAP_LEN)) {
+      if (cpu->trap(cpu)) {
+        return 0;
+      }
+      continue;
+    }
+
+    const uint16_t start_cs = cpu->sregs[CS];
+    const uint16_t start_ip = cpu->ip;
+    cpu->t = 0;
+    cpu->word_accesses = 0;
+    cpu->odd_word_accesses = 0;
+    cpu->fetched = 0;
+
+    if (0 > step(cpu)) {
+      // Leave CS:IP at the instruction, for the error message.
+      cpu->sregs[CS] = start_cs;
+      cpu->ip = start_ip;
+      return -1;
+    }
+
+    const unsigned t86 = cpu->t + 4 * cpu->odd_word_accesses;
+    const unsigned t88 = cpu->t + 4 * cpu->word_accesses;
+    ++cpu->instructions;
+    cpu->cycles_8086 += t86;
+    cpu->cycles_8088 += (t88 > 4 * cpu->fetched) ? t88 : 4 * cpu->fetched;
+  }
+
+  cpu->error = "instruction limit reached";
+  return -1;
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Cycle accounting harness: runs the real `rmtdos.com` on a small 8086
+// interpreter (cycles/cpu.c) inside a fake PC (cycles/pc.c), whose BIOS,
+// DOS and packet driver are implemented in C.  Every instruction the server
+// executes is counted, with its cost from the 8086 timing tables, so the
+// time its interrupt handlers steal from DOS programs can be measured
+// without an old PC.
+
+#ifndef __RMTDOS_CYCLES_CYCLES_H
+#define __RMTDOS_CYCLES_CYCLES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 1 MiB, plus room for the 64 KiB a segment may reach past it.  Addresses
+// wrap at 1 MiB, as on the 8086, so the slack is never used.
+#define CPU_MEM_SIZE 0x110000
+
+// Register indexes, in ModR/M order.
+enum CpuReg { AX, CX, DX, BX, SP, BP, SI, DI };
+enum CpuSeg { ES, CS, SS, DS };
+
+#define FLAG_CF 0x0001
+#define FLAG_PF 0x0004
+#define FLAG_AF 0x0010
+#define FLAG_ZF 0x0040
+#define FLAG_SF 0x0080
+#define FLAG_TF 0x0100
+#define FLAG_IF 0x0200
+#define FLAG_DF 0x0400
+#define FLAG_OF 0x0800
+
+// Instructions at F000:0000 to F000:0fff are not run; they trap to C.
+#define ROM_SEG 0xf000
+#define ROM_TRAP_LEN 0x1000
+
+struct Cpu {
+  uint16_t regs[8];
+  uint16_t sregs[4];
+  uint16_t ip;
+  uint16_t flags;
+  uint8_t *mem;
+
+  // Totals since `cpu_init()`.
+  uint64_t instructions;
+  uint64_t cycles_8086; // Intel's 8086 timings, plus odd word accesses.
+  uint64_t cycles_8088; // The same on the 8088's 8-bit bus.
+
+  // Called instead of running code in the trap region.  Returns 0 to carry
+  // on from the (possibly changed) CS:IP, non-zero to stop `cpu_run()`.
+  int (*trap)(struct Cpu *cpu);
+  void *ctx;
+
+  // Why `cpu_run()` stopped, when not by a trap.
+  const char *error;
+
+  // Cost of the instruction being run.
+  unsigned t;
+  unsigned word_accesses;
+  unsigned odd_word_accesses;
+  unsigned fetched;
+  int seg_override; // -1 if none.
+};
+
+// cycles/cpu.c
+
+extern void cpu_init(struct Cpu *cpu, uint8_t *mem);
+
+// Runs until a trap asks to stop, an error, or `max_instructions`.  Returns
+// 0 when stopped by a trap, <0 otherwise (`cpu->error` says why).
+extern int cpu_run(struct Cpu *cpu, uint64_t max_instructions);
+
+// Enters interrupt `vec` as the hardware would: pushes FLAGS, CS and IP,
+// clears IF and TF, and jumps through the vector table.
+extern void cpu_interrupt(struct Cpu *cpu, uint8_t vec);
+
+extern void cpu_push(struct Cpu *cpu, uint16_t value);
+extern uint16_t cpu_pop(struct Cpu *cpu);
+
+static inline uint32_t cpu_linear(uint16_t seg, uint16_t off) {
+  return (((uint32_t)seg << 4) + off) & 0xfffff;
+}
+
+static inline uint8_t *cpu_ptr(struct Cpu *cpu, uint16_t seg, uint16_t off) {
+  return &cpu->mem[cpu_linear(seg, off)];
+}
+
+static inline uint16_t cpu_peek16(struct Cpu *cpu, uint16_t seg,
+                                  uint16_t off) {
+  return cpu->mem[cpu_linear(seg, off)] |
+         (cpu->mem[cpu_linear(seg, off + 1)] << 8);
+}
+
+static inline void cpu_poke16(struct Cpu *cpu, uint16_t seg, uint16_t off,
+                              uint16_t value) {
+  cpu->mem[cpu_linear(seg, off)] = value;
+  cpu->mem[cpu_linear(seg, off + 1)] = value >> 8;
+}
+
+// cycles/pc.c
+
+// Fake PC: BIOS data area, VGA text buffer, DOS, and a packet driver at
+// int 60h.  Frames the server sends are passed to `on_send`.
+struct Pc {
+  struct Cpu cpu;
+  uint8_t *mem;
+
+  uint8_t mac_addr[6];
+  uint16_t psp;
+  uint16_t rx_handle;     // From `access_type()`, 0 if none.
+  uint16_t rx_seg;        // Receiver, from `access_type()`.
+  uint16_t rx_off;
+  int resident;           // Went TSR (int 21h, AH=31h).
+  int exit_code;          // -1 while running.
+  unsigned keys_injected; // int 16h, AH=05h.
+  int echo_dos_output;
+
+  void (*on_send)(struct Pc *pc, const uint8_t *frame, size_t len);
+  void *ctx;
+};
+
+// Returns <0 if out of memory.
+extern int pc_init(struct Pc *pc, const uint8_t *mac_addr);
+
+// Loads a .COM program with command line `args`.  Returns <0 on error.
+extern int pc_load_com(struct Pc *pc, const char *path, const char *args);
+
+// Runs the loaded program until it exits or goes resident.  Returns <0 if
+// it exits (or fails) instead.
+extern int pc_run_until_resident(struct Pc *pc);
+
+// Fires a hardware interrupt (as from the 8259) and runs its handler, and
+// every handler it chains to, to completion.  Returns <0 on error.
+extern int pc_hw_interrupt(struct Pc *pc, uint8_t vec);
+
+// Delivers a received frame through the server's packet driver receiver,
+// as the driver does (first upcall for a buffer, then the "copied" upcall).
+// Returns 1 if the server took it, 0 if dropped, <0 on error.
+extern int pc_receive(struct Pc *pc, const uint8_t *frame, size_t len);
+
+// VGA text buffer at B800:0000.
+extern uint8_t *pc_text_buffer(struct Pc *pc);
+
+#endif // __RMTDOS_CYCLES_CYCLES_H
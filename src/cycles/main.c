@@ -0,0 +1,531 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Counts the cycles the resident server steals from DOS programs, by
+// running the real `rmtdos.com` on an 8086 interpreter:
+//
+//   out/rmtdos-cycles                    # out/rmtdos.com, built-in script
+//   out/rmtdos-cycles -s busy.txt out/rmtdos.com
+//
+// The program is loaded into a fake PC (cycles/pc.c) and run until it goes
+// resident.  A script then fires its int 08h handler and feeds frames to its
+// packet driver receiver, while drawing on the text screen, grouped into
+// named phases.  For every phase and entry point the report gives the
+// instructions and cycles per call, average and worst, on the 8086 and on
+// the 8088 of the IBM PC, and the worst case in microseconds at 4.77 MHz.
+//
+// Script commands, one per line ('#' starts a comment):
+//
+//   phase NAME        Start a new section of the report.
+//   client N          Following `recv` commands come from client N (1-250).
+//   recv ping|status|stats|session
+//   recv keys TEXT    Frames from the current client, through the receiver.
+//   churn N           Change N random screen cells before every tick.
+//   screen fill C     Fill the screen with the character C.
+//   screen row R TEXT Write TEXT on row R.
+//   ticks N           Fire int 08h N times.
+//   int VEC           Fire interrupt VEC (hex), e.g. "int 28".
+//
+// The figures are the sum of Intel's published instruction timings, plus
+// the bus cycles of word accesses at odd addresses on the 8086, and of every
+// byte moved over the 8-bit bus of the 8088.  The prefetch queue, wait
+// states, DRAM refresh and DMA are not modeled, so real hardware is a little
+// slower; compare runs with each other, not with a stopwatch.
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/protocol.h"
+#include "cycles/cycles.h"
+
+#define MAX_ROWS 128
+#define MAX_LINE 256
+
+// Clock of the IBM PC and XT, and cycles between two timer ticks.
+#define PC_CLOCK_HZ 4772727.0
+#define CYCLES_PER_TICK (PC_CLOCK_HZ * 65536.0 / 1193182.0)
+
+#define TEXT_COLS 80
+#define TEXT_ROWS 25
+
+// Smallest Ethernet frame, as padded by the sending driver.
+#define MIN_ETH_FRAME_SIZE 60
+
+static const char *g_default_script =
+    "# No client: the cost every DOS program pays.\n"
+    "phase idle\n"
+    "ticks 36\n"
+    "\n"
+    "# A client connects; the server sends the whole screen.\n"
+    "phase connect\n"
+    "recv session\n"
+    "ticks 30\n"
+    "\n"
+    "# Nothing on the screen changes.\n"
+    "phase static\n"
+    "recv session\n"
+    "ticks 36\n"
+    "\n"
+    "# One cell changes per tick, as when typing.\n"
+    "phase typing\n"
+    "recv session\n"
+    "churn 1\n"
+    "ticks 36\n"
+    "\n"
+    "# Every cell changes every tick.\n"
+    "phase redraw\n"
+    "recv session\n"
+    "churn 2000\n"
+    "ticks 36\n"
+    "churn 0\n"
+    "\n"
+    "# Requests from the client.\n"
+    "phase requests\n"
+    "recv ping\n"
+    "recv status\n"
+    "recv stats\n"
+    "recv keys dir\n"
+    "ticks 4\n"
+    "\n"
+    "# As many viewers as the server has session slots.\n"
+    "phase 4-clients\n"
+    "client 1\n"
+    "recv session\n"
+    "client 2\n"
+    "recv session\n"
+    "client 3\n"
+    "recv session\n"
+    "client 4\n"
+    "recv session\n"
+    "churn 80\n"
+    "ticks 36\n";
+
+struct Options {
+  const char *com_path;
+  const char *args;
+  const char *script_path;
+  uint8_t mac_addr[ETH_ALEN];
+  int quiet;
+};
+
+// One line of the report: one entry point during one phase.
+struct Row {
+  char phase[32];
+  char isr[8];
+  unsigned calls;
+  uint64_t instructions;
+  uint64_t cycles_8086;
+  uint64_t cycles_8088;
+  uint64_t max_instructions;
+  uint64_t max_8086;
+  uint64_t max_8088;
+  unsigned frames_sent;
+  uint64_t bytes_sent;
+};
+
+struct Harness {
+  struct Pc pc;
+  struct Row rows[MAX_ROWS];
+  int row_count;
+  char phase[32];
+  struct Row *current; // Row of the call being run.
+  uint8_t client;      // Last byte of the client's MAC, and session ID.
+  unsigned churn;
+  unsigned frames_dropped;
+};
+
+static struct Harness g_harness;
+
+static int parse_mac_addr(uint8_t *dest, const char *s) {
+  unsigned int a[ETH_ALEN];
+
+  if (ETH_ALEN != sscanf(s, "%x:%x:%x:%x:%x:%x", &a[0], &a[1], &a[2], &a[3],
+                         &a[4], &a[5])) {
+    return -1;
+  }
+  for (int i = 0; i < ETH_ALEN; ++i) {
+    dest[i] = a[i];
+  }
+  return 0;
+}
+
+static struct Row *find_row(struct Harness *h, const char *isr) {
+  for (int i = 0; i < h->row_count; ++i) {
+    if (!strcmp(h->rows[i].phase, h->phase) && !strcmp(h->rows[i].isr, isr)) {
+      return &h->rows[i];
+    }
+  }
+
+  if (h->row_count >= MAX_ROWS) {
+    return NULL;
+  }
+  struct Row *row = &h->rows[h->row_count++];
+  memset(row, 0, sizeof(*row));
+  snprintf(row->phase, sizeof(row->phase), "%s", h->phase);
+  snprintf(row->isr, sizeof(row->isr), "%s", isr);
+  return row;
+}
+
+static void on_send(struct Pc *pc, const uint8_t *frame, size_t len) {
+  struct Harness *h = (struct Harness *)pc->ctx;
+
+  if (h->current) {
+    h->current->frames_sent++;
+    h->current->bytes_sent += len;
+  }
+}
+
+// Runs `call` and charges what it ran to the row for `isr`.
+static int account(struct Harness *h, const char *isr,
+                   int (*call)(struct Harness *h, const void *arg),
+                   const void *arg) {
+  struct Cpu *cpu = &h->pc.cpu;
+  struct Row *row = find_row(h, isr);
+  const uint64_t instructions = cpu->instructions;
+  const uint64_t cycles_8086 = cpu->cycles_8086;
+  const uint64_t cycles_8088 = cpu->cycles_8088;
+  int r;
+
+  if (!row) {
+    fprintf(stderr, "cycles: too many phases\n");
+    return -1;
+  }
+
+  h->current = row;
+  r = call(h, arg);
+  h->current = NULL;
+  if (0 > r) {
+    return r;
+  }
+
+  const uint64_t di = cpu->instructions - instructions;
+  const uint64_t d86 = cpu->cycles_8086 - cycles_8086;
+  const uint64_t d88 = cpu->cycles_8088 - cycles_8088;
+  row->calls++;
+  row->instructions += di;
+  row->cycles_8086 += d86;
+  row->cycles_8088 += d88;
+  row->max_instructions = (di > row->max_instructions) ? di : row->max_instructions;
+  row->max_8086 = (d86 > row->max_8086) ? d86 : row->max_8086;
+  row->max_8088 = (d88 > row->max_8088) ? d88 : row->max_8088;
+  return r;
+}
+
+static int call_interrupt(struct Harness *h, const void *arg) {
+  return pc_hw_interrupt(&h->pc, *(const uint8_t *)arg);
+}
+
+struct Frame {
+  uint8_t data[ETH_FRAME_LEN];
+  size_t len;
+};
+
+static int call_receive(struct Harness *h, const void *arg) {
+  const struct Frame *frame = (const struct Frame *)arg;
+  const int r = pc_receive(&h->pc, frame->data, frame->len);
+
+  if (!r) {
+    h->frames_dropped++;
+  }
+  return r;
+}
+
+static void build_frame(struct Harness *h, struct Frame *frame,
+                        uint16_t pkt_type, const void *payload,
+                        size_t payload_len) {
+  struct ether_header *eh = (struct ether_header *)frame->data;
+  struct ProtocolHeader *ph = (struct ProtocolHeader *)(eh + 1);
+
+  memset(frame->data, 0, sizeof(frame->data));
+  memcpy(eh->ether_dhost, h->pc.mac_addr, ETH_ALEN);
+  eh->ether_shost[0] = 0x02;
+  eh->ether_shost[1] = 'C';
+  eh->ether_shost[2] = 'Y';
+  eh->ether_shost[5] = h->client;
+  eh->ether_type = htons(ETHERTYPE_RMTDOS);
+
+  ph->signature = htonl(PACKET_SIGNATURE);
+  ph->session_id = htonl(h->client);
+  ph->payload_len = htons(payload_len);
+  ph->pkt_type = htons(pkt_type);
+  memcpy(ph + 1, payload, payload_len);
+
+  frame->len = COMBINED_HEADER_LEN + payload_len;
+  if (frame->len < MIN_ETH_FRAME_SIZE) {
+    frame->len = MIN_ETH_FRAME_SIZE;
+  }
+}
+
+static int recv_frame(struct Harness *h, const char *what, const char *text) {
+  struct Keystroke keys[MAX_PAYLOAD_LENGTH / sizeof(struct Keystroke)];
+  struct Frame frame;
+  static const uint8_t ping[32] = "rmtdos-cycles ping";
+
+  if (!strcmp(what, "ping")) {
+    build_frame(h, &frame, V1_PING, ping, sizeof(ping));
+  } else if (!strcmp(what, "status")) {
+    build_frame(h, &frame, V1_STATUS_REQ, NULL, 0);
+  } else if (!strcmp(what, "stats")) {
+    build_frame(h, &frame, V1_STATS_REQ, NULL, 0);
+  } else if (!strcmp(what, "session")) {
+    build_frame(h, &frame, V1_SESSION_START, NULL, 0);
+  } else if (!strcmp(what, "keys") && text) {
+    size_t count = 0;
+    for (; text[count] && (count < sizeof(keys) / sizeof(keys[0])); ++count) {
+      keys[count].bios_scan_code = 0;
+      keys[count].ascii_value = text[count];
+      keys[count].flags_17 = 0;
+    }
+    build_frame(h, &frame, V1_INJECT_KEYSTROKE, keys, count * sizeof(keys[0]));
+  } else {
+    return -1;
+  }
+
+  return account(h, "rx", call_receive, &frame);
+}
+
+static void churn_screen(struct Harness *h) {
+  uint8_t *text = pc_text_buffer(&h->pc);
+
+  for (unsigned i = 0; i < h->churn; ++i) {
+    const int cell = rand() % (TEXT_COLS * TEXT_ROWS);
+    text[2 * cell] = ' ' + rand() % 95;
+    text[2 * cell + 1] = 1 + rand() % 15;
+  }
+}
+
+static int fire(struct Harness *h, uint8_t vec) {
+  char isr[8];
+
+  snprintf(isr, sizeof(isr), "int%02x", vec);
+  return account(h, isr, call_interrupt, &vec);
+}
+
+// Runs one script line.  Returns <0 on error.
+static int run_command(struct Harness *h, char *line) {
+  char *cmd = strtok(line, " \t");
+  char *arg = strtok(NULL, " \t");
+  char *rest = strtok(NULL, "");
+
+  if (!cmd || (cmd[0] == '#')) {
+    return 0;
+  }
+
+  if (!strcmp(cmd, "phase") && arg) {
+    snprintf(h->phase, sizeof(h->phase), "%s", arg);
+  } else if (!strcmp(cmd, "client") && arg) {
+    const int client = atoi(arg);
+    if ((client < 1) || (client > 250)) {
+      return -1;
+    }
+    h->client = client;
+  } else if (!strcmp(cmd, "recv") && arg) {
+    return recv_frame(h, arg, rest);
+  } else if (!strcmp(cmd, "churn") && arg) {
+    h->churn = atoi(arg);
+  } else if (!strcmp(cmd, "screen") && arg && rest) {
+    uint8_t *text = pc_text_buffer(&h->pc);
+    if (!strcmp(arg, "fill")) {
+      for (int i = 0; i < TEXT_COLS * TEXT_ROWS; ++i) {
+        text[2 * i] = rest[0];
+      }
+    } else if (!strcmp(arg, "row")) {
+      const int row = atoi(rest);
+      const char *s = strchr(rest, ' ');
+      if ((row < 0) || (row >= TEXT_ROWS)) {
+        return -1;
+      }
+      for (int col = 0; s && s[1 + col] && (col < TEXT_COLS); ++col) {
+        text[2 * (row * TEXT_COLS + col)] = s[1 + col];
+      }
+    } else {
+      return -1;
+    }
+  } else if (!strcmp(cmd, "ticks") && arg) {
+    for (int i = atoi(arg); i > 0; --i) {
+      churn_screen(h);
+      if (0 > fire(h, 0x08)) {
+        return -2;
+      }
+    }
+  } else if (!strcmp(cmd, "int") && arg) {
+    return fire(h, strtoul(arg, NULL, 16));
+  } else {
+    return -1;
+  }
+
+  return 0;
+}
+
+static int run_script(struct Harness *h, char *script, const char *name) {
+  int line_no = 0;
+
+  for (char *line = script; line;) {
+    char *next = strchr(line, '\n');
+    char copy[MAX_LINE];
+    int r;
+
+    if (next) {
+      *next++ = 0;
+    }
+    ++line_no;
+
+    snprintf(copy, sizeof(copy), "%s", line);
+    if (0 > (r = run_command(h, line))) {
+      if (r == -1) {
+        fprintf(stderr, "%s:%d: bad command: %s\n", name, line_no, copy);
+      }
+      return -1;
+    }
+    line = next;
+  }
+
+  return 0;
+}
+
+static char *read_file(const char *path) {
+  FILE *fp = fopen(path, "r");
+  char *buf = NULL;
+  long len;
+
+  if (!fp) {
+    perror(path);
+    return NULL;
+  }
+  if (!fseek(fp, 0, SEEK_END) && (0 <= (len = ftell(fp))) &&
+      !fseek(fp, 0, SEEK_SET) && (buf = (char *)malloc(len + 1))) {
+    buf[fread(buf, 1, len, fp)] = 0;
+  }
+  fclose(fp);
+  return buf;
+}
+
+static void print_report(const struct Harness *h) {
+  printf("\n%-12s %-5s %6s %7s %7s %8s %8s %8s %8s %7s %6s %6s %8s\n",
+         "phase", "isr", "calls", "instr", "max", "8086", "max", "8088",
+         "max", "us-max", "%tick", "frames", "bytes");
+
+  for (int i = 0; i < h->row_count; ++i) {
+    const struct Row *row = &h->rows[i];
+    const double calls = row->calls ? row->calls : 1;
+
+    printf("%-12s %-5s %6u %7.0f %7llu %8.0f %8llu %8.0f %8llu %7.0f %6.2f "
+           "%6u %8llu\n",
+           row->phase, row->isr, row->calls, row->instructions / calls,
+           (unsigned long long)row->max_instructions,
+           row->cycles_8086 / calls, (unsigned long long)row->max_8086,
+           row->cycles_8088 / calls, (unsigned long long)row->max_8088,
+           row->max_8088 * 1e6 / PC_CLOCK_HZ,
+           100.0 * row->cycles_8088 / calls / CYCLES_PER_TICK,
+           row->frames_sent, (unsigned long long)row->bytes_sent);
+  }
+
+  printf("\ninstr, 8086, 8088: average per call, then worst.  us-max: worst "
+         "8088 call at 4.77 MHz.\n");
+  printf("%%tick: average 8088 call as a share of the %.0f cycles between "
+         "timer ticks.\n",
+         CYCLES_PER_TICK);
+  if (h->pc.keys_injected || h->frames_dropped) {
+    printf("Keystrokes injected: %u.  Frames dropped by the server: %u.\n",
+           h->pc.keys_injected, h->frames_dropped);
+  }
+}
+
+static void print_usage(const char *prog) {
+  printf("Usage: %s [-a args] [-m mac] [-q] [-s script] [rmtdos.com]\n", prog);
+  printf("  -a  Command line for rmtdos.com (default: none).\n");
+  printf("  -m  MAC address of the fake NIC (default: 02:43:59:00:00:fe).\n");
+  printf("  -q  Do not show what rmtdos.com prints.\n");
+  printf("  -s  Script to run (default: built in, see cycles/main.c).\n");
+  printf("Default program: out/rmtdos.com.\n");
+}
+
+int main(int argc, char **argv) {
+  struct Options opt = {
+      .com_path = "out/rmtdos.com",
+      .args = "",
+      .mac_addr = {0x02, 0x43, 0x59, 0x00, 0x00, 0xfe},
+  };
+  struct Harness *h = &g_harness;
+  char *script = NULL;
+  int c;
+
+  while ((c = getopt(argc, argv, "a:hm:qs:")) != -1) {
+    switch (c) {
+      case 'a':
+        opt.args = optarg;
+        break;
+      case 'h':
+        print_usage(argv[0]);
+        return EXIT_SUCCESS;
+      case 'm':
+        if (0 > parse_mac_addr(opt.mac_addr, optarg)) {
+          fprintf(stderr, "Bad MAC address: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'q':
+        opt.quiet = 1;
+        break;
+      case 's':
+        opt.script_path = optarg;
+        break;
+      default:
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (optind + 1 == argc) {
+    opt.com_path = argv[optind];
+  } else if (optind < argc) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  script = opt.script_path ? read_file(opt.script_path)
+                           : strdup(g_default_script);
+  if (!script) {
+    return EXIT_FAILURE;
+  }
+
+  if (0 > pc_init(&h->pc, opt.mac_addr)) {
+    fprintf(stderr, "Out of memory.\n");
+    return EXIT_FAILURE;
+  }
+  h->pc.on_send = on_send;
+  h->pc.ctx = h;
+  h->pc.echo_dos_output = !opt.quiet;
+  h->client = 1;
+  snprintf(h->phase, sizeof(h->phase), "main");
+  srand(1);
+
+  if ((0 > pc_load_com(&h->pc, opt.com_path, opt.args)) ||
+      (0 > pc_run_until_resident(&h->pc))) {
+    return EXIT_FAILURE;
+  }
+  fflush(stdout);
+
+  printf("Resident after %llu instructions, %llu 8088 cycles.\n",
+         (unsigned long long)h->pc.cpu.instructions,
+         (unsigned long long)h->pc.cpu.cycles_8088);
+  if (!h->pc.rx_handle) {
+    fprintf(stderr, "cycles: no packet driver receiver was registered\n");
+    return EXIT_FAILURE;
+  }
+
+  if (0 > run_script(h, script,
+                     opt.script_path ? opt.script_path : "(built in)")) {
+    print_report(h);
+    return EXIT_FAILURE;
+  }
+
+  print_report(h);
+  free(script);
+  return EXIT_SUCCESS;
+}
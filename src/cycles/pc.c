@@ -0,0 +1,515 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// A fake PC for the cycle harness.  Every interrupt vector points into the
+// trap region of the ROM segment (F000:vec*16), where the BIOS, DOS and the
+// packet driver are implemented in C, so none of their instructions are
+// counted.  Only the code of the program under test is.
+//
+// Memory map:
+//   0000:0000  Interrupt vectors
+//   0040:0000  BIOS data area
+//   0f00:0000  Environment of the program
+//   1000:0000  PSP, and the .COM program at 1000:0100
+//   9000:0000  Stack of the interrupted DOS program (and of the driver)
+//   b800:0000  VGA text buffer
+//   f000:0000  Trap region; f000:0ff0 returns control to the harness
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/ethernet.h"
+#include "cycles/cycles.h"
+
+#define BIOS_DATA_SEG 0x0040
+#define ENV_SEG 0x0f00
+#define PSP_SEG 0x1000
+#define APP_STACK_SEG 0x9000
+#define TEXT_SEG 0xb800
+
+// Returns to the harness, as the "interrupted program".
+#define RETURN_TRAP 0x0ff0
+
+#define PKTDRV_VEC 0x60
+#define PKTDRV_NAME_OFF 0x1100
+#define PKTDRV_PARAMS_OFF 0x1120
+#define PKTDRV_STATS_OFF 0x1140
+
+// Packet driver functions and errors used here.
+#define PD_DRIVER_INFO 1
+#define PD_ACCESS_TYPE 2
+#define PD_RELEASE_TYPE 3
+#define PD_SEND_PKT 4
+#define PD_GET_ADDRESS 6
+#define PD_GET_PARAMETERS 10
+#define PD_GET_STATISTICS 24
+#define PD_ERR_BAD_HANDLE 1
+#define PD_ERR_BAD_COMMAND 11
+
+// Instructions before a call into the program is given up on.
+#define MAX_CALL_INSTRUCTIONS 10000000ULL
+#define MAX_MAIN_INSTRUCTIONS 100000000ULL
+
+static const uint8_t g_tail_cr = 0x0d;
+
+static uint8_t get_ah(struct Cpu *cpu) { return cpu->regs[AX] >> 8; }
+static uint8_t get_al(struct Cpu *cpu) { return cpu->regs[AX] & 0xff; }
+
+static void set_carry(struct Cpu *cpu, int on) {
+  if (on) {
+    cpu->flags |= FLAG_CF;
+  } else {
+    cpu->flags &= ~FLAG_CF;
+  }
+}
+
+static void dos_putc(struct Pc *pc, uint8_t ch) {
+  if (pc->echo_dos_output) {
+    fputc(ch, stdout);
+  }
+}
+
+// int 10h: the video BIOS, for an 80x25 color VGA.
+static void bios_video(struct Pc *pc) {
+  struct Cpu *cpu = &pc->cpu;
+  uint8_t *bda = cpu_ptr(cpu, BIOS_DATA_SEG, 0);
+
+  switch (get_ah(cpu)) {
+    case 0x02: // Set cursor position.
+      bda[0x50] = cpu->regs[DX] & 0xff;
+      bda[0x51] = cpu->regs[DX] >> 8;
+      break;
+    case 0x03: // Get cursor position.
+      cpu->regs[DX] = (bda[0x51] << 8) | bda[0x50];
+      cpu->regs[CX] = 0x0607;
+      break;
+    case 0x0e: // Teletype.
+      dos_putc(pc, get_al(cpu));
+      break;
+    case 0x0f: // Get video mode.
+      cpu->regs[AX] = (bda[0x4a] << 8) | bda[0x49];
+      cpu->regs[BX] &= 0x00ff;
+      break;
+    case 0x12: // EGA information.
+      if ((cpu->regs[BX] & 0xff) == 0x10) {
+        cpu->regs[BX] = 0x0003;
+        cpu->regs[CX] = 0x0009;
+      }
+      break;
+    case 0x1a: // Display combination: VGA color.
+      if (get_al(cpu) == 0) {
+        cpu->regs[AX] = (cpu->regs[AX] & 0xff00) | 0x1a;
+        cpu->regs[BX] = 0x0008;
+      }
+      break;
+  }
+}
+
+// int 16h: only "store keystroke" (AH=05h), into the BIOS ring.
+static void bios_keyboard(struct Pc *pc) {
+  struct Cpu *cpu = &pc->cpu;
+
+  if (get_ah(cpu) == 0x05) {
+    const uint16_t head = cpu_peek16(cpu, BIOS_DATA_SEG, 0x1a);
+    const uint16_t tail = cpu_peek16(cpu, BIOS_DATA_SEG, 0x1c);
+    const uint16_t next = (tail + 2 >= 0x3e) ? 0x1e : tail + 2;
+
+    if (next == head) {
+      cpu->regs[AX] = (cpu->regs[AX] & 0xff00) | 1;
+      return;
+    }
+    cpu_poke16(cpu, BIOS_DATA_SEG, tail, cpu->regs[CX]);
+    cpu_poke16(cpu, BIOS_DATA_SEG, 0x1c, next);
+    cpu->regs[AX] &= 0xff00;
+    ++pc->keys_injected;
+  }
+}
+
+// int 21h.  Returns non-zero to stop the CPU.
+static int dos(struct Pc *pc) {
+  struct Cpu *cpu = &pc->cpu;
+  const uint8_t ah = get_ah(cpu);
+  static uint8_t unsupported[256];
+
+  set_carry(cpu, 0);
+  switch (ah) {
+    case 0x02: // Character output.
+    case 0x06:
+      dos_putc(pc, cpu->regs[DX]);
+      break;
+    case 0x09: // "$" terminated string.
+      for (uint16_t off = cpu->regs[DX];; ++off) {
+        const uint8_t ch = *cpu_ptr(cpu, cpu->sregs[DS], off);
+        if (ch == '$') {
+          break;
+        }
+        dos_putc(pc, ch);
+      }
+      break;
+    case 0x19: // Current drive: C:.
+      cpu->regs[AX] = (cpu->regs[AX] & 0xff00) | 2;
+      break;
+    case 0x25: // Set vector.
+      cpu_poke16(cpu, 0, get_al(cpu) * 4, cpu->regs[DX]);
+      cpu_poke16(cpu, 0, get_al(cpu) * 4 + 2, cpu->sregs[DS]);
+      break;
+    case 0x30: // Version: 6.22.
+      cpu->regs[AX] = 0x1606;
+      cpu->regs[BX] = cpu->regs[CX] = 0;
+      break;
+    case 0x31: // Terminate and stay resident.
+      pc->resident = 1;
+      return 1;
+    case 0x35: // Get vector.
+      cpu->regs[BX] = cpu_peek16(cpu, 0, get_al(cpu) * 4);
+      cpu->sregs[ES] = cpu_peek16(cpu, 0, get_al(cpu) * 4 + 2);
+      break;
+    case 0x40: // Write.
+      if ((cpu->regs[BX] == 1) || (cpu->regs[BX] == 2)) {
+        for (uint16_t i = 0; i < cpu->regs[CX]; ++i) {
+          dos_putc(pc, *cpu_ptr(cpu, cpu->sregs[DS], cpu->regs[DX] + i));
+        }
+        cpu->regs[AX] = cpu->regs[CX];
+      } else {
+        cpu->regs[AX] = 6; // Invalid handle.
+        set_carry(cpu, 1);
+      }
+      break;
+    case 0x44: // IOCTL: handles 0 to 2 are the console.
+      if ((get_al(cpu) == 0) && (cpu->regs[BX] <= 2)) {
+        cpu->regs[DX] = 0x80d3;
+      } else {
+        cpu->regs[AX] = 1;
+        set_carry(cpu, 1);
+      }
+      break;
+    case 0x48: // Allocate: nothing free.
+      cpu->regs[AX] = 8;
+      cpu->regs[BX] = 0;
+      set_carry(cpu, 1);
+      break;
+    case 0x49: // Free.
+    case 0x4a: // Resize.
+      break;
+    case 0x4c: // Exit.
+      pc->exit_code = get_al(cpu);
+      return 1;
+    case 0x51: // Get PSP.
+    case 0x62:
+      cpu->regs[BX] = pc->psp;
+      break;
+    default:
+      if (!unsupported[ah]) {
+        fprintf(stderr, "cycles: unsupported int 21h, AH=%02xh\n", ah);
+        unsupported[ah] = 1;
+      }
+      cpu->regs[AX] = 1;
+      set_carry(cpu, 1);
+      break;
+  }
+
+  return 0;
+}
+
+// int 60h: a packet driver with one handle.
+static void packet_driver(struct Pc *pc) {
+  struct Cpu *cpu = &pc->cpu;
+  const uint8_t ah = get_ah(cpu);
+
+  set_carry(cpu, 0);
+  if ((ah != PD_ACCESS_TYPE) && (ah != PD_DRIVER_INFO) &&
+      (ah != PD_SEND_PKT) && (ah != PD_GET_PARAMETERS) &&
+      (cpu->regs[BX] != pc->rx_handle || !pc->rx_handle)) {
+    cpu->regs[DX] = (PD_ERR_BAD_HANDLE << 8) | (cpu->regs[DX] & 0xff);
+    set_carry(cpu, 1);
+    return;
+  }
+
+  switch (ah) {
+    case PD_DRIVER_INFO:
+      cpu->regs[BX] = 1; // Version.
+      cpu->regs[CX] = 1 << 8; // Class: Ethernet, number 0.
+      cpu->regs[DX] = 0xffff; // Type: generic.
+      cpu->regs[AX] = (cpu->regs[AX] & 0xff00) | 2; // Basic and extended.
+      cpu->sregs[DS] = ROM_SEG;
+      cpu->regs[SI] = PKTDRV_NAME_OFF;
+      break;
+    case PD_ACCESS_TYPE:
+      pc->rx_handle = 1;
+      pc->rx_seg = cpu->sregs[ES];
+      pc->rx_off = cpu->regs[DI];
+      cpu->regs[AX] = pc->rx_handle;
+      break;
+    case PD_RELEASE_TYPE:
+      pc->rx_handle = 0;
+      break;
+    case PD_SEND_PKT:
+      if (pc->on_send) {
+        uint8_t frame[ETH_FRAME_LEN];
+        const uint16_t len = (cpu->regs[CX] < sizeof(frame))
+                                 ? cpu->regs[CX]
+                                 : sizeof(frame);
+        for (uint16_t i = 0; i < len; ++i) {
+          frame[i] = *cpu_ptr(cpu, cpu->sregs[DS], cpu->regs[SI] + i);
+        }
+        pc->on_send(pc, frame, len);
+      }
+      break;
+    case PD_GET_ADDRESS:
+      for (int i = 0; (i < ETH_ALEN) && (i < cpu->regs[CX]); ++i) {
+        *cpu_ptr(cpu, cpu->sregs[ES], cpu->regs[DI] + i) = pc->mac_addr[i];
+      }
+      cpu->regs[CX] = ETH_ALEN;
+      break;
+    case PD_GET_PARAMETERS:
+      cpu->sregs[ES] = ROM_SEG;
+      cpu->regs[DI] = PKTDRV_PARAMS_OFF;
+      break;
+    case PD_GET_STATISTICS:
+      cpu->sregs[DS] = ROM_SEG;
+      cpu->regs[SI] = PKTDRV_STATS_OFF;
+      break;
+    default:
+      cpu->regs[DX] = (PD_ERR_BAD_COMMAND << 8) | (cpu->regs[DX] & 0xff);
+      set_carry(cpu, 1);
+      break;
+  }
+}
+
+// Returns from a trapped interrupt handler, keeping the carry flag it set.
+static void trap_iret(struct Cpu *cpu) {
+  const uint16_t cf = cpu->flags & FLAG_CF;
+
+  cpu->ip = cpu_pop(cpu);
+  cpu->sregs[CS] = cpu_pop(cpu);
+  cpu->flags = (cpu_pop(cpu) & ~FLAG_CF) | cf;
+}
+
+static int pc_trap(struct Cpu *cpu) {
+  struct Pc *pc = (struct Pc *)cpu->ctx;
+  const uint8_t vec = cpu->ip >> 4;
+  int stop = 0;
+
+  if (cpu->ip == RETURN_TRAP) {
+    return 1;
+  }
+
+  switch (vec) {
+    case 0x08: { // BIOS timer: count the tick.
+      const uint32_t ticks = cpu_peek16(cpu, BIOS_DATA_SEG, 0x6c) |
+                             ((uint32_t)cpu_peek16(cpu, BIOS_DATA_SEG, 0x6e)
+                              << 16);
+      cpu_poke16(cpu, BIOS_DATA_SEG, 0x6c, (ticks + 1) & 0xffff);
+      cpu_poke16(cpu, BIOS_DATA_SEG, 0x6e, (ticks + 1) >> 16);
+      break;
+    }
+    case 0x10:
+      bios_video(pc);
+      break;
+    case 0x16:
+      bios_keyboard(pc);
+      break;
+    case 0x1a: // Tick count.
+      cpu->regs[DX] = cpu_peek16(cpu, BIOS_DATA_SEG, 0x6c);
+      cpu->regs[CX] = cpu_peek16(cpu, BIOS_DATA_SEG, 0x6e);
+      cpu->regs[AX] &= 0xff00;
+      break;
+    case 0x20:
+      pc->exit_code = 0;
+      return 1;
+    case 0x21:
+      stop = dos(pc);
+      break;
+    case PKTDRV_VEC:
+      packet_driver(pc);
+      break;
+  }
+
+  if (!stop) {
+    trap_iret(cpu);
+  }
+  return stop;
+}
+
+int pc_init(struct Pc *pc, const uint8_t *mac_addr) {
+  memset(pc, 0, sizeof(*pc));
+  if (!(pc->mem = (uint8_t *)calloc(1, CPU_MEM_SIZE))) {
+    return -1;
+  }
+
+  cpu_init(&pc->cpu, pc->mem);
+  pc->cpu.trap = pc_trap;
+  pc->cpu.ctx = pc;
+  pc->exit_code = -1;
+  memcpy(pc->mac_addr, mac_addr, ETH_ALEN);
+
+  struct Cpu *cpu = &pc->cpu;
+  for (int vec = 0; vec < 256; ++vec) {
+    cpu_poke16(cpu, 0, vec * 4, vec * 16);
+    cpu_poke16(cpu, 0, vec * 4 + 2, ROM_SEG);
+  }
+
+  // The packet driver's signature, 3 bytes into its handler.
+  memcpy(cpu_ptr(cpu, ROM_SEG, PKTDRV_VEC * 16 + 3), "PKT DRVR", 9);
+  strcpy((char *)cpu_ptr(cpu, ROM_SEG, PKTDRV_NAME_OFF), "rmtdos-cycles");
+
+  // BIOS data area: 80x25 color text, empty keyboard ring.
+  cpu_poke16(cpu, BIOS_DATA_SEG, 0x10, 0x0020);
+  *cpu_ptr(cpu, BIOS_DATA_SEG, 0x49) = 3;
+  cpu_poke16(cpu, BIOS_DATA_SEG, 0x4a, 80);
+  cpu_poke16(cpu, BIOS_DATA_SEG, 0x1a, 0x1e);
+  cpu_poke16(cpu, BIOS_DATA_SEG, 0x1c, 0x1e);
+  cpu_poke16(cpu, BIOS_DATA_SEG, 0x80, 0x1e);
+  cpu_poke16(cpu, BIOS_DATA_SEG, 0x82, 0x3e);
+  cpu_poke16(cpu, BIOS_DATA_SEG, 0x63, 0x3d4);
+  *cpu_ptr(cpu, BIOS_DATA_SEG, 0x84) = 24;
+
+  uint8_t *text = pc_text_buffer(pc);
+  for (int i = 0; i < 80 * 25; ++i) {
+    text[2 * i] = ' ';
+    text[2 * i + 1] = 0x07;
+  }
+
+  return 0;
+}
+
+int pc_load_com(struct Pc *pc, const char *path, const char *args) {
+  struct Cpu *cpu = &pc->cpu;
+  FILE *fp = fopen(path, "rb");
+  size_t len;
+
+  if (!fp) {
+    perror(path);
+    return -1;
+  }
+  len = fread(cpu_ptr(cpu, PSP_SEG, 0x100), 1, 0xff00 - 0x100, fp);
+  fclose(fp);
+  if (!len) {
+    fprintf(stderr, "%s: empty\n", path);
+    return -1;
+  }
+
+  // Environment: no variables, then the program's path.
+  uint8_t *env = cpu_ptr(cpu, ENV_SEG, 0);
+  memcpy(env, "\0\0\1\0C:\\RMTDOS.COM", 18);
+
+  // PSP.
+  uint8_t *psp = cpu_ptr(cpu, PSP_SEG, 0);
+  const size_t tail_len = strlen(args) < 126 ? strlen(args) : 126;
+  psp[0] = 0xcd; // int 20h
+  psp[1] = 0x20;
+  cpu_poke16(cpu, PSP_SEG, 0x02, 0xa000); // Top of memory.
+  cpu_poke16(cpu, PSP_SEG, 0x2c, ENV_SEG);
+  psp[0x80] = tail_len;
+  memcpy(&psp[0x81], args, tail_len);
+  psp[0x81 + tail_len] = g_tail_cr;
+  pc->psp = PSP_SEG;
+
+  cpu->sregs[CS] = cpu->sregs[DS] = cpu->sregs[ES] = cpu->sregs[SS] = PSP_SEG;
+  cpu->ip = 0x100;
+  cpu->regs[SP] = 0xfffe;
+  cpu_poke16(cpu, PSP_SEG, 0xfffe, 0); // "ret" goes to int 20h.
+  cpu->regs[AX] = cpu->regs[BX] = 0;
+  cpu->regs[CX] = 0x00ff;
+  cpu->regs[DX] = PSP_SEG;
+  cpu->flags |= FLAG_IF;
+  return 0;
+}
+
+int pc_run_until_resident(struct Pc *pc) {
+  if (0 > cpu_run(&pc->cpu, MAX_MAIN_INSTRUCTIONS)) {
+    fprintf(stderr, "cycles: %s at %04x:%04x\n", pc->cpu.error,
+            pc->cpu.sregs[CS], pc->cpu.ip);
+    return -1;
+  }
+  if (!pc->resident) {
+    fprintf(stderr, "cycles: program exited (%d) instead of going "
+                    "resident\n",
+            pc->exit_code);
+    return -1;
+  }
+  return 0;
+}
+
+// Sets up the context the program is entered from: a DOS program running
+// on its own stack, interrupted at the return trap.
+static void enter_from_app(struct Cpu *cpu) {
+  cpu->sregs[SS] = APP_STACK_SEG;
+  cpu->regs[SP] = 0xfff0;
+  cpu->sregs[DS] = cpu->sregs[ES] = APP_STACK_SEG;
+  cpu->sregs[CS] = ROM_SEG;
+  cpu->ip = RETURN_TRAP;
+  cpu->flags |= FLAG_IF;
+}
+
+static int run_call(struct Pc *pc) {
+  if (0 > cpu_run(&pc->cpu, MAX_CALL_INSTRUCTIONS)) {
+    fprintf(stderr, "cycles: %s at %04x:%04x\n", pc->cpu.error,
+            pc->cpu.sregs[CS], pc->cpu.ip);
+    return -1;
+  }
+  return 0;
+}
+
+int pc_hw_interrupt(struct Pc *pc, uint8_t vec) {
+  struct Cpu *cpu = &pc->cpu;
+
+  enter_from_app(cpu);
+  cpu_interrupt(cpu, vec);
+
+  // Taking a hardware interrupt costs about what "int" does.
+  cpu->cycles_8086 += 61;
+  cpu->cycles_8088 += 61 + 4 * 3;
+  return run_call(pc);
+}
+
+// Far calls the receiver, as the driver does from its own interrupt.
+static int call_receiver(struct Pc *pc, uint16_t flag, uint16_t len) {
+  struct Cpu *cpu = &pc->cpu;
+
+  cpu->regs[AX] = flag;
+  cpu->regs[BX] = pc->rx_handle;
+  cpu->regs[CX] = len;
+  cpu_push(cpu, cpu->sregs[CS]);
+  cpu_push(cpu, cpu->ip);
+  cpu->sregs[CS] = pc->rx_seg;
+  cpu->ip = pc->rx_off;
+  return run_call(pc);
+}
+
+int pc_receive(struct Pc *pc, const uint8_t *frame, size_t len) {
+  struct Cpu *cpu = &pc->cpu;
+
+  if (!pc->rx_handle) {
+    return 0;
+  }
+
+  enter_from_app(cpu);
+  if (0 > call_receiver(pc, 0, len)) {
+    return -1;
+  }
+
+  const uint16_t seg = cpu->sregs[ES];
+  const uint16_t off = cpu->regs[DI];
+  if (!seg && !off) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < len; ++i) {
+    *cpu_ptr(cpu, seg, off + i) = frame[i];
+  }
+
+  cpu->sregs[DS] = seg;
+  cpu->regs[SI] = off;
+  if (0 > call_receiver(pc, 1, len)) {
+    return -1;
+  }
+  return 1;
+}
+
+uint8_t *pc_text_buffer(struct Pc *pc) {
+  return cpu_ptr(&pc->cpu, TEXT_SEG, 0);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <iconv.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "liblinux/cp437.h"
+
+char g_cp437_table[CP437_CHARS][CP437_WIDTH];
+
+static const char *control_chars[32] = {
+    " ",      "\u263a", "\u263b", "\u2665", "\u2666", "\u2663", "\u2660",
+    "\u2022", "\u25d8", "\u25cb", "\u25d9", "\u2642", "\u2640", "\u266a",
+    "\u266b", "\u263c", "\u25ba", "\u25c4", "\u2195", "\u203c", "\u00b6",
+    "\u00a7", "\u25ac", "\u21a8", "\u2191", "\u2193", "\u2192", "\u2190",
+    "\u221f", "\u2194", "\u25b2", "\u25bc",
+};
+
+void cp437_table_init() {
+  iconv_t cnv = iconv_open("UTF-8", "CP437");
+  if (!cnv) {
+    fprintf(stderr, "iconv_open(\"UTF-8\", \"CP437\") failed.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (int i = 0; i < 32; i++) {
+    strncpy(g_cp437_table[i], control_chars[i], CP437_WIDTH);
+  }
+
+  for (int i = 32; i < 256; i++) {
+    char src[2];
+    src[0] = i;
+    src[1] = 0;
+    char *c = src;
+    size_t in_size = sizeof(src);
+
+    char *d = g_cp437_table[i];
+    size_t out_size = CP437_WIDTH;
+
+    int r = iconv(cnv, &c, &in_size, &d, &out_size);
+    if (r == -1) {
+      fprintf(stderr, "iconv() for char 0x%02x failed.\n", i);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  strncpy(g_cp437_table[127], "\u2302", CP437_WIDTH);
+
+  iconv_close(cnv);
+}
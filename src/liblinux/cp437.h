@@ -0,0 +1,19 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Code page 437 (the VGA text mode character set) to UTF-8.
+
+#ifndef __RMTDOS_LIBLINUX_CP437_H
+#define __RMTDOS_LIBLINUX_CP437_H
+
+// Maps VGA text mode characters to unicode strings.
+#define CP437_CHARS 256
+#define CP437_WIDTH 8
+extern char g_cp437_table[CP437_CHARS][CP437_WIDTH];
+
+// Fills `g_cp437_table`.  Exits on failure.
+extern void cp437_table_init();
+
+#endif // __RMTDOS_LIBLINUX_CP437_H
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "liblinux/pcapfile.h"
+
+#define PCAP_MAGIC_USEC 0xa1b2c3d4
+#define PCAP_MAGIC_NSEC 0xa1b23c4d
+
+#define PCAP_FILE_HEADER_LEN 24
+#define PCAP_RECORD_HEADER_LEN 16
+
+static uint32_t get_u32(const struct PcapFile *pf, const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return pf->swapped ? __builtin_bswap32(v) : v;
+}
+
+int pcapfile_open(struct PcapFile *pf, const char *path) {
+  struct stat st;
+  int fd;
+
+  memset(pf, 0, sizeof(*pf));
+
+  if (0 > (fd = open(path, O_RDONLY | O_CLOEXEC))) {
+    perror(path);
+    return -1;
+  }
+
+  if (0 > fstat(fd, &st)) {
+    perror("fstat()");
+    close(fd);
+    return -1;
+  }
+
+  if ((size_t)st.st_size < PCAP_FILE_HEADER_LEN) {
+    fprintf(stderr, "%s: too short to be a pcap file.\n", path);
+    close(fd);
+    return -1;
+  }
+
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    perror("mmap()");
+    return -1;
+  }
+
+  pf->base = (const uint8_t *)base;
+  pf->size = st.st_size;
+
+  uint32_t magic;
+  memcpy(&magic, pf->base, sizeof(magic));
+  if ((magic == PCAP_MAGIC_USEC) || (magic == PCAP_MAGIC_NSEC)) {
+    pf->swapped = 0;
+  } else if ((__builtin_bswap32(magic) == PCAP_MAGIC_USEC) ||
+             (__builtin_bswap32(magic) == PCAP_MAGIC_NSEC)) {
+    pf->swapped = 1;
+    magic = __builtin_bswap32(magic);
+  } else {
+    fprintf(stderr, "%s: not a pcap file (pcapng is not supported).\n",
+            path);
+    pcapfile_release(pf);
+    return -1;
+  }
+
+  pf->nsec = (magic == PCAP_MAGIC_NSEC);
+  pf->linktype = get_u32(pf, pf->base + 20);
+  pf->pos = PCAP_FILE_HEADER_LEN;
+
+  return 0;
+}
+
+void pcapfile_release(struct PcapFile *pf) {
+  if (pf->base) {
+    munmap((void *)pf->base, pf->size);
+  }
+  memset(pf, 0, sizeof(*pf));
+}
+
+void pcapfile_rewind(struct PcapFile *pf) { pf->pos = PCAP_FILE_HEADER_LEN; }
+
+int pcapfile_next(struct PcapFile *pf, struct PcapPacket *pkt) {
+  if (pf->size - pf->pos < PCAP_RECORD_HEADER_LEN) {
+    return 0;
+  }
+
+  const uint8_t *h = pf->base + pf->pos;
+  const uint32_t sec = get_u32(pf, h);
+  const uint32_t frac = get_u32(pf, h + 4);
+  const uint32_t caplen = get_u32(pf, h + 8);
+
+  if (caplen > pf->size - pf->pos - PCAP_RECORD_HEADER_LEN) {
+    return 0;
+  }
+
+  pkt->time_ns = (uint64_t)sec * 1000000000ULL +
+                 (pf->nsec ? frac : (uint64_t)frac * 1000ULL);
+  pkt->data = h + PCAP_RECORD_HEADER_LEN;
+  pkt->caplen = caplen;
+  pkt->len = get_u32(pf, h + 12);
+
+  pf->pos += PCAP_RECORD_HEADER_LEN + caplen;
+  return 1;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Reader for classic libpcap capture files (as written by `tcpdump -w`).
+// The file is mapped read-only; packet data points into the mapping.
+// pcapng is not supported (`tcpdump -w` writes classic pcap by default).
+
+#ifndef __RMTDOS_LIBLINUX_PCAPFILE_H
+#define __RMTDOS_LIBLINUX_PCAPFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Link type of Ethernet captures.
+#define PCAP_LINKTYPE_ETHERNET 1
+
+struct PcapFile {
+  const uint8_t *base;
+  size_t size;
+  size_t pos;
+
+  int swapped; // Non-zero if written on a host of the other byte order.
+  int nsec;    // Non-zero if timestamps are in nanoseconds.
+  uint32_t linktype;
+};
+
+struct PcapPacket {
+  uint64_t time_ns;
+  const uint8_t *data;
+  size_t caplen; // Bytes in `data`.
+  size_t len;    // Length on the wire.
+};
+
+// Returns 0 on success, <0 on error (message printed to stderr).
+extern int pcapfile_open(struct PcapFile *pf, const char *path);
+
+extern void pcapfile_release(struct PcapFile *pf);
+
+// Back to the first packet.
+extern void pcapfile_rewind(struct PcapFile *pf);
+
+// Returns 1 and fills `pkt`, or 0 at the end (or on a truncated record).
+extern int pcapfile_next(struct PcapFile *pf, struct PcapPacket *pkt);
+
+#endif // __RMTDOS_LIBLINUX_PCAPFILE_H
@@ -0,0 +1,639 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "liblinux/recording.h"
+
+// Room for the largest record body: a delta that changes every other byte
+// costs 3 bytes per 2 screen bytes.
+#define BODY_MAX (2 * RECORDING_SCREEN_BYTES + 64)
+
+// Unchanged bytes shorter than this are folded into the surrounding change,
+// as a new change would cost more.
+#define DELTA_MIN_GAP 4
+
+#define INDEX_ENTRY_LEN 16
+
+// Longest varint that fits a uint64_t.
+#define VARINT_MAX 10
+
+static void put_u32le(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; ++i) {
+    p[i] = v >> (8 * i);
+  }
+}
+
+static void put_u64le(uint8_t *p, uint64_t v) {
+  for (int i = 0; i < 8; ++i) {
+    p[i] = v >> (8 * i);
+  }
+}
+
+static uint32_t get_u32le(const uint8_t *p) {
+  uint32_t v = 0;
+  for (int i = 3; i >= 0; --i) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+static uint64_t get_u64le(const uint8_t *p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; --i) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+static size_t put_varint(uint8_t *p, uint64_t v) {
+  size_t n = 0;
+  do {
+    const uint8_t b = v & 0x7f;
+    v >>= 7;
+    p[n++] = b | (v ? 0x80 : 0);
+  } while (v);
+  return n;
+}
+
+// Returns count of bytes consumed, or 0 if truncated or too long.
+static size_t get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v) {
+  *v = 0;
+  for (size_t n = 0; (n < VARINT_MAX) && (p + n < end); ++n) {
+    *v |= (uint64_t)(p[n] & 0x7f) << (7 * n);
+    if (!(p[n] & 0x80)) {
+      return n + 1;
+    }
+  }
+  return 0;
+}
+
+// Writer.
+
+static int write_bytes(struct RecordingWriter *w, const void *data,
+                       size_t len) {
+  if (len && (1 != fwrite(data, len, 1, w->fp))) {
+    return -1;
+  }
+  w->offset += len;
+  return 0;
+}
+
+static int write_record(struct RecordingWriter *w, enum RecordType type,
+                        uint64_t now_us, const uint8_t *body, size_t len) {
+  uint8_t hdr[1 + 2 * VARINT_MAX];
+  size_t n = 0;
+
+  // Clocks can step backwards; keep record times monotonic.
+  if (now_us < w->last_us) {
+    now_us = w->last_us;
+  }
+
+  hdr[n++] = type;
+  n += put_varint(hdr + n, now_us - w->last_us);
+  n += put_varint(hdr + n, len);
+  w->last_us = now_us;
+
+  if ((0 > write_bytes(w, hdr, n)) || (0 > write_bytes(w, body, len))) {
+    return -1;
+  }
+  return 0;
+}
+
+int recording_create(struct RecordingWriter *w, const char *path,
+                     const uint8_t *server_addr, uint64_t now_us,
+                     uint64_t keyframe_interval_us) {
+  uint8_t hdr[RECORDING_HEADER_LEN] = {0};
+
+  memset(w, 0, sizeof(*w));
+  if (NULL == (w->fp = fopen(path, "wb"))) {
+    return -1;
+  }
+
+  w->body = (uint8_t *)malloc(BODY_MAX);
+  w->start_us = w->last_us = now_us;
+  w->keyframe_interval_us = keyframe_interval_us;
+
+  memcpy(hdr, RECORDING_MAGIC, 8);
+  put_u64le(hdr + 8, now_us);
+  memcpy(hdr + 16, server_addr, ETH_ALEN);
+  put_u32le(hdr + 24, keyframe_interval_us / 1000);
+
+  if (0 > write_bytes(w, hdr, sizeof(hdr))) {
+    fclose(w->fp);
+    free(w->body);
+    w->fp = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+static size_t encode_geometry(uint8_t *p, const struct RecordingScreen *s) {
+  p[0] = s->text_rows;
+  p[1] = s->text_cols;
+  p[2] = s->cursor_row;
+  p[3] = s->cursor_col;
+  return 4;
+}
+
+static int write_keyframe(struct RecordingWriter *w, uint64_t now_us) {
+  const struct RecordingScreen *s = &w->screen;
+  const uint8_t *t = s->text;
+  const size_t cells = (size_t)s->text_rows * s->text_cols;
+  uint8_t *body = w->body;
+  size_t n = encode_geometry(body, s);
+
+  for (size_t i = 0; i < cells;) {
+    size_t j = i + 1;
+    while ((j < cells) && (t[2 * j] == t[2 * i]) &&
+           (t[2 * j + 1] == t[2 * i + 1])) {
+      ++j;
+    }
+    n += put_varint(body + n, j - i);
+    body[n++] = t[2 * i];
+    body[n++] = t[2 * i + 1];
+    i = j;
+  }
+
+  if (w->index_count == w->index_alloc) {
+    w->index_alloc = w->index_alloc ? 2 * w->index_alloc : 64;
+    w->index = (struct RecordingIndexEntry *)realloc(
+        w->index, w->index_alloc * sizeof(*w->index));
+  }
+  w->index[w->index_count].time_us =
+      (now_us > w->last_us ? now_us : w->last_us) - w->start_us;
+  w->index[w->index_count].offset = w->offset;
+  ++w->index_count;
+
+  w->last_keyframe_us = now_us;
+  w->changed = 0;
+
+  if (0 > write_record(w, REC_KEYFRAME, now_us, body, n)) {
+    return -1;
+  }
+
+  // Keyframes are the recovery points for a crashed writer.
+  return fflush(w->fp) ? -1 : 0;
+}
+
+int recording_write_screen(struct RecordingWriter *w, uint64_t now_us,
+                           uint8_t rows, uint8_t cols, uint8_t cursor_row,
+                           uint8_t cursor_col, const uint8_t *text) {
+  struct RecordingScreen *s = &w->screen;
+  const size_t bytes = (size_t)rows * cols * 2;
+
+  if (!w->fp || (bytes > RECORDING_SCREEN_BYTES)) {
+    return 0;
+  }
+
+  const int geometry_changed =
+      !w->have_screen || (rows != s->text_rows) || (cols != s->text_cols);
+  const int keyframe_due =
+      w->changed && (now_us - w->last_keyframe_us >= w->keyframe_interval_us);
+
+  if (geometry_changed || keyframe_due) {
+    s->text_rows = rows;
+    s->text_cols = cols;
+    s->cursor_row = cursor_row;
+    s->cursor_col = cursor_col;
+    memcpy(s->text, text, bytes);
+    w->have_screen = 1;
+    return write_keyframe(w, now_us);
+  }
+
+  uint8_t *body = w->body;
+  size_t n = 4;
+  size_t last = 0;
+
+  for (size_t i = 0; i < bytes;) {
+    if (text[i] == s->text[i]) {
+      ++i;
+      continue;
+    }
+
+    size_t end = i + 1;
+    for (size_t j = end; (j < bytes) && (j < end + DELTA_MIN_GAP); ++j) {
+      if (text[j] != s->text[j]) {
+        end = j + 1;
+      }
+    }
+
+    n += put_varint(body + n, i - last);
+    n += put_varint(body + n, end - i);
+    memcpy(body + n, text + i, end - i);
+    memcpy(s->text + i, text + i, end - i);
+    n += end - i;
+    last = i = end;
+  }
+
+  if ((n == 4) && (cursor_row == s->cursor_row) &&
+      (cursor_col == s->cursor_col)) {
+    return 0;
+  }
+
+  s->cursor_row = cursor_row;
+  s->cursor_col = cursor_col;
+  encode_geometry(body, s);
+  w->changed = 1;
+
+  return write_record(w, REC_DELTA, now_us, body, n);
+}
+
+int recording_write_keys(struct RecordingWriter *w, uint64_t now_us,
+                         size_t count, const struct Keystroke *keys) {
+  const size_t len = count * sizeof(struct Keystroke);
+
+  if (!w->fp || !count || (len > BODY_MAX)) {
+    return 0;
+  }
+
+  return write_record(w, REC_KEYS, now_us, (const uint8_t *)keys, len);
+}
+
+int recording_close(struct RecordingWriter *w) {
+  uint8_t buf[RECORDING_TRAILER_LEN];
+  int r = 0;
+
+  if (!w->fp) {
+    return 0;
+  }
+
+  if (0 > write_record(w, REC_END, w->last_us, NULL, 0)) {
+    r = -1;
+  }
+
+  const uint64_t index_offset = w->offset;
+  for (size_t i = 0; (r == 0) && (i < w->index_count); ++i) {
+    put_u64le(buf, w->index[i].time_us);
+    put_u64le(buf + 8, w->index[i].offset);
+    r = write_bytes(w, buf, INDEX_ENTRY_LEN);
+  }
+
+  memcpy(buf, RECORDING_INDEX_MAGIC, 8);
+  put_u64le(buf + 8, index_offset);
+  put_u64le(buf + 16, w->index_count);
+  put_u64le(buf + 24, w->last_us - w->start_us);
+  if ((r == 0) && (0 > write_bytes(w, buf, RECORDING_TRAILER_LEN))) {
+    r = -1;
+  }
+
+  if (fclose(w->fp)) {
+    r = -1;
+  }
+
+  free(w->body);
+  free(w->index);
+  w->fp = NULL;
+  w->body = NULL;
+  w->index = NULL;
+
+  return r;
+}
+
+// Reader.
+
+// Parses the record header at `pos`.  Returns 0 if it is damaged or runs
+// past `end`.
+static int parse_record(const uint8_t *base, size_t pos, size_t end,
+                        uint8_t *type, uint64_t *dt_us, size_t *body_pos,
+                        size_t *body_len) {
+  const uint8_t *p = base + pos;
+  const uint8_t *e = base + end;
+  uint64_t len;
+  size_t n;
+
+  if (p >= e) {
+    return 0;
+  }
+  *type = *p++;
+
+  if (!(n = get_varint(p, e, dt_us))) {
+    return 0;
+  }
+  p += n;
+
+  if (!(n = get_varint(p, e, &len)) || (len > (uint64_t)(e - p - n))) {
+    return 0;
+  }
+  p += n;
+
+  *body_pos = p - base;
+  *body_len = len;
+  return 1;
+}
+
+// Rebuilds the index of a recording that has no trailer.
+static void scan_records(struct Recording *rec) {
+  size_t alloc = 0;
+  size_t pos = rec->records_begin;
+  uint64_t time_us = 0;
+  uint8_t type;
+  uint64_t dt_us;
+  size_t body_pos, body_len;
+
+  rec->index_count = 0;
+
+  while (parse_record(rec->base, pos, rec->size, &type, &dt_us, &body_pos,
+                      &body_len) &&
+         (type != REC_END)) {
+    time_us += dt_us;
+
+    if (type == REC_KEYFRAME) {
+      if (rec->index_count == alloc) {
+        alloc = alloc ? 2 * alloc : 64;
+        rec->owned_index =
+            (uint8_t *)realloc(rec->owned_index, alloc * INDEX_ENTRY_LEN);
+      }
+      uint8_t *e = rec->owned_index + rec->index_count * INDEX_ENTRY_LEN;
+      put_u64le(e, time_us);
+      put_u64le(e + 8, pos);
+      ++rec->index_count;
+    }
+
+    pos = body_pos + body_len;
+  }
+
+  rec->records_end = pos;
+  rec->duration_us = time_us;
+  rec->index = rec->owned_index;
+}
+
+int recording_open(struct Recording *rec, const char *path) {
+  struct stat st;
+  int fd;
+
+  memset(rec, 0, sizeof(*rec));
+
+  if (0 > (fd = open(path, O_RDONLY | O_CLOEXEC))) {
+    perror(path);
+    return -1;
+  }
+
+  if (0 > fstat(fd, &st)) {
+    perror("fstat()");
+    close(fd);
+    return -1;
+  }
+
+  if ((size_t)st.st_size < RECORDING_HEADER_LEN) {
+    fprintf(stderr, "%s: too short to be a recording.\n", path);
+    close(fd);
+    return -1;
+  }
+
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    perror("mmap()");
+    return -1;
+  }
+
+  rec->base = (const uint8_t *)base;
+  rec->size = st.st_size;
+
+  if (memcmp(rec->base, RECORDING_MAGIC, 8)) {
+    fprintf(stderr, "%s: not a recording.\n", path);
+    recording_release(rec);
+    return -1;
+  }
+
+  rec->header.start_us = get_u64le(rec->base + 8);
+  memcpy(rec->header.server_addr, rec->base + 16, ETH_ALEN);
+  rec->header.keyframe_interval_ms = get_u32le(rec->base + 24);
+  rec->records_begin = RECORDING_HEADER_LEN;
+
+  // Use the trailer if it is present and sane.  REC_END is 3 bytes.
+  const uint8_t *t = rec->base + rec->size - RECORDING_TRAILER_LEN;
+  if ((rec->size >= RECORDING_HEADER_LEN + 3 + RECORDING_TRAILER_LEN) &&
+      !memcmp(t, RECORDING_INDEX_MAGIC, 8)) {
+    const uint64_t index_offset = get_u64le(t + 8);
+    const uint64_t count = get_u64le(t + 16);
+
+    if ((index_offset >= RECORDING_HEADER_LEN + 3) &&
+        (count <= rec->size / INDEX_ENTRY_LEN) &&
+        (index_offset + count * INDEX_ENTRY_LEN ==
+         rec->size - RECORDING_TRAILER_LEN) &&
+        (rec->base[index_offset - 3] == REC_END)) {
+      rec->index = rec->base + index_offset;
+      rec->index_count = count;
+      rec->records_end = index_offset - 3;
+      rec->duration_us = get_u64le(t + 24);
+      return 0;
+    }
+  }
+
+  scan_records(rec);
+  return 0;
+}
+
+void recording_release(struct Recording *rec) {
+  if (rec->base) {
+    munmap((void *)rec->base, rec->size);
+  }
+  free(rec->owned_index);
+  memset(rec, 0, sizeof(*rec));
+}
+
+struct RecordingIndexEntry recording_index_entry(const struct Recording *rec,
+                                                 size_t i) {
+  const uint8_t *e = rec->index + i * INDEX_ENTRY_LEN;
+  struct RecordingIndexEntry entry = {
+      .time_us = get_u64le(e),
+      .offset = get_u64le(e + 8),
+  };
+  return entry;
+}
+
+void recording_rewind(struct RecordingCursor *cur,
+                      const struct Recording *rec) {
+  cur->rec = rec;
+  cur->pos = rec->records_begin;
+  cur->time_us = 0;
+  memset(&cur->screen, 0, 4);
+}
+
+int recording_peek_time(const struct RecordingCursor *cur,
+                        uint64_t *time_us) {
+  const struct Recording *rec = cur->rec;
+  uint8_t type;
+  uint64_t dt_us;
+  size_t body_pos, body_len;
+
+  if (!parse_record(rec->base, cur->pos, rec->records_end, &type, &dt_us,
+                    &body_pos, &body_len) ||
+      (type == REC_END)) {
+    return 0;
+  }
+
+  *time_us = cur->time_us + dt_us;
+  return 1;
+}
+
+static int apply_geometry(struct RecordingScreen *s, const uint8_t *p,
+                          size_t len) {
+  if ((len < 4) || ((size_t)p[0] * p[1] * 2 > RECORDING_SCREEN_BYTES)) {
+    return 0;
+  }
+  s->text_rows = p[0];
+  s->text_cols = p[1];
+  s->cursor_row = p[2];
+  s->cursor_col = p[3];
+  return 1;
+}
+
+static int apply_keyframe(struct RecordingScreen *s, const uint8_t *p,
+                          size_t len) {
+  const uint8_t *end = p + len;
+
+  if (!apply_geometry(s, p, len)) {
+    return 0;
+  }
+  p += 4;
+
+  const size_t cells = (size_t)s->text_rows * s->text_cols;
+  size_t i = 0;
+  while ((p < end) && (i < cells)) {
+    uint64_t count;
+    size_t n = get_varint(p, end, &count);
+    if (!n || (end - p < (ptrdiff_t)(n + 2)) || (count > cells - i)) {
+      return 0;
+    }
+    p += n;
+    for (; count; --count, ++i) {
+      s->text[2 * i] = p[0];
+      s->text[2 * i + 1] = p[1];
+    }
+    p += 2;
+  }
+
+  return i == cells;
+}
+
+static int apply_delta(struct RecordingScreen *s, const uint8_t *p,
+                       size_t len) {
+  const uint8_t *end = p + len;
+
+  if (!apply_geometry(s, p, len)) {
+    return 0;
+  }
+  p += 4;
+
+  const size_t bytes = (size_t)s->text_rows * s->text_cols * 2;
+  size_t at = 0;
+  while (p < end) {
+    uint64_t skip, count;
+    size_t n;
+
+    if (!(n = get_varint(p, end, &skip))) {
+      return 0;
+    }
+    p += n;
+    if (!(n = get_varint(p, end, &count))) {
+      return 0;
+    }
+    p += n;
+
+    if ((skip > bytes - at) || (count > bytes - at - skip) ||
+        (count > (uint64_t)(end - p))) {
+      return 0;
+    }
+    at += skip;
+    memcpy(s->text + at, p, count);
+    at += count;
+    p += count;
+  }
+
+  return 1;
+}
+
+int recording_next(struct RecordingCursor *cur, struct RecordingEvent *ev) {
+  const struct Recording *rec = cur->rec;
+  uint8_t type;
+  uint64_t dt_us;
+  size_t body_pos, body_len;
+
+  if (!parse_record(rec->base, cur->pos, rec->records_end, &type, &dt_us,
+                    &body_pos, &body_len) ||
+      (type == REC_END)) {
+    return 0;
+  }
+
+  const uint8_t *body = rec->base + body_pos;
+  memset(ev, 0, sizeof(*ev));
+  ev->type = type;
+  ev->time_us = cur->time_us + dt_us;
+
+  switch (type) {
+    case REC_KEYFRAME:
+      if (!apply_keyframe(&cur->screen, body, body_len)) {
+        return 0;
+      }
+      break;
+    case REC_DELTA:
+      if (!apply_delta(&cur->screen, body, body_len)) {
+        return 0;
+      }
+      break;
+    case REC_KEYS:
+      ev->key_count = body_len / sizeof(struct Keystroke);
+      ev->keys = (const struct Keystroke *)body;
+      break;
+    default:
+      // Unknown record types are skipped, so the format can grow.
+      break;
+  }
+
+  cur->time_us = ev->time_us;
+  cur->pos = body_pos + body_len;
+  return 1;
+}
+
+void recording_seek(struct RecordingCursor *cur, const struct Recording *rec,
+                    uint64_t time_us) {
+  struct RecordingEvent ev;
+  uint64_t next_us;
+  size_t lo = 0;
+  size_t hi = rec->index_count;
+
+  // Last keyframe at or before `time_us`.
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (recording_index_entry(rec, mid).time_us <= time_us) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  recording_rewind(cur, rec);
+
+  if (lo) {
+    const struct RecordingIndexEntry e = recording_index_entry(rec, lo - 1);
+    uint8_t type;
+    uint64_t dt_us;
+    size_t body_pos, body_len;
+
+    if ((e.offset >= rec->records_begin) && (e.offset < rec->records_end) &&
+        parse_record(rec->base, e.offset, rec->records_end, &type, &dt_us,
+                     &body_pos, &body_len) &&
+        (type == REC_KEYFRAME) && (dt_us <= e.time_us)) {
+      cur->pos = e.offset;
+      cur->time_us = e.time_us - dt_us;
+    }
+  }
+
+  while (recording_peek_time(cur, &next_us) && (next_us <= time_us)) {
+    if (!recording_next(cur, &ev)) {
+      break;
+    }
+  }
+}
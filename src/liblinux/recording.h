@@ -0,0 +1,190 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Session recordings: a compact, memory-mappable log of one server's screen
+// and of the keystrokes injected into it.
+//
+// File layout (all integers little-endian):
+//
+//   Header     RECORDING_HEADER_LEN bytes, see `struct RecordingHeader`.
+//   Records    u8 type, varint dt_us, varint body_len, body[body_len]
+//   REC_END    (type only, dt_us = 0, body_len = 0)
+//   Index      u64 time_us, u64 file_offset; one per REC_KEYFRAME
+//   Trailer    "RMTDOSIX", u64 index_offset, u64 index_count, u64 end_us
+//
+// `dt_us` is the time since the previous record, and varints are unsigned
+// LEB128.  Record bodies:
+//
+//   REC_KEYFRAME  u8 rows, cols, cursor_row, cursor_col; then runs of
+//                 { varint count, u8 char, u8 attr } covering the screen.
+//   REC_DELTA     u8 rows, cols, cursor_row, cursor_col; then changes of
+//                 { varint skip, varint len, u8 bytes[len] }, where `skip`
+//                 is the count of unchanged bytes since the previous change.
+//   REC_KEYS      `struct Keystroke` (4 bytes) each.
+//
+// Deltas only carry bytes that changed, so a static screen costs nothing,
+// and the index lets a reader seek to any time with a binary search plus at
+// most one keyframe interval of deltas.  A file without a trailer (writer
+// crashed) can still be read; the index is rebuilt by scanning.
+
+#ifndef __RMTDOS_LIBLINUX_RECORDING_H
+#define __RMTDOS_LIBLINUX_RECORDING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "common/protocol.h"
+
+// Largest screen that can be recorded.  Matches the VGA text buffer.
+#define RECORDING_SCREEN_BYTES 32768
+
+// Default time between keyframes.
+#define RECORDING_DEFAULT_KEYFRAME_US (60ULL * 1000000ULL)
+
+#define RECORDING_MAGIC "RMTDOSR1"
+#define RECORDING_INDEX_MAGIC "RMTDOSIX"
+#define RECORDING_HEADER_LEN 32
+#define RECORDING_TRAILER_LEN 32
+
+enum RecordType {
+  REC_KEYFRAME = 1,
+  REC_DELTA = 2,
+  REC_KEYS = 3,
+  REC_END = 0x7f,
+};
+
+struct RecordingHeader {
+  // `time_now_us()` when the recording started.  Record times are relative
+  // to this.
+  uint64_t start_us;
+
+  // Server that was recorded.
+  uint8_t server_addr[ETH_ALEN];
+
+  uint32_t keyframe_interval_ms;
+};
+
+struct RecordingScreen {
+  uint8_t text_rows;
+  uint8_t text_cols;
+  uint8_t cursor_row;
+  uint8_t cursor_col;
+  uint8_t text[RECORDING_SCREEN_BYTES];
+};
+
+struct RecordingIndexEntry {
+  uint64_t time_us;
+  uint64_t offset;
+};
+
+struct RecordingWriter {
+  FILE *fp;
+  uint64_t offset; // Bytes written so far.
+  uint64_t start_us;
+  uint64_t last_us;          // Time of the last record.
+  uint64_t last_keyframe_us; // Time of the last keyframe.
+  uint64_t keyframe_interval_us;
+  int changed; // Non-zero if a delta was written since the last keyframe.
+  int have_screen;
+
+  // Screen as of the last record.
+  struct RecordingScreen screen;
+
+  // Record body being built.
+  uint8_t *body;
+
+  struct RecordingIndexEntry *index;
+  size_t index_count;
+  size_t index_alloc;
+};
+
+// Creates `path`.  Returns 0 on success, <0 on error (errno is set).
+extern int recording_create(struct RecordingWriter *w, const char *path,
+                            const uint8_t *server_addr, uint64_t now_us,
+                            uint64_t keyframe_interval_us);
+
+// Records the screen contents at `now_us`.  Writes a keyframe when one is
+// due, otherwise the bytes that changed since the last call (or nothing).
+// `text` holds `rows * cols * 2` bytes.  Returns <0 on write error.
+extern int recording_write_screen(struct RecordingWriter *w, uint64_t now_us,
+                                  uint8_t rows, uint8_t cols,
+                                  uint8_t cursor_row, uint8_t cursor_col,
+                                  const uint8_t *text);
+
+// Records keystrokes sent to the server.  Returns <0 on write error.
+extern int recording_write_keys(struct RecordingWriter *w, uint64_t now_us,
+                                size_t count, const struct Keystroke *keys);
+
+// Writes the index and trailer, and closes the file.  Returns <0 on error.
+extern int recording_close(struct RecordingWriter *w);
+
+// A recording, mapped read-only.
+struct Recording {
+  const uint8_t *base;
+  size_t size;
+  struct RecordingHeader header;
+
+  // Offset of the first record, and of REC_END (or the end of the last
+  // complete record, if the file was truncated).
+  size_t records_begin;
+  size_t records_end;
+
+  // Total time covered.
+  uint64_t duration_us;
+
+  // Keyframes, by time.  Points into `base`, or into `owned_index` if the
+  // index had to be rebuilt.
+  const uint8_t *index;
+  size_t index_count;
+  uint8_t *owned_index;
+};
+
+// One decoded record.
+struct RecordingEvent {
+  enum RecordType type;
+  uint64_t time_us;
+
+  // REC_KEYS only.
+  size_t key_count;
+  const struct Keystroke *keys;
+};
+
+// Position in a `Recording`, with the screen as of that position.
+struct RecordingCursor {
+  const struct Recording *rec;
+  size_t pos;
+  uint64_t time_us;
+  struct RecordingScreen screen;
+};
+
+// Returns 0 on success, <0 on error (message printed to stderr).
+extern int recording_open(struct Recording *rec, const char *path);
+
+extern void recording_release(struct Recording *rec);
+
+extern struct RecordingIndexEntry recording_index_entry(
+    const struct Recording *rec, size_t i);
+
+// Positions `cur` at the first record.
+extern void recording_rewind(struct RecordingCursor *cur,
+                             const struct Recording *rec);
+
+// Positions `cur` after the last record at or before `time_us`, with
+// `cur->screen` as it was at that time.  O(log keyframes) plus one keyframe
+// interval of deltas.
+extern void recording_seek(struct RecordingCursor *cur,
+                           const struct Recording *rec, uint64_t time_us);
+
+// Time of the next record, without consuming it.  Returns 0 at the end.
+extern int recording_peek_time(const struct RecordingCursor *cur,
+                               uint64_t *time_us);
+
+// Reads and applies the next record.  Returns 0 at the end (or on a
+// damaged record), 1 otherwise.
+extern int recording_next(struct RecordingCursor *cur,
+                          struct RecordingEvent *ev);
+
+#endif // __RMTDOS_LIBLINUX_RECORDING_H
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "liblinux/samples.h"
+
+void samples_add(struct Samples *s, uint64_t value) {
+  if (s->count == s->alloc) {
+    s->alloc = s->alloc ? 2 * s->alloc : 64;
+    s->values = (uint32_t *)realloc(s->values, s->alloc * sizeof(uint32_t));
+    if (!s->values) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  s->values[s->count++] = (value > UINT32_MAX) ? UINT32_MAX : value;
+  s->sorted = 0;
+}
+
+void samples_free(struct Samples *s) {
+  free(s->values);
+  s->values = NULL;
+  s->count = s->alloc = 0;
+}
+
+static int compare_u32(const void *a, const void *b) {
+  const uint32_t x = *(const uint32_t *)a;
+  const uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+uint32_t samples_percentile(struct Samples *s, int pct) {
+  if (!s->count) {
+    return 0;
+  }
+
+  if (!s->sorted) {
+    qsort(s->values, s->count, sizeof(uint32_t), compare_u32);
+    s->sorted = 1;
+  }
+
+  return s->values[(s->count - 1) * pct / 100];
+}
+
+void samples_print(struct Samples *s, int width) {
+  printf("%*zu %*u %*u %*u %*u %*u", width, s->count, width,
+         samples_percentile(s, 0), width, samples_percentile(s, 50), width,
+         samples_percentile(s, 95), width, samples_percentile(s, 99), width,
+         samples_percentile(s, 100));
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Growable array of latency samples, with percentiles for reports.
+
+#ifndef __RMTDOS_LIBLINUX_SAMPLES_H
+#define __RMTDOS_LIBLINUX_SAMPLES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Samples {
+  uint32_t *values;
+  size_t count;
+  size_t alloc;
+  int sorted;
+};
+
+// Appends `value`, clamped to 32 bits.  Exits if out of memory.
+extern void samples_add(struct Samples *s, uint64_t value);
+
+extern void samples_free(struct Samples *s);
+
+// Nearest-rank percentile (0 to 100) of the samples; 0 if there are none.
+// Sorts the samples on first use after `samples_add()`.
+extern uint32_t samples_percentile(struct Samples *s, int pct);
+
+// Prints "count min p50 p95 p99 max", each right aligned in `width` columns.
+extern void samples_print(struct Samples *s, int width);
+
+#endif // __RMTDOS_LIBLINUX_SAMPLES_H
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Plays back a session recording made with `rmtdos-client -r`.
+//
+// Output is plain ANSI escape sequences, so the player needs no ncurses and
+// can also be used to print a single screen (`-p`) into a report.
+
+#include <getopt.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "liblinux/cp437.h"
+#include "liblinux/recording.h"
+
+// VGA color bits are "I, R, G, B"; ANSI are "B, G, R".
+static const uint8_t vga_to_ansi[8] = {0, 4, 2, 6, 1, 5, 3, 7};
+
+static int g_color = 1;
+
+static void print_screen(const struct RecordingScreen *s, int home) {
+  int last_attr = -1;
+
+  if (home) {
+    fputs("\x1b[H", stdout);
+  }
+
+  for (int y = 0; y < s->text_rows; ++y) {
+    for (int x = 0; x < s->text_cols; ++x) {
+      const uint8_t *p = &s->text[(y * s->text_cols + x) * 2];
+
+      if (g_color && (p[1] != last_attr)) {
+        const int fg = p[1] & 0x0f;
+        const int bg = (p[1] >> 4) & 0x0f;
+        printf("\x1b[%d;%dm", (fg & 8 ? 90 : 30) + vga_to_ansi[fg & 7],
+               (bg & 8 ? 100 : 40) + vga_to_ansi[bg & 7]);
+        last_attr = p[1];
+      }
+      fputs(g_cp437_table[p[0]], stdout);
+    }
+
+    if (g_color) {
+      fputs("\x1b[0m", stdout);
+      last_attr = -1;
+    }
+    fputs(home ? "\x1b[K\r\n" : "\n", stdout);
+  }
+}
+
+static void print_info(const struct Recording *rec) {
+  const uint8_t *m = rec->header.server_addr;
+  const time_t start = rec->header.start_us / 1000000;
+  char stamp[64];
+  struct RecordingCursor cur;
+  struct RecordingEvent ev;
+  size_t counts[4] = {0};
+  size_t keys = 0;
+
+  strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&start));
+
+  recording_rewind(&cur, rec);
+  while (recording_next(&cur, &ev)) {
+    if (ev.type < 4) {
+      ++counts[ev.type];
+    }
+    keys += ev.key_count;
+  }
+
+  printf("server:     %02x:%02x:%02x:%02x:%02x:%02x\n", m[0], m[1], m[2],
+         m[3], m[4], m[5]);
+  printf("started:    %s\n", stamp);
+  printf("duration:   %lu.%06lu s\n", rec->duration_us / 1000000,
+         rec->duration_us % 1000000);
+  printf("size:       %zu bytes\n", rec->size);
+  printf("keyframes:  %zu (every %u ms)\n", counts[REC_KEYFRAME],
+         rec->header.keyframe_interval_ms);
+  printf("deltas:     %zu\n", counts[REC_DELTA]);
+  printf("keystrokes: %zu\n", keys);
+  printf("index:      %s\n", rec->owned_index ? "rebuilt (no trailer)" : "ok");
+}
+
+static void sleep_us(uint64_t us) {
+  struct timespec ts = {
+      .tv_sec = us / 1000000,
+      .tv_nsec = (us % 1000000) * 1000,
+  };
+  nanosleep(&ts, NULL);
+}
+
+static void play(const struct Recording *rec, uint64_t start_us, double speed,
+                 uint64_t max_idle_us) {
+  struct RecordingCursor cur;
+  struct RecordingEvent ev;
+  uint64_t next_us;
+
+  recording_seek(&cur, rec, start_us);
+
+  fputs("\x1b[2J\x1b[?25l", stdout);
+  print_screen(&cur.screen, 1);
+  fflush(stdout);
+
+  while (recording_peek_time(&cur, &next_us)) {
+    uint64_t wait_us = (next_us - cur.time_us) / speed;
+    sleep_us(wait_us < max_idle_us ? wait_us : max_idle_us);
+
+    if (!recording_next(&cur, &ev)) {
+      break;
+    }
+
+    if (ev.type == REC_KEYFRAME || ev.type == REC_DELTA) {
+      print_screen(&cur.screen, 1);
+    }
+    printf("\x1b[0m%10.3f s\x1b[K", ev.time_us / 1e6);
+    fflush(stdout);
+  }
+
+  fputs("\x1b[0m\x1b[?25h\n", stdout);
+}
+
+static void print_usage(const char *progname) {
+  printf("usage: %s [-C] [-i] [-m secs] [-p] [-s speed] [-t secs] file\n",
+         progname);
+  printf("  -C  No colors.\n");
+  printf("  -i  Print information about the recording.\n");
+  printf("  -m  Longest pause during playback (default: 2).\n");
+  printf("  -p  Print the screen at the time given by `-t`, and exit.\n");
+  printf("  -s  Playback speed (default: 1.0).\n");
+  printf("  -t  Start at this many seconds into the recording.\n");
+}
+
+int main(int argc, char **argv) {
+  double start = 0.0;
+  double speed = 1.0;
+  double max_idle = 2.0;
+  int info = 0;
+  int print = 0;
+  int opt;
+
+  setlocale(LC_ALL, "");
+  cp437_table_init();
+
+  while ((opt = getopt(argc, argv, "Cim:ps:t:")) != -1) {
+    switch (opt) {
+      case 'C':
+        g_color = 0;
+        break;
+      case 'i':
+        info = 1;
+        break;
+      case 'm':
+        max_idle = atof(optarg);
+        break;
+      case 'p':
+        print = 1;
+        break;
+      case 's':
+        speed = atof(optarg);
+        break;
+      case 't':
+        start = atof(optarg);
+        break;
+      default: /* '?' */
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if ((optind != argc - 1) || (speed <= 0.0) || (start < 0.0)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  struct Recording rec;
+  if (0 > recording_open(&rec, argv[optind])) {
+    return EXIT_FAILURE;
+  }
+
+  if (info) {
+    print_info(&rec);
+  } else if (print) {
+    struct RecordingCursor cur;
+    recording_seek(&cur, &rec, start * 1e6);
+    print_screen(&cur.screen, 0);
+  } else {
+    play(&rec, start * 1e6, speed, max_idle * 1e6);
+  }
+
+  recording_release(&rec);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,355 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Headless benchmark of the client's receive pipeline, driven by a capture
+// of real traffic:
+//
+//   sudo tcpdump -i eth0 -w rmtdos.pcap ether proto 0x80ab
+//   out/rmtdos-replay rmtdos.pcap
+//
+// Every frame is fed through the same code the client runs
+// (`process_packet()` or, with `-s`, `process_socket_io()`), and every
+// screen update is drawn with `update_session_window()` into an ncurses
+// window that is never shown.  The client MAC and session id to accept are
+// taken from the first V1_VGA_TEXT frame in the capture.
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <locale.h>
+#include <net/ethernet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client/curses.h"
+#include "client/hostlist.h"
+#include "client/rxthread.h"
+#include "common/ethernet.h"
+#include "common/protocol.h"
+#include "liblinux/pcapfile.h"
+
+#define MIN(x, y) ((x) > (y) ? (y) : (x))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+// Hosts whose redraws can be merged per batch of frames.
+#define MAX_DIRTY 64
+
+enum Stage {
+  STAGE_SOCKET = 0, // send() into the socketpair (`-s` only).
+  STAGE_DECODE = 1, // Receive, filter, decode, store into `struct Screen`.
+  STAGE_RENDER = 2, // `update_session_window()`.
+  STAGE_OUTPUT = 3, // `doupdate()` to /dev/null (`-o` only).
+  STAGE_COUNT
+};
+
+static const char *stage_names[STAGE_COUNT] = {
+    "socket",
+    "decode",
+    "render",
+    "output",
+};
+
+struct Frame {
+  const uint8_t *data;
+  size_t length;
+};
+
+// Large (holds the event ring), so static.
+static struct RxThread g_rx;
+
+static uint64_t g_stage_ns[STAGE_COUNT];
+static uint64_t g_cells_rendered = 0;
+static uint64_t g_video_frames = 0;
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Loads the rmtdos frames from the capture.  Returns count.
+static size_t load_frames(struct PcapFile *pf, uint16_t ethertype,
+                          struct Frame **frames) {
+  struct PcapPacket pkt;
+  size_t count = 0;
+  size_t alloc = 0;
+
+  while (pcapfile_next(pf, &pkt)) {
+    const struct ether_header *eh = (const struct ether_header *)pkt.data;
+
+    if ((pkt.caplen < COMBINED_HEADER_LEN) ||
+        (ntohs(eh->ether_type) != ethertype)) {
+      continue;
+    }
+
+    if (count == alloc) {
+      alloc = alloc ? 2 * alloc : 1024;
+      *frames = (struct Frame *)realloc(*frames, alloc * sizeof(**frames));
+    }
+    (*frames)[count].data = pkt.data;
+    (*frames)[count].length = MIN(pkt.caplen, ETH_FRAME_LEN);
+    ++count;
+  }
+
+  return count;
+}
+
+// Accept what the first V1_VGA_TEXT frame was sent to, and give every server
+// that sent one a screen.  Returns 0 if there is no video in the capture.
+static int setup_hosts(struct RawSocket *rs, const struct Frame *frames,
+                       size_t count) {
+  int found = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    const struct ether_header *eh = (const struct ether_header *)frames[i].data;
+    const struct ProtocolHeader *ph = (const struct ProtocolHeader *)(eh + 1);
+
+    if ((PACKET_SIGNATURE != ntohl(ph->signature)) ||
+        (V1_VGA_TEXT != ntohs(ph->pkt_type))) {
+      continue;
+    }
+
+    if (!found) {
+      memcpy(rs->if_addr, eh->ether_dhost, ETH_ALEN);
+      rs->session_id = ntohl(ph->session_id);
+      found = 1;
+    }
+
+    if (!memcmp(eh->ether_dhost, rs->if_addr, ETH_ALEN)) {
+      struct RemoteHost *rh = hostlist_add(eh->ether_shost);
+      if (rh && !rh->window) {
+        host_attach_screen(rh);
+        rh->window = g_session_window;
+      }
+    }
+  }
+
+  return found;
+}
+
+// Same as the client's UI thread: apply events, merging redraws per host.
+static void drain_events() {
+  struct {
+    struct RemoteHost *host;
+    uint32_t lo;
+    uint32_t hi;
+  } dirty[MAX_DIRTY];
+  int dirty_count = 0;
+  struct RxEvent ev;
+
+  while (eventq_pop(&g_rx.queue, &ev)) {
+    struct RemoteHost *rh = ev.host;
+
+    if (ev.type == RX_EVENT_STATUS) {
+      rh->status = ev.status;
+      continue;
+    }
+    if ((ev.type != RX_EVENT_VIDEO) || !rh->window) {
+      continue;
+    }
+
+    ++g_video_frames;
+
+    const uint32_t lo = ev.video.offset;
+    const uint32_t hi = lo + ev.video.count;
+    int i;
+    for (i = 0; (i < dirty_count) && (dirty[i].host != rh); ++i) {
+    }
+
+    if (i == dirty_count) {
+      if (dirty_count == MAX_DIRTY) {
+        continue;
+      }
+      dirty[dirty_count].host = rh;
+      dirty[dirty_count].lo = lo;
+      dirty[dirty_count].hi = hi;
+      ++dirty_count;
+    } else {
+      dirty[i].lo = MIN(dirty[i].lo, lo);
+      dirty[i].hi = MAX(dirty[i].hi, hi);
+    }
+  }
+
+  if (eventq_take_overflow(&g_rx.queue)) {
+    fprintf(stderr, "event queue overflow; use a smaller batch (-b).\n");
+  }
+
+  for (int i = 0; i < dirty_count; ++i) {
+    update_session_window(dirty[i].host, dirty[i].lo,
+                          dirty[i].hi - dirty[i].lo);
+    g_cells_rendered += (dirty[i].hi - dirty[i].lo) / 2;
+  }
+}
+
+static void run(const struct Frame *frames, size_t count, int batch,
+                int send_fd, int output) {
+  uint64_t t0, t1;
+
+  for (size_t i = 0; i < count;) {
+    const size_t end = MIN(count, i + batch);
+
+    for (; i < end; ++i) {
+      if (send_fd >= 0) {
+        t0 = now_ns();
+        if (0 > send(send_fd, frames[i].data, frames[i].length, 0)) {
+          perror("send()");
+          exit(EXIT_FAILURE);
+        }
+        t1 = now_ns();
+        g_stage_ns[STAGE_SOCKET] += t1 - t0;
+
+        process_socket_io(&g_rx, g_rx.sockets);
+        g_stage_ns[STAGE_DECODE] += now_ns() - t1;
+      } else {
+        t0 = now_ns();
+        process_packet(&g_rx, g_rx.sockets, frames[i].data, frames[i].length);
+        g_stage_ns[STAGE_DECODE] += now_ns() - t0;
+      }
+    }
+
+    t0 = now_ns();
+    drain_events();
+    t1 = now_ns();
+    g_stage_ns[STAGE_RENDER] += t1 - t0;
+
+    if (output) {
+      wnoutrefresh(g_session_window);
+      doupdate();
+      g_stage_ns[STAGE_OUTPUT] += now_ns() - t1;
+    }
+  }
+}
+
+static void print_usage(const char *progname) {
+  printf("usage: %s [-b batch] [-e type] [-n loops] [-o] [-s] capture.pcap\n",
+         progname);
+  printf("  -b  Frames decoded per redraw (default: 1).\n");
+  printf("  -e  Ethertype as 4 hexadecimal digits (default: %04x).\n",
+         ETHERTYPE_RMTDOS);
+  printf("  -n  Times to replay the capture (default: 10).\n");
+  printf("  -o  Also time terminal output (doupdate() into /dev/null).\n");
+  printf("  -s  Receive frames from a socket, via process_socket_io().\n");
+}
+
+int main(int argc, char **argv) {
+  uint16_t ethertype = ETHERTYPE_RMTDOS;
+  int batch = 1;
+  int loops = 10;
+  int output = 0;
+  int use_socket = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:e:n:os")) != -1) {
+    switch (opt) {
+      case 'b':
+        batch = atoi(optarg);
+        break;
+      case 'e':
+        ethertype = strtoul(optarg, NULL, 16);
+        break;
+      case 'n':
+        loops = atoi(optarg);
+        break;
+      case 'o':
+        output = 1;
+        break;
+      case 's':
+        use_socket = 1;
+        break;
+      default: /* '?' */
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if ((optind != argc - 1) || (batch < 1) || (loops < 1)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  struct PcapFile pf;
+  if (0 > pcapfile_open(&pf, argv[optind])) {
+    return EXIT_FAILURE;
+  }
+  if (pf.linktype != PCAP_LINKTYPE_ETHERNET) {
+    fprintf(stderr, "%s: not an Ethernet capture (link type %u).\n",
+            argv[optind], pf.linktype);
+    return EXIT_FAILURE;
+  }
+
+  struct Frame *frames = NULL;
+  const size_t count = load_frames(&pf, ethertype, &frames);
+
+  setlocale(LC_ALL, "");
+  cp437_table_init();
+  init_ncurses_headless("xterm-256color", 60, 132);
+  hostlist_create(HOSTLIST_DEFAULT_MAX_HOSTS);
+
+  struct RawSocket rs = {.sock_fd = -1, .ethertype = ethertype};
+  if (!setup_hosts(&rs, frames, count)) {
+    shutdown_ncurses();
+    fprintf(stderr, "%s: no V1_VGA_TEXT frames in %zu rmtdos frames.\n",
+            argv[optind], count);
+    return EXIT_FAILURE;
+  }
+
+  int sv[2] = {-1, -1};
+  if (use_socket && (0 > socketpair(AF_UNIX, SOCK_DGRAM, 0, sv))) {
+    perror("socketpair()");
+    return EXIT_FAILURE;
+  }
+  rs.sock_fd = sv[1];
+
+  g_rx.sockets = &rs;
+  g_rx.socket_count = 1;
+  eventq_init(&g_rx.queue);
+
+  const uint64_t start = now_ns();
+  for (int i = 0; i < loops; ++i) {
+    run(frames, count, batch, sv[0], output);
+  }
+  const uint64_t elapsed = now_ns() - start;
+
+  shutdown_ncurses();
+
+  uint64_t busy = 0;
+  for (int i = 0; i < STAGE_COUNT; ++i) {
+    busy += g_stage_ns[i];
+  }
+
+  const double secs = busy / 1e9;
+  printf("capture:  %s, %zu frames x %d loops, batch %d\n", argv[optind],
+         count, loops, batch);
+  printf("video:    %lu frames, %lu cells rendered\n", g_video_frames,
+         g_cells_rendered);
+  printf("elapsed:  %.3f s (%.3f s in stages)\n", elapsed / 1e9, secs);
+  printf("frames/s: %.0f\n", secs ? g_video_frames / secs : 0.0);
+  printf("cells/s:  %.0f (render only: %.0f)\n",
+         secs ? g_cells_rendered / secs : 0.0,
+         g_stage_ns[STAGE_RENDER] ? g_cells_rendered * 1e9 /
+                                        g_stage_ns[STAGE_RENDER]
+                                  : 0.0);
+  for (int i = 0; i < STAGE_COUNT; ++i) {
+    if (g_stage_ns[i]) {
+      printf("  %-7s %8.3f s  %8.0f ns/frame  %5.1f%%\n", stage_names[i],
+             g_stage_ns[i] / 1e9,
+             (double)g_stage_ns[i] / MAX(1, count * (uint64_t)loops),
+             100.0 * g_stage_ns[i] / busy);
+    }
+  }
+
+  if (use_socket) {
+    close(sv[0]);
+    close(sv[1]);
+  }
+  free(frames);
+  hostlist_destroy();
+  pcapfile_release(&pf);
+
+  return EXIT_SUCCESS;
+}
@@ -21,6 +21,10 @@ static struct Buffer *g_free_list = NULL;
 // Pointer to the next 'ready' buffer.
 static struct Buffer *g_ready_list = NULL;
 
+// Count of buffers on the free list, and the fewest there have ever been.
+static size_t g_free_count = 0;
+static size_t g_min_free_count = 0;
+
 #if DEBUG
 void buffer_debug_dump(FILE *fp) {
   int i, j;
@@ -58,6 +62,8 @@ void buffer_init(size_t count) {
   g_buffer_count = count;
   g_free_list = g_buffers;
   g_ready_list = NULL;
+  g_free_count = count;
+  g_min_free_count = count;
 
   for (i = 0; i < g_buffer_count - 1; i++) {
     g_buffers[i].next = g_buffers + i + 1;
@@ -75,6 +81,9 @@ void *buffer_acquire(size_t bytes) {
 
   node = g_free_list;
   g_free_list = g_free_list->next;
+  if (--g_free_count < g_min_free_count) {
+    g_min_free_count = g_free_count;
+  }
 
   node->bytes = bytes;
   node->state = BUFFER_PENDING;
@@ -126,6 +135,22 @@ void buffer_release(struct Buffer *buffer) {
   buffer->bytes = 0;
   buffer->next = g_free_list;
   g_free_list = buffer;
+  ++g_free_count;
+
+  x86_sti(saved_flags);
+}
+
+void buffer_get_usage(struct BufferUsage *usage) {
+  const struct Buffer *b;
+  uint16_t saved_flags = x86_cli();
+
+  usage->total = g_buffer_count;
+  usage->free = g_free_count;
+  usage->min_free = g_min_free_count;
+  usage->ready = 0;
+  for (b = g_ready_list; b; b = b->next) {
+    ++usage->ready;
+  }
 
   x86_sti(saved_flags);
 }
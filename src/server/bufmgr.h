@@ -45,6 +45,14 @@ struct Buffer {
   uint8_t data[BUFFER_MAX_SIZE];
 };
 
+// Snapshot of the buffers, for V1_STATS_RESP.
+struct BufferUsage {
+  uint16_t total;
+  uint16_t free;
+  uint16_t ready;
+  uint16_t min_free; // Fewest ever free, since `buffer_init()`.
+};
+
 // Initialize the buffer manager (create initial free list).
 extern void buffer_init(size_t count);
 
@@ -64,6 +72,9 @@ extern struct Buffer *buffer_get_ready();
 // to return it to the 'free' list.
 extern void buffer_release(struct Buffer *buffer);
 
+// Fills in `usage`.
+extern void buffer_get_usage(struct BufferUsage *usage);
+
 #if DEBUG
 extern void buffer_debug_dump(FILE *fp);
 #endif
@@ -11,9 +11,9 @@
 
 #if HAS_INT28
 
-// Exposed so that main() can memset() the stack before installing the ISR,
-// so that we can observe stack usage via DEBUG.COM.
-extern uint8_t *int28_stack_top, *int28_stack_bottom;
+// Exposed so that main() can paint the stack before installing the ISR, and
+// V1_STATS_RESP can report how much of it was ever used.
+extern uint8_t int28_stack_bottom[], int28_stack_top[];
 
 // Must be implemented in C, elsewhere.
 extern void int28_handler();
@@ -25,9 +25,9 @@
 #define MULTIPLEX_CMD_INSTALL_CHECK 0
 #define MULTIPLEX_CMD_UNINSTALL 1
 
-// Exposed so that main() can memset() the stack before installing the ISR,
-// so that we can observe stack usage via DEBUG.COM.
-extern uint8_t *int2f_stack_top, *int2f_stack_bottom;
+// Exposed so that main() can paint the stack before installing the ISR, and
+// V1_STATS_RESP can report how much of it was ever used.
+extern uint8_t int2f_stack_bottom[], int2f_stack_top[];
 
 // Must be implemented in C, elsewhere.
 extern void int2f_handler(struct CpuRegs *regs);
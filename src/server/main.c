@@ -39,19 +39,20 @@ extern void *sbrk();
 
 extern uint8_t _etext, _edata, _end;
 
-void install_interrupt_handlers() {
-  uint16_t cs = __get_cs();
-
-  // Debugging aide.  Used to determine how much of each stack we are using.
-  // We can examine the machine's memory (DEBUG.COM or a core-dump from
-  // QEMU) for the regions occupied by these stacks.
-#if DEBUG
-  memset(&int08_stack_bottom, 0x55, &int08_stack_top - &int08_stack_bottom);
+// Paints the private stacks, so that V1_STATS_RESP can report how much of
+// each was ever used (and so can DEBUG.COM, or a core-dump from QEMU).  Must
+// be done before the packet driver or any ISR can run on them.
+void paint_stacks() {
+  stack_paint(int08_stack_bottom, int08_stack_top);
 #if HAS_INT28
-  memset(&int28_stack_bottom, 0x55, &int28_stack_top - &int28_stack_bottom);
-#endif
-  memset(&int2f_stack_bottom, 0x55, &int2f_stack_top - &int2f_stack_bottom);
+  stack_paint(int28_stack_bottom, int28_stack_top);
 #endif
+  stack_paint(int2f_stack_bottom, int2f_stack_top);
+  stack_paint(pktdrv_stack_bottom, pktdrv_stack_top);
+}
+
+void install_interrupt_handlers() {
+  uint16_t cs = __get_cs();
 
   int08_original_handler = __getvect(0x08);
   __setvect(0x08, MK_FP(cs, int08_isr));
@@ -211,6 +212,7 @@ int main(int argc, char *argv[]) {
   buffer_init(buffers);
   protocol_init();
   session_mgr_init();
+  paint_stacks();
 
   r = pktdrv_init(irq);
   if (r) {
@@ -171,9 +171,35 @@ enum PktDrvResultCode pktdrv_send(const void *buffer, uint16_t length) {
 
     x86_call(g_pktdrv_irq, &regs);
     if (regs.flags & CPU_FLAG_CARRY) {
+      ++g_pktdrv_stats.send_errors;
       return regs.b.dh; // Error code.
     }
+    ++g_pktdrv_stats.packets_sent;
   }
 
   return PKTDRV_OK;
 }
+
+// `driver_info()` functionality: 2 = basic and extended, 6 = all three.
+#define PKTDRV_HAS_EXTENDED(functionality) ((functionality) & 2)
+
+enum PktDrvResultCode pktdrv_get_statistics(struct PktDrvDriverStats *stats) {
+  struct CpuRegs regs;
+
+  if (!g_pktdrv_handle || !PKTDRV_HAS_EXTENDED(g_pktdrv_info.functionality)) {
+    return PKTDRV_ERR_BAD_COMMAND;
+  }
+
+  x86_reset_regs(&regs);
+  regs.w.ax = PKTDRV_FUNC_GET_STATISTICS << 8;
+  regs.w.bx = g_pktdrv_handle;
+  x86_call(g_pktdrv_irq, &regs);
+  if (regs.flags & CPU_FLAG_CARRY) {
+    return regs.b.dh; // Error code.
+  }
+
+  // DS:SI points into the driver.
+  x86_memcpy_bytes(__get_ds(), (uint16_t)stats, regs.ds, regs.si,
+                   sizeof(*stats));
+  return PKTDRV_OK;
+}
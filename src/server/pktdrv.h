@@ -120,8 +120,25 @@ struct PktDrvStats {
   uint32_t packets_recv;
   uint32_t packets_dropped;
   uint32_t packets_sent;
+  uint32_t send_errors;
 };
 
+// http://crynwr.com/packet_driver.html, "get_statistics()"
+// Counted by the driver itself, for all of its handles.
+struct PktDrvDriverStats {
+  uint32_t packets_in;
+  uint32_t packets_out;
+  uint32_t bytes_in;
+  uint32_t bytes_out;
+  uint32_t errors_in;
+  uint32_t errors_out;
+  uint32_t packets_lost;
+};
+
+// Private stack of the receiver, `pktdrv_receive_isr()`.
+// Implemented in server/pktrecv.s
+extern uint8_t pktdrv_stack_bottom[], pktdrv_stack_top[];
+
 // Initializes state and connects to the packet driver.
 // If `irq` is zero, will then probe for the packet driver.
 // If `pktdrv_init()` returns `PKTDRV_OK`, then the program MUST call
@@ -137,4 +154,9 @@ extern enum PktDrvResultCode pktdrv_done();
 // the trailing CRC (which the packet driver fills in for us).
 extern enum PktDrvResultCode pktdrv_send(const void *buffer, uint16_t length);
 
+// Copies the driver's own counters into `stats`.  Only "extended" drivers
+// implement this; others return PKTDRV_ERR_BAD_COMMAND.
+extern enum PktDrvResultCode
+pktdrv_get_statistics(struct PktDrvDriverStats *stats);
+
 #endif // __RMTDOS_SERVER_PKTDRV_H
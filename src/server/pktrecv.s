@@ -13,9 +13,11 @@
 ; the NIC handled a packet interrupt and caused the packet driver to invoke us.
 
 .data
-pktdrv_stack_bottom:
+.global _pktdrv_stack_bottom, _pktdrv_stack_top
+
+_pktdrv_stack_bottom:
     .blkb    $100
-pktdrv_stack_top:
+_pktdrv_stack_top:
 
 pktdrv_saved_ss:
     .word  $0
@@ -51,7 +53,7 @@ _pktdrv_receive_isr:
 ; Tell CPU to use our private stack with SS=CS.
     mov     dx, cs                   ; Caller does not use DX.
     mov     ss, dx
-    lea     sp, pktdrv_stack_top - 2
+    lea     sp, _pktdrv_stack_top - 2
 
 ; We are now on our alternate stack.  Proceed as normal.
     push    bp
@@ -16,6 +16,7 @@
 #include "server/globals.h"
 #include "server/pktdrv.h"
 #include "server/protocol.h"
+#include "server/resident.h"
 #include "server/session.h"
 #include "server/util.h"
 
@@ -125,6 +126,47 @@ void handle_status_req(const struct Buffer *buffer) {
   pktdrv_send(g_send_buffer, V1_STATUS_RESP_LEN);
 }
 
+void handle_stats_req(const struct Buffer *buffer) {
+  struct EthernetHeader *out_eh = (struct EthernetHeader *)(g_send_buffer);
+  struct ProtocolHeader *out_ph = (struct ProtocolHeader *)(out_eh + 1);
+  struct StatsResponse *resp = (struct StatsResponse *)(out_ph + 1);
+  struct PktDrvDriverStats drv;
+  struct BufferUsage usage;
+
+  prep_for_reply(buffer);
+  out_ph->pkt_type = htons(V1_STATS_RESP);
+  out_ph->payload_len = htons(sizeof(*resp));
+
+  resp->int08_ticks = htonl(int08_ticks);
+  resp->int2f_ticks = htonl(int2f_ticks);
+  resp->packets_recv = htonl(g_pktdrv_stats.packets_recv);
+  resp->packets_dropped = htonl(g_pktdrv_stats.packets_dropped);
+  resp->packets_sent = htonl(g_pktdrv_stats.packets_sent);
+  resp->send_errors = htonl(g_pktdrv_stats.send_errors);
+
+  if (PKTDRV_OK == pktdrv_get_statistics(&drv)) {
+    resp->flags = htons(STATS_HAS_DRIVER);
+    resp->drv_packets_in = htonl(drv.packets_in);
+    resp->drv_packets_out = htonl(drv.packets_out);
+    resp->drv_bytes_in = htonl(drv.bytes_in);
+    resp->drv_bytes_out = htonl(drv.bytes_out);
+    resp->drv_errors_in = htonl(drv.errors_in);
+    resp->drv_errors_out = htonl(drv.errors_out);
+    resp->drv_packets_lost = htonl(drv.packets_lost);
+  }
+
+  buffer_get_usage(&usage);
+  resp->buffers_total = htons(usage.total);
+  resp->buffers_free = htons(usage.free);
+  resp->buffers_ready = htons(usage.ready);
+  resp->buffers_min_free = htons(usage.min_free);
+
+  resp->sessions_active = htons(session_mgr_count());
+  resident_stack_usage(resp);
+
+  pktdrv_send(g_send_buffer, COMBINED_HEADER_LEN + sizeof(*resp));
+}
+
 void handle_inject_keystroke(const struct Buffer *buffer) {
   const struct EthernetHeader *in_eh =
       (const struct EthernetHeader *)(buffer->data);
@@ -174,6 +216,9 @@ void protocol_process() {
         case V1_STATUS_REQ:
           handle_status_req(buffer);
           break;
+        case V1_STATS_REQ:
+          handle_stats_req(buffer);
+          break;
         case V1_SESSION_START:
           session_mgr_start(buffer);
           break;
@@ -9,6 +9,7 @@
 #include <dos.h>
 #endif
 
+#include "common/protocol.h"
 #include "lib16/x86.h"
 #include "lib16/video.h"
 #include "server/config.h"
@@ -16,6 +17,7 @@
 #include "server/int08.h"
 #include "server/int28.h"
 #include "server/int2f.h"
+#include "server/pktdrv.h"
 #include "server/protocol.h"
 #include "server/resident.h"
 #include "server/session.h"
@@ -79,6 +81,18 @@ int resident_do_uninstall() {
   return -regs.w.ax;
 }
 
+void resident_stack_usage(struct StatsResponse *resp) {
+  resp->int08_stack_size = htons(int08_stack_top - int08_stack_bottom);
+  resp->int08_stack_used =
+      htons(stack_used(int08_stack_bottom, int08_stack_top));
+  resp->int2f_stack_size = htons(int2f_stack_top - int2f_stack_bottom);
+  resp->int2f_stack_used =
+      htons(stack_used(int2f_stack_bottom, int2f_stack_top));
+  resp->pktdrv_stack_size = htons(pktdrv_stack_top - pktdrv_stack_bottom);
+  resp->pktdrv_stack_used =
+      htons(stack_used(pktdrv_stack_bottom, pktdrv_stack_top));
+}
+
 #if DEBUG
 void isr_show_debug_stats() {
   video_printf(64, 0, 15, "int 08: %8lu", int08_ticks);
@@ -8,6 +8,8 @@
 
 #include "lib16/x86.h"
 
+struct StatsResponse;
+
 extern int resident_uninstall_check();
 
 extern void restore_interrupt_handlers();
@@ -18,4 +20,8 @@ extern void int28_handler();
 
 extern void int2f_handler(struct CpuRegs *regs);
 
+// Fills in the `*_stack_*` fields of `resp` (network byte order), from the
+// paint left on the private stacks.
+extern void resident_stack_usage(struct StatsResponse *resp);
+
 #endif // __RMTDOS_SERVER_RESIDENT_H
@@ -69,6 +69,10 @@ struct Session *session_mgr_start(const struct Buffer *buffer) {
     }
     memcpy(s->mac_addr, in_eh->src_mac_addr, ETH_ALEN);
     s->session_id = session_id;
+
+    // A new client has nothing on screen yet.  Forget the checksum of the
+    // last frame, so the next pass is sent even if the screen is static.
+    video_chksum = 0;
   }
 
   s->t_last_recv = x86_read_bios_tick_clock();
@@ -77,6 +81,19 @@ struct Session *session_mgr_start(const struct Buffer *buffer) {
   return s;
 }
 
+int session_mgr_count() {
+  struct Session *s;
+  int count = 0;
+
+  for (s = g_sessions; s < g_session_eof; ++s) {
+    if (memcmp(s->mac_addr, null_if_addr, ETH_ALEN)) {
+      ++count;
+    }
+  }
+
+  return count;
+}
+
 void session_mgr_reclaim(struct Session *s) { memset(s, 0, sizeof(*s)); }
 
 void session_mgr_update(struct Session *s) {}
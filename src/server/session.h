@@ -38,3 +38,6 @@ extern void session_mgr_debug();
 #endif // DEBUG
 
 extern void session_mgr_update_all();
+
+// Count of sessions not yet timed out (nor pruned).
+extern int session_mgr_count();
@@ -5,6 +5,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "server/util.h"
 
@@ -13,3 +14,17 @@ char *fmt_mac_addr(char *dest, const uint8_t *mac_addr) {
           mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
   return dest;
 }
+
+void stack_paint(uint8_t *bottom, uint8_t *top) {
+  memset(bottom, STACK_PAINT, top - bottom);
+}
+
+uint16_t stack_used(const uint8_t *bottom, const uint8_t *top) {
+  const uint8_t *p = bottom;
+
+  // Stacks grow down, so the paint left at the bottom was never touched.
+  while ((p < top) && (*p == STACK_PAINT)) {
+    ++p;
+  }
+  return top - p;
+}
@@ -32,3 +32,15 @@ extern void copy_mac_addr(uint8_t *dest, const uint8_t *src);
 #define MAC_ADDR_FMT_LEN (5 + 6 * 2 + 1)
 
 extern char *fmt_mac_addr(char *dest, const uint8_t *mac_addr);
+
+// Fill byte of unused stack.  The private stacks of the interrupt handlers
+// are painted with it before the handlers are installed, so that the most
+// ever used can be found later.
+#define STACK_PAINT 0x55
+
+// Paints the stack from `bottom` up to (not including) `top`.
+extern void stack_paint(uint8_t *bottom, uint8_t *top);
+
+// Returns the most bytes of the painted stack from `bottom` to `top` that
+// were ever used.
+extern uint16_t stack_used(const uint8_t *bottom, const uint8_t *top);
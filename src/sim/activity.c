@@ -0,0 +1,413 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Scripted screen activity for the simulated servers.  Every workload shows
+// a DOS prompt and echoes keystrokes injected by the client at the cursor,
+// so keystroke to echo latency can be measured against any of them.  The
+// "probe" workload is instead the echo probe of "vga_demo.com -p" (see
+// common/probe.h), for "rmtdos-client -E".
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/probe.h"
+#include "sim/sim.h"
+
+#define ATTR_NORMAL 0x07
+#define ATTR_STATUS 0x1f
+#define ATTR_WINDOW 0x17 // White on blue, as EDIT and DEFRAG.
+#define ATTR_MENU 0x70
+#define ATTR_HINT 0x30
+
+// Code page 437 box drawing and blocks.
+#define CP437_LIGHT_SHADE 0xb0
+#define CP437_VERTICAL 0xb3
+#define CP437_UPPER_RIGHT 0xbf
+#define CP437_LOWER_LEFT 0xc0
+#define CP437_HORIZONTAL 0xc4
+#define CP437_LOWER_RIGHT 0xd9
+#define CP437_UPPER_LEFT 0xda
+#define CP437_FULL_BLOCK 0xdb
+
+#define PROMPT "C:\\>"
+
+struct Workload {
+  const char *name;
+
+  // Milliseconds between steps, unless overridden with `-i`.
+  unsigned default_interval_ms;
+
+  void (*step)(uint64_t now_ms);
+
+  // Draws a keystroke.  NULL to echo it at the DOS prompt.
+  void (*echo)(uint8_t ascii_value);
+};
+
+static const struct Workload *g_workload = NULL;
+static unsigned g_interval_ms = 0;
+static unsigned g_seed = 0;
+static uint64_t g_next_ms = 0;
+static uint64_t g_steps = 0;
+static uint16_t g_probe_received = 0;
+
+static uint8_t *cell(int row, int col) {
+  return &g_sim_frame_buffer[(row * g_sim_text_cols + col) * 2];
+}
+
+static void put_str(int row, int col, uint8_t attr, const char *s) {
+  for (; *s && (col < g_sim_text_cols); ++s, ++col) {
+    uint8_t *p = cell(row, col);
+    p[0] = *s;
+    p[1] = attr;
+  }
+}
+
+static void fill_row(int row, uint8_t ch, uint8_t attr) {
+  for (int col = 0; col < g_sim_text_cols; ++col) {
+    uint8_t *p = cell(row, col);
+    p[0] = ch;
+    p[1] = attr;
+  }
+}
+
+static void clear_row(int row) { fill_row(row, ' ', ATTR_NORMAL); }
+
+// Moves every row up by one, as the BIOS teletype does at the bottom.
+static void scroll_up() {
+  const size_t row_len = g_sim_text_cols * 2;
+
+  memmove(cell(0, 0), cell(1, 0), (g_sim_text_rows - 1) * row_len);
+  clear_row(g_sim_text_rows - 1);
+}
+
+static void newline() {
+  g_sim_cursor_col = 0;
+  if (g_sim_cursor_row + 1 < g_sim_text_rows) {
+    ++g_sim_cursor_row;
+  } else {
+    scroll_up();
+  }
+}
+
+static void teletype(const char *s) {
+  for (; *s; ++s) {
+    if (*s == '\n') {
+      newline();
+      continue;
+    }
+
+    uint8_t *p = cell(g_sim_cursor_row, g_sim_cursor_col);
+    p[0] = *s;
+    p[1] = ATTR_NORMAL;
+    if (++g_sim_cursor_col == g_sim_text_cols) {
+      newline();
+    }
+  }
+}
+
+// Echoes keystrokes like COMMAND.COM: text at the cursor, Backspace, and
+// Enter for a fresh prompt.
+static void echo_keys(struct SimStats *stats) {
+  uint8_t scan_code, ascii_value;
+
+  while (sim_keyboard_pop(&scan_code, &ascii_value)) {
+    ++stats->keystrokes;
+
+    if (g_workload->echo) {
+      g_workload->echo(ascii_value);
+    } else if (ascii_value == '\r') {
+      teletype("\n" PROMPT);
+    } else if (ascii_value == '\b') {
+      if (g_sim_cursor_col > strlen(PROMPT)) {
+        --g_sim_cursor_col;
+        cell(g_sim_cursor_row, g_sim_cursor_col)[0] = ' ';
+      }
+    } else if (ascii_value >= ' ') {
+      const char s[2] = {(char)ascii_value, 0};
+      teletype(s);
+    }
+  }
+}
+
+static void step_idle(uint64_t now_ms) {}
+
+// Echo probe: the key, after the count of keys so far, as "vga_demo -p".
+static void draw_probe(uint8_t ascii_value) {
+  char buf[PROBE_COUNT_DIGITS + 1];
+
+  snprintf(buf, sizeof(buf), "%04x", g_probe_received);
+  put_str(PROBE_ROW, PROBE_COL + PROBE_COUNT_OFFSET, PROBE_ATTR, buf);
+  cell(PROBE_ROW, PROBE_COL)[0] = ascii_value ? ascii_value : ' ';
+  cell(PROBE_ROW, PROBE_COL)[1] = PROBE_ATTR;
+}
+
+static void echo_probe(uint8_t ascii_value) {
+  ++g_probe_received;
+  draw_probe(ascii_value);
+}
+
+static void step_probe(uint64_t now_ms) {
+  if (!g_steps) {
+    for (int row = 0; row < g_sim_text_rows; ++row) {
+      clear_row(row);
+    }
+    put_str(0, 0, ATTR_NORMAL, "rmtdos echo probe.  <ALT-X> Exit.");
+    put_str(PROBE_ROW - 1, PROBE_COL, ATTR_NORMAL, "Key Count");
+    draw_probe(' ');
+  }
+}
+
+// A clock in the top right corner, as many TSRs show.
+static void step_clock(uint64_t now_ms) {
+  char buf[16];
+  const unsigned secs = now_ms / 1000;
+
+  snprintf(buf, sizeof(buf), " %02u:%02u:%02u ", secs / 3600 % 24,
+           secs / 60 % 60, secs % 60);
+  put_str(0, g_sim_text_cols - strlen(buf), ATTR_STATUS, buf);
+}
+
+// A program printing a log line at a time, scrolling the screen.
+static void step_log(uint64_t now_ms) {
+  char buf[80];
+
+  snprintf(buf, sizeof(buf), "%10lu.%03lu  job %06lu: %s\n", now_ms / 1000,
+           now_ms % 1000, g_steps,
+           (g_steps % 7) ? "record processed" : "checkpoint written");
+  teletype(buf);
+}
+
+// Cells changing all over the screen, like a dashboard.
+static void step_random(uint64_t now_ms) {
+  for (int i = 0; i < 16; ++i) {
+    const int row = rand_r(&g_seed) % g_sim_text_rows;
+    const int col = rand_r(&g_seed) % g_sim_text_cols;
+    uint8_t *p = cell(row, col);
+    p[0] = '!' + rand_r(&g_seed) % 94;
+    p[1] = 1 + rand_r(&g_seed) % 15;
+  }
+}
+
+// Every cell changes every step; the most the server can be asked to send.
+static void step_full(uint64_t now_ms) {
+  const uint8_t ch = 'A' + g_steps % 26;
+  const uint8_t attr = 1 + g_steps % 15;
+
+  for (int row = 0; row < g_sim_text_rows; ++row) {
+    for (int col = 0; col < g_sim_text_cols; ++col) {
+      uint8_t *p = cell(row, col);
+      p[0] = ch;
+      p[1] = attr;
+    }
+  }
+}
+
+// DIR of a large directory, a line per step, then a pause at the prompt.
+#define DIR_FILES 48
+#define DIR_PAUSE_STEPS 40
+
+static void step_dir(uint64_t now_ms) {
+  static const char *names[] = {
+      "COMMAND COM", "APPEND  EXE", "ATTRIB  EXE", "CHKDSK  EXE",
+      "DEBUG   EXE", "DEFRAG  EXE", "DELTREE EXE", "DOSKEY  COM",
+      "EDIT    COM", "EMM386  EXE", "FDISK   EXE", "FORMAT  COM",
+      "HIMEM   SYS", "MEM     EXE", "MSD     EXE", "QBASIC  EXE",
+  };
+  const unsigned n = g_steps % (DIR_FILES + DIR_PAUSE_STEPS);
+  char buf[80];
+
+  if (n == 0) {
+    teletype("DIR\n\n Volume in drive C is MS-DOS_6\n Directory of C:\\DOS\n\n");
+  } else if (n <= DIR_FILES) {
+    const unsigned i = n - 1;
+    snprintf(buf, sizeof(buf), "%s %9u 05-31-94   6:%02ua\n",
+             names[i % (sizeof(names) / sizeof(names[0]))],
+             1000 + (i * 7919) % 90000, i % 60);
+    teletype(buf);
+  } else if (n == DIR_FILES + 1) {
+    teletype("       48 file(s)      2,145,678 bytes\n"
+             "                     312,401,920 bytes free\n\n" PROMPT);
+  }
+}
+
+// MS-DOS EDIT: a window of text typed at a steady pace, with the cursor
+// position in the status line.
+static const char g_edit_text[] =
+    "REM Nightly batch for the accounts ledger.\n"
+    "@ECHO OFF\n"
+    "CD \\LEDGER\n"
+    "IF EXIST LEDGER.LCK GOTO BUSY\n"
+    "COPY LEDGER.DAT LEDGER.BAK > NUL\n"
+    "POST /ALL /REPORT=PRN\n"
+    "GOTO END\n"
+    ":BUSY\n"
+    "ECHO Ledger is in use, try again later.\n"
+    ":END\n";
+
+static unsigned g_edit_line = 0;
+
+static void draw_edit_window() {
+  const int bottom = g_sim_text_rows - 2;
+
+  fill_row(0, ' ', ATTR_MENU);
+  put_str(0, 1, ATTR_MENU, " File  Edit  Search  Options");
+  for (int row = 1; row < g_sim_text_rows - 1; ++row) {
+    fill_row(row, ' ', ATTR_WINDOW);
+    cell(row, 0)[0] = CP437_VERTICAL;
+    cell(row, g_sim_text_cols - 1)[0] = CP437_VERTICAL;
+  }
+  fill_row(1, CP437_HORIZONTAL, ATTR_WINDOW);
+  fill_row(bottom, CP437_HORIZONTAL, ATTR_WINDOW);
+  cell(1, 0)[0] = CP437_UPPER_LEFT;
+  cell(1, g_sim_text_cols - 1)[0] = CP437_UPPER_RIGHT;
+  cell(bottom, 0)[0] = CP437_LOWER_LEFT;
+  cell(bottom, g_sim_text_cols - 1)[0] = CP437_LOWER_RIGHT;
+  put_str(1, g_sim_text_cols / 2 - 5, ATTR_MENU, " LEDGER.BAT ");
+  fill_row(g_sim_text_rows - 1, ' ', ATTR_HINT);
+  put_str(g_sim_text_rows - 1, 1, ATTR_HINT,
+          "MS-DOS Editor  <F1=Help> Press ALT to activate menus");
+
+  g_sim_cursor_row = 2;
+  g_sim_cursor_col = 1;
+  g_edit_line = 1;
+}
+
+static void step_edit(uint64_t now_ms) {
+  const int last_text_row = g_sim_text_rows - 3;
+  const char ch = g_edit_text[g_steps % (sizeof(g_edit_text) - 1)];
+  char buf[32];
+
+  if (!g_steps) {
+    draw_edit_window();
+  }
+
+  if (ch == '\n') {
+    g_sim_cursor_col = 1;
+    ++g_edit_line;
+    if (g_sim_cursor_row < last_text_row) {
+      ++g_sim_cursor_row;
+    } else {
+      // Scroll the text, frame and all, up a row.
+      memmove(cell(2, 0), cell(3, 0), (last_text_row - 2) * g_sim_text_cols * 2);
+      for (int col = 1; col < g_sim_text_cols - 1; ++col) {
+        cell(last_text_row, col)[0] = ' ';
+      }
+    }
+  } else if (g_sim_cursor_col < g_sim_text_cols - 1) {
+    uint8_t *p = cell(g_sim_cursor_row, g_sim_cursor_col++);
+    p[0] = ch;
+    p[1] = ATTR_WINDOW;
+  }
+
+  snprintf(buf, sizeof(buf), " %05u:%03u ", g_edit_line, g_sim_cursor_col);
+  put_str(g_sim_text_rows - 1, g_sim_text_cols - strlen(buf) - 1, ATTR_HINT,
+          buf);
+}
+
+// A disk optimizer's cluster map filling the screen.  Each step moves a few
+// clusters and the progress bar.
+#define DEFRAG_CLUSTERS_PER_STEP 4
+
+static void draw_defrag_map(int map_rows) {
+  fill_row(0, ' ', ATTR_MENU);
+  put_str(0, 1, ATTR_MENU, "Optimize  Analyze  Configure  Exit");
+  for (int row = 1; row < 1 + map_rows; ++row) {
+    for (int col = 0; col < g_sim_text_cols; ++col) {
+      uint8_t *p = cell(row, col);
+      p[0] = (rand_r(&g_seed) % 3) ? CP437_FULL_BLOCK : CP437_LIGHT_SHADE;
+      p[1] = ATTR_WINDOW;
+    }
+  }
+  for (int row = 1 + map_rows; row < g_sim_text_rows; ++row) {
+    fill_row(row, ' ', ATTR_WINDOW);
+  }
+}
+
+static void step_defrag(uint64_t now_ms) {
+  const int map_rows = g_sim_text_rows - 4;
+  const unsigned clusters = map_rows * g_sim_text_cols;
+  char buf[48];
+
+  if (map_rows < 1) {
+    return;
+  }
+
+  const unsigned pos = (g_steps * DEFRAG_CLUSTERS_PER_STEP) % clusters;
+  if (pos < DEFRAG_CLUSTERS_PER_STEP) {
+    draw_defrag_map(map_rows);
+  }
+
+  // Clusters behind the head are packed; the head reads ahead of them.
+  for (unsigned i = 0; i < 2 * DEFRAG_CLUSTERS_PER_STEP; ++i) {
+    const unsigned c = pos + i;
+    if (c < clusters) {
+      uint8_t *p = cell(1 + c / g_sim_text_cols, c % g_sim_text_cols);
+      p[0] = (i < DEFRAG_CLUSTERS_PER_STEP) ? CP437_FULL_BLOCK : 'r';
+      p[1] = (i < DEFRAG_CLUSTERS_PER_STEP) ? 0x1a : 0x1e;
+    }
+  }
+
+  const unsigned pct = pos * 100 / clusters;
+  const int bar_row = g_sim_text_rows - 2;
+  for (int col = 0; col < g_sim_text_cols; ++col) {
+    uint8_t *p = cell(bar_row, col);
+    p[0] = (col * 100 < (int)pct * g_sim_text_cols) ? CP437_FULL_BLOCK
+                                                     : CP437_LIGHT_SHADE;
+    p[1] = ATTR_WINDOW;
+  }
+  snprintf(buf, sizeof(buf), "Cluster %6u      %3u%% complete", pos, pct);
+  put_str(g_sim_text_rows - 1, 1, ATTR_WINDOW, buf);
+}
+
+static const struct Workload g_workloads[] = {
+    {"idle", 1000, step_idle},     {"clock", 1000, step_clock},
+    {"log", 100, step_log},        {"random", 55, step_random},
+    {"full", 55, step_full},       {"dir", 55, step_dir},
+    {"edit", 150, step_edit},      {"defrag", 55, step_defrag},
+    {"probe", 1000, step_probe, echo_probe},
+};
+
+#define WORKLOAD_COUNT (sizeof(g_workloads) / sizeof(g_workloads[0]))
+
+const char *activity_names() {
+  return "idle, clock, log, random, full, dir, edit, defrag, probe";
+}
+
+static const struct Workload *find_workload(const char *name) {
+  for (size_t i = 0; i < WORKLOAD_COUNT; ++i) {
+    if (!strcmp(g_workloads[i].name, name)) {
+      return &g_workloads[i];
+    }
+  }
+  return NULL;
+}
+
+int activity_exists(const char *name) { return !!find_workload(name); }
+
+int activity_init(const char *name, unsigned interval_ms, unsigned seed) {
+  if (!(g_workload = find_workload(name))) {
+    return -1;
+  }
+
+  g_interval_ms = interval_ms ? interval_ms : g_workload->default_interval_ms;
+  g_seed = seed;
+  g_next_ms = 0;
+  g_steps = 0;
+  g_probe_received = 0;
+
+  teletype("Microsoft(R) MS-DOS(R) Version 6.22\n\n" PROMPT);
+  return 0;
+}
+
+void activity_step(uint64_t now_ms, struct SimStats *stats) {
+  echo_keys(stats);
+
+  if (now_ms >= g_next_ms) {
+    g_workload->step(now_ms);
+    ++g_steps;
+    g_next_ms = now_ms + g_interval_ms;
+  }
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Linux stand-ins for the lib16 routines that the server's protocol and
+// session code call.  The VGA text buffer is a plain array, the BIOS tick
+// clock runs from CLOCK_MONOTONIC (or is set by hand), and injected keystrokes go to a small
+// ring that the scripted activity consumes.
+
+#include <string.h>
+#include <time.h>
+
+#include "common/protocol.h"
+#include "lib16/video.h"
+#include "lib16/x86.h"
+#include "server/resident.h"
+#include "sim/sim.h"
+
+// Same as the BIOS keyboard buffer.
+#define KEYBOARD_BUFFER_LEN 16
+
+uint8_t g_sim_frame_buffer[SIM_FRAME_BUFFER_LEN];
+uint8_t g_sim_text_rows = VIDEO_ROWS;
+uint8_t g_sim_text_cols = VIDEO_COLS;
+uint8_t g_sim_cursor_row = 0;
+uint8_t g_sim_cursor_col = 0;
+
+uint16_t video_address = 0xb800;
+
+static struct timespec g_clock_start;
+
+// Set by `sim_clock_set()`; the clock then only moves when told to.
+static int g_clock_manual = 0;
+static uint32_t g_clock_ticks = 0;
+
+static uint16_t g_keys[KEYBOARD_BUFFER_LEN];
+static unsigned g_keys_head = 0;
+static unsigned g_keys_tail = 0;
+
+void sim_video_init(uint8_t text_rows, uint8_t text_cols) {
+  g_sim_text_rows = text_rows;
+  g_sim_text_cols = text_cols;
+  g_sim_cursor_row = g_sim_cursor_col = 0;
+
+  for (size_t i = 0; i < SIM_FRAME_BUFFER_LEN; i += 2) {
+    g_sim_frame_buffer[i] = ' ';
+    g_sim_frame_buffer[i + 1] = 0x07;
+  }
+}
+
+void sim_clock_init() {
+  g_clock_manual = 0;
+  clock_gettime(CLOCK_MONOTONIC, &g_clock_start);
+}
+
+void sim_clock_set(uint32_t ticks) {
+  g_clock_manual = 1;
+  g_clock_ticks = ticks;
+}
+
+int sim_keyboard_pop(uint8_t *scan_code, uint8_t *ascii_value) {
+  if (g_keys_head == g_keys_tail) {
+    return 0;
+  }
+
+  const uint16_t key = g_keys[g_keys_head++ % KEYBOARD_BUFFER_LEN];
+  *scan_code = key >> 8;
+  *ascii_value = key & 0xff;
+  return 1;
+}
+
+uint16_t video_init() { return video_address; }
+
+uint16_t video_get_segment() { return video_address; }
+
+void video_read_state(struct VideoState *state) {
+  state->video_mode = 3;
+  state->active_page = 0;
+  state->text_rows = g_sim_text_rows;
+  state->text_cols = g_sim_text_cols;
+  state->cursor_row = g_sim_cursor_row;
+  state->cursor_col = g_sim_cursor_col;
+}
+
+void video_copy_from_frame_buffer(void *dest, uint16_t offset,
+                                  uint16_t words) {
+  if ((size_t)offset + words * 2 > SIM_FRAME_BUFFER_LEN) {
+    words = (SIM_FRAME_BUFFER_LEN - offset) / 2;
+  }
+  memcpy(dest, &g_sim_frame_buffer[offset], words * 2);
+}
+
+// Same algorithm as lib16/video.s: add each big-endian word, rotate left.
+uint16_t video_checksum_frame_buffer(uint16_t offset, uint16_t words) {
+  uint16_t sum = 0;
+
+  for (; words && (offset + 1 < SIM_FRAME_BUFFER_LEN); --words, offset += 2) {
+    sum += (g_sim_frame_buffer[offset] << 8) | g_sim_frame_buffer[offset + 1];
+    sum = (sum << 1) | (sum >> 15);
+  }
+
+  return sum;
+}
+
+// Ticks of the BIOS clock at 0040:006c since `sim_clock_init()`, or as last
+// set by `sim_clock_set()`.
+uint32_t x86_read_bios_tick_clock() {
+  struct timespec now;
+
+  if (g_clock_manual) {
+    return g_clock_ticks;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  const double secs = (now.tv_sec - g_clock_start.tv_sec) +
+                      (now.tv_nsec - g_clock_start.tv_nsec) / 1e9;
+  return (uint32_t)(secs * SIM_BIOS_TICK_HZ);
+}
+
+int x86_inject_keystroke(uint8_t bios_scan_code, uint8_t ascii_value,
+                         uint8_t flags_17) {
+  if (g_keys_tail - g_keys_head == KEYBOARD_BUFFER_LEN) {
+    return 0;
+  }
+
+  g_keys[g_keys_tail++ % KEYBOARD_BUFFER_LEN] =
+      (bios_scan_code << 8) | ascii_value;
+  return 1;
+}
+
+// Each virtual server is single threaded; there are no interrupts to mask.
+uint16_t x86_cli() { return 0; }
+
+uint16_t x86_sti(uint16_t saved_flags) { return saved_flags; }
+
+// The simulated server has no interrupt handlers, and so no private stacks;
+// V1_STATS_RESP reports them as empty.
+void resident_stack_usage(struct StatsResponse *resp) {}
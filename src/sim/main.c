@@ -0,0 +1,349 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Runs many simulated rmtdos servers on one interface, for load testing the
+// client and the protocol without DOS machines:
+//
+//   sudo out/rmtdos-sim -i veth0 -n 200 -w log,clock,random
+//
+// Each virtual server is a forked process running the real server code
+// (server/protocol.c, server/session.c, server/bufmgr.c) from a fake int 08h
+// tick, with its own MAC address (`-m` plus its index) and a scripted screen
+// workload.
+
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lib16/video.h"
+#include "server/bufmgr.h"
+#include "server/config.h"
+#include "server/globals.h"
+#include "server/protocol.h"
+#include "server/session.h"
+#include "sim/sim.h"
+
+#define MAX_WORKLOADS 16
+
+struct Options {
+  const char *if_name;
+  uint16_t ethertype;
+  uint8_t base_addr[ETH_ALEN];
+  int count;
+  int buffers;
+  double tick_hz;
+  unsigned interval_ms;
+  unsigned duration_s;
+  unsigned report_s;
+  uint8_t text_rows;
+  uint8_t text_cols;
+  const char *workloads[MAX_WORKLOADS];
+  int workload_count;
+};
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_signal(int sig) { g_stop = 1; }
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int parse_mac_addr(uint8_t *dest, const char *s) {
+  unsigned int a[ETH_ALEN];
+
+  if (ETH_ALEN != sscanf(s, "%x:%x:%x:%x:%x:%x", &a[0], &a[1], &a[2], &a[3],
+                         &a[4], &a[5])) {
+    return -1;
+  }
+  for (int i = 0; i < ETH_ALEN; ++i) {
+    dest[i] = a[i];
+  }
+  return 0;
+}
+
+// `base` plus `index`, carried across the low three bytes.
+static void server_addr(uint8_t *dest, const uint8_t *base, int index) {
+  uint32_t low = (base[3] << 16) | (base[4] << 8) | base[5];
+
+  low += index;
+  memcpy(dest, base, 3);
+  dest[3] = low >> 16;
+  dest[4] = low >> 8;
+  dest[5] = low;
+}
+
+// One virtual server; never returns.
+static void run_server(const struct Options *opt, int index,
+                       struct SimStats *stats) {
+  const uint64_t period_ns = 1e9 / opt->tick_hz;
+  uint8_t mac_addr[ETH_ALEN];
+  int fd;
+
+  // Don't outlive the parent.
+  prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+  server_addr(mac_addr, opt->base_addr, index);
+  g_ethertype = opt->ethertype;
+
+  sim_video_init(opt->text_rows, opt->text_cols);
+  sim_clock_init();
+  buffer_init(opt->buffers);
+  protocol_init();
+  session_mgr_init();
+
+  if (0 > (fd = sim_pktdrv_open(opt->if_name, mac_addr, opt->ethertype,
+                                stats))) {
+    _exit(EXIT_FAILURE);
+  }
+
+  activity_init(opt->workloads[index % opt->workload_count], opt->interval_ms,
+                index + 1);
+
+  const uint64_t start_ns = now_ns();
+  uint64_t next_ns = start_ns;
+
+  while (!g_stop) {
+    uint64_t now = now_ns();
+
+    if (now < next_ns) {
+      struct pollfd pfd = {.fd = fd, .events = POLLIN};
+      const struct timespec timeout = {
+          .tv_sec = (next_ns - now) / 1000000000ULL,
+          .tv_nsec = (next_ns - now) % 1000000000ULL,
+      };
+
+      // Frames arrive between ticks, as the driver's upcall would deliver
+      // them.
+      if (0 < ppoll(&pfd, 1, &timeout, NULL)) {
+        sim_pktdrv_receive();
+      }
+      continue;
+    }
+
+    // int 08h.
+    ++int08_ticks;
+    ++stats->ticks;
+    if (now - next_ns > period_ns / 2) {
+      ++stats->late_ticks;
+    }
+    next_ns += period_ns;
+    if (next_ns < now) {
+      next_ns = now + period_ns;
+    }
+
+    activity_step((now - start_ns) / 1000000, stats);
+    protocol_process();
+    session_mgr_update_all();
+  }
+
+  pktdrv_done();
+  _exit(EXIT_SUCCESS);
+}
+
+static void print_totals(const struct SimStats *stats, int count,
+                         double secs) {
+  struct SimStats sum = {0};
+
+  for (int i = 0; i < count; ++i) {
+    sum.packets_recv += stats[i].packets_recv;
+    sum.packets_dropped += stats[i].packets_dropped;
+    sum.packets_sent += stats[i].packets_sent;
+    sum.bytes_sent += stats[i].bytes_sent;
+    sum.send_errors += stats[i].send_errors;
+    sum.ticks += stats[i].ticks;
+    sum.late_ticks += stats[i].late_ticks;
+    sum.keystrokes += stats[i].keystrokes;
+  }
+
+  printf("%8.1f s  %d servers  sent %lu frames (%.0f/s, %.0f B/s, %lu "
+         "errors)  recv %lu (%lu dropped)  keys %lu  late ticks %lu/%lu\n",
+         secs, count, sum.packets_sent, secs ? sum.packets_sent / secs : 0.0,
+         secs ? sum.bytes_sent / secs : 0.0, sum.send_errors,
+         sum.packets_recv, sum.packets_dropped, sum.keystrokes,
+         sum.late_ticks, sum.ticks);
+  fflush(stdout);
+}
+
+static void print_usage(const char *progname) {
+  printf("usage: %s -i iface [options]\n", progname);
+  printf("  -b  Receive buffers per server (default: %d, max %d).\n",
+         DEFAULT_BUFFERS, MAX_BUFFERS);
+  printf("  -d  Exit after this many seconds (default: run until killed).\n");
+  printf("  -e  Ethertype as 4 hexadecimal digits (default: %04x).\n",
+         ETHERTYPE_RMTDOS);
+  printf("  -g  Screen size as COLSxROWS (default: %dx%d).\n", VIDEO_COLS,
+         VIDEO_ROWS);
+  printf("  -i  Interface to run on (a veth or a bridge).\n");
+  printf("  -I  Milliseconds between workload steps (default: per workload).\n");
+  printf("  -m  MAC address of the first server (default: "
+         "02:52:44:00:00:00).\n");
+  printf("  -n  Count of servers (default: 1, max %d).\n", SIM_MAX_SERVERS);
+  printf("  -r  Print totals every this many seconds (default: at exit).\n");
+  printf("  -t  Timer ticks per second (default: %.4f, as a PC).\n",
+         SIM_BIOS_TICK_HZ);
+  printf("  -w  Workloads, assigned in turn (default: idle).  One of:\n"
+         "      %s.\n",
+         activity_names());
+}
+
+int main(int argc, char **argv) {
+  struct Options opt = {
+      .ethertype = ETHERTYPE_RMTDOS,
+      .base_addr = {0x02, 0x52, 0x44, 0x00, 0x00, 0x00},
+      .count = 1,
+      .buffers = DEFAULT_BUFFERS,
+      .tick_hz = SIM_BIOS_TICK_HZ,
+      .text_rows = VIDEO_ROWS,
+      .text_cols = VIDEO_COLS,
+      .workloads = {"idle"},
+      .workload_count = 1,
+  };
+  char *workloads = NULL;
+  unsigned cols, rows;
+  int c;
+
+  while ((c = getopt(argc, argv, "b:d:e:g:i:I:m:n:r:t:w:")) != -1) {
+    switch (c) {
+      case 'b':
+        opt.buffers = atoi(optarg);
+        break;
+      case 'd':
+        opt.duration_s = atoi(optarg);
+        break;
+      case 'e':
+        opt.ethertype = strtoul(optarg, NULL, 16);
+        break;
+      case 'g':
+        if ((2 != sscanf(optarg, "%ux%u", &cols, &rows)) || !cols || !rows ||
+            (cols > 255) || (rows > 255) ||
+            (cols * rows * 2 > SIM_FRAME_BUFFER_LEN)) {
+          fprintf(stderr, "Bad screen size: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        opt.text_cols = cols;
+        opt.text_rows = rows;
+        break;
+      case 'i':
+        opt.if_name = optarg;
+        break;
+      case 'I':
+        opt.interval_ms = atoi(optarg);
+        break;
+      case 'm':
+        if (0 > parse_mac_addr(opt.base_addr, optarg)) {
+          fprintf(stderr, "Bad MAC address: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'n':
+        opt.count = atoi(optarg);
+        break;
+      case 'r':
+        opt.report_s = atoi(optarg);
+        break;
+      case 't':
+        opt.tick_hz = atof(optarg);
+        break;
+      case 'w':
+        workloads = optarg;
+        break;
+      default: /* '?' */
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (!opt.if_name || (opt.count < 1) || (opt.count > SIM_MAX_SERVERS) ||
+      (opt.buffers < 1) || (opt.buffers > MAX_BUFFERS) ||
+      (opt.tick_hz <= 0.0) || (optind != argc)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (workloads) {
+    opt.workload_count = 0;
+    for (char *w = strtok(workloads, ","); w && opt.workload_count < MAX_WORKLOADS;
+         w = strtok(NULL, ",")) {
+      if (!activity_exists(w)) {
+        fprintf(stderr, "Unknown workload: %s\n", w);
+        return EXIT_FAILURE;
+      }
+      opt.workloads[opt.workload_count++] = w;
+    }
+  }
+
+  // Counters of every server, readable by the parent.
+  struct SimStats *stats = (struct SimStats *)mmap(
+      NULL, opt.count * sizeof(struct SimStats), PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (stats == MAP_FAILED) {
+    perror("mmap()");
+    return EXIT_FAILURE;
+  }
+
+  struct sigaction sa = {.sa_handler = on_signal};
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  pid_t *pids = (pid_t *)calloc(opt.count, sizeof(pid_t));
+  for (int i = 0; i < opt.count; ++i) {
+    if (0 > (pids[i] = fork())) {
+      perror("fork()");
+      g_stop = 1;
+      break;
+    }
+    if (!pids[i]) {
+      run_server(&opt, i, &stats[i]);
+    }
+  }
+
+  const uint64_t start_ns = now_ns();
+  uint64_t last_report_ns = start_ns;
+  int running = opt.count;
+
+  while (!g_stop && running) {
+    sleep(1);
+
+    // Servers that failed to start exit at once.
+    while (0 < waitpid(-1, NULL, WNOHANG)) {
+      --running;
+    }
+
+    const uint64_t now = now_ns();
+    if (opt.duration_s && (now - start_ns >= opt.duration_s * 1000000000ULL)) {
+      break;
+    }
+    if (opt.report_s && (now - last_report_ns >= opt.report_s * 1000000000ULL)) {
+      print_totals(stats, opt.count, (now - start_ns) / 1e9);
+      last_report_ns = now;
+    }
+  }
+
+  for (int i = 0; i < opt.count; ++i) {
+    if (pids[i] > 0) {
+      kill(pids[i], SIGTERM);
+    }
+  }
+  while ((0 < wait(NULL)) || (errno == EINTR)) {
+  }
+
+  print_totals(stats, opt.count, (now_ns() - start_ns) / 1e9);
+
+  free(pids);
+  munmap(stats, opt.count * sizeof(struct SimStats));
+  return running ? EXIT_SUCCESS : EXIT_FAILURE;
+}
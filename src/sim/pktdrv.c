@@ -0,0 +1,178 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Packet driver stand-in.  Frames are received on an AF_PACKET socket and
+// handed to the server's buffer manager exactly as the driver's receive
+// upcall does (`buffer_acquire()`, copy, `buffer_mark_ready()`), and
+// `pktdrv_send()` writes to the same socket.
+//
+// Virtual servers use made-up MAC addresses, so each socket carries a BPF
+// filter that passes only frames to its address or to broadcast, doing the
+// job of the NIC's address filter.  Without it, every server would wake for
+// every frame sent to any of them.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/filter.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "server/bufmgr.h"
+#include "server/globals.h"
+#include "server/pktdrv.h"
+#include "sim/sim.h"
+
+static int g_sock_fd = -1;
+static int g_if_index = 0;
+static struct SimStats *g_stats = NULL;
+
+// What the driver's `get_statistics()` would count.
+static struct PktDrvDriverStats g_driver_stats;
+
+// Accepts frames whose destination is `addr`, or broadcast.
+static int attach_address_filter(int fd, const uint8_t *addr) {
+  struct sock_filter code[] = {
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 2),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+               ((uint32_t)addr[2] << 24) | (addr[3] << 16) | (addr[4] << 8) |
+                   addr[5],
+               0, 2),
+      BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 0),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (addr[0] << 8) | addr[1], 4, 0),
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 2),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0xffffffff, 0, 3),
+      BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 0),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0xffff, 0, 1),
+      BPF_STMT(BPF_RET | BPF_K, ETH_FRAME_LEN),
+      BPF_STMT(BPF_RET | BPF_K, 0),
+  };
+  struct sock_fprog prog = {
+      .len = sizeof(code) / sizeof(code[0]),
+      .filter = code,
+  };
+
+  return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+}
+
+int sim_pktdrv_open(const char *if_name, const uint8_t *mac_addr,
+                    uint16_t ethertype, struct SimStats *stats) {
+  struct ifreq ifr = {0};
+  struct sockaddr_ll sll = {0};
+  struct packet_mreq mreq = {0};
+
+  memset(&g_pktdrv_info, 0, sizeof(g_pktdrv_info));
+  memset(&g_pktdrv_stats, 0, sizeof(g_pktdrv_stats));
+  memset(&g_driver_stats, 0, sizeof(g_driver_stats));
+  g_stats = stats;
+  memcpy(g_pktdrv_info.mac_addr, mac_addr, ETH_ALEN);
+  g_pktdrv_info._class = PKTDRV_CLASS_ETHERNET;
+  strcpy(g_pktdrv_info.name, "rmtdos-sim");
+
+  if (0 > (g_sock_fd = socket(AF_PACKET, SOCK_RAW, htons(ethertype)))) {
+    perror("socket()");
+    return -1;
+  }
+
+  strncpy(ifr.ifr_name, if_name, IFNAMSIZ - 1);
+  if (0 > ioctl(g_sock_fd, SIOCGIFINDEX, &ifr)) {
+    perror("SIOCGIFINDEX");
+    goto fail;
+  }
+  g_if_index = ifr.ifr_ifindex;
+
+  // Filter before binding, so no foreign frame is ever queued.
+  if (0 > attach_address_filter(g_sock_fd, mac_addr)) {
+    perror("SO_ATTACH_FILTER");
+    goto fail;
+  }
+
+  sll.sll_family = AF_PACKET;
+  sll.sll_protocol = htons(ethertype);
+  sll.sll_ifindex = g_if_index;
+  if (0 > bind(g_sock_fd, (struct sockaddr *)&sll, sizeof(sll))) {
+    perror("bind()");
+    goto fail;
+  }
+
+  // Our addresses are not the interface's.  On a real NIC (or a bridge),
+  // frames to them are only delivered in promiscuous mode.
+  mreq.mr_ifindex = g_if_index;
+  mreq.mr_type = PACKET_MR_PROMISC;
+  if (0 > setsockopt(g_sock_fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq,
+                     sizeof(mreq))) {
+    perror("PACKET_ADD_MEMBERSHIP");
+    goto fail;
+  }
+
+  return g_sock_fd;
+
+fail:
+  close(g_sock_fd);
+  g_sock_fd = -1;
+  return -1;
+}
+
+void sim_pktdrv_receive() {
+  uint8_t frame[ETH_FRAME_LEN];
+  ssize_t len;
+
+  while (0 < (len = recv(g_sock_fd, frame, sizeof(frame), MSG_DONTWAIT))) {
+    void *buffer = buffer_acquire(len);
+
+    ++g_driver_stats.packets_in;
+    g_driver_stats.bytes_in += len;
+    if (buffer) {
+      memcpy(buffer, frame, len);
+      buffer_mark_ready(buffer);
+      ++g_pktdrv_stats.packets_recv;
+      ++g_stats->packets_recv;
+    } else {
+      ++g_pktdrv_stats.packets_dropped;
+      ++g_stats->packets_dropped;
+      ++g_driver_stats.packets_lost;
+    }
+  }
+}
+
+enum PktDrvResultCode pktdrv_send(const void *buffer, uint16_t length) {
+  struct sockaddr_ll sll = {0};
+
+  sll.sll_ifindex = g_if_index;
+  sll.sll_halen = ETH_ALEN;
+  memcpy(sll.sll_addr, buffer, ETH_ALEN);
+
+  if (0 > sendto(g_sock_fd, buffer, length, 0, (struct sockaddr *)&sll,
+                 sizeof(sll))) {
+    ++g_pktdrv_stats.send_errors;
+    ++g_stats->send_errors;
+    ++g_driver_stats.errors_out;
+    return PKTDRV_ERR_CANT_SEND;
+  }
+
+  ++g_pktdrv_stats.packets_sent;
+  ++g_stats->packets_sent;
+  g_stats->bytes_sent += length;
+  ++g_driver_stats.packets_out;
+  g_driver_stats.bytes_out += length;
+  return PKTDRV_OK;
+}
+
+enum PktDrvResultCode pktdrv_get_statistics(struct PktDrvDriverStats *stats) {
+  *stats = g_driver_stats;
+  return PKTDRV_OK;
+}
+
+enum PktDrvResultCode pktdrv_done() {
+  if (g_sock_fd >= 0) {
+    close(g_sock_fd);
+    g_sock_fd = -1;
+  }
+  return PKTDRV_OK;
+}
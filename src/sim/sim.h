@@ -0,0 +1,89 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Simulated servers: the DOS server's protocol and session code, built for
+// Linux against a fake VGA frame buffer and BIOS (sim/lib16.c) and a packet
+// driver on a raw socket (sim/pktdrv.c).  Each virtual server is its own
+// process, so the server's globals need no changes.
+
+#ifndef __RMTDOS_SIM_SIM_H
+#define __RMTDOS_SIM_SIM_H
+
+#include <stdint.h>
+
+#include "common/ethernet.h"
+
+// BIOS timer rate, and so the rate of int 08h on a stock PC.
+#define SIM_BIOS_TICK_HZ 18.2065
+
+// Size of the fake VGA text frame buffer ($b800:0000).
+#define SIM_FRAME_BUFFER_LEN 32768
+
+// Largest count of virtual servers.
+#define SIM_MAX_SERVERS 4096
+
+// Counters of one virtual server, in memory shared with the parent.
+struct SimStats {
+  uint64_t packets_recv;
+  uint64_t packets_dropped;
+  uint64_t packets_sent;
+  uint64_t bytes_sent;
+  uint64_t send_errors;
+  uint64_t ticks;
+  uint64_t late_ticks; // Ticks run over half a period late.
+  uint64_t keystrokes;
+};
+
+// lib16 stand-ins (sim/lib16.c).
+
+// Screen geometry reported by `video_read_state()`.
+extern void sim_video_init(uint8_t text_rows, uint8_t text_cols);
+
+// The fake frame buffer, as (char, attr) pairs.
+extern uint8_t g_sim_frame_buffer[SIM_FRAME_BUFFER_LEN];
+extern uint8_t g_sim_text_rows;
+extern uint8_t g_sim_text_cols;
+extern uint8_t g_sim_cursor_row;
+extern uint8_t g_sim_cursor_col;
+
+// Starts the BIOS tick clock at zero.
+extern void sim_clock_init();
+
+// Stops the BIOS tick clock at `ticks`, for runs in virtual time.  It stays
+// there until the next call.
+extern void sim_clock_set(uint32_t ticks);
+
+// Pops one keystroke injected by the client.  Returns 0 if none.
+extern int sim_keyboard_pop(uint8_t *scan_code, uint8_t *ascii_value);
+
+// Packet driver stand-in (sim/pktdrv.c).
+
+// Opens a raw socket on `if_name` that receives only frames for `mac_addr`
+// (or broadcast), as a NIC would.  Traffic is counted in `stats`.  Returns
+// the socket, or <0 on error.
+extern int sim_pktdrv_open(const char *if_name, const uint8_t *mac_addr,
+                           uint16_t ethertype, struct SimStats *stats);
+
+// Moves every frame waiting on the socket into the server's buffers, as the
+// driver's receive upcall would.
+extern void sim_pktdrv_receive();
+
+// Scripted screen activity (sim/activity.c).
+
+// Returns non-zero if `name` is a known workload.
+extern int activity_exists(const char *name);
+
+// Draws the workload's first screen.  Returns <0 if `name` is not a known
+// workload.
+extern int activity_init(const char *name, unsigned interval_ms,
+                         unsigned seed);
+
+// Advances the workload to `now_ms`, and echoes injected keystrokes.
+extern void activity_step(uint64_t now_ms, struct SimStats *stats);
+
+// Comma separated list of the known workloads.
+extern const char *activity_names();
+
+#endif // __RMTDOS_SIM_SIM_H
@@ -0,0 +1,573 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Emulates a swarm of clients, each with its own MAC address and session
+// id, all talking to one server at once:
+//
+//   sudo out/rmtdos-swarm -i eth0 -t 02:52:44:00:00:00 -n 32 -p 100 -s 50
+//
+// Pings and status requests are spread over the clients at the given total
+// rates.  Each of the first `-S` clients also keeps a session open, as the
+// real client does.  At the end the swarm reports response latencies,
+// unanswered pings and status requests, and how many sessions the server
+// actually served.  The server has a fixed table of session slots
+// (`MAX_SESSIONS` in server/session.c), so sessions beyond that never get
+// video.
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client/network.h"
+#include "common/protocol.h"
+#include "liblinux/samples.h"
+
+#define MIN(x, y) ((x) > (y) ? (y) : (x))
+
+#define NS_PER_SEC 1000000000ULL
+#define NS_PER_US 1000ULL
+
+// Largest count of clients.
+#define SWARM_MAX_CLIENTS 65536
+
+// Status requests in flight per client.  Responses carry nothing to match
+// them by, so they are matched oldest first.
+#define STATUS_RING 8
+
+// Marks the swarm's own pings ("SWRM").
+#define PING_MAGIC 0x5357524dUL
+
+struct PingPayload {
+  uint32_t magic;
+  uint32_t client;
+  uint64_t sent_ns;
+};
+
+struct Client {
+  uint8_t addr[ETH_ALEN];
+  uint32_t session_id;
+
+  uint64_t status_sent_ns[STATUS_RING];
+  unsigned status_head;
+  unsigned status_tail;
+
+  // Sessions only.
+  uint64_t next_keepalive_ns;
+  uint64_t session_start_ns; // First V1_SESSION_START.
+  uint64_t video_frames;
+};
+
+struct Counter {
+  uint64_t sent;
+  uint64_t answered;
+  struct Samples latency_us;
+};
+
+struct Options {
+  const char *if_name;
+  uint16_t ethertype;
+  uint8_t server_addr[ETH_ALEN];
+  uint8_t base_addr[ETH_ALEN];
+  int clients;
+  int sessions;
+  double ping_rate;
+  double status_rate;
+  double key_rate;
+  uint8_t key_ascii;
+  uint8_t key_scan_code;
+  unsigned keepalive_ms;
+  unsigned duration_s;
+  unsigned grace_ms;
+  unsigned report_s;
+};
+
+static volatile sig_atomic_t g_stop = 0;
+
+static struct Client *g_clients = NULL;
+static struct Counter g_ping;
+static struct Counter g_status;
+static struct Samples g_first_video_us;
+static uint64_t g_keys_sent = 0;
+static uint64_t g_video_frames = 0;
+static uint64_t g_video_bytes = 0;
+static uint64_t g_foreign = 0;
+
+static void on_signal(int sig) { g_stop = 1; }
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static int parse_mac_addr(uint8_t *dest, const char *s) {
+  unsigned int a[ETH_ALEN];
+
+  if (ETH_ALEN != sscanf(s, "%x:%x:%x:%x:%x:%x", &a[0], &a[1], &a[2], &a[3],
+                         &a[4], &a[5])) {
+    return -1;
+  }
+  for (int i = 0; i < ETH_ALEN; ++i) {
+    dest[i] = a[i];
+  }
+  return 0;
+}
+
+static uint32_t addr_low(const uint8_t *a) {
+  return (a[3] << 16) | (a[4] << 8) | a[5];
+}
+
+// Index of the client with MAC address `addr`, or -1.
+static int client_index(const struct Options *opt, const uint8_t *addr) {
+  if (memcmp(addr, opt->base_addr, 3)) {
+    return -1;
+  }
+
+  const uint32_t i = addr_low(addr) - addr_low(opt->base_addr);
+  return (i < (uint32_t)opt->clients) ? (int)i : -1;
+}
+
+// Sends as client `c`.
+static int send_as(struct RawSocket *rs, const struct Options *opt,
+                   const struct Client *c, enum PKT_TYPE type,
+                   const void *payload, size_t payload_len) {
+  memcpy(rs->if_addr, c->addr, ETH_ALEN);
+  rs->session_id = c->session_id;
+  return send_packet(rs, opt->server_addr, type, payload, payload_len);
+}
+
+static void send_ping_as(struct RawSocket *rs, const struct Options *opt,
+                         int i, uint64_t now) {
+  const struct PingPayload payload = {
+      .magic = PING_MAGIC,
+      .client = i,
+      .sent_ns = now,
+  };
+
+  if (0 <= send_as(rs, opt, &g_clients[i], V1_PING, &payload,
+                   sizeof(payload))) {
+    ++g_ping.sent;
+  }
+}
+
+static void send_status_as(struct RawSocket *rs, const struct Options *opt,
+                           int i, uint64_t now) {
+  struct Client *c = &g_clients[i];
+
+  if (0 > send_as(rs, opt, c, V1_STATUS_REQ, NULL, 0)) {
+    return;
+  }
+  ++g_status.sent;
+
+  // Ring full: the oldest request is given up on.
+  if (c->status_tail - c->status_head == STATUS_RING) {
+    ++c->status_head;
+  }
+  c->status_sent_ns[c->status_tail++ % STATUS_RING] = now;
+}
+
+static void send_key_as(struct RawSocket *rs, const struct Options *opt,
+                        int i) {
+  const struct Keystroke key = {
+      .bios_scan_code = opt->key_scan_code,
+      .ascii_value = opt->key_ascii,
+      .flags_17 = 0,
+  };
+
+  if (0 <= send_as(rs, opt, &g_clients[i], V1_INJECT_KEYSTROKE, &key,
+                   sizeof(key))) {
+    ++g_keys_sent;
+  }
+}
+
+static void process_frame(const struct Options *opt, const uint8_t *buf,
+                          size_t len, uint64_t now) {
+  const struct ether_header *eh = (const struct ether_header *)buf;
+  const struct ProtocolHeader *ph = (const struct ProtocolHeader *)(eh + 1);
+  const uint8_t *payload = (const uint8_t *)(ph + 1);
+  int i;
+
+  // Our own requests, reflected back by a bridge or veth peer.
+  if ((len >= ETH_HLEN) && (0 <= client_index(opt, eh->ether_shost))) {
+    return;
+  }
+
+  if ((len < COMBINED_HEADER_LEN) ||
+      memcmp(eh->ether_shost, opt->server_addr, ETH_ALEN) ||
+      (PACKET_SIGNATURE != ntohl(ph->signature)) ||
+      (0 > (i = client_index(opt, eh->ether_dhost)))) {
+    ++g_foreign;
+    return;
+  }
+
+  struct Client *c = &g_clients[i];
+
+  switch (ntohs(ph->pkt_type)) {
+    case V1_PONG: {
+      struct PingPayload ping;
+
+      if (len < COMBINED_HEADER_LEN + sizeof(ping)) {
+        break;
+      }
+      memcpy(&ping, payload, sizeof(ping));
+      if ((ping.magic == PING_MAGIC) && (ping.client == (uint32_t)i) &&
+          (ping.sent_ns <= now)) {
+        ++g_ping.answered;
+        samples_add(&g_ping.latency_us, (now - ping.sent_ns) / NS_PER_US);
+      }
+      break;
+    }
+
+    case V1_STATUS_RESP:
+      if (c->status_head != c->status_tail) {
+        const uint64_t sent = c->status_sent_ns[c->status_head++ % STATUS_RING];
+        ++g_status.answered;
+        samples_add(&g_status.latency_us, (now - sent) / NS_PER_US);
+      }
+      break;
+
+    case V1_VGA_TEXT:
+      if (ntohl(ph->session_id) != c->session_id) {
+        break;
+      }
+      if (!c->video_frames && c->session_start_ns) {
+        samples_add(&g_first_video_us,
+                    (now - c->session_start_ns) / NS_PER_US);
+      }
+      ++c->video_frames;
+      ++g_video_frames;
+      g_video_bytes += len;
+      break;
+  }
+}
+
+static void receive_all(struct RawSocket *rs, const struct Options *opt) {
+  uint8_t buf[ETH_FRAME_LEN];
+  ssize_t len;
+
+  struct sockaddr_ll from;
+  socklen_t from_len = sizeof(from);
+
+  while (0 < (len = recvfrom(rs->sock_fd, buf, sizeof(buf), MSG_DONTWAIT,
+                             (struct sockaddr *)&from, &from_len))) {
+    // Our own requests, looped back.
+    if (from.sll_pkttype != PACKET_OUTGOING) {
+      process_frame(opt, buf, len, now_ns());
+    }
+    from_len = sizeof(from);
+  }
+}
+
+static void print_counter(const char *name, struct Counter *c) {
+  printf("  %-8s %9lu %9lu %9lu ", name, c->sent, c->answered,
+         c->sent > c->answered ? c->sent - c->answered : 0);
+  samples_print(&c->latency_us, 9);
+  printf("\n");
+}
+
+static void print_progress(double secs) {
+  printf("%8.1f s  ping %lu/%lu  status %lu/%lu  video %lu frames  keys %lu\n",
+         secs, g_ping.answered, g_ping.sent, g_status.answered, g_status.sent,
+         g_video_frames, g_keys_sent);
+  fflush(stdout);
+}
+
+static void print_report(const struct Options *opt, double secs) {
+  int served = 0;
+
+  for (int i = 0; i < opt->sessions; ++i) {
+    served += !!g_clients[i].video_frames;
+  }
+
+  printf("server:   %02x:%02x:%02x:%02x:%02x:%02x on %s\n",
+         opt->server_addr[0], opt->server_addr[1], opt->server_addr[2],
+         opt->server_addr[3], opt->server_addr[4], opt->server_addr[5],
+         opt->if_name);
+  printf("clients:  %d (%d with sessions), %.1f s\n\n", opt->clients,
+         opt->sessions, secs);
+
+  printf("  %-8s %9s %9s %9s %9s %9s %9s %9s %9s %9s  (microseconds)\n",
+         "request", "sent", "answered", "lost", "count", "min", "p50", "p95",
+         "p99", "max");
+  print_counter("ping", &g_ping);
+  print_counter("status", &g_status);
+
+  if (opt->sessions) {
+    printf("  %-8s %9d %9d %9d ", "session", opt->sessions, served,
+           opt->sessions - served);
+    samples_print(&g_first_video_us, 9);
+    printf("\n");
+  }
+
+  printf("\nvideo:    %lu frames, %lu bytes\n", g_video_frames, g_video_bytes);
+  printf("keys:     %lu sent\n", g_keys_sent);
+  if (g_foreign) {
+    printf("ignored:  %lu frames not for the swarm\n", g_foreign);
+  }
+
+  if (served < opt->sessions) {
+    printf("\n%d of %d sessions never received video: the server's session "
+           "table is full (or the server is not sending).\n",
+           opt->sessions - served, opt->sessions);
+  }
+}
+
+static void print_usage(const char *progname) {
+  printf("usage: %s -i iface -t server [options]\n", progname);
+  printf("  -d  Seconds to run (default: 10).\n");
+  printf("  -e  Ethertype as 4 hexadecimal digits (default: %04x).\n",
+         ETHERTYPE_RMTDOS);
+  printf("  -g  Milliseconds to wait for late responses (default: 1000).\n");
+  printf("  -i  Interface to send on.\n");
+  printf("  -k  Keystrokes per second, over all clients (default: 0).\n");
+  printf("  -K  Key to inject, as scan:ascii in hex (default: 39:20, space).\n");
+  printf("  -l  Session keepalive interval in ms (default: 2000).\n");
+  printf("  -m  MAC address of the first client (default: "
+         "02:53:57:00:00:00).\n");
+  printf("  -n  Count of clients (default: 8, max %d).\n", SWARM_MAX_CLIENTS);
+  printf("  -p  Pings per second, over all clients (default: 20).\n");
+  printf("  -r  Print progress every this many seconds.\n");
+  printf("  -s  Status requests per second, over all clients (default: 20).\n");
+  printf("  -S  Clients that also open a session (default: all).\n");
+  printf("  -t  MAC address of the server.\n");
+}
+
+int main(int argc, char **argv) {
+  struct Options opt = {
+      .ethertype = ETHERTYPE_RMTDOS,
+      .base_addr = {0x02, 0x53, 0x57, 0x00, 0x00, 0x00},
+      .clients = 8,
+      .sessions = -1,
+      .ping_rate = 20.0,
+      .status_rate = 20.0,
+      .key_rate = 0.0,
+      .key_ascii = ' ',
+      .key_scan_code = 0x39,
+      .keepalive_ms = 2000,
+      .duration_s = 10,
+      .grace_ms = 1000,
+  };
+  int have_server = 0;
+  unsigned scan, ascii;
+  int c;
+
+  while ((c = getopt(argc, argv, "d:e:g:i:k:K:l:m:n:p:r:s:S:t:")) != -1) {
+    switch (c) {
+      case 'd':
+        opt.duration_s = atoi(optarg);
+        break;
+      case 'e':
+        opt.ethertype = strtoul(optarg, NULL, 16);
+        break;
+      case 'g':
+        opt.grace_ms = atoi(optarg);
+        break;
+      case 'i':
+        opt.if_name = optarg;
+        break;
+      case 'k':
+        opt.key_rate = atof(optarg);
+        break;
+      case 'K':
+        if (2 != sscanf(optarg, "%x:%x", &scan, &ascii)) {
+          fprintf(stderr, "Bad key: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        opt.key_scan_code = scan;
+        opt.key_ascii = ascii;
+        break;
+      case 'l':
+        opt.keepalive_ms = atoi(optarg);
+        break;
+      case 'm':
+        if (0 > parse_mac_addr(opt.base_addr, optarg)) {
+          fprintf(stderr, "Bad MAC address: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'n':
+        opt.clients = atoi(optarg);
+        break;
+      case 'p':
+        opt.ping_rate = atof(optarg);
+        break;
+      case 'r':
+        opt.report_s = atoi(optarg);
+        break;
+      case 's':
+        opt.status_rate = atof(optarg);
+        break;
+      case 'S':
+        opt.sessions = atoi(optarg);
+        break;
+      case 't':
+        if (0 > parse_mac_addr(opt.server_addr, optarg)) {
+          fprintf(stderr, "Bad MAC address: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        have_server = 1;
+        break;
+      default: /* '?' */
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (opt.sessions < 0 || opt.sessions > opt.clients) {
+    opt.sessions = opt.clients;
+  }
+
+  if (!opt.if_name || !have_server || (opt.clients < 1) ||
+      (opt.clients > SWARM_MAX_CLIENTS) || (opt.keepalive_ms < 1) ||
+      (optind != argc)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  struct RawSocket rs;
+  if ((0 > create_socket(&rs, opt.if_name, opt.ethertype)) ||
+      (0 > set_promiscuous(&rs))) {
+    return EXIT_FAILURE;
+  }
+
+  g_clients = (struct Client *)calloc(opt.clients, sizeof(struct Client));
+  if (!g_clients) {
+    fprintf(stderr, "Out of memory.\n");
+    return EXIT_FAILURE;
+  }
+
+  const uint64_t start_ns = now_ns();
+  const uint64_t keepalive_ns = opt.keepalive_ms * 1000000ULL;
+  for (int i = 0; i < opt.clients; ++i) {
+    struct Client *cl = &g_clients[i];
+    const uint32_t low = addr_low(opt.base_addr) + i;
+
+    memcpy(cl->addr, opt.base_addr, 3);
+    cl->addr[3] = low >> 16;
+    cl->addr[4] = low >> 8;
+    cl->addr[5] = low;
+    getrandom(&cl->session_id, sizeof(cl->session_id), 0);
+
+    // Spread the sessions' keepalives over the interval.
+    cl->next_keepalive_ns = start_ns + keepalive_ns * i / opt.clients;
+  }
+
+  struct sigaction sa = {.sa_handler = on_signal};
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  const uint64_t end_ns = start_ns + opt.duration_s * NS_PER_SEC;
+  const uint64_t ping_ns = opt.ping_rate > 0 ? NS_PER_SEC / opt.ping_rate : 0;
+  const uint64_t status_ns =
+      opt.status_rate > 0 ? NS_PER_SEC / opt.status_rate : 0;
+  const uint64_t key_ns = opt.key_rate > 0 ? NS_PER_SEC / opt.key_rate : 0;
+  uint64_t next_ping_ns = start_ns;
+  uint64_t next_status_ns = start_ns;
+  uint64_t next_key_ns = start_ns;
+  uint64_t next_report_ns = start_ns + opt.report_s * NS_PER_SEC;
+  int ping_client = 0, status_client = 0, key_client = 0;
+  int next_session = 0;
+
+  while (!g_stop) {
+    uint64_t now = now_ns();
+    uint64_t wake_ns = end_ns;
+
+    if (now >= end_ns) {
+      break;
+    }
+
+    // Requests due, each from the next client in turn.
+    if (ping_ns) {
+      for (; next_ping_ns <= now; next_ping_ns += ping_ns) {
+        send_ping_as(&rs, &opt, ping_client, now);
+        ping_client = (ping_client + 1) % opt.clients;
+      }
+      wake_ns = MIN(wake_ns, next_ping_ns);
+    }
+
+    if (status_ns) {
+      for (; next_status_ns <= now; next_status_ns += status_ns) {
+        send_status_as(&rs, &opt, status_client, now);
+        status_client = (status_client + 1) % opt.clients;
+      }
+      wake_ns = MIN(wake_ns, next_status_ns);
+    }
+
+    if (key_ns) {
+      for (; next_key_ns <= now; next_key_ns += key_ns) {
+        send_key_as(&rs, &opt, key_client);
+        key_client = (key_client + 1) % opt.clients;
+      }
+      wake_ns = MIN(wake_ns, next_key_ns);
+    }
+
+    // Keepalives are due in client order, so only the next one is checked.
+    for (int n = 0; opt.sessions && (n < opt.sessions); ++n) {
+      struct Client *cl = &g_clients[next_session];
+      if (cl->next_keepalive_ns > now) {
+        wake_ns = MIN(wake_ns, cl->next_keepalive_ns);
+        break;
+      }
+
+      if (0 <= send_as(&rs, &opt, cl, V1_SESSION_START, NULL, 0) &&
+          !cl->session_start_ns) {
+        cl->session_start_ns = now;
+      }
+      cl->next_keepalive_ns += keepalive_ns;
+      next_session = (next_session + 1) % opt.sessions;
+    }
+
+    if (opt.report_s && (now >= next_report_ns)) {
+      print_progress((now - start_ns) / 1e9);
+      next_report_ns += opt.report_s * NS_PER_SEC;
+    }
+
+    receive_all(&rs, &opt);
+
+    now = now_ns();
+    if (wake_ns > now) {
+      struct pollfd pfd = {.fd = rs.sock_fd, .events = POLLIN};
+      const struct timespec timeout = {
+          .tv_sec = (wake_ns - now) / NS_PER_SEC,
+          .tv_nsec = (wake_ns - now) % NS_PER_SEC,
+      };
+      ppoll(&pfd, 1, &timeout, NULL);
+    }
+  }
+
+  // Late responses still count.
+  const uint64_t grace_end_ns = now_ns() + opt.grace_ms * 1000000ULL;
+  for (uint64_t now = now_ns(); !g_stop && (now < grace_end_ns);
+       now = now_ns()) {
+    struct pollfd pfd = {.fd = rs.sock_fd, .events = POLLIN};
+    const struct timespec timeout = {
+        .tv_sec = (grace_end_ns - now) / NS_PER_SEC,
+        .tv_nsec = (grace_end_ns - now) % NS_PER_SEC,
+    };
+    if (0 < ppoll(&pfd, 1, &timeout, NULL)) {
+      receive_all(&rs, &opt);
+    }
+  }
+
+  print_report(&opt, (MIN(now_ns(), end_ns) - start_ns) / 1e9);
+
+  close_socket(&rs);
+  samples_free(&g_ping.latency_us);
+  samples_free(&g_status.latency_us);
+  samples_free(&g_first_video_us);
+  free(g_clients);
+
+  return EXIT_SUCCESS;
+}
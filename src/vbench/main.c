@@ -0,0 +1,416 @@
+/*
+ * Copyright 2022 Dennis Jenkins <dennis.jenkins.75@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Benchmarks the server's video packetization on Linux, in virtual time:
+//
+//   out/rmtdos-vbench                       # the built-in scenes
+//   out/rmtdos-vbench -w defrag -s 4 -d 120
+//   out/rmtdos-vbench session.rmtrec        # screens recorded by the client
+//
+// The server's own session and protocol code (server/session.c,
+// server/protocol.c) runs from a fake int 08h against the simulated B800
+// buffer of rmtdos-sim.  Each tick the scene draws, then the server runs,
+// and every frame it sends is applied to a model of the client's screen.
+// That gives, per scene, the bytes on the wire, frames per screen change,
+// the share of sent bytes that were actually new to the client, and the
+// time from a change until the client's screen matched again.
+//
+// Everything but the CPU times is deterministic, so runs before and after a
+// change to the encoding can be compared line by line.
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lib16/video.h"
+#include "liblinux/recording.h"
+#include "liblinux/samples.h"
+#include "server/bufmgr.h"
+#include "server/config.h"
+#include "server/globals.h"
+#include "server/pktdrv.h"
+#include "server/protocol.h"
+#include "server/session.h"
+#include "sim/sim.h"
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+#define MAX_SCENES 64
+
+// Largest count of clients watching at once.  The server has four slots.
+#define VBENCH_MAX_SESSIONS 4
+
+// The client sends V1_SESSION_START this often.
+#define KEEPALIVE_MS 2000
+
+// Smallest Ethernet frame, as padded by the packet driver.
+#define MIN_ETH_FRAME_SIZE 60
+
+// Calls of `video_checksum_frame_buffer()` timed per scene.
+#define CHECKSUM_RUNS 1000
+
+static const char *g_default_scenes[] = {"dir", "edit", "defrag", "clock"};
+
+struct Options {
+  unsigned duration_s;
+  unsigned interval_ms;
+  int sessions;
+  double tick_hz;
+  uint8_t text_rows;
+  uint8_t text_cols;
+};
+
+// What the first client has on screen, built from the frames sent to it.
+struct ClientScreen {
+  uint8_t text_rows;
+  uint8_t text_cols;
+  uint8_t text[SIM_FRAME_BUFFER_LEN];
+};
+
+struct SceneStats {
+  uint64_t ticks;
+  uint64_t changes;
+  uint64_t frames;       // Every frame sent, to every session.
+  uint64_t wire_bytes;   // Of those frames, padded as on the wire.
+  uint64_t video_frames; // V1_VGA_TEXT to the first client.
+  uint64_t video_bytes;  // Their screen bytes.
+  uint64_t new_bytes;    // Screen bytes the first client didn't have yet.
+  uint64_t server_ns;    // In `protocol_process()` and friends.
+  uint64_t checksum_ns;  // Per call, full screen.
+  int stale;             // Screen not consistent at the end.
+  struct Samples consistent_ms;
+};
+
+static const uint8_t g_server_addr[ETH_ALEN] = {0x02, 0x52, 0x44,
+                                                0x00, 0x00, 0x00};
+static const uint8_t g_client_addr[ETH_ALEN] = {0x02, 0x43, 0x4c,
+                                                0x00, 0x00, 0x00};
+
+static struct ClientScreen g_client;
+static struct SceneStats *g_scene = NULL;
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Packet driver stand-in: frames are applied to the client model instead
+// of being sent.
+enum PktDrvResultCode pktdrv_send(const void *buffer, uint16_t length) {
+  const struct EthernetHeader *eh = (const struct EthernetHeader *)buffer;
+  const struct ProtocolHeader *ph = (const struct ProtocolHeader *)(eh + 1);
+  const struct VideoText *vt = (const struct VideoText *)(ph + 1);
+  const uint8_t *data = (const uint8_t *)(vt + 1);
+
+  ++g_scene->frames;
+  g_scene->wire_bytes += MAX(length, MIN_ETH_FRAME_SIZE);
+
+  if ((ntohs(ph->pkt_type) != V1_VGA_TEXT) ||
+      memcmp(eh->dest_mac_addr, g_client_addr, ETH_ALEN)) {
+    return PKTDRV_OK;
+  }
+
+  const uint16_t offset = ntohs(vt->offset);
+  uint16_t count = ntohs(vt->count);
+  if (offset + count > SIM_FRAME_BUFFER_LEN) {
+    count = SIM_FRAME_BUFFER_LEN - offset;
+  }
+
+  ++g_scene->video_frames;
+  g_scene->video_bytes += count;
+  for (uint16_t i = 0; i < count; ++i) {
+    g_scene->new_bytes += (g_client.text[offset + i] != data[i]);
+  }
+
+  g_client.text_rows = vt->text_rows;
+  g_client.text_cols = vt->text_cols;
+  memcpy(&g_client.text[offset], data, count);
+  return PKTDRV_OK;
+}
+
+enum PktDrvResultCode pktdrv_done() { return PKTDRV_OK; }
+
+enum PktDrvResultCode pktdrv_get_statistics(struct PktDrvDriverStats *stats) {
+  return PKTDRV_ERR_BAD_COMMAND;
+}
+
+// Hands the server a V1_SESSION_START from client `i`, as the packet
+// driver's receive upcall would.
+static void receive_session_start(int i) {
+  const size_t len = COMBINED_HEADER_LEN;
+  uint8_t *frame = (uint8_t *)buffer_acquire(len);
+
+  if (!frame) {
+    return;
+  }
+
+  struct EthernetHeader *eh = (struct EthernetHeader *)frame;
+  struct ProtocolHeader *ph = (struct ProtocolHeader *)(eh + 1);
+
+  memcpy(eh->dest_mac_addr, g_server_addr, ETH_ALEN);
+  memcpy(eh->src_mac_addr, g_client_addr, ETH_ALEN);
+  eh->src_mac_addr[5] += i;
+  eh->ethertype = htons(g_ethertype);
+  ph->signature = htonl(PACKET_SIGNATURE);
+  ph->session_id = htonl(i + 1);
+  ph->payload_len = 0;
+  ph->pkt_type = htons(V1_SESSION_START);
+  buffer_mark_ready(frame);
+}
+
+static size_t screen_len() { return g_sim_text_rows * g_sim_text_cols * 2; }
+
+static int client_consistent() {
+  return (g_client.text_rows == g_sim_text_rows) &&
+         (g_client.text_cols == g_sim_text_cols) &&
+         !memcmp(g_client.text, g_sim_frame_buffer, screen_len());
+}
+
+// Scene source: a workload of rmtdos-sim, or a recording.
+struct Scene {
+  const char *name;
+  const char *workload;
+  struct Recording rec;
+  struct RecordingCursor cur;
+};
+
+// Draws the scene as of `now_ms`.
+static void scene_step(struct Scene *scene, uint64_t now_ms) {
+  struct SimStats unused = {0};
+  struct RecordingEvent ev;
+  uint64_t t;
+
+  if (scene->workload) {
+    activity_step(now_ms, &unused);
+    return;
+  }
+
+  while (recording_peek_time(&scene->cur, &t) && (t <= now_ms * 1000)) {
+    recording_next(&scene->cur, &ev);
+  }
+
+  const struct RecordingScreen *s = &scene->cur.screen;
+  if (s->text_rows && s->text_cols) {
+    g_sim_text_rows = s->text_rows;
+    g_sim_text_cols = s->text_cols;
+    g_sim_cursor_row = s->cursor_row;
+    g_sim_cursor_col = s->cursor_col;
+    memcpy(g_sim_frame_buffer, s->text, screen_len());
+  }
+}
+
+static void run_scene(const struct Options *opt, struct Scene *scene,
+                      uint64_t duration_ms, struct SceneStats *stats) {
+  static uint8_t last[SIM_FRAME_BUFFER_LEN];
+  const uint64_t ticks = duration_ms * opt->tick_hz / 1000;
+  const uint32_t keepalive_ticks = MAX(1, KEEPALIVE_MS * opt->tick_hz / 1000);
+  int64_t pending_tick = -1; // First change the client hasn't seen.
+
+  memset(stats, 0, sizeof(*stats));
+  memset(&g_client, 0, sizeof(g_client));
+  g_scene = stats;
+
+  sim_video_init(opt->text_rows, opt->text_cols);
+  session_mgr_init();
+  video_next_row = 0;
+  if (scene->workload) {
+    activity_init(scene->workload, opt->interval_ms, 1);
+  } else {
+    recording_rewind(&scene->cur, &scene->rec);
+  }
+  memcpy(last, g_sim_frame_buffer, SIM_FRAME_BUFFER_LEN);
+
+  for (uint64_t tick = 0; tick < ticks; ++tick) {
+    sim_clock_set(tick);
+
+    // Clients aren't in step; spread their keepalives over the interval so
+    // they don't contend for the server's few receive buffers.
+    for (int i = 0; i < opt->sessions; ++i) {
+      if (!((tick + keepalive_ticks * i / opt->sessions) % keepalive_ticks)) {
+        receive_session_start(i);
+      }
+    }
+
+    scene_step(scene, tick * 1000 / opt->tick_hz);
+    if (memcmp(last, g_sim_frame_buffer, screen_len())) {
+      memcpy(last, g_sim_frame_buffer, screen_len());
+      ++stats->changes;
+      if (pending_tick < 0) {
+        pending_tick = tick;
+      }
+    }
+
+    // int 08h.
+    const uint64_t start_ns = now_ns();
+    protocol_process();
+    session_mgr_update_all();
+    stats->server_ns += now_ns() - start_ns;
+
+    if ((pending_tick >= 0) && client_consistent()) {
+      samples_add(&stats->consistent_ms,
+                  (tick - pending_tick) * 1000 / opt->tick_hz);
+      pending_tick = -1;
+    }
+  }
+
+  stats->ticks = ticks;
+  stats->stale = (pending_tick >= 0);
+
+  const uint64_t start_ns = now_ns();
+  for (int i = 0; i < CHECKSUM_RUNS; ++i) {
+    video_checksum_frame_buffer(0, screen_len() / 2);
+  }
+  stats->checksum_ns = (now_ns() - start_ns) / CHECKSUM_RUNS;
+}
+
+static void print_header() {
+  printf("%-12s %6s %7s %7s %9s %7s %7s %8s %6s  %13s %7s %7s %5s %7s %7s\n",
+         "scene", "secs", "changes", "frames", "bytes", "B/s", "fr/chg",
+         "B/chg", "new%", "sync ms p50", "p95", "max", "stale", "ns/tick",
+         "ns/csum");
+}
+
+static void print_scene(const char *name, double tick_hz,
+                        struct SceneStats *s) {
+  const double secs = s->ticks / tick_hz;
+
+  printf("%-12.12s %6.1f %7lu %7lu %9lu %7.0f %7.2f %8.0f %5.1f%%  %13u "
+         "%7u %7u %5s %7lu %7lu\n",
+         name, secs, s->changes, s->frames, s->wire_bytes,
+         secs ? s->wire_bytes / secs : 0.0,
+         s->changes ? (double)s->video_frames / s->changes : 0.0,
+         s->changes ? (double)s->wire_bytes / s->changes : 0.0,
+         s->video_bytes ? 100.0 * s->new_bytes / s->video_bytes : 0.0,
+         samples_percentile(&s->consistent_ms, 50),
+         samples_percentile(&s->consistent_ms, 95),
+         samples_percentile(&s->consistent_ms, 100), s->stale ? "yes" : "no",
+         s->ticks ? s->server_ns / s->ticks : 0, s->checksum_ns);
+}
+
+static void print_usage(const char *progname) {
+  printf("usage: %s [options] [recording.rmtrec ...]\n", progname);
+  printf("  -d  Seconds per workload scene (default: 60).\n");
+  printf("  -g  Screen size as COLSxROWS (default: %dx%d).\n", VIDEO_COLS,
+         VIDEO_ROWS);
+  printf("  -I  Milliseconds between workload steps (default: per workload).\n");
+  printf("  -s  Clients watching (default: 1, max %d).\n", VBENCH_MAX_SESSIONS);
+  printf("  -t  Timer ticks per second (default: %.4f, as a PC).\n",
+         SIM_BIOS_TICK_HZ);
+  printf("  -w  Workload scenes (default: dir,edit,defrag,clock unless\n"
+         "      recordings are given).  Any of: %s.\n",
+         activity_names());
+}
+
+int main(int argc, char **argv) {
+  struct Options opt = {
+      .duration_s = 60,
+      .sessions = 1,
+      .tick_hz = SIM_BIOS_TICK_HZ,
+      .text_rows = VIDEO_ROWS,
+      .text_cols = VIDEO_COLS,
+  };
+  struct Scene scenes[MAX_SCENES];
+  int scene_count = 0;
+  char *workloads = NULL;
+  unsigned cols, rows;
+  int c;
+
+  while ((c = getopt(argc, argv, "d:g:I:s:t:w:")) != -1) {
+    switch (c) {
+      case 'd':
+        opt.duration_s = atoi(optarg);
+        break;
+      case 'g':
+        if ((2 != sscanf(optarg, "%ux%u", &cols, &rows)) || !cols || !rows ||
+            (cols > 255) || (rows > 255) ||
+            (cols * rows * 2 > SIM_FRAME_BUFFER_LEN)) {
+          fprintf(stderr, "Bad screen size: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        opt.text_cols = cols;
+        opt.text_rows = rows;
+        break;
+      case 'I':
+        opt.interval_ms = atoi(optarg);
+        break;
+      case 's':
+        opt.sessions = atoi(optarg);
+        break;
+      case 't':
+        opt.tick_hz = atof(optarg);
+        break;
+      case 'w':
+        workloads = optarg;
+        break;
+      default: /* '?' */
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if ((opt.sessions < 1) || (opt.sessions > VBENCH_MAX_SESSIONS) ||
+      (opt.tick_hz <= 0.0) || !opt.duration_s) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  memset(scenes, 0, sizeof(scenes));
+  if (workloads) {
+    for (char *w = strtok(workloads, ","); w && scene_count < MAX_SCENES;
+         w = strtok(NULL, ",")) {
+      if (!activity_exists(w)) {
+        fprintf(stderr, "Unknown workload: %s\n", w);
+        return EXIT_FAILURE;
+      }
+      scenes[scene_count].name = w;
+      scenes[scene_count++].workload = w;
+    }
+  } else if (optind == argc) {
+    for (size_t i = 0; i < sizeof(g_default_scenes) / sizeof(char *); ++i) {
+      scenes[scene_count].name = g_default_scenes[i];
+      scenes[scene_count++].workload = g_default_scenes[i];
+    }
+  }
+
+  for (int i = optind; (i < argc) && (scene_count < MAX_SCENES); ++i) {
+    const char *slash = strrchr(argv[i], '/');
+    if (0 > recording_open(&scenes[scene_count].rec, argv[i])) {
+      return EXIT_FAILURE;
+    }
+    scenes[scene_count++].name = slash ? slash + 1 : argv[i];
+  }
+
+  g_ethertype = ETHERTYPE_RMTDOS;
+  memcpy(g_pktdrv_info.mac_addr, g_server_addr, ETH_ALEN);
+  buffer_init(DEFAULT_BUFFERS);
+  protocol_init();
+
+  printf("%d client(s), %ux%u screen, %.4f ticks/s\n\n", opt.sessions,
+         opt.text_cols, opt.text_rows, opt.tick_hz);
+  print_header();
+
+  for (int i = 0; i < scene_count; ++i) {
+    struct Scene *scene = &scenes[i];
+    struct SceneStats stats;
+    const uint64_t duration_ms = scene->workload
+                                     ? opt.duration_s * 1000ULL
+                                     : scene->rec.duration_us / 1000 + 1;
+
+    run_scene(&opt, scene, duration_ms, &stats);
+    print_scene(scene->name, opt.tick_hz, &stats);
+    fflush(stdout);
+
+    samples_free(&stats.consistent_ms);
+    if (!scene->workload) {
+      recording_release(&scene->rec);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
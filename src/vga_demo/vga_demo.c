@@ -4,10 +4,22 @@
  */
 
 // Utility to test VGA text mode capabilities.
+//
+// With "-p", it is instead the keystroke echo probe (see common/probe.h),
+// for measuring keystroke to echo latency with "rmtdos-client -E".
+//
+// With "-w", it is a screen workload generator, for benchmarking how the
+// server scans and sends screens that change in different ways.  The
+// screens drawn depend only on the workload, rate and seed, so runs before
+// and after a change to the server see identical input.
 
 #include <bios.h>
+#include <getopt.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "common/probe.h"
 #include "lib16/vga.h"
 #include "lib16/x86.h"
 
@@ -192,7 +204,322 @@ void process_keyboard() {
   key_events[--i] = regs.w.ax;
 }
 
+// Workload generator ("-w").
+struct Workload {
+  const char *name;
+  int default_rate; // Events per second.
+  void (*init)();
+  void (*step)(uint32_t n);
+};
+
+static int g_rows = 25;
+static int g_cols = 80;
+static uint16_t g_seed = 1;
+static uint16_t g_rand = 1;
+
+// 16-bit xorshift, so the sequence does not depend on the C library.
+static uint16_t next_rand() {
+  g_rand ^= g_rand << 7;
+  g_rand ^= g_rand >> 9;
+  g_rand ^= g_rand << 8;
+  return g_rand;
+}
+
+static void read_geometry() {
+  struct VgaState vga;
+
+  vga_read_state(&vga);
+  g_rows = vga.text_rows;
+  g_cols = vga.text_cols;
+}
+
+static void put_cell(int x, int y, uint8_t attr, char ch) {
+  char str[2];
+
+  str[0] = ch;
+  str[1] = 0;
+  vga_write_str(x, y, attr, str);
+}
+
+// Random printable text, `len` chars.
+static void random_text(char *dest, int len) {
+  int i;
+
+  for (i = 0; i < len; ++i) {
+    dest[i] = (next_rand() % 5) ? 'a' + next_rand() % 26 : ' ';
+  }
+  dest[len] = 0;
+}
+
+// Scrolls rows 1 and below up by one, as a program printing a log does,
+// with the BIOS (int 10h, AH=06h).
+static void step_scroll(uint32_t n) {
+  struct CpuRegs regs;
+  char line[VGA_COLS + 1];
+
+  x86_reset_regs(&regs);
+  regs.w.ax = 0x0601;
+  regs.b.bh = 0x07;
+  regs.w.cx = 0x0100;
+  regs.b.dh = g_rows - 1;
+  regs.b.dl = g_cols - 1;
+  x86_call(0x10, &regs);
+
+  sprintf(line, "%08lx ", n);
+  random_text(line + 9, ((g_cols < VGA_COLS) ? g_cols : VGA_COLS) - 9);
+  vga_write_str(0, g_rows - 1, 0x07, line);
+}
+
+// One cell, in the top right corner.
+static void step_clock(uint32_t n) {
+  put_cell(g_cols - 1, 0, 0x1e, '0' + (char)(n % 10));
+}
+
+// One random cell, below the title.
+static void step_churn(uint32_t n) {
+  const int x = next_rand() % g_cols;
+  const int y = 1 + next_rand() % (g_rows - 1);
+  const char ch = '!' + next_rand() % 94;
+
+  put_cell(x, y, 1 + next_rand() % 15, ch);
+}
+
+// Random text in random colors, for "attr".
+static void init_attr() {
+  char line[VGA_COLS + 1];
+  int y;
+
+  for (y = 1; y < g_rows; ++y) {
+    random_text(line, (g_cols < VGA_COLS) ? g_cols : VGA_COLS);
+    vga_write_str(0, y, 0x10 * (y % 8) + 7 + (y & 8), line);
+  }
+}
+
+// Swaps foreground and background of every cell below the title: all of
+// the attribute bytes change, none of the characters.
+static void step_attr(uint32_t n) {
+  uint8_t row[VGA_COLS * VGA_WORD];
+  const int words = (g_cols < VGA_COLS) ? g_cols : VGA_COLS;
+  uint16_t offset;
+  int x, y;
+
+  for (y = 1; y < g_rows; ++y) {
+    offset = y * g_cols * VGA_WORD;
+    vga_copy_from_frame_buffer(row, offset, words);
+    for (x = 1; x < words * VGA_WORD; x += 2) {
+      row[x] = (row[x] << 4) | (row[x] >> 4);
+    }
+    x86_memcpy_bytes(0xb800, offset, __get_ds(), (uint16_t)row,
+                     words * VGA_WORD);
+  }
+}
+
+static void draw_workload_title();
+
+// The test pattern, as the modes are cycled.
+static void init_modes() {
+  prep_screen();
+  draw_workload_title();
+}
+
+// Cycles through 80x25, 80x43 and 80x50, redrawing the test pattern.
+static void step_modes(uint32_t n) {
+  video_mode = (video_mode + 1) % VIDEO_MODES;
+  set_video_mode();
+  read_geometry();
+  draw_workload_title();
+}
+
+static const struct Workload g_workloads[] = {
+    {"scroll", 5, NULL, step_scroll}, {"clock", 1, NULL, step_clock},
+    {"churn", 50, NULL, step_churn},  {"attr", 1, init_attr, step_attr},
+    {"modes", 1, init_modes, step_modes},
+};
+
+#define WORKLOAD_COUNT (sizeof(g_workloads) / sizeof(g_workloads[0]))
+
+static const struct Workload *g_workload = NULL;
+static int g_rate = 0;
+
+static void draw_workload_title() {
+  vga_printf(0, 0, 0x70, "vga_demo: %s, %d/s, seed %u.  <ESC> Exit. ",
+             g_workload->name, g_rate, g_seed);
+}
+
+// Runs `g_workload` at `g_rate` events per second, paced by the BIOS tick
+// count, for `seconds` (0 until a key is pressed).  Event `n` always draws
+// the same thing, however late it runs.
+void run_workload(unsigned seconds) {
+  struct CpuRegs regs;
+  const uint32_t start = x86_read_bios_tick_clock();
+  uint32_t elapsed = 0;
+  uint32_t done = 0;
+  uint32_t due = 0;
+
+  g_rand = g_seed ? g_seed : 1;
+  set_video_mode();
+  read_geometry();
+  vga_clear_rows(0, g_rows);
+  draw_workload_title();
+  vga_gotoxy(0, g_rows);
+  if (g_workload->init) {
+    g_workload->init();
+  }
+
+  while (running) {
+    // 18.2 ticks per second.
+    elapsed = x86_read_bios_tick_clock() - start;
+    if (seconds && (elapsed * 10 >= (uint32_t)seconds * 182)) {
+      break;
+    }
+
+    due = elapsed * g_rate * 10 / 182;
+    for (; done < due; ++done) {
+      g_workload->step(done);
+    }
+
+    if (kbhit()) {
+      // <ESC> or <ALT-X> exits; other keys are ignored, as they would
+      // change the screen.
+      x86_reset_regs(&regs);
+      regs.w.ax = 0;
+      x86_call(0x16, &regs);
+      if ((regs.b.al == 0x1b) || (regs.w.ax == 0x2d00)) {
+        running = 0;
+      }
+    } else {
+      x86_dos_idle();
+    }
+  }
+}
+
+// Echo probe: draws each key read at the probe cell, after the count of keys
+// read so far.
+void run_probe() {
+  struct CpuRegs regs;
+  uint16_t received = 0;
+  char key[2];
+
+  vga_mode_80x25();
+  vga_clear_rows(0, VGA_ROWS);
+  vga_write_str(0, 0, 15, "rmtdos echo probe.  <ALT-X> Exit.");
+  vga_write_str(PROBE_COL, PROBE_ROW - 1, 7, "Key Count");
+  vga_printf(PROBE_COL + PROBE_COUNT_OFFSET, PROBE_ROW, PROBE_ATTR, "%04x",
+             received);
+  vga_gotoxy(0, VGA_ROWS - 2);
+
+  while (running) {
+    while (!kbhit()) {
+      x86_dos_idle();
+    }
+
+    x86_reset_regs(&regs);
+    regs.w.ax = 0;
+    x86_call(0x16, &regs);
+
+    if (regs.w.ax == 0x2d00) { // ALT-X
+      running = 0;
+      break;
+    }
+
+    ++received;
+    vga_printf(PROBE_COL + PROBE_COUNT_OFFSET, PROBE_ROW, PROBE_ATTR, "%04x",
+               received);
+
+    key[0] = regs.b.al ? regs.b.al : ' ';
+    key[1] = 0;
+    vga_write_str(PROBE_COL, PROBE_ROW, PROBE_ATTR, key);
+  }
+}
+
+void print_usage() {
+  printf("Usage: vga_demo [-p] [-w workload [-r rate] [-s seed] [-d secs] "
+         "[-g rows]]\n");
+  printf("  -p  Keystroke echo probe, for \"rmtdos-client -E\".\n");
+  printf("  -w  Screen workload: scroll, clock, churn, attr or modes.\n");
+  printf("  -r  Events per second (lines, ticks, cells, flips or modes).\n");
+  printf("  -s  Seed (default 1).  Same seed and rate, same screens.\n");
+  printf("  -d  Exit after this many seconds (default: at <ESC>).\n");
+  printf("  -g  Text rows to start with: 25, 43 or 50 (default 25).\n");
+}
+
+static const struct Workload *find_workload(const char *name) {
+  int i;
+
+  for (i = 0; i < WORKLOAD_COUNT; ++i) {
+    if (!strcmp(g_workloads[i].name, name)) {
+      return &g_workloads[i];
+    }
+  }
+  return NULL;
+}
+
 int main(int argc, char *argv[]) {
+  int opt = 0;
+  int probe = 0;
+  int rows = 25;
+  unsigned seconds = 0;
+
+  while (-1 != (opt = getopt(argc, argv, "d:g:hpr:s:w:"))) {
+    switch (opt) {
+      case 'd':
+        seconds = atoi(optarg);
+        break;
+
+      case 'g':
+        rows = atoi(optarg);
+        break;
+
+      case 'p':
+        probe = 1;
+        break;
+
+      case 'r':
+        g_rate = atoi(optarg);
+        break;
+
+      case 's':
+        g_seed = atoi(optarg);
+        break;
+
+      case 'w':
+        if (!(g_workload = find_workload(optarg))) {
+          print_usage();
+          return EXIT_FAILURE;
+        }
+        break;
+
+      case 'h':
+        print_usage();
+        return EXIT_SUCCESS;
+
+      default:
+        print_usage();
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (probe) {
+    run_probe();
+    vga_clear_rows(0, VGA_ROWS);
+    vga_gotoxy(0, 0);
+    return 0;
+  }
+
+  video_mode = (rows >= 50) ? 2 : ((rows >= 43) ? 1 : 0);
+
+  if (g_workload) {
+    if (g_rate < 1) {
+      g_rate = g_workload->default_rate;
+    }
+    run_workload(seconds);
+    video_mode = 0;
+    set_video_mode();
+    vga_clear_rows(0, VGA_ROWS);
+    vga_gotoxy(0, 0);
+    return 0;
+  }
+
   set_video_mode();
   prep_screen();
 